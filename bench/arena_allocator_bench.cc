@@ -0,0 +1,88 @@
+#include "bench.h"
+
+#include "arena_allocator.h"
+
+#include <vector>
+#include <stdlib.h>
+
+namespace {
+
+const uint32_t BLOCK_COUNT = 1024;
+
+// Sizes like the driver's object allocations, mostly small with the odd large one.
+size_t GetBlockSize(uint32_t i) {
+	return 16 + (i * 37) % 480 + (i % 64 == 0 ? 2048 : 0);
+}
+
+// Allocates BLOCK_COUNT blocks and frees them in an interleaved order, as objects are created
+// and destroyed. Items are allocations.
+void BenchSizeClassPool(BenchmarkState& state) {
+	SizeClassPool pool;
+	std::vector<void*> blocks(BLOCK_COUNT);
+	while (state.KeepRunning()) {
+		for (uint32_t i = 0; i < BLOCK_COUNT; ++i) {
+			blocks[i] = pool.Allocate(GetBlockSize(i));
+		}
+		DoNotOptimize(blocks[BLOCK_COUNT - 1]);
+		for (uint32_t i = 0; i < BLOCK_COUNT; i += 2) {
+			pool.Free(blocks[i], GetBlockSize(i));
+		}
+		for (uint32_t i = 1; i < BLOCK_COUNT; i += 2) {
+			pool.Free(blocks[i], GetBlockSize(i));
+		}
+	}
+	state.SetItemsPerIteration(BLOCK_COUNT);
+}
+
+// The same pattern on the C heap, for comparison.
+void BenchMalloc(BenchmarkState& state) {
+	std::vector<void*> blocks(BLOCK_COUNT);
+	while (state.KeepRunning()) {
+		for (uint32_t i = 0; i < BLOCK_COUNT; ++i) {
+			blocks[i] = malloc(GetBlockSize(i));
+		}
+		DoNotOptimize(blocks[BLOCK_COUNT - 1]);
+		for (uint32_t i = 0; i < BLOCK_COUNT; i += 2) {
+			free(blocks[i]);
+		}
+		for (uint32_t i = 1; i < BLOCK_COUNT; i += 2) {
+			free(blocks[i]);
+		}
+	}
+	state.SetItemsPerIteration(BLOCK_COUNT);
+}
+
+// A query result list like FindQueueFamilies fills, built in a scratch arena and rewound.
+void BenchScratchVector(BenchmarkState& state) {
+	LinearArena arena;
+	while (state.KeepRunning()) {
+		ScratchScope scratch(arena);
+		ArenaAllocator<uint64_t> scratch_allocator(arena);
+		ScratchVector<uint64_t> values(scratch_allocator);
+		for (uint32_t i = 0; i < BLOCK_COUNT; ++i) {
+			values.push_back(i);
+		}
+		DoNotOptimize(values.back());
+	}
+	state.SetItemsPerIteration(BLOCK_COUNT);
+}
+
+void BenchHeapVector(BenchmarkState& state) {
+	while (state.KeepRunning()) {
+		std::vector<uint64_t> values;
+		for (uint32_t i = 0; i < BLOCK_COUNT; ++i) {
+			values.push_back(i);
+		}
+		DoNotOptimize(values.back());
+	}
+	state.SetItemsPerIteration(BLOCK_COUNT);
+}
+
+}
+
+void RegisterArenaAllocatorBenchmarks() {
+	RegisterBenchmark("arena_allocator/size_class_pool/1024", BenchSizeClassPool);
+	RegisterBenchmark("arena_allocator/malloc/1024", BenchMalloc);
+	RegisterBenchmark("arena_allocator/scratch_vector/1024", BenchScratchVector);
+	RegisterBenchmark("arena_allocator/heap_vector/1024", BenchHeapVector);
+}
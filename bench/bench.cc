@@ -0,0 +1,258 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+struct Benchmark {
+	std::string name;
+	BenchmarkFunction function;
+};
+
+struct BenchmarkResult {
+	std::string name;
+	uint64_t iterations;
+	std::vector<double> samples_ns;
+	double mean_ns;
+	double median_ns;
+	double stddev_ns;
+	double mad_ns;
+	double min_ns;
+	double max_ns;
+	double ci95_ns;
+	double bytes_per_second;
+	double items_per_second;
+};
+
+struct Options {
+	int repetitions = 20;
+	int warmup_repetitions = 2;
+	double min_time = 0.02;
+	std::string filter;
+	std::string json_path;
+};
+
+std::vector<Benchmark>& Registry() {
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+// Runs the benchmark once and returns the elapsed time in nanoseconds.
+double RunOnce(const Benchmark& benchmark, uint64_t iterations, BenchmarkState* out_state = nullptr) {
+	BenchmarkState state(iterations);
+	auto start = std::chrono::steady_clock::now();
+	benchmark.function(state);
+	auto end = std::chrono::steady_clock::now();
+	if (out_state) {
+		*out_state = state;
+	}
+	return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Grows the iteration count until a single repetition takes at least min_time seconds.
+uint64_t CalibrateIterations(const Benchmark& benchmark, double min_time) {
+	uint64_t iterations = 1;
+	for (;;) {
+		double elapsed = RunOnce(benchmark, iterations) * 1e-9;
+		if (elapsed >= min_time || iterations >= (1ull << 40)) {
+			return iterations;
+		}
+		double scale = elapsed > 0.0 ? std::min(10.0, std::max(1.5, 1.4 * min_time / elapsed)) : 10.0;
+		iterations = static_cast<uint64_t>(std::ceil(iterations * scale));
+	}
+}
+
+double Median(std::vector<double> values) {
+	std::sort(values.begin(), values.end());
+	size_t n = values.size();
+	return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+// Two sided 95% Student t quantile, used for the confidence interval of the mean.
+double StudentT95(size_t degrees_of_freedom) {
+	static const double table[] = {
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+	};
+	if (degrees_of_freedom == 0) {
+		return 0.0;
+	}
+	if (degrees_of_freedom <= 30) {
+		return table[degrees_of_freedom - 1];
+	}
+	return 1.96;
+}
+
+BenchmarkResult RunBenchmark(const Benchmark& benchmark, const Options& options) {
+	BenchmarkResult result = {};
+	result.name = benchmark.name;
+	result.iterations = CalibrateIterations(benchmark, options.min_time);
+
+	for (int i = 0; i < options.warmup_repetitions; ++i) {
+		RunOnce(benchmark, result.iterations);
+	}
+
+	BenchmarkState state(0);
+	for (int i = 0; i < options.repetitions; ++i) {
+		result.samples_ns.push_back(RunOnce(benchmark, result.iterations, &state) / result.iterations);
+	}
+
+	const std::vector<double>& samples = result.samples_ns;
+	size_t n = samples.size();
+
+	double sum = 0.0;
+	for (double sample : samples) {
+		sum += sample;
+	}
+	result.mean_ns = sum / n;
+
+	double variance = 0.0;
+	for (double sample : samples) {
+		variance += (sample - result.mean_ns) * (sample - result.mean_ns);
+	}
+	result.stddev_ns = n > 1 ? std::sqrt(variance / (n - 1)) : 0.0;
+	result.ci95_ns = StudentT95(n - 1) * result.stddev_ns / std::sqrt(static_cast<double>(n));
+
+	result.median_ns = Median(samples);
+	std::vector<double> deviations;
+	for (double sample : samples) {
+		deviations.push_back(std::fabs(sample - result.median_ns));
+	}
+	result.mad_ns = Median(deviations);
+
+	result.min_ns = *std::min_element(samples.begin(), samples.end());
+	result.max_ns = *std::max_element(samples.begin(), samples.end());
+
+	// Throughput is reported against the median, which is robust to scheduler noise.
+	result.bytes_per_second = state.bytes_per_iteration * 1e9 / result.median_ns;
+	result.items_per_second = state.items_per_iteration * 1e9 / result.median_ns;
+
+	return result;
+}
+
+std::string EscapeJson(const std::string& value) {
+	std::string escaped;
+	for (char c : value) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+void WriteJson(std::ostream& out, const std::vector<BenchmarkResult>& results, const Options& options) {
+	out << "{\n";
+	out << "  \"context\": {\n";
+	out << "    \"repetitions\": " << options.repetitions << ",\n";
+	out << "    \"warmup_repetitions\": " << options.warmup_repetitions << ",\n";
+	out << "    \"min_time_s\": " << options.min_time << ",\n";
+#ifdef NDEBUG
+	out << "    \"build_type\": \"release\"\n";
+#else
+	out << "    \"build_type\": \"debug\"\n";
+#endif
+	out << "  },\n";
+	out << "  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const BenchmarkResult& result = results[i];
+		out << "    {\n";
+		out << "      \"name\": \"" << EscapeJson(result.name) << "\",\n";
+		out << "      \"iterations\": " << result.iterations << ",\n";
+		out << "      \"mean_ns\": " << result.mean_ns << ",\n";
+		out << "      \"median_ns\": " << result.median_ns << ",\n";
+		out << "      \"stddev_ns\": " << result.stddev_ns << ",\n";
+		out << "      \"mad_ns\": " << result.mad_ns << ",\n";
+		out << "      \"min_ns\": " << result.min_ns << ",\n";
+		out << "      \"max_ns\": " << result.max_ns << ",\n";
+		out << "      \"ci95_ns\": " << result.ci95_ns << ",\n";
+		out << "      \"bytes_per_second\": " << result.bytes_per_second << ",\n";
+		out << "      \"items_per_second\": " << result.items_per_second << ",\n";
+		out << "      \"samples_ns\": [";
+		for (size_t j = 0; j < result.samples_ns.size(); ++j) {
+			out << (j ? ", " : "") << result.samples_ns[j];
+		}
+		out << "]\n";
+		out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}\n";
+}
+
+void PrintUsage() {
+	std::cerr << "usage: vulkan_tutorial_bench [--filter substring] [--repetitions n] [--min-time seconds] [--json path]" << std::endl;
+}
+
+}
+
+void RegisterBenchmark(const std::string& name, BenchmarkFunction function) {
+	Registry().push_back({ name, function });
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--filter") == 0 && has_value) {
+			options.filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "--repetitions") == 0 && has_value) {
+			options.repetitions = std::max(2, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--min-time") == 0 && has_value) {
+			options.min_time = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--json") == 0 && has_value) {
+			options.json_path = argv[++i];
+		}
+		else {
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	RegisterRenderHelpersBenchmarks();
+	RegisterTransformHierarchyBenchmarks();
+	RegisterTextureStreamingBenchmarks();
+	RegisterQuadBatchBenchmarks();
+	RegisterFrameCaptureBenchmarks();
+	RegisterJobSystemBenchmarks();
+	RegisterMeshLodBenchmarks();
+	RegisterClusteredLightingBenchmarks();
+	RegisterArenaAllocatorBenchmarks();
+	RegisterMeshletsBenchmarks();
+	RegisterResolutionScalingBenchmarks();
+	RegisterFrameExportBenchmarks();
+
+	std::vector<BenchmarkResult> results;
+	for (const Benchmark& benchmark : Registry()) {
+		if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+			continue;
+		}
+		results.push_back(RunBenchmark(benchmark, options));
+
+		const BenchmarkResult& result = results.back();
+		std::cerr << result.name << ": median " << result.median_ns << " ns, mean " << result.mean_ns
+			<< " +- " << result.ci95_ns << " ns (95% CI), mad " << result.mad_ns << " ns" << std::endl;
+	}
+
+	// JSON goes to stdout unless a file is given, so the human readable summary on stderr doesn't mix in.
+	if (options.json_path.empty()) {
+		WriteJson(std::cout, results, options);
+	}
+	else {
+		std::ofstream file(options.json_path);
+		WriteJson(file, results, options);
+	}
+
+	return 0;
+}
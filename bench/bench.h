@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Minimal benchmark harness: every benchmark is run for a calibrated number of iterations,
+// repeated several times, and summarized with robust statistics.
+
+class BenchmarkState {
+public:
+	explicit BenchmarkState(uint64_t iterations) : iterations(iterations), remaining(iterations) {}
+
+	bool KeepRunning() {
+		if (remaining == 0) {
+			return false;
+		}
+		--remaining;
+		return true;
+	}
+
+	uint64_t Iterations() const { return iterations; }
+
+	// Work done by a single iteration, used to report throughput.
+	void SetBytesPerIteration(uint64_t bytes) { bytes_per_iteration = bytes; }
+	void SetItemsPerIteration(uint64_t items) { items_per_iteration = items; }
+
+	uint64_t bytes_per_iteration = 0;
+	uint64_t items_per_iteration = 0;
+
+private:
+	uint64_t iterations;
+	uint64_t remaining;
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState& state);
+
+void RegisterBenchmark(const std::string& name, BenchmarkFunction function);
+
+// Keeps the compiler from discarding a computed value.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile const void* sink;
+	sink = &value;
+#endif
+}
+
+// Registration entry points of the individual benchmark files.
+void RegisterRenderHelpersBenchmarks();
+void RegisterTransformHierarchyBenchmarks();
+void RegisterTextureStreamingBenchmarks();
+void RegisterQuadBatchBenchmarks();
+void RegisterFrameCaptureBenchmarks();
+void RegisterJobSystemBenchmarks();
+void RegisterMeshLodBenchmarks();
+void RegisterClusteredLightingBenchmarks();
+void RegisterArenaAllocatorBenchmarks();
+void RegisterMeshletsBenchmarks();
+void RegisterResolutionScalingBenchmarks();
+void RegisterFrameExportBenchmarks();
@@ -0,0 +1,52 @@
+#include "bench.h"
+
+#include "clustered_lighting.h"
+#include "render_helpers.h"
+
+#include <vector>
+
+namespace {
+
+const uint32_t LIGHT_COUNT = 4096;
+
+// The stress scene's lights over the quad, seen by the default camera.
+ClusterUniforms MakeStressClusters(std::vector<PointLight>& lights) {
+	lights = GenerateStressLights(LIGHT_COUNT, glm::vec3(-0.6f, -0.6f, 0.02f), glm::vec3(0.6f, 0.6f, 0.3f), 0.04f, 0.12f, 0.5f, 1);
+	Camera camera = { glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+	VkExtent2D extent = { 1280, 720 };
+	return ComputeClusterUniforms(ComputeView(camera), ComputeProjection(extent), extent, LIGHT_COUNT, true);
+}
+
+// The CPU reference of light_cluster.comp. Items are light-cluster tests.
+void BenchAssignLightsToClusters(BenchmarkState& state) {
+	std::vector<PointLight> lights;
+	ClusterUniforms uniforms = MakeStressClusters(lights);
+	std::vector<uint32_t> cluster_lights;
+	while (state.KeepRunning()) {
+		AssignLightsToClusters(uniforms, lights, cluster_lights);
+		DoNotOptimize(cluster_lights[0]);
+	}
+	state.SetItemsPerIteration(static_cast<uint64_t>(CLUSTER_COUNT) * LIGHT_COUNT);
+}
+
+// What a fragment does to find its lights; each item is one fragment.
+void BenchGetClusterSlice(BenchmarkState& state) {
+	const uint32_t FRAGMENT_COUNT = 10000;
+	std::vector<PointLight> lights;
+	ClusterUniforms uniforms = MakeStressClusters(lights);
+	uint32_t slices = 0;
+	while (state.KeepRunning()) {
+		for (uint32_t i = 0; i < FRAGMENT_COUNT; ++i) {
+			slices += GetClusterSlice(uniforms, 0.1f + i * 0.001f);
+		}
+		DoNotOptimize(slices);
+	}
+	state.SetItemsPerIteration(FRAGMENT_COUNT);
+}
+
+}
+
+void RegisterClusteredLightingBenchmarks() {
+	RegisterBenchmark("clustered_lighting/assign/4096", BenchAssignLightsToClusters);
+	RegisterBenchmark("clustered_lighting/slice/10000", BenchGetClusterSlice);
+}
@@ -0,0 +1,81 @@
+#include "bench.h"
+
+#include "frame_capture.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+namespace {
+
+const uint32_t FRAME_COUNT = 1000;
+
+// A spinning quad seen from an orbiting camera: every frame changes the animation time and
+// the object transform, every tenth moves the camera, and the first frames stream a texture.
+std::vector<CapturedFrame> MakeFrames() {
+	std::vector<CapturedFrame> frames(FRAME_COUNT);
+	VkExtent2D extent = { 1920, 1080 };
+	for (uint32_t i = 0; i < FRAME_COUNT; ++i) {
+		CapturedFrame& frame = frames[i];
+		frame.animation_time = i / 60.0f;
+		frame.camera_eye = glm::vec3(2.0f + (i / 10) * 0.01f, 2.0f, 2.0f);
+		frame.extent = extent;
+		frame.projection = { ComputeProjection(extent) };
+		frame.camera = { ComputeView({ frame.camera_eye, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f) }) };
+		frame.object = { glm::rotate(glm::mat4(1.0f), frame.animation_time, glm::vec3(0.0f, 0.0f, 1.0f)) };
+		frame.draw_flags = FRAME_DRAW_SCENE | (i > 0 ? FRAME_DRAW_PARTICLES : 0);
+		frame.overlay_quads = 123;
+		if (i == 1) {
+			frame.registered_textures.push_back(0);
+		}
+		if (i >= 1 && i <= 11) {
+			frame.uploads.push_back({ 0, 11 - (i - 1) });
+		}
+	}
+	return frames;
+}
+
+void BenchEncodeFrames(BenchmarkState& state) {
+	std::vector<CapturedFrame> frames = MakeFrames();
+	std::vector<char> data;
+	while (state.KeepRunning()) {
+		data.clear();
+		CapturedFrame previous;
+		for (const CapturedFrame& frame : frames) {
+			EncodeFrame(previous, frame, data);
+			previous = frame;
+		}
+		DoNotOptimize(data.data());
+	}
+	state.SetItemsPerIteration(FRAME_COUNT);
+	state.SetBytesPerIteration(data.size());
+}
+
+void BenchDecodeFrames(BenchmarkState& state) {
+	std::vector<CapturedFrame> frames = MakeFrames();
+	std::vector<char> data;
+	CapturedFrame previous;
+	for (const CapturedFrame& frame : frames) {
+		EncodeFrame(previous, frame, data);
+		previous = frame;
+	}
+
+	CapturedFrame frame;
+	while (state.KeepRunning()) {
+		size_t offset = 0;
+		previous = CapturedFrame();
+		while (offset < data.size() && DecodeFrame(data, offset, previous, frame)) {
+			previous = frame;
+		}
+		DoNotOptimize(frame.animation_time);
+	}
+	state.SetItemsPerIteration(FRAME_COUNT);
+	state.SetBytesPerIteration(data.size());
+}
+
+}
+
+void RegisterFrameCaptureBenchmarks() {
+	RegisterBenchmark("capture/encode/1000", BenchEncodeFrames);
+	RegisterBenchmark("capture/decode/1000", BenchDecodeFrames);
+}
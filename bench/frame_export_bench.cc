@@ -0,0 +1,34 @@
+#include "bench.h"
+
+#include "frame_export.h"
+
+#include <vector>
+
+namespace {
+
+const uint32_t WIDTH = 1920;
+const uint32_t HEIGHT = 1080;
+
+// What the export worker does to every row of a PPM sequence: a 1080p frame of BGRA swap chain
+// pixels repacked as RGB.
+void BenchConvertFrameToRgb(BenchmarkState& state) {
+	std::vector<uint8_t> pixels(WIDTH * HEIGHT * 4);
+	for (size_t i = 0; i < pixels.size(); ++i) {
+		pixels[i] = static_cast<uint8_t>(i * 7);
+	}
+	std::vector<uint8_t> rgb(WIDTH * 3);
+	while (state.KeepRunning()) {
+		for (uint32_t y = 0; y < HEIGHT; ++y) {
+			ConvertRowToRgb(pixels.data() + y * WIDTH * 4, WIDTH, true, rgb.data());
+			DoNotOptimize(rgb.data());
+		}
+	}
+	state.SetItemsPerIteration(HEIGHT);
+	state.SetBytesPerIteration(pixels.size());
+}
+
+}
+
+void RegisterFrameExportBenchmarks() {
+	RegisterBenchmark("frame_export/convert_rgb/1080p", BenchConvertFrameToRgb);
+}
@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#include "job_system.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint32_t ITEM_COUNT = 1 << 18;
+const uint32_t EMPTY_JOB_COUNT = 4096;
+
+// THREADS is the thread count, or 0 for every hardware thread, which is only known at run
+// time; benchmarks are plain functions, so it is resolved here.
+template <uint32_t THREADS>
+uint32_t GetThreadCount() {
+	return THREADS > 0 ? THREADS : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// One system per thread count, kept for the whole run so thread start up is not measured.
+template <uint32_t THREADS>
+JobSystem& GetJobSystem() {
+	static JobSystem jobs(GetThreadCount<THREADS>() - 1, true);
+	return jobs;
+}
+
+// A transform update sized workload: every item composes a few matrices.
+template <uint32_t THREADS>
+void BenchParallelFor(BenchmarkState& state) {
+	JobSystem& jobs = GetJobSystem<THREADS>();
+	std::vector<glm::mat4> matrices(ITEM_COUNT);
+	while (state.KeepRunning()) {
+		jobs.ParallelFor(ITEM_COUNT, 0, [&matrices](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i) {
+				float f = static_cast<float>(i & 255);
+				glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(f, 0.5f * f, 1.0f));
+				local = glm::rotate(local, 0.01f * f, glm::vec3(0.0f, 0.0f, 1.0f));
+				matrices[i] = glm::scale(local, glm::vec3(1.0f + 0.001f * f)) * local;
+			}
+		});
+		DoNotOptimize(matrices[ITEM_COUNT - 1]);
+	}
+	state.SetItemsPerIteration(ITEM_COUNT);
+}
+
+// Scheduling overhead: jobs that do nothing.
+template <uint32_t THREADS>
+void BenchEmptyJobs(BenchmarkState& state) {
+	JobSystem& jobs = GetJobSystem<THREADS>();
+	while (state.KeepRunning()) {
+		JobCounter counter;
+		for (uint32_t i = 0; i < EMPTY_JOB_COUNT; ++i) {
+			jobs.Schedule(counter, []() {});
+		}
+		jobs.Wait(counter);
+	}
+	state.SetItemsPerIteration(EMPTY_JOB_COUNT);
+}
+
+template <uint32_t THREADS>
+void RegisterForThreadCount() {
+	// Scaling past the hardware threads only measures oversubscription.
+	if (THREADS > 1 && THREADS > std::thread::hardware_concurrency()) {
+		return;
+	}
+	std::string threads = std::to_string(GetThreadCount<THREADS>());
+	RegisterBenchmark("jobs/parallel_for/" + threads, BenchParallelFor<THREADS>);
+	RegisterBenchmark("jobs/empty_jobs/" + threads, BenchEmptyJobs<THREADS>);
+}
+
+}
+
+void RegisterJobSystemBenchmarks() {
+	RegisterForThreadCount<1>();
+	RegisterForThreadCount<2>();
+	RegisterForThreadCount<4>();
+	RegisterForThreadCount<8>();
+	RegisterForThreadCount<16>();
+	RegisterForThreadCount<32>();
+	RegisterForThreadCount<64>();
+	// Every hardware thread, unless that is one of the counts above.
+	uint32_t hardware_threads = GetThreadCount<0>();
+	if ((hardware_threads & (hardware_threads - 1)) != 0 || hardware_threads > 64) {
+		RegisterForThreadCount<0>();
+	}
+}
@@ -0,0 +1,57 @@
+#include "bench.h"
+
+#include "mesh_lod.h"
+#include "render_helpers.h"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const uint32_t GRID_SUBDIVISIONS = 64;
+const uint32_t LOD_COUNT = 6;
+
+// A tessellated quad displaced into waves, so collapses have a real error to rank by.
+void MakeWavyGrid(std::vector<glm::vec3>& positions, std::vector<uint16_t>& indices) {
+	std::vector<Vertex> vertices;
+	TessellateQuad(GRID_SUBDIVISIONS, vertices, indices);
+	positions.clear();
+	for (const auto& vertex : vertices) {
+		positions.push_back(glm::vec3(vertex.pos, 0.1f * std::sin(vertex.pos.x * 12.0f) * std::cos(vertex.pos.y * 9.0f)));
+	}
+}
+
+// The whole offline step: 8192 triangles down to a chain of LOD_COUNT levels.
+void BenchBuildMeshLods(BenchmarkState& state) {
+	std::vector<glm::vec3> positions;
+	std::vector<uint16_t> grid_indices;
+	MakeWavyGrid(positions, grid_indices);
+	while (state.KeepRunning()) {
+		std::vector<uint16_t> indices(grid_indices);
+		std::vector<MeshLod> lods = BuildMeshLods(positions, indices, LOD_COUNT, 0.5f);
+		DoNotOptimize(lods.back().index_count);
+	}
+	state.SetItemsPerIteration(grid_indices.size() / 3);
+}
+
+void BenchSelectMeshLod(BenchmarkState& state) {
+	const uint32_t OBJECT_COUNT = 10000;
+	std::vector<uint32_t> lods(OBJECT_COUNT, 0);
+	float frame = 0.0f;
+	while (state.KeepRunning()) {
+		for (uint32_t i = 0; i < OBJECT_COUNT; ++i) {
+			float screen_size = 0.02f + 0.5f * (1.0f + std::sin(frame + i * 0.01f));
+			lods[i] = SelectMeshLod(screen_size, lods[i], LOD_COUNT, 0.5f, 0.15f);
+		}
+		frame += 0.1f;
+		DoNotOptimize(lods[0]);
+	}
+	state.SetItemsPerIteration(OBJECT_COUNT);
+}
+
+}
+
+void RegisterMeshLodBenchmarks() {
+	RegisterBenchmark("mesh_lod/build/8192", BenchBuildMeshLods);
+	RegisterBenchmark("mesh_lod/select/10000", BenchSelectMeshLod);
+}
@@ -0,0 +1,67 @@
+#include "bench.h"
+
+#include "meshlets.h"
+#include "render_helpers.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const uint32_t GRID_SUBDIVISIONS = 64;
+
+// A tessellated quad displaced into waves, so the meshlets' normal cones have some spread.
+void MakeWavyGrid(std::vector<glm::vec3>& positions, std::vector<uint16_t>& indices) {
+	std::vector<Vertex> vertices;
+	TessellateQuad(GRID_SUBDIVISIONS, vertices, indices);
+	positions.clear();
+	for (const auto& vertex : vertices) {
+		positions.push_back(glm::vec3(vertex.pos, 0.05f * std::sin(vertex.pos.x * 12.0f) * std::cos(vertex.pos.y * 9.0f)));
+	}
+}
+
+// The offline step for 8192 triangles.
+void BenchBuildMeshlets(BenchmarkState& state) {
+	std::vector<glm::vec3> positions;
+	std::vector<uint16_t> indices;
+	MakeWavyGrid(positions, indices);
+	while (state.KeepRunning()) {
+		MeshletMesh mesh;
+		MeshletRange range = BuildMeshlets(positions, indices, 0, static_cast<uint32_t>(indices.size()), mesh);
+		DoNotOptimize(range.meshlet_count);
+	}
+	state.SetItemsPerIteration(indices.size() / 3);
+}
+
+// What meshlet_cull.comp does per meshlet, from a camera below the grid: most meshlets face
+// away from it and are rejected by their cones.
+void BenchCullMeshlets(BenchmarkState& state) {
+	std::vector<glm::vec3> positions;
+	std::vector<uint16_t> indices;
+	MakeWavyGrid(positions, indices);
+	MeshletMesh mesh;
+	BuildMeshlets(positions, indices, 0, static_cast<uint32_t>(indices.size()), mesh);
+
+	glm::vec3 eye(0.3f, 0.2f, -1.5f);
+	glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	std::array<glm::vec4, 6> planes = ExtractFrustumPlanes(ComputeProjection({ 800, 600 }) * view);
+	while (state.KeepRunning()) {
+		uint32_t drawn = 0;
+		for (const auto& meshlet : mesh.meshlets) {
+			if (IsSphereInFrustum(planes, glm::vec3(meshlet.sphere), meshlet.sphere.w) && !IsMeshletBackfacing(meshlet, eye)) {
+				++drawn;
+			}
+		}
+		DoNotOptimize(drawn);
+	}
+	state.SetItemsPerIteration(mesh.meshlets.size());
+}
+
+}
+
+void RegisterMeshletsBenchmarks() {
+	RegisterBenchmark("meshlets/build/8192", BenchBuildMeshlets);
+	RegisterBenchmark("meshlets/cull/8192", BenchCullMeshlets);
+}
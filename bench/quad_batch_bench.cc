@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#include "quad_batch.h"
+
+#include <vector>
+
+namespace {
+
+const uint32_t QUAD_COUNT = 100000;
+const uint32_t CHUNK_QUADS = 16384;
+
+// Stands in for the renderer's mapped chunks: the same memory for every chunk, draws only
+// counted, so the numbers are the CPU cost of writing the vertices.
+class MemoryTarget : public QuadBatchTarget {
+public:
+	MemoryTarget() : vertices(CHUNK_QUADS * 4 + 1) {}
+
+	BatchVertex* AcquireChunk(uint32_t& quad_capacity) override {
+		quad_capacity = CHUNK_QUADS;
+		// vector storage is only guaranteed 8 byte aligned.
+		uintptr_t address = reinterpret_cast<uintptr_t>(vertices.data());
+		return reinterpret_cast<BatchVertex*>((address + 15) & ~uintptr_t(15));
+	}
+
+	void SubmitDraws(const std::vector<QuadBatchDraw>& draws) override {
+		draw_count += draws.size();
+	}
+
+	std::vector<BatchVertex> vertices;
+	uint64_t draw_count = 0;
+};
+
+void BenchDrawQuads(BenchmarkState& state) {
+	MemoryTarget target;
+	QuadBatch batch(target);
+	uint32_t color = PackColor(1.0f, 0.5f, 0.25f);
+	while (state.KeepRunning()) {
+		batch.Begin({ 1920, 1080 });
+		for (uint32_t i = 0; i < QUAD_COUNT; ++i) {
+			batch.DrawQuad(static_cast<float>(i % 480) * 4.0f, static_cast<float>(i / 480) * 4.0f, 3.0f, 3.0f, color);
+		}
+		batch.End();
+		DoNotOptimize(target.draw_count);
+	}
+	state.SetItemsPerIteration(QUAD_COUNT);
+}
+
+void BenchDrawLines(BenchmarkState& state) {
+	MemoryTarget target;
+	QuadBatch batch(target);
+	uint32_t color = PackColor(0.25f, 1.0f, 0.5f);
+	while (state.KeepRunning()) {
+		batch.Begin({ 1920, 1080 });
+		for (uint32_t i = 0; i < QUAD_COUNT; ++i) {
+			float x = static_cast<float>(i % 480) * 4.0f;
+			float y = static_cast<float>(i / 480) * 4.0f;
+			batch.DrawLine(x, y, x + 3.0f, y + 2.0f, 1.0f, color);
+		}
+		batch.End();
+		DoNotOptimize(target.draw_count);
+	}
+	state.SetItemsPerIteration(QUAD_COUNT);
+}
+
+// Scissor changes every 64 quads, the worst case for draw merging a HUD of clipped panels
+// would produce.
+void BenchDrawClippedQuads(BenchmarkState& state) {
+	MemoryTarget target;
+	QuadBatch batch(target);
+	uint32_t color = PackColor(1.0f, 1.0f, 1.0f, 0.5f);
+	while (state.KeepRunning()) {
+		batch.Begin({ 1920, 1080 });
+		for (uint32_t i = 0; i < QUAD_COUNT; ++i) {
+			if (i % 64 == 0) {
+				batch.SetScissor({ { static_cast<int32_t>(i / 64 % 16) * 100, 0 }, { 100, 1080 } });
+			}
+			batch.DrawQuad(static_cast<float>(i % 480) * 4.0f, static_cast<float>(i / 480) * 4.0f, 3.0f, 3.0f, color);
+		}
+		batch.End();
+		DoNotOptimize(target.draw_count);
+	}
+	state.SetItemsPerIteration(QUAD_COUNT);
+}
+
+}
+
+void RegisterQuadBatchBenchmarks() {
+	RegisterBenchmark("overlay/quads/100000", BenchDrawQuads);
+	RegisterBenchmark("overlay/lines/100000", BenchDrawLines);
+	RegisterBenchmark("overlay/clipped_quads/100000", BenchDrawClippedQuads);
+}
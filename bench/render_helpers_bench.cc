@@ -0,0 +1,180 @@
+#include "bench.h"
+
+#include "render_helpers.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const char* READ_FILE_PATH = "vulkan_tutorial_bench_read_file.bin";
+const size_t READ_FILE_SIZE = 64 * 1024;
+
+void BenchComputeProjection(BenchmarkState& state) {
+	VkExtent2D extent = { 1920, 1080 };
+	while (state.KeepRunning()) {
+		glm::mat4 proj = ComputeProjection(extent);
+		DoNotOptimize(proj);
+		extent.width = extent.width == 1920 ? 1919 : 1920;
+	}
+}
+
+void BenchComputeView(BenchmarkState& state) {
+	Camera camera = { glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+	while (state.KeepRunning()) {
+		glm::mat4 view = ComputeView(camera);
+		DoNotOptimize(view);
+		camera.eye.x += 0.001f;
+	}
+}
+
+void BenchRotate(BenchmarkState& state) {
+	float angle = 0.0f;
+	while (state.KeepRunning()) {
+		glm::mat4 model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 0.0f, 1.0f));
+		DoNotOptimize(model);
+		angle += 0.01f;
+	}
+}
+
+void BenchLookAt(BenchmarkState& state) {
+	glm::vec3 eye(2.0f, 2.0f, 2.0f);
+	while (state.KeepRunning()) {
+		glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		DoNotOptimize(view);
+		eye.x += 0.001f;
+	}
+}
+
+void BenchPerspective(BenchmarkState& state) {
+	float aspect = 16.0f / 9.0f;
+	while (state.KeepRunning()) {
+		glm::mat4 proj = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 10.0f);
+		DoNotOptimize(proj);
+		aspect += 0.0001f;
+	}
+}
+
+void BenchChooseSwapSurfaceFormat(BenchmarkState& state) {
+	// Preferred format last, the worst case for the linear search.
+	std::vector<VkSurfaceFormatKHR> formats = {
+		{ VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+		{ VK_FORMAT_R8G8B8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+		{ VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+		{ VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+		{ VK_FORMAT_R16G16B16A16_SFLOAT, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+		{ VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+	};
+	while (state.KeepRunning()) {
+		VkSurfaceFormatKHR format = ChooseSwapSurfaceFormat(formats.data(), static_cast<uint32_t>(formats.size()));
+		DoNotOptimize(format);
+	}
+	state.SetItemsPerIteration(formats.size());
+}
+
+void BenchChooseSwapPresentMode(BenchmarkState& state) {
+	std::vector<VkPresentModeKHR> present_modes = {
+		VK_PRESENT_MODE_FIFO_KHR,
+		VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+		VK_PRESENT_MODE_IMMEDIATE_KHR,
+	};
+	while (state.KeepRunning()) {
+		VkPresentModeKHR present_mode = ChooseSwapPresentMode(present_modes.data(), static_cast<uint32_t>(present_modes.size()));
+		DoNotOptimize(present_mode);
+	}
+	state.SetItemsPerIteration(present_modes.size());
+}
+
+void BenchChooseSwapExtent(BenchmarkState& state) {
+	VkSurfaceCapabilitiesKHR capabilities = {};
+	capabilities.currentExtent = { 0xFFFFFFFF, 0xFFFFFFFF };
+	capabilities.minImageExtent = { 1, 1 };
+	capabilities.maxImageExtent = { 4096, 4096 };
+	int width = 800;
+	while (state.KeepRunning()) {
+		VkExtent2D extent = ChooseSwapExtent(capabilities, width, 600);
+		DoNotOptimize(extent);
+		width = (width + 1) & 8191;
+	}
+}
+
+void BenchReadFile(BenchmarkState& state) {
+	while (state.KeepRunning()) {
+		std::vector<char> data = ReadFile(READ_FILE_PATH);
+		DoNotOptimize(data.data());
+	}
+	state.SetBytesPerIteration(READ_FILE_SIZE);
+}
+
+std::vector<Vertex> MakeVertices(size_t count) {
+	std::vector<Vertex> vertices(count);
+	for (size_t i = 0; i < count; ++i) {
+		float f = static_cast<float>(i);
+		vertices[i] = { { f, -f }, { f * 0.5f, f * 0.25f, 1.0f } };
+	}
+	return vertices;
+}
+
+template <size_t COUNT>
+void BenchPackVertices(BenchmarkState& state) {
+	std::vector<Vertex> vertices = MakeVertices(COUNT);
+	std::vector<char> staging(sizeof(Vertex) * COUNT);
+	while (state.KeepRunning()) {
+		PackVertices(vertices, staging.data());
+		DoNotOptimize(staging.data());
+	}
+	state.SetBytesPerIteration(staging.size());
+	state.SetItemsPerIteration(COUNT);
+}
+
+template <size_t COUNT>
+void BenchPackIndices(BenchmarkState& state) {
+	std::vector<uint16_t> indices(COUNT);
+	for (size_t i = 0; i < COUNT; ++i) {
+		indices[i] = static_cast<uint16_t>(i);
+	}
+	std::vector<char> staging(sizeof(uint16_t) * COUNT);
+	while (state.KeepRunning()) {
+		PackIndices(indices, staging.data());
+		DoNotOptimize(staging.data());
+	}
+	state.SetBytesPerIteration(staging.size());
+	state.SetItemsPerIteration(COUNT);
+}
+
+void WriteReadFileFixture() {
+	std::vector<char> data(READ_FILE_SIZE);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = static_cast<char>(i * 31);
+	}
+	std::ofstream file(READ_FILE_PATH, std::ios::binary);
+	file.write(data.data(), data.size());
+}
+
+struct ReadFileFixture {
+	ReadFileFixture() { WriteReadFileFixture(); }
+	~ReadFileFixture() { std::remove(READ_FILE_PATH); }
+};
+
+}
+
+void RegisterRenderHelpersBenchmarks() {
+	static ReadFileFixture read_file_fixture;
+
+	RegisterBenchmark("uniform/projection", BenchComputeProjection);
+	RegisterBenchmark("uniform/view", BenchComputeView);
+	RegisterBenchmark("uniform/rotate", BenchRotate);
+	RegisterBenchmark("uniform/look_at", BenchLookAt);
+	RegisterBenchmark("uniform/perspective", BenchPerspective);
+	RegisterBenchmark("swap_chain/choose_surface_format", BenchChooseSwapSurfaceFormat);
+	RegisterBenchmark("swap_chain/choose_present_mode", BenchChooseSwapPresentMode);
+	RegisterBenchmark("swap_chain/choose_extent", BenchChooseSwapExtent);
+	RegisterBenchmark("read_file/64KiB", BenchReadFile);
+	RegisterBenchmark("pack/vertices/4", BenchPackVertices<4>);
+	RegisterBenchmark("pack/vertices/65536", BenchPackVertices<65536>);
+	RegisterBenchmark("pack/indices/6", BenchPackIndices<6>);
+	RegisterBenchmark("pack/indices/98304", BenchPackIndices<98304>);
+}
@@ -0,0 +1,32 @@
+#include "bench.h"
+
+#include "resolution_scaling.h"
+
+#include <array>
+
+namespace {
+
+const uint32_t FRAMES = 1000;
+
+// A thousand frames of a scene whose full resolution cost jumps between light and three times
+// the target, fed back with the two frames of latency the timestamps have in the renderer.
+void BenchResolutionController(BenchmarkState& state) {
+	while (state.KeepRunning()) {
+		ResolutionController controller(8.0f, 0.5f, 1.0f);
+		std::array<float, 2> scales_in_flight = { 1.0f, 1.0f };
+		for (uint32_t frame = 0; frame < FRAMES; ++frame) {
+			float full_resolution_time = (frame / 250) % 2 == 0 ? 4.0f : 24.0f;
+			float frame_scale = scales_in_flight[frame % 2];
+			controller.AddFrameTime(1.0f + full_resolution_time * frame_scale * frame_scale, frame_scale);
+			scales_in_flight[frame % 2] = controller.GetScale();
+		}
+		DoNotOptimize(controller.GetChangeCount());
+	}
+	state.SetItemsPerIteration(FRAMES);
+}
+
+}
+
+void RegisterResolutionScalingBenchmarks() {
+	RegisterBenchmark("resolution_scaling/controller/1000", BenchResolutionController);
+}
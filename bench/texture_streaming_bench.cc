@@ -0,0 +1,155 @@
+#include "bench.h"
+
+#include "block_compression.h"
+#include "texture_container.h"
+#include "texture_data.h"
+#include "texture_residency.h"
+#include "staging_ring.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint32_t IMAGE_SIZE = 1024;
+
+MipLevel MakeImage(uint32_t size) {
+	MipLevel image;
+	image.width = size;
+	image.height = size;
+	image.data.resize(static_cast<size_t>(size) * size * 4);
+	for (size_t i = 0; i < image.data.size(); ++i) {
+		image.data[i] = static_cast<uint8_t>(i * 7);
+	}
+	return image;
+}
+
+std::vector<char> MakePpm(uint32_t size) {
+	std::string header = "P6\n" + std::to_string(size) + " " + std::to_string(size) + "\n255\n";
+	std::vector<char> file(header.begin(), header.end());
+	for (size_t i = 0; i < static_cast<size_t>(size) * size * 3; ++i) {
+		file.push_back(static_cast<char>(i * 13));
+	}
+	return file;
+}
+
+void BenchDecodePpm(BenchmarkState& state) {
+	std::vector<char> file = MakePpm(IMAGE_SIZE);
+	MipLevel image;
+	while (state.KeepRunning()) {
+		DecodePpm(file, image);
+		DoNotOptimize(image.data[0]);
+	}
+	state.SetBytesPerIteration(file.size());
+}
+
+void BenchGenerateMipChain(BenchmarkState& state) {
+	MipLevel base = MakeImage(IMAGE_SIZE);
+	while (state.KeepRunning()) {
+		std::vector<MipLevel> mips = GenerateMipChain(base);
+		DoNotOptimize(mips.back().data[0]);
+	}
+	state.SetBytesPerIteration(base.data.size());
+}
+
+// Build-time cost of the block encoders, per source RGBA8 byte.
+void BenchCompressBc1(BenchmarkState& state) {
+	MipLevel base = MakeImage(IMAGE_SIZE);
+	while (state.KeepRunning()) {
+		MipLevel compressed = CompressBc1(base);
+		DoNotOptimize(compressed.data[0]);
+	}
+	state.SetBytesPerIteration(base.data.size());
+}
+
+void BenchCompressEtc2(BenchmarkState& state) {
+	MipLevel base = MakeImage(IMAGE_SIZE);
+	while (state.KeepRunning()) {
+		MipLevel compressed = CompressEtc2Rgb(base);
+		DoNotOptimize(compressed.data[0]);
+	}
+	state.SetBytesPerIteration(base.data.size());
+}
+
+// What is left for the load workers once textures are transcoded: validating and splitting a
+// container, compared to decode_ppm plus mip_chain for the same image.
+std::vector<char> MakeBc1Container(uint32_t size) {
+	std::vector<MipLevel> mips;
+	for (const auto& mip : GenerateMipChain(MakeImage(size))) {
+		mips.push_back(CompressBc1(mip));
+	}
+	return WriteTextureContainer(VK_FORMAT_BC1_RGB_UNORM_BLOCK, mips);
+}
+
+void BenchReadContainer(BenchmarkState& state) {
+	// Encoding dwarfs the read, so it is done once rather than per calibration run.
+	static const std::vector<char> file = MakeBc1Container(IMAGE_SIZE);
+
+	VkFormat format;
+	std::vector<MipLevel> mips;
+	while (state.KeepRunning()) {
+		ReadTextureContainer(file, format, mips);
+		DoNotOptimize(mips[0].data[0]);
+	}
+	state.SetBytesPerIteration(file.size());
+}
+
+// Mixed upload sizes tagged with a frame each, released two frames later like the renderer.
+void BenchStagingRing(BenchmarkState& state) {
+	StagingRing ring(4 * 1024 * 1024);
+	uint64_t frame = 0;
+	uint64_t sizes[] = { 4096, 65536, 1024, 262144 };
+	uint32_t i = 0;
+	while (state.KeepRunning()) {
+		uint64_t offset = ring.Allocate(sizes[i++ % 4], 16, frame);
+		DoNotOptimize(offset);
+		if (i % 8 == 0) {
+			++frame;
+			if (frame >= 2) {
+				ring.Release(frame - 2);
+			}
+		}
+	}
+	state.SetItemsPerIteration(1);
+}
+
+// Streams 256 textures under a budget that only fits a fraction of them, with the used set
+// moving every frame so levels are constantly evicted.
+void BenchResidencyChurn(BenchmarkState& state) {
+	const uint32_t texture_count = 256;
+	std::vector<uint64_t> level_sizes;
+	for (uint64_t size = 1024 * 1024; size >= 4; size /= 4) {
+		level_sizes.push_back(size);
+	}
+
+	TextureResidency residency(32 * 1024 * 1024);
+	for (uint32_t i = 0; i < texture_count; ++i) {
+		residency.AddTexture(level_sizes);
+	}
+
+	uint64_t frame = 1;
+	std::vector<uint32_t> evicted;
+	while (state.KeepRunning()) {
+		for (uint32_t i = 0; i < 16; ++i) {
+			uint32_t texture = static_cast<uint32_t>((frame * 16 + i) % texture_count);
+			residency.Touch(texture, frame);
+			evicted.clear();
+			residency.ReserveNextLevel(texture, evicted);
+		}
+		DoNotOptimize(residency.GetResidentBytes());
+		++frame;
+	}
+	state.SetItemsPerIteration(16);
+}
+
+}
+
+void RegisterTextureStreamingBenchmarks() {
+	RegisterBenchmark("texture/decode_ppm/1024", BenchDecodePpm);
+	RegisterBenchmark("texture/mip_chain/1024", BenchGenerateMipChain);
+	RegisterBenchmark("texture/bc1_encode/1024", BenchCompressBc1);
+	RegisterBenchmark("texture/etc2_encode/1024", BenchCompressEtc2);
+	RegisterBenchmark("texture/read_container/bc1/1024", BenchReadContainer);
+	RegisterBenchmark("texture/staging_ring", BenchStagingRing);
+	RegisterBenchmark("texture/residency_churn", BenchResidencyChurn);
+}
@@ -0,0 +1,95 @@
+#include "bench.h"
+
+#include "transform_hierarchy.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+namespace {
+
+const uint32_t NODE_COUNT = 16384;
+const uint32_t BRANCHING = 4;
+
+// A balanced tree with BRANCHING children per node, created breadth first so parents
+// always precede their children.
+void BuildTree(TransformHierarchy& hierarchy) {
+	for (uint32_t i = 0; i < NODE_COUNT; ++i) {
+		uint32_t parent = i == 0 ? TransformHierarchy::NO_PARENT : (i - 1) / BRANCHING;
+		float f = static_cast<float>(i % 16);
+		hierarchy.AddNode(parent,
+			glm::vec3(f, 0.5f * f, 1.0f),
+			glm::angleAxis(0.1f * f, glm::vec3(0.0f, 0.0f, 1.0f)),
+			glm::vec3(1.0f + 0.01f * f));
+	}
+}
+
+void BenchUpdateAll(BenchmarkState& state) {
+	TransformHierarchy hierarchy;
+	BuildTree(hierarchy);
+	float angle = 0.0f;
+	while (state.KeepRunning()) {
+		hierarchy.SetRotation(0, glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f)));
+		hierarchy.Update();
+		DoNotOptimize(hierarchy.GetWorldMatrices()[NODE_COUNT - 1]);
+		angle += 0.01f;
+	}
+	state.SetItemsPerIteration(NODE_COUNT);
+}
+
+// Animates a handful of leaves, the common case where most of the scene is static.
+void BenchUpdateSparse(BenchmarkState& state) {
+	TransformHierarchy hierarchy;
+	BuildTree(hierarchy);
+	hierarchy.Update();
+	float angle = 0.0f;
+	while (state.KeepRunning()) {
+		for (uint32_t node = NODE_COUNT - 64; node < NODE_COUNT; ++node) {
+			hierarchy.SetRotation(node, glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f)));
+		}
+		hierarchy.Update();
+		DoNotOptimize(hierarchy.GetWorldMatrices()[NODE_COUNT - 1]);
+		angle += 0.01f;
+	}
+	state.SetItemsPerIteration(NODE_COUNT);
+}
+
+// Baseline: array-of-structures nodes with per-node glm calls, the way a naive scene graph
+// would compute the same matrices.
+struct AosNode {
+	glm::vec3 translation;
+	glm::quat rotation;
+	glm::vec3 scale;
+	uint32_t parent;
+	glm::mat4 world;
+};
+
+void BenchUpdateAllAos(BenchmarkState& state) {
+	std::vector<AosNode> nodes(NODE_COUNT);
+	for (uint32_t i = 0; i < NODE_COUNT; ++i) {
+		float f = static_cast<float>(i % 16);
+		nodes[i].translation = glm::vec3(f, 0.5f * f, 1.0f);
+		nodes[i].rotation = glm::angleAxis(0.1f * f, glm::vec3(0.0f, 0.0f, 1.0f));
+		nodes[i].scale = glm::vec3(1.0f + 0.01f * f);
+		nodes[i].parent = i == 0 ? TransformHierarchy::NO_PARENT : (i - 1) / BRANCHING;
+	}
+	float angle = 0.0f;
+	while (state.KeepRunning()) {
+		nodes[0].rotation = glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f));
+		for (AosNode& node : nodes) {
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), node.translation) * glm::mat4_cast(node.rotation) * glm::scale(glm::mat4(1.0f), node.scale);
+			node.world = node.parent == TransformHierarchy::NO_PARENT ? local : nodes[node.parent].world * local;
+		}
+		DoNotOptimize(nodes[NODE_COUNT - 1].world);
+		angle += 0.01f;
+	}
+	state.SetItemsPerIteration(NODE_COUNT);
+}
+
+}
+
+void RegisterTransformHierarchyBenchmarks() {
+	RegisterBenchmark("transform_hierarchy/update_all/16384", BenchUpdateAll);
+	RegisterBenchmark("transform_hierarchy/update_sparse/16384", BenchUpdateSparse);
+	RegisterBenchmark("transform_hierarchy/update_all_aos_baseline/16384", BenchUpdateAllAos);
+}
@@ -0,0 +1,17 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Overlay quads arrive in normalized device coordinates, already transformed on the CPU.
+layout(location=0) in vec2 inPosition;
+layout(location=1) in vec4 inColor;
+
+layout(location = 0) out vec4 fragColor;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    gl_Position = vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+}
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform ProjectionUniforms {
+    mat4 proj;
+} projection;
+
+layout(binding = 1) uniform CameraUniforms {
+    mat4 view;
+} camera;
+
+layout(location=0) in vec4 inPosition;
+layout(location=1) in vec4 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+    float gl_PointSize;
+};
+
+void main() {
+    gl_Position = projection.proj * camera.view * inPosition;
+    gl_PointSize = 2.0;
+    fragColor = inColor.rgb;
+}
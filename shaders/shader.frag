@@ -1,10 +1,71 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Clustered forward shading: each fragment only loops over the lights light_cluster.comp
+// assigned to its cluster.
+
+// CLUSTER_STRIDE in clustered_lighting.h.
+const uint STRIDE = 128;
+const vec3 AMBIENT = vec3(0.15);
+
+struct PointLight {
+    vec4 position_radius;
+    vec4 color;
+};
+
+layout(set = 1, binding = 0) uniform sampler2D texSampler;
+
+layout(std140, set = 2, binding = 0) uniform ClusterUniforms {
+    mat4 view;
+    vec4 projection;
+    vec4 screen;
+    uvec4 grid;
+    uint clustered;
+} clusters;
+
+layout(std430, set = 2, binding = 1) readonly buffer Lights {
+    PointLight lights[];
+};
+
+layout(std430, set = 2, binding = 2) readonly buffer ClusterLights {
+    uint cluster_lights[];
+};
+
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragPosition;
+layout(location = 3) in vec3 fragNormal;
+layout(location = 4) in float fragViewDepth;
 
 layout(location = 0) out vec4 outColor;
 
+// Smooth falloff reaching zero at the light's radius, lighting both sides of the surface.
+vec3 Shade(PointLight light, vec3 normal) {
+    vec3 to_light = light.position_radius.xyz - fragPosition;
+    float distance = length(to_light);
+    float falloff = clamp(1.0 - distance / light.position_radius.w, 0.0, 1.0);
+    return light.color.rgb * falloff * falloff * abs(dot(normal, to_light / max(distance, 1e-4)));
+}
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 normal = normalize(fragNormal);
+    vec3 lighting = AMBIENT;
+
+    if (clusters.clustered != 0u) {
+        uvec2 tile = min(uvec2(gl_FragCoord.xy / clusters.screen.xy * vec2(clusters.grid.xy)), clusters.grid.xy - 1u);
+        uint slice = uint(clamp(log(fragViewDepth) * clusters.screen.z + clusters.screen.w, 0.0, float(clusters.grid.z - 1u)));
+        uint cluster = (slice * clusters.grid.y + tile.y) * clusters.grid.x + tile.x;
+
+        uint count = cluster_lights[cluster * STRIDE];
+        for (uint i = 0u; i < count; ++i) {
+            lighting += Shade(lights[cluster_lights[cluster * STRIDE + 1u + i]], normal);
+        }
+    }
+    else {
+        for (uint i = 0u; i < clusters.grid.w; ++i) {
+            lighting += Shade(lights[i], normal);
+        }
+    }
+
+    outColor = vec4(fragColor * lighting, 1.0) * texture(texSampler, fragTexCoord);
 }
@@ -1,22 +1,98 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
+layout(binding = 0) uniform ProjectionUniforms {
     mat4 proj;
-} ubo;
+} projection;
+
+layout(binding = 1) uniform CameraUniforms {
+    mat4 view;
+} camera;
+
+layout(binding = 2) uniform ObjectUniforms {
+    mat4 model;
+} object;
+
+#ifdef VERTEX_PULLING
+// Meshlet geometry. Every instance is one visible meshlet and every vertex one corner of its
+// triangles; the vertices are fetched here rather than by fixed-function vertex input.
+
+struct Meshlet {
+    vec4 sphere;
+    vec4 cone;
+    uint vertex_offset;
+    uint triangle_offset;
+    uint vertex_count;
+    uint triangle_count;
+};
+
+// Vertex in render_helpers.h: vec2 pos, vec3 color, vec2 tex_coord, tightly packed.
+const uint VERTEX_FLOATS = 7;
+
+layout(std430, set = 3, binding = 0) readonly buffer Vertices {
+    float vertex_data[];
+};
+
+layout(std430, set = 3, binding = 1) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+layout(std430, set = 3, binding = 2) readonly buffer MeshletVertices {
+    uint meshlet_vertices[];
+};
+
+layout(std430, set = 3, binding = 3) readonly buffer MeshletTriangles {
+    uint meshlet_triangles[];
+};
+
+layout(std430, set = 3, binding = 4) readonly buffer VisibleMeshlets {
+    uint visible_meshlets[];
+};
 
+// Start of the drawing phase's list in visible_meshlets.
+layout(push_constant) uniform Phase {
+    uint visible_offset;
+} push;
+#else
 layout(location=0) in vec2 inPosition;
 layout(location=1) in vec3 inColor;
+layout(location=2) in vec2 inTexCoord;
+#endif
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+// World space, for lighting, and the distance along the view direction picking the cluster.
+layout(location = 2) out vec3 fragPosition;
+layout(location = 3) out vec3 fragNormal;
+layout(location = 4) out float fragViewDepth;
 
 out gl_PerVertex {
     vec4 gl_Position;
 };
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+#ifdef VERTEX_PULLING
+    Meshlet meshlet = meshlets[visible_meshlets[push.visible_offset + uint(gl_InstanceIndex)]];
+    uint triangle = uint(gl_VertexIndex) / 3;
+    if (triangle >= meshlet.triangle_count) {
+        // Past the meshlet's triangles: a degenerate triangle, which is never rasterized.
+        gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    uint corners = meshlet_triangles[meshlet.triangle_offset + triangle];
+    uint local_index = (corners >> ((uint(gl_VertexIndex) % 3) * 8)) & 0xff;
+    uint base = meshlet_vertices[meshlet.vertex_offset + local_index] * VERTEX_FLOATS;
+    vec2 inPosition = vec2(vertex_data[base], vertex_data[base + 1]);
+    vec3 inColor = vec3(vertex_data[base + 2], vertex_data[base + 3], vertex_data[base + 4]);
+    vec2 inTexCoord = vec2(vertex_data[base + 5], vertex_data[base + 6]);
+#endif
+    vec4 position = object.model * vec4(inPosition, 0.0, 1.0);
+    vec4 view_position = camera.view * position;
+    gl_Position = projection.proj * view_position;
     fragColor = inColor;
+    fragTexCoord = inTexCoord;
+    fragPosition = position.xyz;
+    // The quad lies in its xy plane.
+    fragNormal = mat3(object.model) * vec3(0.0, 0.0, 1.0);
+    fragViewDepth = -view_position.z;
 }
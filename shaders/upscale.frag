@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Stretches the rendered area in the top left corner of the scene color over the window.
+layout(binding = 0) uniform sampler2D sceneColor;
+
+// uv_scale maps the window's 0..1 onto the rendered area; uv_max keeps bilinear filtering from
+// reaching past its last texels into what earlier, larger frames left there.
+layout(push_constant) uniform Upscale {
+    vec2 uv_scale;
+    vec2 uv_max;
+} upscale;
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(sceneColor, min(fragTexCoord * upscale.uv_scale, upscale.uv_max));
+}
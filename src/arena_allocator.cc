@@ -0,0 +1,260 @@
+#include "arena_allocator.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+enum BlockSource : uint8_t {
+	BLOCK_SOURCE_ARENA,
+	BLOCK_SOURCE_POOL,
+	BLOCK_SOURCE_HEAP,
+};
+
+// In front of every block handed to the driver, ending right before it.
+struct BlockHeader {
+	size_t size;
+	// From the start of what the block was cut from to the block.
+	uint32_t offset;
+	uint8_t scope;
+	uint8_t source;
+};
+
+const size_t MIN_ALIGNMENT = 16;
+static_assert(sizeof(BlockHeader) <= MIN_ALIGNMENT, "BlockHeader must fit in front of the block");
+
+BlockHeader* GetHeader(void* memory) {
+	return reinterpret_cast<BlockHeader*>(static_cast<char*>(memory) - sizeof(BlockHeader));
+}
+
+char* AlignUp(char* pointer, size_t alignment) {
+	uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+	return reinterpret_cast<char*>((address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+}
+
+}
+
+LinearArena::LinearArena(size_t chunk_size)
+	: chunk_size(chunk_size) {
+}
+
+LinearArena::~LinearArena() {
+	for (const auto& chunk : chunks) {
+		free(chunk.memory);
+	}
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment) {
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+	for (; current_chunk < chunks.size(); ++current_chunk, offset = 0) {
+		const Chunk& chunk = chunks[current_chunk];
+		char* memory = AlignUp(chunk.memory + offset, alignment);
+		if (memory + size <= chunk.memory + chunk.size) {
+			offset = memory + size - chunk.memory;
+			return memory;
+		}
+	}
+
+	Chunk chunk;
+	chunk.size = std::max(chunk_size, size + alignment);
+	chunk.memory = static_cast<char*>(malloc(chunk.size));
+	if (!chunk.memory) {
+		return nullptr;
+	}
+	chunks.push_back(chunk);
+	current_chunk = chunks.size() - 1;
+	char* memory = AlignUp(chunk.memory, alignment);
+	offset = memory + size - chunk.memory;
+	return memory;
+}
+
+void LinearArena::Rewind(Marker marker) {
+	assert(marker.chunk < current_chunk || (marker.chunk == current_chunk && marker.offset <= offset));
+	current_chunk = marker.chunk;
+	offset = marker.offset;
+}
+
+size_t LinearArena::GetReservedBytes() const {
+	size_t bytes = 0;
+	for (const auto& chunk : chunks) {
+		bytes += chunk.size;
+	}
+	return bytes;
+}
+
+SizeClassPool::SizeClassPool(size_t chunk_size)
+	: chunk_size(chunk_size) {
+	assert(chunk_size % SIZE_CLASS_MAX == 0);
+}
+
+SizeClassPool::~SizeClassPool() {
+	for (char* chunk : chunks) {
+		free(chunk);
+	}
+}
+
+size_t SizeClassPool::GetSizeClass(size_t size) {
+	size_t size_class = 0;
+	while ((SIZE_CLASS_MIN << size_class) < size) {
+		++size_class;
+	}
+	return size_class;
+}
+
+void* SizeClassPool::Allocate(size_t size) {
+	if (size > SIZE_CLASS_MAX) {
+		return nullptr;
+	}
+	size_t size_class = GetSizeClass(size);
+	if (!free_lists[size_class]) {
+		Refill(size_class);
+		if (!free_lists[size_class]) {
+			return nullptr;
+		}
+	}
+	FreeBlock* block = free_lists[size_class];
+	free_lists[size_class] = block->next;
+	return block;
+}
+
+void SizeClassPool::Free(void* block, size_t size) {
+	size_t size_class = GetSizeClass(size);
+	FreeBlock* free_block = static_cast<FreeBlock*>(block);
+	free_block->next = free_lists[size_class];
+	free_lists[size_class] = free_block;
+}
+
+void SizeClassPool::Refill(size_t size_class) {
+	if (run_cursor == run_end) {
+		// Runs start SIZE_CLASS_MAX aligned, which aligns every block to its class.
+		char* chunk = static_cast<char*>(malloc(chunk_size + SIZE_CLASS_MAX));
+		if (!chunk) {
+			return;
+		}
+		chunks.push_back(chunk);
+		run_cursor = AlignUp(chunk, SIZE_CLASS_MAX);
+		run_end = run_cursor + chunk_size;
+	}
+
+	size_t block_size = SIZE_CLASS_MIN << size_class;
+	for (size_t offset = SIZE_CLASS_MAX; offset >= block_size; offset -= block_size) {
+		Free(run_cursor + offset - block_size, block_size);
+	}
+	run_cursor += SIZE_CLASS_MAX;
+}
+
+ArenaHostAllocator::ArenaHostAllocator() {
+	callbacks.pUserData = this;
+	callbacks.pfnAllocation = Allocate;
+	callbacks.pfnReallocation = Reallocate;
+	callbacks.pfnFree = Free;
+	callbacks.pfnInternalAllocation = nullptr;
+	callbacks.pfnInternalFree = nullptr;
+}
+
+size_t ArenaHostAllocator::GetReservedBytes() {
+	size_t bytes = 0;
+	for (auto& scope : scopes) {
+		std::lock_guard<std::mutex> lock(scope.mutex);
+		bytes += scope.arena.GetReservedBytes() + scope.pool.GetReservedBytes();
+	}
+	return bytes;
+}
+
+void* ArenaHostAllocator::AllocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+	// The header takes a whole alignment in front of the block, so the block stays aligned.
+	// Pool blocks are aligned to their class, which is at least that.
+	size_t header_size = std::max(alignment, MIN_ALIGNMENT);
+	char* base = nullptr;
+	BlockSource source;
+	{
+		Scope& allocation_scope = scopes[scope];
+		std::lock_guard<std::mutex> lock(allocation_scope.mutex);
+		if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) {
+			base = static_cast<char*>(allocation_scope.arena.Allocate(size + header_size, header_size));
+			source = BLOCK_SOURCE_ARENA;
+			if (base) {
+				++allocation_scope.live_arena_blocks;
+			}
+		}
+		else {
+			base = static_cast<char*>(allocation_scope.pool.Allocate(size + header_size));
+			source = BLOCK_SOURCE_POOL;
+		}
+	}
+
+	char* memory;
+	if (base) {
+		memory = base + header_size;
+	}
+	else if (source == BLOCK_SOURCE_POOL && size + header_size > SIZE_CLASS_MAX) {
+		base = static_cast<char*>(malloc(size + header_size * 2));
+		if (!base) {
+			return nullptr;
+		}
+		source = BLOCK_SOURCE_HEAP;
+		memory = AlignUp(base + header_size, header_size);
+		++heap_block_count;
+	}
+	else {
+		return nullptr;
+	}
+
+	BlockHeader* header = GetHeader(memory);
+	header->size = size;
+	header->offset = static_cast<uint32_t>(memory - base);
+	header->scope = static_cast<uint8_t>(scope);
+	header->source = source;
+	return memory;
+}
+
+void ArenaHostAllocator::FreeBlock(void* memory) {
+	BlockHeader* header = GetHeader(memory);
+	char* base = static_cast<char*>(memory) - header->offset;
+	if (header->source == BLOCK_SOURCE_HEAP) {
+		free(base);
+		return;
+	}
+
+	Scope& scope = scopes[header->scope];
+	std::lock_guard<std::mutex> lock(scope.mutex);
+	if (header->source == BLOCK_SOURCE_ARENA) {
+		if (--scope.live_arena_blocks == 0) {
+			scope.arena.Reset();
+		}
+	}
+	else {
+		scope.pool.Free(base, header->size + header->offset);
+	}
+}
+
+void* VKAPI_PTR ArenaHostAllocator::Allocate(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	return static_cast<ArenaHostAllocator*>(user_data)->AllocateBlock(size, alignment, scope);
+}
+
+void* VKAPI_PTR ArenaHostAllocator::Reallocate(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	ArenaHostAllocator* allocator = static_cast<ArenaHostAllocator*>(user_data);
+	if (!original) {
+		return allocator->AllocateBlock(size, alignment, scope);
+	}
+	if (size == 0) {
+		allocator->FreeBlock(original);
+		return nullptr;
+	}
+	void* memory = allocator->AllocateBlock(size, alignment, scope);
+	if (!memory) {
+		return nullptr;
+	}
+	memcpy(memory, original, std::min(size, GetHeader(original)->size));
+	allocator->FreeBlock(original);
+	return memory;
+}
+
+void VKAPI_PTR ArenaHostAllocator::Free(void* user_data, void* memory) {
+	if (memory) {
+		static_cast<ArenaHostAllocator*>(user_data)->FreeBlock(memory);
+	}
+}
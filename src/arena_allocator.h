@@ -0,0 +1,165 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// Heap memory is reserved in chunks of this size and kept for reuse, so once the chunks are
+// there neither allocator below goes back to the heap.
+const size_t ARENA_CHUNK_SIZE = 64 * 1024;
+
+// Bump allocator over a list of chunks. Nothing is freed on its own: the arena is rewound to
+// an earlier marker, releasing everything allocated since at once.
+class LinearArena {
+public:
+	struct Marker {
+		size_t chunk;
+		size_t offset;
+	};
+
+	explicit LinearArena(size_t chunk_size = ARENA_CHUNK_SIZE);
+	~LinearArena();
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	// size bytes aligned to alignment, a power of two. Larger requests than the chunk size get
+	// a chunk of their own.
+	void* Allocate(size_t size, size_t alignment);
+
+	Marker GetMarker() const { return { current_chunk, offset }; }
+	void Rewind(Marker marker);
+	void Reset() { Rewind({ 0, 0 }); }
+
+	size_t GetReservedBytes() const;
+
+private:
+	struct Chunk {
+		char* memory;
+		size_t size;
+	};
+
+	size_t chunk_size;
+	std::vector<Chunk> chunks;
+	size_t current_chunk = 0;
+	size_t offset = 0;
+};
+
+// Rewinds the arena to where it was on construction, for temporaries of a scope.
+class ScratchScope {
+public:
+	explicit ScratchScope(LinearArena& arena) : arena(arena), marker(arena.GetMarker()) {}
+	~ScratchScope() { arena.Rewind(marker); }
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+
+private:
+	LinearArena& arena;
+	LinearArena::Marker marker;
+};
+
+// Standard allocator over a LinearArena; deallocation is left to rewinding the arena.
+template <typename T>
+class ArenaAllocator {
+public:
+	typedef T value_type;
+
+	explicit ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(arena->Allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	bool operator==(const ArenaAllocator& other) const { return arena == other.arena; }
+	bool operator!=(const ArenaAllocator& other) const { return arena != other.arena; }
+
+	LinearArena* arena;
+};
+
+// Vector of temporaries in a scratch arena, only valid until the arena is rewound past it.
+template <typename T>
+using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+
+// Blocks are rounded up to a power of two between these.
+const size_t SIZE_CLASS_MIN = 16;
+const size_t SIZE_CLASS_MAX = 4096;
+const size_t SIZE_CLASS_COUNT = 9;
+static_assert(SIZE_CLASS_MIN << (SIZE_CLASS_COUNT - 1) == SIZE_CLASS_MAX, "SIZE_CLASS_COUNT must span SIZE_CLASS_MIN to SIZE_CLASS_MAX");
+
+// Fixed size blocks with a free list per size class. A class out of blocks takes a run of
+// SIZE_CLASS_MAX bytes from the current chunk and splits it, so blocks of one size sit
+// together, freed blocks are reused by the next allocation of their class and the chunks never
+// fragment. Not thread-safe.
+class SizeClassPool {
+public:
+	explicit SizeClassPool(size_t chunk_size = ARENA_CHUNK_SIZE);
+	~SizeClassPool();
+	SizeClassPool(const SizeClassPool&) = delete;
+	SizeClassPool& operator=(const SizeClassPool&) = delete;
+
+	// A block of at least size bytes, aligned to its size class. Null above SIZE_CLASS_MAX.
+	void* Allocate(size_t size);
+	// size as it was passed to Allocate.
+	void Free(void* block, size_t size);
+
+	size_t GetReservedBytes() const { return chunks.size() * chunk_size; }
+
+	static size_t GetSizeClass(size_t size);
+
+private:
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	void Refill(size_t size_class);
+
+	size_t chunk_size;
+	std::array<FreeBlock*, SIZE_CLASS_COUNT> free_lists = {};
+	// What the heap returned, and the part of the newest chunk not split into runs yet.
+	std::vector<char*> chunks;
+	char* run_cursor = nullptr;
+	char* run_end = nullptr;
+};
+
+// VkAllocationCallbacks serving every VkSystemAllocationScope from memory of its own. Command
+// scope allocations, which the driver frees before the call returns, come from a linear arena
+// rewound whenever none of them is live. Longer lived ones come from size-class pools, so
+// objects being created and destroyed reuse blocks rather than fragmenting the heap. Blocks
+// too large for the pools are the only ones taken from the C heap.
+class ArenaHostAllocator {
+public:
+	ArenaHostAllocator();
+	ArenaHostAllocator(const ArenaHostAllocator&) = delete;
+	ArenaHostAllocator& operator=(const ArenaHostAllocator&) = delete;
+
+	const VkAllocationCallbacks* GetCallbacks() const { return &callbacks; }
+
+	// Chunks the arenas and pools hold, in use or not.
+	size_t GetReservedBytes();
+	// Blocks taken from the C heap since they were above SIZE_CLASS_MAX.
+	uint64_t GetHeapBlockCount() const { return heap_block_count; }
+
+private:
+	struct Scope {
+		std::mutex mutex;
+		LinearArena arena;
+		SizeClassPool pool;
+		uint64_t live_arena_blocks = 0;
+	};
+
+	static void* VKAPI_PTR Allocate(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void* VKAPI_PTR Reallocate(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void VKAPI_PTR Free(void* user_data, void* memory);
+
+	void* AllocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void FreeBlock(void* memory);
+
+	VkAllocationCallbacks callbacks;
+	std::array<Scope, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1> scopes;
+	std::atomic<uint64_t> heap_block_count{ 0 };
+};
@@ -0,0 +1,286 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+namespace {
+
+uint16_t PackRgb565(int r, int g, int b) {
+	return static_cast<uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+void UnpackRgb565(uint16_t c, int* rgb) {
+	int r = (c >> 11) & 31;
+	int g = (c >> 5) & 63;
+	int b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+int ColorDistance(const int* a, const uint8_t* b) {
+	int dr = a[0] - b[0];
+	int dg = a[1] - b[1];
+	int db = a[2] - b[2];
+	return dr * dr + dg * dg + db * db;
+}
+
+const int ETC_MODIFIERS[8][2] = {
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+struct EtcSubblock {
+	int table;
+	uint32_t indices[8];
+	int error;
+};
+
+// Picks the modifier table and per-texel modifiers for one half of the block around base.
+// texels holds the 8 row-major indices (y * 4 + x) of the half.
+EtcSubblock FitEtcSubblock(const uint8_t* rgba, const int* texels, const int* base) {
+	EtcSubblock best = {};
+	best.error = std::numeric_limits<int>::max();
+
+	for (int table = 0; table < 8; ++table) {
+		EtcSubblock candidate = {};
+		candidate.table = table;
+		for (int i = 0; i < 8; ++i) {
+			// Modifier index order of the format: +small, +large, -small, -large.
+			const int offsets[4] = { ETC_MODIFIERS[table][0], ETC_MODIFIERS[table][1], -ETC_MODIFIERS[table][0], -ETC_MODIFIERS[table][1] };
+			int best_texel_error = std::numeric_limits<int>::max();
+			for (uint32_t m = 0; m < 4; ++m) {
+				int color[3];
+				for (int c = 0; c < 3; ++c) {
+					color[c] = std::min(std::max(base[c] + offsets[m], 0), 255);
+				}
+				int error = ColorDistance(color, rgba + texels[i] * 4);
+				if (error < best_texel_error) {
+					best_texel_error = error;
+					candidate.indices[i] = m;
+				}
+			}
+			candidate.error += best_texel_error;
+		}
+		if (candidate.error < best.error) {
+			best = candidate;
+		}
+	}
+
+	return best;
+}
+
+void AverageColor(const uint8_t* rgba, const int* texels, int* average) {
+	int sum[3] = { 0, 0, 0 };
+	for (int i = 0; i < 8; ++i) {
+		for (int c = 0; c < 3; ++c) {
+			sum[c] += rgba[texels[i] * 4 + c];
+		}
+	}
+	for (int c = 0; c < 3; ++c) {
+		average[c] = (sum[c] + 4) / 8;
+	}
+}
+
+// Gathers the 4x4 block at (block_x, block_y), clamping to the level edges.
+void FetchBlock(const MipLevel& rgba, uint32_t block_x, uint32_t block_y, uint8_t* texels) {
+	for (uint32_t y = 0; y < 4; ++y) {
+		uint32_t src_y = std::min(block_y * 4 + y, rgba.height - 1);
+		for (uint32_t x = 0; x < 4; ++x) {
+			uint32_t src_x = std::min(block_x * 4 + x, rgba.width - 1);
+			memcpy(texels + (y * 4 + x) * 4, &rgba.data[(static_cast<size_t>(src_y) * rgba.width + src_x) * 4], 4);
+		}
+	}
+}
+
+MipLevel CompressLevel(const MipLevel& rgba, void (*encode)(const uint8_t*, uint8_t*)) {
+	MipLevel compressed;
+	compressed.width = rgba.width;
+	compressed.height = rgba.height;
+
+	uint32_t blocks_x = GetBlockCount(rgba.width);
+	uint32_t blocks_y = GetBlockCount(rgba.height);
+	compressed.data.resize(static_cast<size_t>(blocks_x) * blocks_y * 8);
+
+	uint8_t texels[16 * 4];
+	for (uint32_t y = 0; y < blocks_y; ++y) {
+		for (uint32_t x = 0; x < blocks_x; ++x) {
+			FetchBlock(rgba, x, y, texels);
+			encode(texels, &compressed.data[(static_cast<size_t>(y) * blocks_x + x) * 8]);
+		}
+	}
+
+	return compressed;
+}
+
+}
+
+uint32_t GetBlockCount(uint32_t texels) {
+	return (texels + 3) / 4;
+}
+
+// Endpoints are the darkest and brightest texels of the block; cheap, deterministic and close
+// enough for the mostly two-tone assets this is used on.
+void EncodeBc1Block(const uint8_t* rgba, uint8_t* block) {
+	int min_index = 0;
+	int max_index = 0;
+	int min_luma = std::numeric_limits<int>::max();
+	int max_luma = -1;
+	for (int i = 0; i < 16; ++i) {
+		const uint8_t* texel = rgba + i * 4;
+		int luma = texel[0] * 299 + texel[1] * 587 + texel[2] * 114;
+		if (luma < min_luma) {
+			min_luma = luma;
+			min_index = i;
+		}
+		if (luma > max_luma) {
+			max_luma = luma;
+			max_index = i;
+		}
+	}
+
+	const uint8_t* hi = rgba + max_index * 4;
+	const uint8_t* lo = rgba + min_index * 4;
+	uint16_t color0 = PackRgb565(hi[0], hi[1], hi[2]);
+	uint16_t color1 = PackRgb565(lo[0], lo[1], lo[2]);
+
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		// color0 > color1 selects the four color mode.
+		if (color0 < color1) {
+			std::swap(color0, color1);
+		}
+
+		int palette[4][3];
+		UnpackRgb565(color0, palette[0]);
+		UnpackRgb565(color1, palette[1]);
+		for (int c = 0; c < 3; ++c) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; ++i) {
+			uint32_t best = 0;
+			int best_error = std::numeric_limits<int>::max();
+			for (uint32_t p = 0; p < 4; ++p) {
+				int error = ColorDistance(palette[p], rgba + i * 4);
+				if (error < best_error) {
+					best_error = error;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+
+	block[0] = static_cast<uint8_t>(color0 & 0xFF);
+	block[1] = static_cast<uint8_t>(color0 >> 8);
+	block[2] = static_cast<uint8_t>(color1 & 0xFF);
+	block[3] = static_cast<uint8_t>(color1 >> 8);
+	for (int i = 0; i < 4; ++i) {
+		block[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+}
+
+// Tries both block orientations in individual (4:4:4 + 4:4:4) and differential (5:5:5 + 3 bit
+// delta) mode and keeps the one with the least squared error.
+void EncodeEtc2RgbBlock(const uint8_t* rgba, uint8_t* block) {
+	uint64_t best_bits = 0;
+	int best_error = std::numeric_limits<int>::max();
+
+	for (int flip = 0; flip < 2; ++flip) {
+		// Halves as row-major texel indices: flip 0 splits left/right, flip 1 top/bottom.
+		int halves[2][8];
+		for (int i = 0; i < 8; ++i) {
+			int x = flip ? i % 4 : i % 2;
+			int y = flip ? i / 4 : i / 2;
+			halves[0][i] = y * 4 + x;
+			halves[1][i] = flip ? (y + 2) * 4 + x : y * 4 + x + 2;
+		}
+
+		int averages[2][3];
+		AverageColor(rgba, halves[0], averages[0]);
+		AverageColor(rgba, halves[1], averages[1]);
+
+		for (int differential = 0; differential < 2; ++differential) {
+			int quantized[2][3];
+			int bases[2][3];
+			bool representable = true;
+			for (int h = 0; h < 2; ++h) {
+				for (int c = 0; c < 3; ++c) {
+					if (differential) {
+						quantized[h][c] = (averages[h][c] * 31 + 127) / 255;
+						bases[h][c] = (quantized[h][c] << 3) | (quantized[h][c] >> 2);
+					}
+					else {
+						quantized[h][c] = (averages[h][c] * 15 + 127) / 255;
+						bases[h][c] = (quantized[h][c] << 4) | quantized[h][c];
+					}
+				}
+			}
+			if (differential) {
+				for (int c = 0; c < 3; ++c) {
+					int delta = quantized[1][c] - quantized[0][c];
+					if (delta < -4 || delta > 3) {
+						representable = false;
+					}
+				}
+			}
+			if (!representable) {
+				continue;
+			}
+
+			EtcSubblock fits[2] = {
+				FitEtcSubblock(rgba, halves[0], bases[0]),
+				FitEtcSubblock(rgba, halves[1], bases[1]),
+			};
+			int error = fits[0].error + fits[1].error;
+			if (error >= best_error) {
+				continue;
+			}
+			best_error = error;
+
+			uint64_t bits = 0;
+			for (int c = 0; c < 3; ++c) {
+				uint64_t channel;
+				if (differential) {
+					channel = static_cast<uint64_t>(quantized[0][c]) << 3 | static_cast<uint64_t>((quantized[1][c] - quantized[0][c]) & 7);
+				}
+				else {
+					channel = static_cast<uint64_t>(quantized[0][c]) << 4 | static_cast<uint64_t>(quantized[1][c]);
+				}
+				bits |= channel << (56 - c * 8);
+			}
+			bits |= static_cast<uint64_t>(fits[0].table) << 37;
+			bits |= static_cast<uint64_t>(fits[1].table) << 34;
+			bits |= static_cast<uint64_t>(differential) << 33;
+			bits |= static_cast<uint64_t>(flip) << 32;
+
+			// Texel indices are stored column-major: bit x * 4 + y holds the low bit and
+			// bit 16 + x * 4 + y the high bit of the modifier index.
+			for (int h = 0; h < 2; ++h) {
+				for (int i = 0; i < 8; ++i) {
+					int texel = halves[h][i];
+					int position = (texel % 4) * 4 + texel / 4;
+					uint32_t index = fits[h].indices[i];
+					bits |= static_cast<uint64_t>(index & 1) << position;
+					bits |= static_cast<uint64_t>(index >> 1) << (16 + position);
+				}
+			}
+			best_bits = bits;
+		}
+	}
+
+	// Blocks are big-endian.
+	for (int i = 0; i < 8; ++i) {
+		block[i] = static_cast<uint8_t>(best_bits >> (56 - i * 8));
+	}
+}
+
+MipLevel CompressBc1(const MipLevel& rgba) {
+	return CompressLevel(rgba, EncodeBc1Block);
+}
+
+MipLevel CompressEtc2Rgb(const MipLevel& rgba) {
+	return CompressLevel(rgba, EncodeEtc2RgbBlock);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "texture_data.h"
+
+#include <stdint.h>
+
+// CPU encoders for GPU block-compressed formats, run at asset build time. Both formats store
+// a 4x4 texel block in 8 bytes (1/8 of RGBA8) and are sampled by the GPU without a decode step.
+//
+// rgba points at the 16 texels of a block in row-major order, 4 bytes each.
+void EncodeBc1Block(const uint8_t* rgba, uint8_t* block);
+// ETC1-compatible subset of ETC2 RGB8 (individual and differential modes).
+void EncodeEtc2RgbBlock(const uint8_t* rgba, uint8_t* block);
+
+// Compresses a whole RGBA8 level block by block. Edge blocks of levels that are not a multiple
+// of 4 repeat the last row/column.
+MipLevel CompressBc1(const MipLevel& rgba);
+MipLevel CompressEtc2Rgb(const MipLevel& rgba);
+
+uint32_t GetBlockCount(uint32_t texels);
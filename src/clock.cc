@@ -0,0 +1,26 @@
+#include "clock.h"
+
+Clock::~Clock() {
+}
+
+SteadyClock::SteadyClock() : start_time(std::chrono::steady_clock::now()) {
+}
+
+double SteadyClock::Now() const {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+FixedStepClock::FixedStepClock(double step) : step(step) {
+}
+
+void FixedStepClock::BeginFrame() {
+	// The first frame is at time zero.
+	if (started) {
+		time += step;
+	}
+	started = true;
+}
+
+double FixedStepClock::Now() const {
+	return time;
+}
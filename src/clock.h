@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+
+// Source of animation time for the renderer. The application samples it once per frame,
+// so swapping in a FixedStepClock makes every frame see the same time on every run.
+class Clock {
+public:
+	virtual ~Clock();
+
+	// Called once at the start of every loop iteration, before Now().
+	virtual void BeginFrame() {}
+
+	// Seconds since the clock was created.
+	virtual double Now() const = 0;
+};
+
+class SteadyClock : public Clock {
+public:
+	SteadyClock();
+
+	double Now() const override;
+
+private:
+	std::chrono::steady_clock::time_point start_time;
+};
+
+// Advances by a constant step per frame regardless of wall time, for deterministic replays
+// and benchmarks.
+class FixedStepClock : public Clock {
+public:
+	explicit FixedStepClock(double step);
+
+	void BeginFrame() override;
+	double Now() const override;
+
+private:
+	double step;
+	double time = 0.0;
+	bool started = false;
+};
@@ -0,0 +1,99 @@
+#include "clustered_lighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+ClusterUniforms ComputeClusterUniforms(const glm::mat4& view, const glm::mat4& proj, VkExtent2D extent, uint32_t light_count, bool clustered) {
+	float near_plane = proj[3][2] / proj[2][2];
+	float far_plane = proj[3][2] / (proj[2][2] + 1.0f);
+	float log_range = std::log(far_plane / near_plane);
+
+	ClusterUniforms uniforms = {};
+	uniforms.view = view;
+	uniforms.projection = glm::vec4(proj[0][0], proj[1][1], near_plane, far_plane);
+	uniforms.screen = glm::vec4(static_cast<float>(extent.width), static_cast<float>(extent.height),
+		CLUSTER_GRID_Z / log_range, -(CLUSTER_GRID_Z * std::log(near_plane)) / log_range);
+	uniforms.grid_x = CLUSTER_GRID_X;
+	uniforms.grid_y = CLUSTER_GRID_Y;
+	uniforms.grid_z = CLUSTER_GRID_Z;
+	uniforms.light_count = light_count;
+	uniforms.clustered = clustered ? 1 : 0;
+	return uniforms;
+}
+
+uint32_t GetClusterSlice(const ClusterUniforms& uniforms, float view_depth) {
+	float slice = std::log(std::max(view_depth, 1e-6f)) * uniforms.screen.z + uniforms.screen.w;
+	return static_cast<uint32_t>(std::min(std::max(slice, 0.0f), static_cast<float>(uniforms.grid_z - 1)));
+}
+
+void ComputeClusterBounds(const ClusterUniforms& uniforms, uint32_t cluster, glm::vec3& min, glm::vec3& max) {
+	uint32_t x = cluster % uniforms.grid_x;
+	uint32_t y = (cluster / uniforms.grid_x) % uniforms.grid_y;
+	uint32_t z = cluster / (uniforms.grid_x * uniforms.grid_y);
+
+	float near_plane = uniforms.projection.z;
+	float depth_ratio = uniforms.projection.w / near_plane;
+	float near_depth = near_plane * std::pow(depth_ratio, static_cast<float>(z) / uniforms.grid_z);
+	float far_depth = near_plane * std::pow(depth_ratio, static_cast<float>(z + 1) / uniforms.grid_z);
+
+	// Normalized device coordinates of the tile; a point at depth d and x ndc is at ndc * d / P00.
+	float ndc_x0 = 2.0f * x / uniforms.grid_x - 1.0f;
+	float ndc_x1 = 2.0f * (x + 1) / uniforms.grid_x - 1.0f;
+	float ndc_y0 = 2.0f * y / uniforms.grid_y - 1.0f;
+	float ndc_y1 = 2.0f * (y + 1) / uniforms.grid_y - 1.0f;
+
+	float xs[4] = { ndc_x0 * near_depth, ndc_x1 * near_depth, ndc_x0 * far_depth, ndc_x1 * far_depth };
+	float ys[4] = { ndc_y0 * near_depth, ndc_y1 * near_depth, ndc_y0 * far_depth, ndc_y1 * far_depth };
+	min = glm::vec3(*std::min_element(xs, xs + 4) / uniforms.projection.x, 0.0f, -far_depth);
+	max = glm::vec3(*std::max_element(xs, xs + 4) / uniforms.projection.x, 0.0f, -near_depth);
+	// P11 is negative with Vulkan's flipped y, which swaps the ends.
+	float y0 = *std::min_element(ys, ys + 4) / uniforms.projection.y;
+	float y1 = *std::max_element(ys, ys + 4) / uniforms.projection.y;
+	min.y = std::min(y0, y1);
+	max.y = std::max(y0, y1);
+}
+
+void AssignLightsToClusters(const ClusterUniforms& uniforms, const std::vector<PointLight>& lights, std::vector<uint32_t>& cluster_lights) {
+	std::vector<glm::vec4> view_lights;
+	view_lights.reserve(lights.size());
+	for (const auto& light : lights) {
+		glm::vec4 position = uniforms.view * glm::vec4(glm::vec3(light.position_radius), 1.0f);
+		view_lights.push_back(glm::vec4(glm::vec3(position), light.position_radius.w));
+	}
+
+	cluster_lights.assign(CLUSTER_COUNT * CLUSTER_STRIDE, 0);
+	for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; ++cluster) {
+		glm::vec3 min, max;
+		ComputeClusterBounds(uniforms, cluster, min, max);
+
+		uint32_t* entry = &cluster_lights[cluster * CLUSTER_STRIDE];
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < view_lights.size() && count < CLUSTER_MAX_LIGHTS; ++i) {
+			glm::vec3 center = glm::vec3(view_lights[i]);
+			glm::vec3 outside = glm::max(min - center, glm::vec3(0.0f)) + glm::max(center - max, glm::vec3(0.0f));
+			if (glm::dot(outside, outside) <= view_lights[i].w * view_lights[i].w) {
+				entry[1 + count++] = i;
+			}
+		}
+		entry[0] = count;
+	}
+}
+
+std::vector<PointLight> GenerateStressLights(uint32_t count, const glm::vec3& min, const glm::vec3& max, float min_radius, float max_radius, float intensity, uint32_t seed) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<PointLight> lights(count);
+	for (auto& light : lights) {
+		glm::vec3 position = min + (max - min) * glm::vec3(unit(random), unit(random), unit(random));
+		float radius = min_radius + (max_radius - min_radius) * unit(random);
+		light.position_radius = glm::vec4(position, radius);
+
+		// Fully saturated hue.
+		float hue = unit(random) * 6.0f;
+		glm::vec3 color = glm::clamp(glm::vec3(std::abs(hue - 3.0f) - 1.0f, 2.0f - std::abs(hue - 2.0f), 2.0f - std::abs(hue - 4.0f)), 0.0f, 1.0f);
+		light.color = glm::vec4(color * intensity, 0.0f);
+	}
+	return lights;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// The view frustum is split into CLUSTER_GRID_X x CLUSTER_GRID_Y screen tiles, each cut into
+// CLUSTER_GRID_Z slices spaced exponentially between the near and far plane, so clusters stay
+// roughly as deep as they are wide at any distance.
+const uint32_t CLUSTER_GRID_X = 16;
+const uint32_t CLUSTER_GRID_Y = 9;
+const uint32_t CLUSTER_GRID_Z = 24;
+const uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+// Lights a cluster can hold; any further ones touching it are dropped. A cluster's entry in
+// the light grid is its count followed by CLUSTER_MAX_LIGHTS indices.
+const uint32_t CLUSTER_MAX_LIGHTS = 127;
+const uint32_t CLUSTER_STRIDE = CLUSTER_MAX_LIGHTS + 1;
+// local_size of light_cluster.comp, one invocation per cluster. Also the number of lights a
+// workgroup stages in shared memory at a time.
+const uint32_t CLUSTER_WORKGROUP_SIZE = 64;
+
+// Like PointLight in light_cluster.comp and shader.frag.
+struct PointLight {
+	// World space position, and the distance at which the light has faded out.
+	glm::vec4 position_radius;
+	// Color premultiplied by intensity; w is unused.
+	glm::vec4 color;
+};
+
+// Laid out like ClusterUniforms (std140) in light_cluster.comp and shader.frag.
+struct ClusterUniforms {
+	glm::mat4 view;
+	// P00 and P11 of the projection, and the near and far plane distances.
+	glm::vec4 projection;
+	// Framebuffer width and height. A view depth d falls into slice log(d) * z + w.
+	glm::vec4 screen;
+	uint32_t grid_x;
+	uint32_t grid_y;
+	uint32_t grid_z;
+	uint32_t light_count;
+	// 0 shades every fragment with every light, for comparison, and skips the light grid.
+	uint32_t clustered;
+	uint32_t padding[3];
+};
+
+static_assert(offsetof(ClusterUniforms, grid_x) == 96, "ClusterUniforms must match the std140 layout of the shaders");
+
+// Near and far come out of the projection, which maps view depth to 0..1.
+ClusterUniforms ComputeClusterUniforms(const glm::mat4& view, const glm::mat4& proj, VkExtent2D extent, uint32_t light_count, bool clustered);
+
+uint32_t GetClusterSlice(const ClusterUniforms& uniforms, float view_depth);
+
+// View space bounding box of a cluster, indexed x fastest, then y, then the slice.
+void ComputeClusterBounds(const ClusterUniforms& uniforms, uint32_t cluster, glm::vec3& min, glm::vec3& max);
+
+// The assignment light_cluster.comp does, on the CPU: CLUSTER_COUNT entries of
+// CLUSTER_STRIDE, lights tested as spheres against each cluster's box.
+void AssignLightsToClusters(const ClusterUniforms& uniforms, const std::vector<PointLight>& lights, std::vector<uint32_t>& cluster_lights);
+
+// Lights of random radius and hue, all of the same intensity, scattered over the box between
+// min and max. The same seed gives the same lights.
+std::vector<PointLight> GenerateStressLights(uint32_t count, const glm::vec3& min, const glm::vec3& max, float min_radius, float max_radius, float intensity, uint32_t seed);
@@ -0,0 +1,230 @@
+#include "frame_capture.h"
+
+#include <iterator>
+#include <string.h>
+
+namespace {
+
+const char CAPTURE_MAGIC[8] = { 'V', 'K', 'T', 'C', 'A', 'P', 0, 2 };
+const size_t WRITE_BLOCK_SIZE = 64 * 1024;
+
+enum FrameFieldBits {
+	FIELD_ANIMATION_TIME = 1 << 0,
+	FIELD_ROTATION = 1 << 1,
+	FIELD_CAMERA_EYE = 1 << 2,
+	FIELD_EXTENT = 1 << 3,
+	FIELD_PROJECTION = 1 << 4,
+	FIELD_CAMERA = 1 << 5,
+	FIELD_OBJECT = 1 << 6,
+	FIELD_DRAW_FLAGS = 1 << 7,
+	FIELD_OVERLAY_QUADS = 1 << 8,
+	FIELD_REGISTERED_TEXTURES = 1 << 9,
+	FIELD_UPLOADS = 1 << 10,
+};
+
+// Fields are written in memory order, which is little-endian on every platform this runs on.
+template <typename T>
+void Write(std::vector<char>& out, const T& value) {
+	const char* bytes = reinterpret_cast<const char*>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool Read(const std::vector<char>& data, size_t& offset, T& value) {
+	if (data.size() - offset < sizeof(T)) {
+		return false;
+	}
+	memcpy(&value, data.data() + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
+
+template <typename T>
+bool Equal(const T& a, const T& b) {
+	return memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+template <typename T>
+void WriteVector(std::vector<char>& out, const std::vector<T>& values) {
+	Write(out, static_cast<uint32_t>(values.size()));
+	for (const T& value : values) {
+		Write(out, value);
+	}
+}
+
+template <typename T>
+bool ReadVector(const std::vector<char>& data, size_t& offset, std::vector<T>& values) {
+	uint32_t count;
+	if (!Read(data, offset, count) || (data.size() - offset) / sizeof(T) < count) {
+		return false;
+	}
+	values.resize(count);
+	for (T& value : values) {
+		Read(data, offset, value);
+	}
+	return true;
+}
+
+}
+
+bool operator==(const CapturedFrame& a, const CapturedFrame& b) {
+	return Equal(a.animation_time, b.animation_time) && Equal(a.rotation, b.rotation) && Equal(a.camera_eye, b.camera_eye) && Equal(a.extent, b.extent) &&
+		Equal(a.projection, b.projection) && Equal(a.camera, b.camera) && Equal(a.object, b.object) &&
+		a.draw_flags == b.draw_flags && a.overlay_quads == b.overlay_quads && a.registered_textures == b.registered_textures &&
+		a.uploads.size() == b.uploads.size() && (a.uploads.empty() || memcmp(a.uploads.data(), b.uploads.data(), a.uploads.size() * sizeof(FrameTextureUpload)) == 0);
+}
+
+void EncodeFrame(const CapturedFrame& previous, const CapturedFrame& frame, std::vector<char>& out) {
+	uint32_t fields = 0;
+	fields |= Equal(frame.animation_time, previous.animation_time) ? 0 : FIELD_ANIMATION_TIME;
+	fields |= Equal(frame.rotation, previous.rotation) ? 0 : FIELD_ROTATION;
+	fields |= Equal(frame.camera_eye, previous.camera_eye) ? 0 : FIELD_CAMERA_EYE;
+	fields |= Equal(frame.extent, previous.extent) ? 0 : FIELD_EXTENT;
+	fields |= Equal(frame.projection, previous.projection) ? 0 : FIELD_PROJECTION;
+	fields |= Equal(frame.camera, previous.camera) ? 0 : FIELD_CAMERA;
+	fields |= Equal(frame.object, previous.object) ? 0 : FIELD_OBJECT;
+	fields |= frame.draw_flags == previous.draw_flags ? 0 : FIELD_DRAW_FLAGS;
+	fields |= frame.overlay_quads == previous.overlay_quads ? 0 : FIELD_OVERLAY_QUADS;
+	// Texture work is per frame rather than state, so only the presence is delta coded.
+	fields |= frame.registered_textures.empty() ? 0 : FIELD_REGISTERED_TEXTURES;
+	fields |= frame.uploads.empty() ? 0 : FIELD_UPLOADS;
+
+	Write(out, static_cast<uint16_t>(fields));
+	if (fields & FIELD_ANIMATION_TIME) {
+		Write(out, frame.animation_time);
+	}
+	if (fields & FIELD_ROTATION) {
+		Write(out, frame.rotation);
+	}
+	if (fields & FIELD_CAMERA_EYE) {
+		Write(out, frame.camera_eye);
+	}
+	if (fields & FIELD_EXTENT) {
+		Write(out, frame.extent);
+	}
+	if (fields & FIELD_PROJECTION) {
+		Write(out, frame.projection);
+	}
+	if (fields & FIELD_CAMERA) {
+		Write(out, frame.camera);
+	}
+	if (fields & FIELD_OBJECT) {
+		Write(out, frame.object);
+	}
+	if (fields & FIELD_DRAW_FLAGS) {
+		Write(out, frame.draw_flags);
+	}
+	if (fields & FIELD_OVERLAY_QUADS) {
+		Write(out, frame.overlay_quads);
+	}
+	if (fields & FIELD_REGISTERED_TEXTURES) {
+		WriteVector(out, frame.registered_textures);
+	}
+	if (fields & FIELD_UPLOADS) {
+		WriteVector(out, frame.uploads);
+	}
+}
+
+bool DecodeFrame(const std::vector<char>& data, size_t& offset, const CapturedFrame& previous, CapturedFrame& frame) {
+	uint16_t fields;
+	if (!Read(data, offset, fields)) {
+		return false;
+	}
+
+	frame = previous;
+	frame.registered_textures.clear();
+	frame.uploads.clear();
+
+	bool ok = true;
+	if (fields & FIELD_ANIMATION_TIME) {
+		ok = ok && Read(data, offset, frame.animation_time);
+	}
+	if (fields & FIELD_ROTATION) {
+		ok = ok && Read(data, offset, frame.rotation);
+	}
+	if (fields & FIELD_CAMERA_EYE) {
+		ok = ok && Read(data, offset, frame.camera_eye);
+	}
+	if (fields & FIELD_EXTENT) {
+		ok = ok && Read(data, offset, frame.extent);
+	}
+	if (fields & FIELD_PROJECTION) {
+		ok = ok && Read(data, offset, frame.projection);
+	}
+	if (fields & FIELD_CAMERA) {
+		ok = ok && Read(data, offset, frame.camera);
+	}
+	if (fields & FIELD_OBJECT) {
+		ok = ok && Read(data, offset, frame.object);
+	}
+	if (fields & FIELD_DRAW_FLAGS) {
+		ok = ok && Read(data, offset, frame.draw_flags);
+	}
+	if (fields & FIELD_OVERLAY_QUADS) {
+		ok = ok && Read(data, offset, frame.overlay_quads);
+	}
+	if (fields & FIELD_REGISTERED_TEXTURES) {
+		ok = ok && ReadVector(data, offset, frame.registered_textures);
+	}
+	if (fields & FIELD_UPLOADS) {
+		ok = ok && ReadVector(data, offset, frame.uploads);
+	}
+	return ok;
+}
+
+bool FrameCaptureWriter::Open(const std::string& path, VkExtent2D extent) {
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+	buffer.clear();
+	buffer.insert(buffer.end(), CAPTURE_MAGIC, CAPTURE_MAGIC + sizeof(CAPTURE_MAGIC));
+	Write(buffer, extent);
+	previous = CapturedFrame();
+	frame_count = 0;
+	return true;
+}
+
+void FrameCaptureWriter::WriteFrame(const CapturedFrame& frame) {
+	EncodeFrame(previous, frame, buffer);
+	previous = frame;
+	++frame_count;
+	if (buffer.size() >= WRITE_BLOCK_SIZE) {
+		FlushBuffer();
+	}
+}
+
+void FrameCaptureWriter::FlushBuffer() {
+	file.write(buffer.data(), buffer.size());
+	buffer.clear();
+}
+
+void FrameCaptureWriter::Close() {
+	if (file.is_open()) {
+		FlushBuffer();
+		file.close();
+	}
+}
+
+bool FrameCaptureReader::Open(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	if (data.size() < sizeof(CAPTURE_MAGIC) || memcmp(data.data(), CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) {
+		return false;
+	}
+	offset = sizeof(CAPTURE_MAGIC);
+	previous = CapturedFrame();
+	return Read(data, offset, extent);
+}
+
+bool FrameCaptureReader::ReadFrame(CapturedFrame& frame) {
+	if (offset >= data.size() || !DecodeFrame(data, offset, previous, frame)) {
+		return false;
+	}
+	previous = frame;
+	return true;
+}
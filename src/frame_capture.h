@@ -0,0 +1,82 @@
+#pragma once
+
+#include "render_helpers.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+enum FrameDrawFlagBits {
+	FRAME_DRAW_SCENE = 1 << 0,
+	FRAME_DRAW_PARTICLES = 1 << 1,
+};
+
+struct FrameTextureUpload {
+	uint32_t texture;
+	uint32_t level;
+};
+
+// Everything that decides what a frame renders: its inputs (simulation state, camera, extent),
+// the uniform contents and draws they produced, and the texture work streamed in the frame.
+// Replaying the inputs must reproduce the rest, which is how replays detect divergence.
+struct CapturedFrame {
+	float animation_time = 0.0f;
+	float rotation = 0.0f;
+	glm::vec3 camera_eye = glm::vec3(0.0f);
+	VkExtent2D extent = {};
+	ProjectionUniforms projection = {};
+	CameraUniforms camera = {};
+	ObjectUniforms object = {};
+	uint32_t draw_flags = 0;
+	uint32_t overlay_quads = 0;
+	// Textures whose decode was picked up, and mip levels uploaded, during the frame.
+	std::vector<uint32_t> registered_textures;
+	std::vector<FrameTextureUpload> uploads;
+};
+
+bool operator==(const CapturedFrame& a, const CapturedFrame& b);
+inline bool operator!=(const CapturedFrame& a, const CapturedFrame& b) { return !(a == b); }
+
+// A frame is stored as a mask of the fields that changed since the previous frame followed by
+// just those fields, so steady state frames take a few bytes.
+void EncodeFrame(const CapturedFrame& previous, const CapturedFrame& frame, std::vector<char>& out);
+// Reads a frame encoded against previous from [offset, data.size()), advancing offset. Returns
+// false on truncated or malformed data.
+bool DecodeFrame(const std::vector<char>& data, size_t& offset, const CapturedFrame& previous, CapturedFrame& frame);
+
+// Appends frames to a capture file. Frames are buffered and written in blocks.
+class FrameCaptureWriter {
+public:
+	// extent is the window size the replay should open with.
+	bool Open(const std::string& path, VkExtent2D extent);
+	void WriteFrame(const CapturedFrame& frame);
+	void Close();
+
+	bool IsOpen() const { return file.is_open(); }
+	uint64_t GetFrameCount() const { return frame_count; }
+
+private:
+	void FlushBuffer();
+
+	std::ofstream file;
+	std::vector<char> buffer;
+	CapturedFrame previous;
+	uint64_t frame_count = 0;
+};
+
+// Reads a whole capture file up front, so replay never touches the disk mid-run.
+class FrameCaptureReader {
+public:
+	bool Open(const std::string& path);
+	// False at the end of the capture.
+	bool ReadFrame(CapturedFrame& frame);
+
+	VkExtent2D GetExtent() const { return extent; }
+
+private:
+	std::vector<char> data;
+	size_t offset = 0;
+	VkExtent2D extent = {};
+	CapturedFrame previous;
+};
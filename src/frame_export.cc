@@ -0,0 +1,204 @@
+#include "frame_export.h"
+
+#include <assert.h>
+#include <chrono>
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#else
+#include <signal.h>
+#endif
+
+namespace {
+
+#if defined(_WIN32)
+const char* const PIPE_MODE = "wb";
+#else
+const char* const PIPE_MODE = "w";
+#endif
+
+}
+
+void ConvertRowToRgb(const uint8_t* pixels, uint32_t width, bool bgra, uint8_t* rgb) {
+	uint32_t red = bgra ? 2 : 0;
+	uint32_t blue = bgra ? 0 : 2;
+	for (uint32_t x = 0; x < width; ++x) {
+		const uint8_t* pixel = pixels + x * 4;
+		rgb[x * 3 + 0] = pixel[red];
+		rgb[x * 3 + 1] = pixel[1];
+		rgb[x * 3 + 2] = pixel[blue];
+	}
+}
+
+FrameExporter::~FrameExporter() {
+	Close();
+}
+
+bool FrameExporter::Open(FrameExportFormat format, const std::string& target, uint32_t slot_count) {
+	Close();
+
+	if (format == FRAME_EXPORT_RAW) {
+		stream = std::fopen(target.c_str(), "wb");
+	}
+	else if (format == FRAME_EXPORT_PIPE) {
+#if !defined(_WIN32)
+		// An encoder that exits early must fail the writes, not end the process.
+		signal(SIGPIPE, SIG_IGN);
+#endif
+		stream = popen(target.c_str(), PIPE_MODE);
+	}
+	else if (target.find('#') == std::string::npos) {
+		return false;
+	}
+	if (format != FRAME_EXPORT_PPM && stream == nullptr) {
+		return false;
+	}
+
+	this->format = format;
+	this->target = target;
+	stream_width = 0;
+	stream_height = 0;
+	queue.assign(slot_count, QueuedFrame());
+	queue_head = 0;
+	queue_count = 0;
+	busy_slots.assign(slot_count, false);
+	stopping = false;
+	written_frames = 0;
+	written_bytes = 0;
+	failed_frames = 0;
+	write_seconds = 0.0;
+	worker = std::thread(&FrameExporter::Run, this);
+	return true;
+}
+
+void FrameExporter::Close() {
+	if (!worker.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	frames_queued.notify_one();
+	worker.join();
+
+	if (stream != nullptr) {
+		if (format == FRAME_EXPORT_PIPE) {
+			pclose(stream);
+		}
+		else {
+			std::fclose(stream);
+		}
+		stream = nullptr;
+	}
+}
+
+void FrameExporter::Submit(uint32_t slot, const ExportFrame& frame) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(!busy_slots[slot] && queue_count < queue.size());
+		busy_slots[slot] = true;
+		queue[(queue_head + queue_count) % queue.size()] = { slot, frame };
+		++queue_count;
+	}
+	frames_queued.notify_one();
+}
+
+bool FrameExporter::IsSlotBusy(uint32_t slot) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return busy_slots[slot];
+}
+
+void FrameExporter::WaitIdle() {
+	std::unique_lock<std::mutex> lock(mutex);
+	frames_written.wait(lock, [this] {
+		for (bool busy : busy_slots) {
+			if (busy) {
+				return false;
+			}
+		}
+		return true;
+	});
+}
+
+void FrameExporter::Run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		frames_queued.wait(lock, [this] { return stopping || queue_count > 0; });
+		if (queue_count == 0) {
+			return;
+		}
+		QueuedFrame queued = queue[queue_head];
+		queue_head = (queue_head + 1) % queue.size();
+		--queue_count;
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		if (WriteFrame(queued.frame)) {
+			++written_frames;
+		}
+		else {
+			++failed_frames;
+		}
+		write_seconds = write_seconds + std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		lock.lock();
+		busy_slots[queued.slot] = false;
+		frames_written.notify_all();
+	}
+}
+
+bool FrameExporter::WriteFrame(const ExportFrame& frame) {
+	if (format == FRAME_EXPORT_PPM) {
+		return WritePpm(frame);
+	}
+
+	// Raw video has no per frame header, so the size of the first frame holds for the stream.
+	if (stream_width == 0) {
+		stream_width = frame.width;
+		stream_height = frame.height;
+	}
+	if (frame.width != stream_width || frame.height != stream_height) {
+		return false;
+	}
+	size_t row_size = static_cast<size_t>(frame.width) * 4;
+	for (uint32_t y = 0; y < frame.height; ++y) {
+		if (std::fwrite(frame.pixels + static_cast<size_t>(y) * frame.row_pitch, 1, row_size, stream) != row_size) {
+			return false;
+		}
+	}
+	written_bytes += row_size * frame.height;
+	return true;
+}
+
+bool FrameExporter::WritePpm(const ExportFrame& frame) {
+	std::string sequence = std::to_string(written_frames);
+	std::string path = target;
+	size_t first = path.find('#');
+	size_t last = path.find_first_not_of('#', first);
+	size_t count = (last == std::string::npos ? path.size() : last) - first;
+	if (sequence.size() < count) {
+		sequence.insert(0, count - sequence.size(), '0');
+	}
+	path.replace(first, count, sequence);
+
+	std::FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	std::string header = "P6\n" + std::to_string(frame.width) + " " + std::to_string(frame.height) + "\n255\n";
+	bool written = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+
+	size_t row_size = static_cast<size_t>(frame.width) * 3;
+	rgb_row.resize(row_size);
+	for (uint32_t y = 0; y < frame.height && written; ++y) {
+		ConvertRowToRgb(frame.pixels + static_cast<size_t>(y) * frame.row_pitch, frame.width, frame.bgra, rgb_row.data());
+		written = std::fwrite(rgb_row.data(), 1, row_size, file) == row_size;
+	}
+	written = std::fclose(file) == 0 && written;
+	if (written) {
+		written_bytes += header.size() + row_size * frame.height;
+	}
+	return written;
+}
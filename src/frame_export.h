@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+enum FrameExportFormat {
+	// Every frame appended to one file, 4 bytes per pixel in the order they were read back.
+	FRAME_EXPORT_RAW,
+	// A binary PPM per frame. The run of '#' in the path is replaced by the zero padded
+	// sequence number, so dropped frames leave no gaps.
+	FRAME_EXPORT_PPM,
+	// Frames written as with FRAME_EXPORT_RAW to the standard input of a command, such as an
+	// encoder reading raw video.
+	FRAME_EXPORT_PIPE,
+};
+
+// A frame read back to host memory, 4 bytes per pixel.
+struct ExportFrame {
+	const uint8_t* pixels;
+	uint32_t width;
+	uint32_t height;
+	uint32_t row_pitch;
+	// B, G, R, A byte order rather than R, G, B, A.
+	bool bgra;
+};
+
+// Writes rows of width 4 byte pixels as 3 byte R, G, B ones.
+void ConvertRowToRgb(const uint8_t* pixels, uint32_t width, bool bgra, uint8_t* rgb);
+
+// Writes frames read back by the renderer on a worker thread. The pixels stay where they were
+// read back to: each frame is handed over with the slot of the readback buffer holding it, and
+// the slot is busy until the worker wrote it. The renderer skips frames when the slot it would
+// read back to is busy, so a slow disk or encoder drops frames instead of stalling rendering.
+class FrameExporter {
+public:
+	FrameExporter() = default;
+	~FrameExporter();
+
+	FrameExporter(const FrameExporter&) = delete;
+	FrameExporter& operator=(const FrameExporter&) = delete;
+
+	// target is the file, the PPM path pattern or the command. Returns false when it cannot be
+	// opened.
+	bool Open(FrameExportFormat format, const std::string& target, uint32_t slot_count);
+	// Writes every frame handed over, then stops the worker.
+	void Close();
+
+	bool IsOpen() const { return worker.joinable(); }
+
+	void Submit(uint32_t slot, const ExportFrame& frame);
+	bool IsSlotBusy(uint32_t slot);
+	// Blocks until every frame handed over is written.
+	void WaitIdle();
+
+	// Written by the worker; only exact once it is idle.
+	uint64_t GetWrittenFrameCount() const { return written_frames; }
+	uint64_t GetWrittenBytes() const { return written_bytes; }
+	// Frames that could not be written, or whose size differs from the first frame of a raw
+	// stream or pipe.
+	uint64_t GetFailedFrameCount() const { return failed_frames; }
+	// Time the worker spent writing, which bounds the frame rate it can keep up with.
+	double GetWriteSeconds() const { return write_seconds; }
+
+private:
+	struct QueuedFrame {
+		uint32_t slot;
+		ExportFrame frame;
+	};
+
+	void Run();
+	bool WriteFrame(const ExportFrame& frame);
+	bool WritePpm(const ExportFrame& frame);
+
+	FrameExportFormat format = FRAME_EXPORT_RAW;
+	std::string target;
+	std::FILE* stream = nullptr;
+	uint32_t stream_width = 0;
+	uint32_t stream_height = 0;
+	std::vector<uint8_t> rgb_row;
+
+	std::mutex mutex;
+	std::condition_variable frames_queued;
+	std::condition_variable frames_written;
+	// Ring of frames handed over and not yet taken by the worker, allocated in Open. A slot is
+	// busy while queued, so slot_count entries always fit and Submit never allocates.
+	std::vector<QueuedFrame> queue;
+	uint32_t queue_head = 0;
+	uint32_t queue_count = 0;
+	std::vector<bool> busy_slots;
+	bool stopping = false;
+	std::thread worker;
+
+	std::atomic<uint64_t> written_frames{ 0 };
+	std::atomic<uint64_t> written_bytes{ 0 };
+	std::atomic<uint64_t> failed_frames{ 0 };
+	std::atomic<double> write_seconds{ 0.0 };
+};
@@ -0,0 +1,239 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <assert.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Spins a worker does looking for work before it goes to sleep.
+const uint32_t IDLE_SPINS = 256;
+
+struct CurrentThread {
+	const JobSystem* system;
+	uint32_t index;
+};
+
+thread_local CurrentThread current_thread = { nullptr, 0 };
+
+void PinCurrentThread(uint32_t core) {
+#if defined(_WIN32)
+	SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (core % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(core, &cpu_set);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+}
+
+uint32_t NextRandom(uint32_t& state) {
+	// xorshift32
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+}
+
+WorkStealingQueue::WorkStealingQueue(uint32_t capacity) : jobs(new std::atomic<Job*>[capacity]), mask(capacity - 1) {
+	assert((capacity & (capacity - 1)) == 0);
+}
+
+bool WorkStealingQueue::Push(Job* job) {
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t > mask) {
+		return false;
+	}
+	jobs[b & mask].store(job, std::memory_order_relaxed);
+	// Publishes the job's contents to thieves, which load bottom with acquire.
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+Job* WorkStealingQueue::Pop() {
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b) {
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = jobs[b & mask].load(std::memory_order_relaxed);
+	if (t == b) {
+		// Last job: a thief may be taking it too.
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* WorkStealingQueue::Steal() {
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b) {
+		return nullptr;
+	}
+
+	Job* job = jobs[t & mask].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return job;
+}
+
+JobSystem::JobSystem(uint32_t worker_count, bool pin_threads) : owner_thread(std::this_thread::get_id()) {
+	for (uint32_t i = 0; i <= worker_count; ++i) {
+		threads.emplace_back(new ThreadState());
+		threads.back()->random = 2463534242u + i * 7919u;
+	}
+
+	for (uint32_t i = 1; i <= worker_count; ++i) {
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i, pin_threads);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	for (auto& state : threads) {
+		assert(state->queue.IsEmpty());
+	}
+}
+
+uint32_t JobSystem::GetDefaultWorkerCount() {
+	uint32_t hardware_threads = std::thread::hardware_concurrency();
+	return hardware_threads > 2 ? hardware_threads - 1 : 1;
+}
+
+JobSystem::ThreadState& JobSystem::GetCurrentThreadState() {
+	if (current_thread.system == this) {
+		return *threads[current_thread.index];
+	}
+	// Only the constructing thread and the workers have a deque.
+	assert(std::this_thread::get_id() == owner_thread);
+	return *threads[0];
+}
+
+Job* JobSystem::AllocateJob() {
+	ThreadState& state = GetCurrentThreadState();
+	Job* job = &state.jobs[state.next_job];
+	state.next_job = (state.next_job + 1) % JOBS_PER_THREAD;
+
+	// The slot's previous job may still be queued or running elsewhere; help until it is not.
+	while (job->busy.load(std::memory_order_acquire)) {
+		if (!RunOneJob(state)) {
+			std::this_thread::yield();
+		}
+	}
+	job->busy.store(true, std::memory_order_relaxed);
+	return job;
+}
+
+void JobSystem::Submit(Job* job) {
+	ThreadState& state = GetCurrentThreadState();
+	if (!state.queue.Push(job)) {
+		Execute(job);
+		return;
+	}
+
+	// Pairs with the fence in WorkerLoop: either the worker sees the job, or we see it sleeping.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping_workers.load(std::memory_order_relaxed) > 0) {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			++wake_generation;
+		}
+		wake.notify_one();
+	}
+}
+
+bool JobSystem::RunOneJob(ThreadState& state) {
+	Job* job = state.queue.Pop();
+	if (job == nullptr && threads.size() > 1) {
+		uint32_t first = NextRandom(state.random) % threads.size();
+		for (uint32_t i = 0; i < threads.size() && job == nullptr; ++i) {
+			ThreadState& victim = *threads[(first + i) % threads.size()];
+			if (&victim != &state) {
+				job = victim.queue.Steal();
+			}
+		}
+	}
+	if (job == nullptr) {
+		return false;
+	}
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Execute(Job* job) {
+	JobCounter* counter = job->counter;
+	job->function(*job);
+	job->busy.store(false, std::memory_order_release);
+	counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::Wait(const JobCounter& counter) {
+	ThreadState& state = GetCurrentThreadState();
+	while (!counter.IsDone()) {
+		if (!RunOneJob(state)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop(uint32_t index, bool pin) {
+	current_thread = { this, index };
+	if (pin) {
+		PinCurrentThread(index % std::max(std::thread::hardware_concurrency(), 1u));
+	}
+
+	ThreadState& state = *threads[index];
+	uint32_t idle_spins = 0;
+	while (!stopping.load(std::memory_order_relaxed)) {
+		if (RunOneJob(state)) {
+			idle_spins = 0;
+			continue;
+		}
+		if (++idle_spins < IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		uint64_t generation = wake_generation;
+		sleeping_workers.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool has_work = false;
+		for (auto& other : threads) {
+			has_work = has_work || !other->queue.IsEmpty();
+		}
+		if (!has_work) {
+			wake.wait(lock, [this, generation]() { return stopping.load(std::memory_order_relaxed) || wake_generation != generation; });
+		}
+		sleeping_workers.fetch_sub(1, std::memory_order_relaxed);
+		idle_spins = 0;
+	}
+}
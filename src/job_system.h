@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string.h>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+class JobSystem;
+
+// Number of scheduled jobs that have not finished yet. Wait on it to join a group of jobs.
+class JobCounter {
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<uint32_t> pending{ 0 };
+};
+
+// A callable stored in place when it is small and trivially copyable, otherwise on the heap.
+struct Job {
+	static const uint32_t STORAGE_SIZE = 32;
+
+	void (*function)(Job& job) = nullptr;
+	JobCounter* counter = nullptr;
+	// Set while the job is queued or running, so its slot is not handed out again.
+	std::atomic<bool> busy{ false };
+	alignas(16) unsigned char storage[STORAGE_SIZE];
+};
+
+// Chase-Lev deque of a fixed capacity. The owning thread pushes and pops at the bottom, any
+// other thread steals from the top, and only a race for the last job takes a CAS.
+class WorkStealingQueue {
+public:
+	// capacity must be a power of two.
+	explicit WorkStealingQueue(uint32_t capacity);
+
+	// Owner only. Returns false when the queue is full.
+	bool Push(Job* job);
+	// Owner only. Newest job first, or nullptr.
+	Job* Pop();
+	// Any thread. Oldest job first, or nullptr when empty or another thread won the race.
+	Job* Steal();
+
+	bool IsEmpty() const { return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed); }
+
+private:
+	std::unique_ptr<std::atomic<Job*>[]> jobs;
+	int64_t mask;
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+};
+
+// Work-stealing scheduler shared by everything that runs in parallel. Every thread, the
+// constructing one included, owns a deque it pushes its jobs to and pops from; idle threads
+// steal from the others. Threads never block on each other: Wait runs queued jobs until the
+// counter drops to zero, and idle workers sleep until something is scheduled.
+//
+// Jobs may be scheduled from the constructing thread and from inside jobs, and must all be
+// waited for before the system is destroyed.
+class JobSystem {
+public:
+	// Jobs each thread can have outstanding before scheduling runs jobs to free a slot.
+	static const uint32_t JOBS_PER_THREAD = 4096;
+
+	// Starts worker_count threads next to the calling one. With pin_threads, worker i is pinned
+	// to core i so workers never migrate; the calling thread is left alone.
+	JobSystem(uint32_t worker_count, bool pin_threads);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// One worker per hardware thread besides the calling one, and at least one so scheduled
+	// work progresses without anybody waiting on it.
+	static uint32_t GetDefaultWorkerCount();
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(threads.size()); }
+
+	// Runs function() on some thread and decrements counter when it returned.
+	template <typename F>
+	void Schedule(JobCounter& counter, F&& function);
+
+	// Runs function(begin, end) over [0, count) in chunks of grain items, 0 picking a grain
+	// that gives every thread a few chunks to balance with. function must outlive the jobs.
+	template <typename F>
+	void ParallelFor(JobCounter& counter, uint32_t count, uint32_t grain, const F& function);
+
+	// Blocking ParallelFor; the calling thread takes part.
+	template <typename F>
+	void ParallelFor(uint32_t count, uint32_t grain, const F& function) {
+		JobCounter counter;
+		ParallelFor(counter, count, grain, function);
+		Wait(counter);
+	}
+
+	// Runs jobs until counter is done.
+	void Wait(const JobCounter& counter);
+
+private:
+	struct alignas(64) ThreadState {
+		ThreadState() : queue(JOBS_PER_THREAD), jobs(new Job[JOBS_PER_THREAD]) {}
+
+		WorkStealingQueue queue;
+		std::unique_ptr<Job[]> jobs;
+		uint32_t next_job = 0;
+		uint32_t random = 0;
+	};
+
+	template <typename Function>
+	static void RunInPlace(Job& job) {
+		Function* function = reinterpret_cast<Function*>(job.storage);
+		(*function)();
+	}
+
+	template <typename Function>
+	static void RunOnHeap(Job& job) {
+		Function* function;
+		memcpy(&function, job.storage, sizeof(function));
+		(*function)();
+		delete function;
+	}
+
+	template <typename Function, typename F>
+	static void Store(Job& job, F&& function, std::true_type) {
+		new (job.storage) Function(std::forward<F>(function));
+		job.function = &RunInPlace<Function>;
+	}
+
+	template <typename Function, typename F>
+	static void Store(Job& job, F&& function, std::false_type) {
+		Function* copy = new Function(std::forward<F>(function));
+		memcpy(job.storage, &copy, sizeof(copy));
+		job.function = &RunOnHeap<Function>;
+	}
+
+	ThreadState& GetCurrentThreadState();
+	Job* AllocateJob();
+	void Submit(Job* job);
+	bool RunOneJob(ThreadState& state);
+	void Execute(Job* job);
+	void WorkerLoop(uint32_t index, bool pin);
+
+	std::thread::id owner_thread;
+	std::vector<std::unique_ptr<ThreadState>> threads;
+	std::vector<std::thread> workers;
+	std::atomic<bool> stopping{ false };
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::atomic<uint32_t> sleeping_workers{ 0 };
+	uint64_t wake_generation = 0;
+};
+
+template <typename F>
+void JobSystem::Schedule(JobCounter& counter, F&& function) {
+	typedef typename std::decay<F>::type Function;
+	typedef std::integral_constant<bool, sizeof(Function) <= Job::STORAGE_SIZE && alignof(Function) <= 16 && std::is_trivially_copyable<Function>::value> InPlace;
+
+	Job* job = AllocateJob();
+	Store<Function>(*job, std::forward<F>(function), InPlace());
+	job->counter = &counter;
+	counter.pending.fetch_add(1, std::memory_order_relaxed);
+	Submit(job);
+}
+
+template <typename F>
+void JobSystem::ParallelFor(JobCounter& counter, uint32_t count, uint32_t grain, const F& function) {
+	if (grain == 0) {
+		grain = count / (GetThreadCount() * 4) + 1;
+	}
+	for (uint32_t begin = 0; begin < count; begin += grain) {
+		uint32_t end = count - begin < grain ? count : begin + grain;
+		const F* body = &function;
+		Schedule(counter, [body, begin, end]() { (*body)(begin, end); });
+	}
+}
@@ -3,73 +3,237 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "render_helpers.h"
+#include "transform_hierarchy.h"
+#include "arena_allocator.h"
+#include "clock.h"
+#include "clustered_lighting.h"
+#include "frame_capture.h"
+#include "frame_export.h"
+#include "job_system.h"
+#include "memory_telemetry.h"
+#include "mesh_lod.h"
+#include "meshlets.h"
+#include "occlusion_culling.h"
+#include "pipeline_cache.h"
+#include "quad_batch.h"
+#include "resolution_scaling.h"
+#include "shader_watcher.h"
+#include "simulation.h"
+#include "texture_container.h"
+#include "texture_data.h"
+#include "texture_residency.h"
+#include "staging_ring.h"
+#include "vulkan_dispatch.h"
+
 #include <iostream>
 #include <vector>
 #include <array>
 #include <set>
 #include <assert.h>
 #include <algorithm>
-#include <fstream>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
 
 const int WIDTH = 800;
 const int HEIGHT = 600;
 
+// Windows rendering the scene from one device; all of them are recorded into the same command
+// buffer and presented together. The first one captures, replays and shows the HUD.
+const int WINDOW_COUNT = 1;
+
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
-struct Vertex {
-	glm::vec2 pos;
-	glm::vec3 color;
+// Requested MSAA sample count, clamped to what the device supports for both color and depth.
+const VkSampleCountFlagBits MSAA_SAMPLES = VK_SAMPLE_COUNT_4_BIT;
+
+// Only render when something changed (input, resize, animation tick, upload) instead of
+// spinning on DrawFrame, and block in glfwWaitEvents while the image is static.
+const bool RENDER_ON_DEMAND = true;
+// Upper bound on presented frames per second, 0 for uncapped.
+const double MAX_FRAME_RATE = 60.0;
+// Animation time advanced per rendered frame, or 0 to follow the wall clock. A fixed step
+// makes every run render the same sequence of frames.
+const double FIXED_TIME_STEP = 0.0;
+// The scene is stepped at this fixed rate on a thread of its own and interpolated by the
+// renderer. With a FIXED_TIME_STEP the ticks run inline on the render thread instead, as that
+// clock only moves with rendered frames.
+const double SIMULATION_TICK_RATE = 120.0;
+// Spin of the quad, in radians per simulated second.
+const double QUAD_ROTATION_SPEED = glm::radians(90.0);
+
+// The quad is tessellated into a grid and simplified at startup into up to MESH_LOD_COUNT
+// levels, each with about MESH_LOD_REDUCTION of the triangles of the one before. Level 0 is
+// drawn while the quad covers LOD_SCREEN_SIZE of the viewport height or more, each further
+// level below half the size of the previous one. LOD_HYSTERESIS widens the bands so a quad on
+// a boundary keeps its level.
+const uint32_t SCENE_GRID_SUBDIVISIONS = 16;
+const uint32_t MESH_LOD_COUNT = 5;
+const float MESH_LOD_REDUCTION = 0.5f;
+const float LOD_SCREEN_SIZE = 0.5f;
+const float LOD_HYSTERESIS = 0.15f;
+// Culls the scene on the GPU against a depth pyramid. The previous frame's pyramid decides
+// what is drawn first; the pyramid is then rebuilt from that depth and what it wrongly hid is
+// drawn in a second render pass. Keeps each window's depth (and multisampled color) in memory
+// between the two passes.
+const bool OCCLUSION_CULLING = true;
+// Draws the scene as meshlets, clusters of at most MESHLET_MAX_VERTICES vertices and
+// MESHLET_MAX_TRIANGLES triangles built from every level at startup. A compute pass culls the
+// current level's meshlets against each window's frustum and, with MESHLET_CONE_CULLING, those
+// facing away from the camera; the vertex shader then pulls the survivors' vertices from
+// storage buffers instead of fixed-function vertex input. With OCCLUSION_CULLING the object
+// level culling still decides which of its phases draws the quad.
+const bool MESHLET_GEOMETRY = true;
+const bool MESHLET_CONE_CULLING = true;
+
+// Stress scene of LIGHT_COUNT point lights scattered just above the quad, shaded with clustered
+// forward lighting: a compute pass assigns them to view space clusters every frame and each
+// fragment only loops over its cluster's lights. Without CLUSTERED_LIGHTING every fragment
+// loops over all of them, for comparison.
+const uint32_t LIGHT_COUNT = 4096;
+const float LIGHT_MIN_RADIUS = 0.04f;
+const float LIGHT_MAX_RADIUS = 0.12f;
+const float LIGHT_INTENSITY = 0.5f;
+const bool CLUSTERED_LIGHTING = true;
+// GPU timestamps around the passes of every window, averaged in the statistics on exit.
+const bool GPU_PASS_TIMINGS = true;
+// Renders each window's scene into an offscreen target at a fraction of the window's size and
+// upscales it into the swap chain image, trading resolution for frame time. The fraction is
+// picked every frame from the GPU timings so that the scene's passes (everything but the
+// upscale) hold DYNAMIC_RESOLUTION_TARGET milliseconds; without GPU_PASS_TIMINGS it stays at
+// full size. The target is allocated at full size and only the rendered area changes.
+const bool DYNAMIC_RESOLUTION = true;
+const float DYNAMIC_RESOLUTION_TARGET = 8.0f;
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+
+// Particles simulated on the compute queue, a dedicated async compute family when the device
+// has one, and drawn by the graphics queue one frame later.
+const uint32_t PARTICLE_COUNT = 16384;
+// Must match local_size_x in particle.comp.
+const uint32_t PARTICLE_WORKGROUP_SIZE = 256;
+// Longest simulation step, so a pause between rendered frames does not tear the orbits apart.
+const float MAX_PARTICLE_STEP = 1.0f / 30.0f;
+
+// Textures are loaded on worker threads and streamed in coarsest mip first, so startup never
+// waits on them. Resident mips are kept within TEXTURE_BUDGET by evicting the finest mips of
+// the least recently used textures. Entries are base names: texture_compiler writes one
+// container per format at build time and the one matching the device's format is loaded.
+const std::vector<std::string> TEXTURE_FILES = {
+	"textures/checker",
 };
+// Index into TEXTURE_FILES of the texture drawn on the quad.
+const uint32_t SCENE_TEXTURE = 0;
+const VkDeviceSize TEXTURE_BUDGET = 64 * 1024 * 1024;
+// Host visible memory that mip uploads are copied through; bounds the upload bandwidth per
+// frame in flight.
+const VkDeviceSize STAGING_RING_SIZE = 4 * 1024 * 1024;
+
+// The overlay streams its quads through persistently mapped chunks of this many quads, added
+// per frame in flight as a frame needs them. 16384 quads keep indices within 16 bits.
+const uint32_t OVERLAY_CHUNK_QUADS = 16384;
+// Extra small quads the overlay draws every frame to load the batcher; 0 draws just the HUD.
+const uint32_t OVERLAY_STRESS_QUADS = 0;
+
+// How long a replay waits for a texture the capture registered to finish loading before it
+// carries on without it and reports the divergence.
+const double REPLAY_TEXTURE_WAIT = 10.0;
+// Host visible buffers the first window's frames are read back into for --export. A frame is
+// dropped when the next one is still waiting on the GPU or the export worker.
+const uint32_t FRAME_EXPORT_SLOTS = 4;
+
+// Seconds between device memory reports on stdout; 0 only reports at exit.
+const double MEMORY_REPORT_INTERVAL = 10.0;
+// How often heap budgets are re-read from VK_EXT_memory_budget and checked for low memory.
+const uint64_t MEMORY_BUDGET_POLL_FRAMES = 30;
+
+// Vulkan calls and the driver's host allocations are counted per frame and reported with the
+// device memory. Once VULKAN_FRAME_WARMUP frames are past, a frame is over budget when it
+// calls operator new, the driver allocates host memory for it, or it maps memory or allocates
+// descriptor sets. The first such frame is reported with what went over, or asserted on with
+// ASSERT_VULKAN_FRAME_BUDGET, and their number at exit.
+const uint64_t VULKAN_FRAME_WARMUP = 10;
+const bool ASSERT_VULKAN_FRAME_BUDGET = false;
+// Serve the driver's host allocations from per-scope arenas and size-class pools instead of
+// the C heap.
+const bool ARENA_HOST_ALLOCATIONS = true;
+
+// Job system workers next to the main thread, 0 for one per remaining hardware thread. Pinned
+// workers stay on their core instead of migrating with the main thread's load.
+const uint32_t JOB_WORKER_COUNT = 0;
+const bool PIN_JOB_THREADS = true;
+
+// Rebuild a graphics pipeline in the background whenever one of its GLSL sources changes, and
+// swap it in at the next frame. Sources are checked every SHADER_POLL_INTERVAL seconds, also
+// while idle. A source that fails to compile leaves the running pipeline in place.
+const bool SHADER_HOT_RELOAD = true;
+const double SHADER_POLL_INTERVAL = 0.25;
+const char* const SHADER_COMPILER = "glslangValidator";
+#ifndef SHADER_SOURCE_DIR
+#define SHADER_SOURCE_DIR "../shaders"
+#endif
 
-struct UniformBufferObject {
-	glm::mat4 model;
-	glm::mat4 view;
-	glm::mat4 proj;
+// Pipeline descs compiled by the last run, built before the first frame of the next.
+const char* const PIPELINE_PREWARM_FILE = "pipeline_prewarm.bin";
+
+// Orbit applied to the camera per LEFT/RIGHT key press.
+const float CAMERA_YAW_STEP = glm::radians(15.0f);
+// Distance to the target scaled per scroll step, and its limits.
+const float CAMERA_DOLLY_STEP = 1.25f;
+const float CAMERA_MIN_DISTANCE = 1.0f;
+const float CAMERA_MAX_DISTANCE = 9.0f;
+
+enum DirtyFlagBits {
+	DIRTY_INPUT = 1 << 0,
+	DIRTY_RESIZE = 1 << 1,
+	DIRTY_ANIMATION = 1 << 2,
+	DIRTY_UPLOAD = 1 << 3,
+	DIRTY_PIPELINES = 1 << 4,
 };
 
-VkVertexInputBindingDescription GetBindingDescription() {
-	VkVertexInputBindingDescription binding_description = {};
-	binding_description.binding = 0;
-	binding_description.stride = sizeof(Vertex);
-	binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-	return binding_description;
-}
-
-std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescription() {
-	std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions = {};
-
-	attribute_descriptions[0].binding = 0;
-	attribute_descriptions[0].location = 0;
-	attribute_descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-	attribute_descriptions[0].offset = offsetof(Vertex, pos);
-
-	attribute_descriptions[1].binding = 0;
-	attribute_descriptions[1].location = 1;
-	attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attribute_descriptions[1].offset = offsetof(Vertex, color);
-
-	return attribute_descriptions;
-}
-
-const std::vector<Vertex> vertices = {
-	{{-0.5f,-0.5f},{1.0f,0.0f,0.0f}},
-	{{ 0.5f,-0.5f},{0.0f,1.0f,0.0f}},
-	{{ 0.5f, 0.5f},{0.0f,0.0f,1.0f}},
-	{{-0.5f, 0.5f},{1.0f,1.0f,1.0f}},
+// Sources of each graphics pipeline, in SHADER_SOURCE_DIR, the SPIR-V built from them and the
+// preprocessor defines they are compiled with. Programs sharing sources compile them into
+// SPIR-V of their own, so their reloads never write the same file.
+struct ShaderProgram {
+	const char* vert_source;
+	const char* frag_source;
+	const char* vert_spv;
+	const char* frag_spv;
+	const char* defines;
 };
 
-const std::vector<uint16_t> indices = {
-	0,1,2,2,3,0
+enum ShaderProgramId {
+	PROGRAM_SCENE,
+	PROGRAM_PARTICLES,
+	PROGRAM_OVERLAY,
+	// The scene's vertices pulled by meshlet from storage buffers.
+	PROGRAM_SCENE_MESHLETS,
+	PROGRAM_COUNT,
 };
 
+const std::array<ShaderProgram, PROGRAM_COUNT> SHADER_PROGRAMS = { {
+	{ "shader.vert", "shader.frag", "shaders/vert.spv", "shaders/frag.spv", "" },
+	{ "particle.vert", "particle.frag", "shaders/particle_vert.spv", "shaders/particle_frag.spv", "" },
+	{ "batch.vert", "batch.frag", "shaders/batch_vert.spv", "shaders/batch_frag.spv", "" },
+	{ "shader.vert", "shader.frag", "shaders/meshlet_vert.spv", "shaders/meshlet_frag.spv", "-DVERTEX_PULLING" },
+} };
+
 const std::vector<const char*> validation_layers = {
 	"VK_LAYER_LUNARG_standard_validation"
 };
 
 const std::vector<const char*> device_extensions = {
-	VK_KHR_SWAPCHAIN_EXTENSION_NAME
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+	VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME
 };
 
 #define VK_EXT_DEBUG_UTILS_EXTENSION_NAME "VK_EXT_debug_utils"
@@ -106,86 +270,383 @@ void DestroyDebugUtilsMessengerEXT(
 	}
 }
 
+// Every replaceable operator new of the program is counted for the calling thread, so the
+// frame budget can check that a frame did not allocate through new. Calls of malloc and
+// realloc that bypass new, from the program or its libraries, are not seen.
+void* AllocateCounted(size_t size) {
+	CountHeapAllocation();
+	return malloc(size != 0 ? size : 1);
+}
+
+void* operator new(size_t size) {
+	void* memory = AllocateCounted(size);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return AllocateCounted(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return AllocateCounted(size);
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	free(memory);
+}
+
+#ifdef __cpp_aligned_new
+// Over-aligned types. aligned_alloc wants a size that is a multiple of the alignment, and
+// Windows has no aligned_alloc, so its blocks must go back through _aligned_free.
+void* AllocateCountedAligned(size_t size, std::align_val_t alignment) {
+	CountHeapAllocation();
+	size_t align = static_cast<size_t>(alignment);
+	size = (std::max<size_t>(size, 1) + align - 1) & ~(align - 1);
+#if defined(_WIN32)
+	return _aligned_malloc(size, align);
+#else
+	return aligned_alloc(align, size);
+#endif
+}
+
+void FreeAligned(void* memory) {
+#if defined(_WIN32)
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	void* memory = AllocateCountedAligned(size, alignment);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return AllocateCountedAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return AllocateCountedAligned(size, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+	FreeAligned(memory);
+}
+#endif
+
 struct QueueFamilyIndices {
 	int graphics_family = -1;
 	int present_family = -1;
+	int compute_family = -1;
 
 	bool IsComplete() {
-		return graphics_family >= 0 && present_family >= 0;
+		return graphics_family >= 0 && present_family >= 0 && compute_family >= 0;
 	}
 };
 
+// Push constants of particle.comp.
+struct ParticleSimulation {
+	float delta_time;
+	uint32_t particle_count;
+	uint32_t reset;
+};
+
+// Passes timed with GPU timestamps, per window.
+enum GpuPass {
+	GPU_PASS_LIGHT_CLUSTERS,
+	GPU_PASS_DEPTH_PYRAMID,
+	// Everything drawn into the window, culling and the pyramid included.
+	GPU_PASS_WINDOW,
+	// Dynamic resolution's upscale into the swap chain image, submitted after the rest.
+	GPU_PASS_UPSCALE,
+	GPU_PASS_COUNT
+};
+
+const std::array<const char*, GPU_PASS_COUNT> GPU_PASS_NAMES = { "light clusters", "depth pyramid", "window", "upscale" };
+// Timestamps a frame in flight can write.
+const uint32_t GPU_TIMER_QUERIES = WINDOW_COUNT * GPU_PASS_COUNT * 2;
+static_assert(GPU_TIMER_QUERIES / 2 <= 64, "every timer of a frame needs a bit in its written mask");
+
+// Push constants of hiz_reduce.comp.
+struct DepthReduce {
+	uint32_t source_width;
+	uint32_t source_height;
+	uint32_t destination_width;
+	uint32_t destination_height;
+	uint32_t sample_count;
+};
+
+// Push constants of upscale.frag.
+struct Upscale {
+	glm::vec2 uv_scale;
+	glm::vec2 uv_max;
+};
+
+// The lists live in a scratch arena, which must not be rewound while they are used.
 struct SwapChainSupportDetails {
+	explicit SwapChainSupportDetails(LinearArena& arena) : formats(ArenaAllocator<VkSurfaceFormatKHR>(arena)), present_modes(ArenaAllocator<VkPresentModeKHR>(arena)) {}
+
 	VkSurfaceCapabilitiesKHR capabilities;
-	std::vector<VkSurfaceFormatKHR> formats;
-	std::vector<VkPresentModeKHR> present_modes;
+	ScratchVector<VkSurfaceFormatKHR> formats;
+	ScratchVector<VkPresentModeKHR> present_modes;
 };
 
-VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats) {
-	if (available_formats.size() == 1 && available_formats[0].format == VK_FORMAT_UNDEFINED) {
-		return { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
-	}
-	for (const auto& available_format : available_formats) {
-		if (available_format.format == VK_FORMAT_B8G8R8A8_UNORM && available_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-			return available_format;
-		}
-	}
-	return available_formats[0];
-}
+// Render target that only lives inside the render pass (multisampled color, depth), unless
+// occlusion culling reads it between two passes or the upscale pass samples it.
+struct TransientAttachment {
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	bool lazily_allocated = false;
+};
 
-VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes) {
-	VkPresentModeKHR best_mode = VK_PRESENT_MODE_FIFO_KHR;
-	for (const auto& available_present_mode : available_present_modes) {
-		if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-			return available_present_mode;
-		}
-		else if (available_present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-			best_mode = available_present_mode;
-		}
-	}
-	return best_mode;
-}
+// Uniform buffer with one copy per frame in flight. The host copy carries a version that is
+// only bumped when its contents change, and a frame's buffer is rewritten only when it is
+// behind that version.
+struct UniformBlock {
+	VkDeviceSize size = 0;
+	std::vector<char> data;
+	uint64_t version = 0;
+	std::vector<uint64_t> uploaded_versions;
+	std::vector<VkBuffer> buffers;
+	std::vector<VkDeviceMemory> memories;
+	std::vector<void*> mapped;
+};
 
-VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window) {
-	if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
-		return capabilities.currentExtent;
-	}
-	else {
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
-		VkExtent2D actual_extent = { width, height };
+// A window and everything sized to it. The render pass, pipelines and scene resources are
+// shared by all windows, so their swap chains must agree on the format.
+struct PresentWindow {
+	GLFWwindow* window = nullptr;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
+	std::vector<VkImage> images;
+	std::vector<VkImageView> image_views;
+	VkFormat image_format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = {};
+	// Area the scene is rendered at this frame, the top left of its attachments. The whole
+	// window without DYNAMIC_RESOLUTION.
+	VkExtent2D render_extent = {};
+	TransientAttachment color_target;
+	TransientAttachment depth_target;
+	// With DYNAMIC_RESOLUTION the scene renders (or resolves) into scene_color through a single
+	// framebuffer, and the upscale pass draws it into the image through upscale_framebuffers.
+	// Otherwise there is a scene framebuffer per swap chain image.
+	TransientAttachment scene_color;
+	std::vector<VkFramebuffer> framebuffers;
+	std::vector<VkFramebuffer> upscale_framebuffers;
+	VkDescriptorSet upscale_descriptor_set = VK_NULL_HANDLE;
+	// Indexed by frame in flight; acquire and present only take binary semaphores.
+	std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> image_available_semaphores = {};
+	std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> render_finished_semaphores = {};
+	// The projection follows the window's aspect, so each window has its own block, bound
+	// together with the shared camera and object blocks by one set per frame in flight.
+	UniformBlock projection_uniforms;
+	VkExtent2D projection_extent = {};
+	std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptor_sets = {};
+	// Set while a minimized window waits to get its swap chain recreated.
+	bool out_of_date = false;
+	// Swap chain image of the frame being recorded, valid when acquired.
+	uint32_t image_index = 0;
+	bool acquired = false;
+
+	// Occlusion culling. The depth pyramid is rebuilt every frame and tested against by the
+	// next, under the view and projection its depth was drawn with. It is invalid until the
+	// first frame after it was (re)created.
+	VkImage depth_pyramid = VK_NULL_HANDLE;
+	VkDeviceMemory depth_pyramid_memory = VK_NULL_HANDLE;
+	VkImageView depth_pyramid_view = VK_NULL_HANDLE;
+	std::array<VkImageView, DEPTH_PYRAMID_MAX_LEVELS> depth_pyramid_level_views = {};
+	uint32_t depth_pyramid_levels = 0;
+	bool depth_pyramid_valid = false;
+	glm::mat4 depth_pyramid_view_matrix;
+	glm::mat4 depth_pyramid_projection;
+	// Reduces into level i; level 0 reads depth, the others the level below.
+	std::array<VkDescriptorSet, DEPTH_PYRAMID_MAX_LEVELS> reduce_descriptor_sets = {};
+	UniformBlock cull_uniforms;
+	std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> cull_descriptor_sets = {};
+	VkBuffer visibility_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory visibility_memory = VK_NULL_HANDLE;
+	// CULL_MAX_OBJECTS indirect draws for each phase.
+	VkBuffer draw_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory draw_memory = VK_NULL_HANDLE;
+	// Indexed by frame in flight, read back once the frame completed.
+	std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> cull_stats_buffers = {};
+	std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> cull_stats_memories = {};
+	std::array<const CullStats*, MAX_FRAMES_IN_FLIGHT> cull_stats_mapped = {};
+	std::array<bool, MAX_FRAMES_IN_FLIGHT> cull_stats_pending = {};
+
+	// Meshlet culling: a meshlet draw per phase and the meshlets each draws, read through the
+	// geometry set. The uniforms follow the window's frustum.
+	UniformBlock meshlet_cull_uniforms;
+	std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> meshlet_cull_descriptor_sets = {};
+	VkDescriptorSet meshlet_geometry_set = VK_NULL_HANDLE;
+	VkBuffer meshlet_draw_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory meshlet_draw_memory = VK_NULL_HANDLE;
+	VkBuffer visible_meshlet_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory visible_meshlet_memory = VK_NULL_HANDLE;
+	std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> meshlet_stats_buffers = {};
+	std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> meshlet_stats_memories = {};
+	std::array<const MeshletStats*, MAX_FRAMES_IN_FLIGHT> meshlet_stats_mapped = {};
+	std::array<bool, MAX_FRAMES_IN_FLIGHT> meshlet_stats_pending = {};
+
+	// Clustered lighting: the view and projection the clusters are built for, and the grid of
+	// light indices the cluster pass writes and the scene's fragments read.
+	UniformBlock cluster_uniforms;
+	VkBuffer cluster_light_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory cluster_light_memory = VK_NULL_HANDLE;
+	std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> light_descriptor_sets = {};
+};
 
-		actual_extent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actual_extent.width));
-		actual_extent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actual_extent.height));
+// GPU copy of a streamed texture. The image only holds the resident levels, so its level 0 is
+// the finest resident mip and normalized coordinates sample it without any LOD clamping.
+struct StreamedTexture {
+	// Full mip chain as stored in the container, empty until the worker finished loading it.
+	std::vector<MipLevel> mips;
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	uint32_t residency_id = 0;
+	// Level of mips held in level 0 of image.
+	uint32_t image_first_level = 0;
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+};
 
-		return actual_extent;
-	}
-}
+// Image replaced while frames in flight may still sample it, destroyed once the graphics
+// timeline reached timeline_value.
+struct RetiredImage {
+	VkImage image;
+	VkDeviceMemory memory;
+	VkImageView view;
+	uint64_t timeline_value;
+};
 
-std::vector<char> ReadFile(const std::string& filename) {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+struct RetiredPipeline {
+	VkPipeline pipeline;
+	uint64_t timeline_value;
+};
 
-	if (!file.is_open()) {
-		assert(0);
-	}
+// Host visible buffer a frame of the first window is copied into. Pending until the graphics
+// timeline reached timeline_value, then the export worker's until it wrote the frame.
+struct ReadbackSlot {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	const uint8_t* mapped = nullptr;
+	VkDeviceSize size = 0;
+	bool pending = false;
+	uint64_t timeline_value = 0;
+	VkExtent2D extent = {};
+};
+
+// SPIR-V of both stages of a program. Shared with the jobs compiling pipelines from it, so a
+// reload can replace it while they run.
+struct ShaderCode {
+	std::vector<char> vert;
+	std::vector<char> frag;
+	uint64_t hash;
+};
 
-	size_t file_size = (size_t)file.tellg();
-	std::vector<char> buffer(file_size);
+// Result of a background shader reload; code is null when it failed.
+struct ReloadedProgram {
+	uint32_t program;
+	std::shared_ptr<const ShaderCode> code;
+};
 
-	file.seekg(0);
-	file.read(buffer.data(), file_size);
+struct DecodedTexture {
+	uint32_t texture;
+	VkFormat format;
+	std::vector<MipLevel> mips;
+};
 
-	file.close();
+// Host visible vertex memory the overlay batch writes into, mapped for its whole lifetime.
+struct OverlayChunk {
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	BatchVertex* mapped;
+};
 
-	return buffer;
-}
+// Paths from the command line; empty when unused. Capturing records the inputs and draw stream
+// of every rendered frame, replaying renders a capture back unpaced and reports frame times.
+// Exporting writes the first window's frames as images: to a raw file, a sequence of PPMs for
+// a path ending in .ppm, numbered at its run of '#' or before the extension, or the standard
+// input of export_command.
+struct CaptureOptions {
+	std::string capture_path;
+	std::string replay_path;
+	std::string timings_path;
+	std::string export_path;
+	std::string export_command;
+};
 
-class HelloTriangleApplication {
+class HelloTriangleApplication : private QuadBatchTarget {
 public:
+	HelloTriangleApplication(Clock& clock, const CaptureOptions& capture_options) : clock(clock), capture_options(capture_options) {
+	}
+
 	void Run() {
 		InitWindow();
 		InitVulkan();
-		MainLoop();
+		if (replaying) {
+			ReplayCapture();
+		}
+		else {
+			MainLoop();
+		}
 		Cleanup();
 	}
 
@@ -196,7 +657,99 @@ private:
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_FALSE);
 		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-		window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+		int width = WIDTH;
+		int height = HEIGHT;
+		if (!capture_options.replay_path.empty()) {
+			if (!capture_reader.Open(capture_options.replay_path)) {
+				std::cerr << "failed to open capture " << capture_options.replay_path << std::endl;
+				assert(0);
+			}
+			width = static_cast<int>(capture_reader.GetExtent().width);
+			height = static_cast<int>(capture_reader.GetExtent().height);
+			replaying = true;
+		}
+		OpenFrameExport();
+
+		windows.resize(WINDOW_COUNT);
+		for (size_t i = 0; i < windows.size(); ++i) {
+			std::string title = i == 0 ? "Vulkan" : "Vulkan " + std::to_string(i + 1);
+			GLFWwindow* window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+			windows[i].window = window;
+
+			glfwSetWindowUserPointer(window, this);
+			glfwSetFramebufferSizeCallback(window, FramebufferResizeCallback);
+			glfwSetWindowRefreshCallback(window, WindowRefreshCallback);
+			glfwSetKeyCallback(window, KeyCallback);
+			glfwSetMouseButtonCallback(window, MouseButtonCallback);
+			glfwSetScrollCallback(window, ScrollCallback);
+		}
+	}
+
+	bool AnyWindowShouldClose() const {
+		for (const auto& window : windows) {
+			if (glfwWindowShouldClose(window.window)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static void FramebufferResizeCallback(GLFWwindow* window, int, int) {
+		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+		app->MarkDirty(DIRTY_RESIZE);
+	}
+
+	static void WindowRefreshCallback(GLFWwindow* window) {
+		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+		app->MarkDirty(DIRTY_RESIZE);
+	}
+
+	static void KeyCallback(GLFWwindow* window, int key, int, int action, int) {
+		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+		if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+			app->animating = !app->animating;
+			app->simulation.SetPaused(!app->animating);
+		}
+		if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+			app->additive_particles = !app->additive_particles;
+		}
+		if ((key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT) && action != GLFW_RELEASE) {
+			app->OrbitCamera(key == GLFW_KEY_LEFT ? -CAMERA_YAW_STEP : CAMERA_YAW_STEP);
+		}
+		app->MarkDirty(DIRTY_INPUT);
+	}
+
+	static void MouseButtonCallback(GLFWwindow* window, int, int, int) {
+		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+		app->MarkDirty(DIRTY_INPUT);
+	}
+
+	static void ScrollCallback(GLFWwindow* window, double, double y_offset) {
+		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+		if (y_offset != 0.0) {
+			app->DollyCamera(y_offset > 0.0 ? 1.0f / CAMERA_DOLLY_STEP : CAMERA_DOLLY_STEP);
+		}
+		app->MarkDirty(DIRTY_INPUT);
+	}
+
+	void MarkDirty(uint32_t flags) {
+		dirty_flags |= flags;
+	}
+
+	void OrbitCamera(float delta_yaw) {
+		camera_yaw += delta_yaw;
+
+		float distance = glm::length(glm::vec2(camera.eye.x, camera.eye.y));
+		camera.eye.x = distance * std::cos(camera_yaw);
+		camera.eye.y = distance * std::sin(camera_yaw);
+		camera_dirty = true;
+	}
+
+	void DollyCamera(float scale) {
+		glm::vec3 offset = camera.eye - camera.target;
+		float distance = glm::clamp(glm::length(offset) * scale, CAMERA_MIN_DISTANCE, CAMERA_MAX_DISTANCE);
+		camera.eye = camera.target + glm::normalize(offset) * distance;
+		camera_dirty = true;
 	}
 
 	void InitVulkan() {
@@ -205,20 +758,93 @@ private:
 		CreateSurface();
 		PickPhysicalDevice();
 		CreateLogicalDevice();
-		CreateSwapChain();
-		CreateImageViews();
-		CreateRenderPass();
+		InitMemoryTelemetry();
+		for (auto& window : windows) {
+			CreateSwapChain(window);
+			CreateImageViews(window);
+		}
+		// With occlusion culling the scene is drawn in two passes, the second one presenting.
+		CreateRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, !OCCLUSION_CULLING, render_pass);
+		if (OCCLUSION_CULLING) {
+			CreateRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD, true, late_render_pass);
+		}
+		if (DYNAMIC_RESOLUTION) {
+			CreateUpscaleRenderPass();
+		}
 		CreateDescriptorSetLayout();
-		CreateGraphicsPipeline();
-		CreateFramebuffers();
+		CreateTextureDescriptorSetLayout();
+		CreateComputeDescriptorSetLayout();
+		CreateLightDescriptorSetLayout();
+		CreateMeshletDescriptorSetLayout();
+		CreatePipelineLayout();
+		PrewarmPipelines();
+		CreateComputePipeline();
+		if (OCCLUSION_CULLING) {
+			CreateCullingPipelines();
+		}
+		if (MESHLET_GEOMETRY) {
+			CreateMeshletCullingPipeline();
+		}
+		CreateLightClusterPipeline();
+		if (DYNAMIC_RESOLUTION) {
+			CreateUpscalePipeline();
+		}
+		for (auto& window : windows) {
+			CreateColorResources(window);
+			CreateDepthResources(window);
+			CreateFramebuffers(window);
+		}
 		CreateCommandPool();
+		CreateGpuTimers();
+		// Uploads from here on signal the graphics timeline.
+		CreateSemaphores();
+		BuildSceneMesh();
 		CreateVertexBuffers();
 		CreateIndexBuffers();
+		CreateOverlayBuffers();
 		CreateUniformBuffers();
+		if (OCCLUSION_CULLING) {
+			CreateCullingBuffers();
+		}
+		if (MESHLET_GEOMETRY) {
+			CreateMeshletBuffers();
+		}
+		CreateLightBuffers();
+		CreateParticleBuffers();
+		CreateStagingRing();
+		if (frame_exporter.IsOpen()) {
+			CreateReadbackBuffers();
+		}
+		CreateTextureSampler();
+		CreatePlaceholderTexture();
 		CreateDescriptorPool();
 		CreateDescriptorSets();
+		CreateLightDescriptorSets();
+		CreateTextureDescriptorSets();
+		CreateComputeDescriptorSets();
+		if (OCCLUSION_CULLING) {
+			for (auto& window : windows) {
+				CreateCullingDescriptorSets(window);
+				CreateDepthPyramid(window);
+			}
+		}
+		if (MESHLET_GEOMETRY) {
+			for (auto& window : windows) {
+				CreateMeshletDescriptorSets(window);
+			}
+		}
+		if (DYNAMIC_RESOLUTION) {
+			for (auto& window : windows) {
+				CreateUpscaleDescriptorSet(window);
+			}
+		}
 		CreateCommandBuffers();
-		CreateSemaphores();
+		CreateScene();
+		LoadTextures();
+	}
+
+	void CreateScene() {
+		quad_node = scene_transforms.AddNode(TransformHierarchy::NO_PARENT);
 	}
 
 	void CreateInstance() {
@@ -232,7 +858,8 @@ private:
 		app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		app_info.pEngineName = "No Engine";
 		app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		app_info.apiVersion = VK_API_VERSION_1_0;
+		// VK_KHR_timeline_semaphore depends on Vulkan 1.1.
+		app_info.apiVersion = VK_API_VERSION_1_1;
 
 		VkInstanceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -250,7 +877,7 @@ private:
 			create_info.enabledLayerCount = 0;
 		}
 
-		if (vkCreateInstance(&create_info, nullptr, &instance) != VK_SUCCESS) {
+		if (vkCreateInstance(&create_info, allocator, &instance) != VK_SUCCESS) {
 			assert(0);
 		}
 
@@ -278,9 +905,28 @@ private:
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 		}
 
+		// Needed on Vulkan 1.0 to query VK_EXT_memory_budget; optional.
+		physical_device_properties2 = IsInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		if (physical_device_properties2) {
+			extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
+
 		return extensions;
 	}
 
+	bool IsInstanceExtensionAvailable(const char* name) {
+		uint32_t extension_count = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
+		std::vector<VkExtensionProperties> extensions(extension_count);
+		vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, extensions.data());
+		for (const auto& extension : extensions) {
+			if (strcmp(extension.extensionName, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
 	bool CheckValidationLayerSupport() {
 		uint32_t layer_count;
 		vkEnumerateInstanceLayerProperties(&layer_count, nullptr);
@@ -331,14 +977,16 @@ return VK_FALSE;
 		create_info.pfnUserCallback = DebugCallback;
 		create_info.pUserData = nullptr;
 
-		if (CreateDebugUtilsMessengerEXT(instance, &create_info, nullptr, &callback) != VK_SUCCESS) {
+		if (CreateDebugUtilsMessengerEXT(instance, &create_info, allocator, &callback) != VK_SUCCESS) {
 			assert(0);
 		}
 	}
 
 	void CreateSurface() {
-		if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
-			assert(0);
+		for (auto& window : windows) {
+			if (glfwCreateWindowSurface(instance, window.window, allocator, &window.surface) != VK_SUCCESS) {
+				assert(0);
+			}
 		}
 	}
 
@@ -359,6 +1007,81 @@ return VK_FALSE;
 		if (physical_device == VK_NULL_HANDLE) {
 			assert(0);
 		}
+
+		msaa_samples = GetMaxUsableSampleCount(MSAA_SAMPLES);
+		depth_format = FindDepthFormat();
+		texture_format = FindTextureFormat();
+		std::cout << "msaa samples: " << msaa_samples << std::endl;
+		std::cout << "texture format: " << GetTextureContainerSuffix(texture_format) << std::endl;
+	}
+
+	VkSampleCountFlagBits GetMaxUsableSampleCount(VkSampleCountFlagBits requested) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+		VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+		VkSampleCountFlagBits candidates[] = { VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT };
+		for (auto candidate : candidates) {
+			if (candidate <= requested && (counts & candidate)) {
+				return candidate;
+			}
+		}
+		return VK_SAMPLE_COUNT_1_BIT;
+	}
+
+	VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+		for (VkFormat format : candidates) {
+			VkFormatProperties properties;
+			vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+
+			if (tiling == VK_IMAGE_TILING_LINEAR && (properties.linearTilingFeatures & features) == features) {
+				return format;
+			}
+			else if (tiling == VK_IMAGE_TILING_OPTIMAL && (properties.optimalTilingFeatures & features) == features) {
+				return format;
+			}
+		}
+		assert(0);
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	// Occlusion culling builds its depth pyramid by sampling depth.
+	VkFormat FindDepthFormat() {
+		VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		if (OCCLUSION_CULLING) {
+			features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+		}
+		return FindSupportedFormat(
+			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+			VK_IMAGE_TILING_OPTIMAL,
+			features);
+	}
+
+	VkImageAspectFlags GetDepthAspectMask() {
+		if (depth_format == VK_FORMAT_D32_SFLOAT_S8_UINT || depth_format == VK_FORMAT_D24_UNORM_S8_UINT) {
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	}
+
+	// Block-compressed formats are a quarter of the memory and bandwidth of RGBA8 (BC1/ETC2 are
+	// 4 bits per texel) and upload without any CPU decode, so the first one the device can
+	// sample with linear filtering wins. Each family is an optional device feature.
+	VkFormat FindTextureFormat() {
+		VkPhysicalDeviceFeatures features;
+		vkGetPhysicalDeviceFeatures(physical_device, &features);
+
+		std::vector<VkFormat> candidates;
+		for (const auto& container_format : TEXTURE_CONTAINER_FORMATS) {
+			if (container_format.format == VK_FORMAT_BC1_RGB_UNORM_BLOCK && !features.textureCompressionBC) {
+				continue;
+			}
+			if (container_format.format == VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && !features.textureCompressionETC2) {
+				continue;
+			}
+			candidates.push_back(container_format.format);
+		}
+		return FindSupportedFormat(candidates, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
 	}
 
 	bool IsDeviceSuitable(VkPhysicalDevice device) {
@@ -368,7 +1091,8 @@ return VK_FALSE;
 
 		bool swap_chain_adequate = false;
 		if (extensions_supported) {
-			SwapChainSupportDetails swap_chain_support = QuerySwapChainSupport(device);
+			ScratchScope scratch(scratch_arena);
+			SwapChainSupportDetails swap_chain_support = QuerySwapChainSupport(device, windows[0].surface);
 			swap_chain_adequate = !swap_chain_support.formats.empty() && !swap_chain_support.present_modes.empty();
 		}
 
@@ -378,22 +1102,28 @@ return VK_FALSE;
 	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device) {
 		QueueFamilyIndices indices;
 
+		ScratchScope scratch(scratch_arena);
 		uint32_t queue_family_count;
 		vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, nullptr);
-		std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+		ScratchVector<VkQueueFamilyProperties> queue_families(queue_family_count, ArenaAllocator<VkQueueFamilyProperties>(scratch_arena));
 		vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_families.data());
 		int i = 0;
 		for (const auto& queue_family : queue_families) {
 			VkBool32 present_support = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
-			if (queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, windows[0].surface, &present_support);
+			if (queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT && indices.graphics_family < 0) {
 				indices.graphics_family = i;
 			}
-			if (queue_family.queueCount > 0 && present_support) {
+			if (queue_family.queueCount > 0 && present_support && indices.present_family < 0) {
 				indices.present_family = i;
 			}
-			if (indices.IsComplete()) {
-				break;
+			// A compute family without graphics runs next to the graphics queue instead of
+			// being serialized with it, so it wins over any graphics-capable family.
+			if (queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+				bool dedicated = !(queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+				if (indices.compute_family < 0 || (dedicated && queue_families[indices.compute_family].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+					indices.compute_family = i;
+				}
 			}
 			++i;
 		}
@@ -401,8 +1131,9 @@ return VK_FALSE;
 		return indices;
 	}
 
-	SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device) {
-		SwapChainSupportDetails details;
+	// The details are allocated in scratch_arena; callers open a ScratchScope around them.
+	SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
+		SwapChainSupportDetails details(scratch_arena);
 
 		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
 
@@ -424,25 +1155,33 @@ return VK_FALSE;
 	}
 
 	bool CheckDeviceExtensionSupport(VkPhysicalDevice device) {
+		for (const char* extension : device_extensions) {
+			if (!IsDeviceExtensionAvailable(device, extension)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool IsDeviceExtensionAvailable(VkPhysicalDevice device, const char* name) {
+		ScratchScope scratch(scratch_arena);
 		uint32_t extension_count;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
-		std::vector<VkExtensionProperties> available_extensions(extension_count);
-		vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
-
-		std::set<std::string> required_extensions(device_extensions.begin(), device_extensions.end());
-
-		for (const auto& extension : available_extensions) {
-			required_extensions.erase(extension.extensionName);
+		ScratchVector<VkExtensionProperties> extensions(extension_count, ArenaAllocator<VkExtensionProperties>(scratch_arena));
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extensions.data());
+		for (const auto& extension : extensions) {
+			if (strcmp(extension.extensionName, name) == 0) {
+				return true;
+			}
 		}
-
-		return required_extensions.empty();
+		return false;
 	}
 
 	void CreateLogicalDevice() {
 		QueueFamilyIndices indices = FindQueueFamilies(physical_device);
 
 		std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-		std::set<int> unique_queue_families = { indices.graphics_family, indices.present_family };
+		std::set<int> unique_queue_families = { indices.graphics_family, indices.present_family, indices.compute_family };
 		float queue_priority = 1.0f;
 
 		for (int queue_family : unique_queue_families) {
@@ -455,14 +1194,26 @@ return VK_FALSE;
 		}
 
 		VkPhysicalDeviceFeatures device_features = {};
+		device_features.textureCompressionBC = texture_format == VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		device_features.textureCompressionETC2 = texture_format == VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = {};
+		timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timeline_features.timelineSemaphore = VK_TRUE;
 
 		VkDeviceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		create_info.pNext = &timeline_features;
 		create_info.pQueueCreateInfos = queue_create_infos.data();
 		create_info.queueCreateInfoCount = queue_create_infos.size();
 		create_info.pEnabledFeatures = &device_features;
-		create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-		create_info.ppEnabledExtensionNames = device_extensions.data();
+		std::vector<const char*> enabled_extensions = device_extensions;
+		memory_budget = physical_device_properties2 && IsDeviceExtensionAvailable(physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (memory_budget) {
+			enabled_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+		create_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
+		create_info.ppEnabledExtensionNames = enabled_extensions.data();
 		if (enable_validation_layers) {
 			create_info.enabledLayerCount = static_cast<uint32_t>(validation_layers.size());
 			create_info.ppEnabledLayerNames = validation_layers.data();
@@ -471,20 +1222,36 @@ return VK_FALSE;
 			create_info.enabledLayerCount = 0;
 		}
 
-		if (vkCreateDevice(physical_device, &create_info, nullptr, &device) != VK_SUCCESS) {
+		if (vkCreateDevice(physical_device, &create_info, allocator, &device) != VK_SUCCESS) {
 			assert(0);
 		}
 
 		vkGetDeviceQueue(device, indices.graphics_family, 0, &graphics_queue);
 		vkGetDeviceQueue(device, indices.present_family, 0, &present_queue);
+		vkGetDeviceQueue(device, indices.compute_family, 0, &compute_queue);
+
+		wait_semaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+		get_semaphore_counter_value = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+		if (wait_semaphores == nullptr || get_semaphore_counter_value == nullptr) {
+			assert(0);
+		}
+
+		graphics_family = indices.graphics_family;
+		compute_family = indices.compute_family;
+		if (graphics_family != compute_family) {
+			std::cout << "async compute on queue family " << compute_family << std::endl;
+		}
 	}
 
-	void CreateSwapChain() {
-		SwapChainSupportDetails swap_chain_support = QuerySwapChainSupport(physical_device);
+	void CreateSwapChain(PresentWindow& window) {
+		ScratchScope scratch(scratch_arena);
+		SwapChainSupportDetails swap_chain_support = QuerySwapChainSupport(physical_device, window.surface);
 
-		VkSurfaceFormatKHR surface_format = ChooseSwapSurfaceFormat(swap_chain_support.formats);
-		VkPresentModeKHR present_mode = ChooseSwapPresentMode(swap_chain_support.present_modes);
-		VkExtent2D extent = ChooseSwapExtent(swap_chain_support.capabilities, window);
+		VkSurfaceFormatKHR surface_format = ChooseSwapSurfaceFormat(swap_chain_support.formats.data(), static_cast<uint32_t>(swap_chain_support.formats.size()));
+		VkPresentModeKHR present_mode = ChooseSwapPresentMode(swap_chain_support.present_modes.data(), static_cast<uint32_t>(swap_chain_support.present_modes.size()));
+		int framebuffer_width, framebuffer_height;
+		glfwGetFramebufferSize(window.window, &framebuffer_width, &framebuffer_height);
+		VkExtent2D extent = ChooseSwapExtent(swap_chain_support.capabilities, framebuffer_width, framebuffer_height);
 
 		uint32_t image_count = swap_chain_support.capabilities.minImageCount + 1;
 		if (swap_chain_support.capabilities.maxImageCount > 0 && image_count > swap_chain_support.capabilities.maxImageCount) {
@@ -493,17 +1260,33 @@ return VK_FALSE;
 
 		VkSwapchainCreateInfoKHR create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-		create_info.surface = surface;
+		create_info.surface = window.surface;
 		create_info.minImageCount = image_count;
 		create_info.imageFormat = surface_format.format;
 		create_info.imageColorSpace = surface_format.colorSpace;
 		create_info.imageExtent = extent;
 		create_info.imageArrayLayers = 1;
 		create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-		
+		if (&window == &windows[0] && frame_exporter.IsOpen()) {
+			if (!(swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+				std::cerr << "swap chain images cannot be copied from, not exporting" << std::endl;
+				frame_exporter.Close();
+			}
+			else {
+				create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			}
+		}
+
 		QueueFamilyIndices indices = FindQueueFamilies(physical_device);
 		uint32_t queue_family_indices[] = {(uint32_t) indices.graphics_family, (uint32_t) indices.present_family};
 
+		// The present queue was picked for the first window; all of them present from it.
+		VkBool32 present_support = VK_FALSE;
+		vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, indices.present_family, window.surface, &present_support);
+		if (!present_support) {
+			assert(0);
+		}
+
 		if (indices.graphics_family != indices.present_family) {
 			create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
 			create_info.queueFamilyIndexCount = 2;
@@ -521,26 +1304,34 @@ return VK_FALSE;
 		create_info.clipped = VK_TRUE;
 		create_info.oldSwapchain = VK_NULL_HANDLE;
 
-		if (vkCreateSwapchainKHR(device, &create_info, nullptr, &swap_chain) != VK_SUCCESS) {
+		if (vkCreateSwapchainKHR(device, &create_info, allocator, &window.swap_chain) != VK_SUCCESS) {
 			assert(0);
 		}
 
-		vkGetSwapchainImagesKHR(device, swap_chain, &image_count, nullptr);
-		swap_chain_images.resize(image_count);
-		vkGetSwapchainImagesKHR(device, swap_chain, &image_count, swap_chain_images.data());
+		vkGetSwapchainImagesKHR(device, window.swap_chain, &image_count, nullptr);
+		window.images.resize(image_count);
+		vkGetSwapchainImagesKHR(device, window.swap_chain, &image_count, window.images.data());
+
+		window.image_format = surface_format.format;
+		window.extent = extent;
 
-		swap_chain_image_format = surface_format.format;
-		swap_chain_extent = extent;
+		// The first swap chain picks the format of the shared render pass and pipelines.
+		if (swap_chain_image_format == VK_FORMAT_UNDEFINED) {
+			swap_chain_image_format = window.image_format;
+		}
+		if (window.image_format != swap_chain_image_format) {
+			assert(0);
+		}
 	}
 
-	void CreateImageViews() {
-		swap_chain_image_views.resize(swap_chain_images.size());
-		for (size_t i = 0; i < swap_chain_image_views.size(); ++i) {
+	void CreateImageViews(PresentWindow& window) {
+		window.image_views.resize(window.images.size());
+		for (size_t i = 0; i < window.image_views.size(); ++i) {
 			VkImageViewCreateInfo create_info = {};
 			create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			create_info.image = swap_chain_images[i];
+			create_info.image = window.images[i];
 			create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			create_info.format = swap_chain_image_format;
+			create_info.format = window.image_format;
 			create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 			create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 			create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -551,78 +1342,540 @@ return VK_FALSE;
 			create_info.subresourceRange.baseArrayLayer = 0;
 			create_info.subresourceRange.layerCount = 1;
 
-			if (vkCreateImageView(device, &create_info, nullptr, &swap_chain_image_views[i]) != VK_SUCCESS) {
+			if (vkCreateImageView(device, &create_info, allocator, &window.image_views[i]) != VK_SUCCESS) {
 				assert(0);
 			}
 		}
 	}
 
-	void CreateRenderPass() {
+	// load_op is what color and depth start with: cleared, or kept from a previous pass that
+	// did not present. All variants are compatible, so they share pipelines and framebuffers.
+	// With DYNAMIC_RESOLUTION the presenting pass leaves the scene color for the upscale pass
+	// to sample instead.
+	void CreateRenderPass(VkAttachmentLoadOp load_op, bool presents, VkRenderPass& pass) {
+		bool multisampled = msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+		bool loads = load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+		VkImageLayout output_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		if (presents) {
+			output_layout = DYNAMIC_RESOLUTION ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		}
+
+		// The multisampled attachments are resolved inside the subpass, so their contents never
+		// have to leave tile memory and can be discarded at the end of the pass. A pass another
+		// one continues has to store them.
 		VkAttachmentDescription color_attachment = {};
 		color_attachment.format = swap_chain_image_format;
-		color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		color_attachment.samples = msaa_samples;
+		color_attachment.loadOp = load_op;
+		color_attachment.storeOp = multisampled && presents ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 		color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		color_attachment.initialLayout = loads ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		color_attachment.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : output_layout;
+
+		VkAttachmentDescription depth_attachment = {};
+		depth_attachment.format = depth_format;
+		depth_attachment.samples = msaa_samples;
+		depth_attachment.loadOp = load_op;
+		depth_attachment.storeOp = presents ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+		depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depth_attachment.initialLayout = loads ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		// Resolving is only wanted by the pass that presents; a pass before it resolves into the
+		// image all the same and the result is overwritten.
+		VkAttachmentDescription color_attachment_resolve = {};
+		color_attachment_resolve.format = swap_chain_image_format;
+		color_attachment_resolve.samples = VK_SAMPLE_COUNT_1_BIT;
+		color_attachment_resolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment_resolve.storeOp = presents ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		color_attachment_resolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment_resolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		color_attachment_resolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		color_attachment_resolve.finalLayout = output_layout;
 
 		VkAttachmentReference color_attachment_ref = {};
 		color_attachment_ref.attachment = 0;
 		color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+		VkAttachmentReference depth_attachment_ref = {};
+		depth_attachment_ref.attachment = 1;
+		depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference color_attachment_resolve_ref = {};
+		color_attachment_resolve_ref.attachment = 2;
+		color_attachment_resolve_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
 		VkSubpassDescription subpass = {};
 		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 		subpass.colorAttachmentCount = 1;
 		subpass.pColorAttachments = &color_attachment_ref;
+		subpass.pResolveAttachments = multisampled ? &color_attachment_resolve_ref : nullptr;
+		subpass.pDepthStencilAttachment = &depth_attachment_ref;
 
+		// The frames in flight share the color and depth targets, so a clearing pass must wait
+		// for the previous frame's writes just as a loading pass waits for the previous pass's.
 		VkSubpassDependency dependency = {};
 		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		// The previous frame's upscale is done sampling the scene color before it is overwritten.
+		if (DYNAMIC_RESOLUTION) {
+			dependency.srcStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		}
+
+		// The upscale pass samples what the presenting pass wrote.
+		VkSubpassDependency output_dependency = {};
+		output_dependency.srcSubpass = 0;
+		output_dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+		output_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		output_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		output_dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		output_dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		std::array<VkSubpassDependency, 2> dependencies = { dependency, output_dependency };
+
+		std::vector<VkAttachmentDescription> attachments = { color_attachment, depth_attachment };
+		if (multisampled) {
+			attachments.push_back(color_attachment_resolve);
+		}
 
 		VkRenderPassCreateInfo render_pass_info = {};
 		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		render_pass_info.attachmentCount = 1;
-		render_pass_info.pAttachments = &color_attachment;
+		render_pass_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+		render_pass_info.pAttachments = attachments.data();
 		render_pass_info.subpassCount = 1;
 		render_pass_info.pSubpasses = &subpass;
-		render_pass_info.dependencyCount = 1;
-		render_pass_info.pDependencies = &dependency;
+		render_pass_info.dependencyCount = presents && DYNAMIC_RESOLUTION ? 2 : 1;
+		render_pass_info.pDependencies = dependencies.data();
 
-		if (vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass) != VK_SUCCESS) {
+		if (vkCreateRenderPass(device, &render_pass_info, allocator, &pass) != VK_SUCCESS) {
 			assert(0);
 		}
 	}
 
-	void CreateDescriptorSetLayout() {
-		VkDescriptorSetLayoutBinding ubo_layout_binding = {};
-		ubo_layout_binding.binding = 0;
-		ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		ubo_layout_binding.descriptorCount = 1;
-		ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		ubo_layout_binding.pImmutableSamplers = nullptr;
+	// The upscale only writes the swap chain image, all of it, so its old contents are never
+	// loaded.
+	void CreateUpscaleRenderPass() {
+		VkAttachmentDescription color_attachment = {};
+		color_attachment.format = swap_chain_image_format;
+		color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
-		VkDescriptorSetLayoutCreateInfo layout_info = {};
-		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layout_info.bindingCount = 1;
-		layout_info.pBindings = &ubo_layout_binding;
+		VkAttachmentReference color_attachment_ref = {};
+		color_attachment_ref.attachment = 0;
+		color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-		if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &descriptor_set_layout) != VK_SUCCESS) {
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &color_attachment_ref;
+
+		// Waits for the acquired image, like the submit.
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass = 0;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask = 0;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		VkRenderPassCreateInfo render_pass_info = {};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		render_pass_info.attachmentCount = 1;
+		render_pass_info.pAttachments = &color_attachment;
+		render_pass_info.subpassCount = 1;
+		render_pass_info.pSubpasses = &subpass;
+		render_pass_info.dependencyCount = 1;
+		render_pass_info.pDependencies = &dependency;
+
+		if (vkCreateRenderPass(device, &render_pass_info, allocator, &upscale_render_pass) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// Binding 0 projection, 1 camera, 2 object, in order of how rarely they change.
+	void CreateDescriptorSetLayout() {
+		std::array<VkDescriptorSetLayoutBinding, 3> ubo_layout_bindings = {};
+		for (uint32_t i = 0; i < ubo_layout_bindings.size(); ++i) {
+			ubo_layout_bindings[i].binding = i;
+			ubo_layout_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			ubo_layout_bindings[i].descriptorCount = 1;
+			ubo_layout_bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+			ubo_layout_bindings[i].pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = static_cast<uint32_t>(ubo_layout_bindings.size());
+		layout_info.pBindings = ubo_layout_bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device, &layout_info, allocator, &descriptor_set_layout) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// Set 1 holds the scene texture. It is separate from the per-image uniforms because it is
+	// rewritten whenever streaming swaps the image, which must not touch a set still in flight.
+	void CreateTextureDescriptorSetLayout() {
+		VkDescriptorSetLayoutBinding sampler_layout_binding = {};
+		sampler_layout_binding.binding = 0;
+		sampler_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		sampler_layout_binding.descriptorCount = 1;
+		sampler_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		sampler_layout_binding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = 1;
+		layout_info.pBindings = &sampler_layout_binding;
+
+		if (vkCreateDescriptorSetLayout(device, &layout_info, allocator, &texture_descriptor_set_layout) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// Binding 0 particle state, 1 vertex stream written for the graphics queue.
+	void CreateComputeDescriptorSetLayout() {
+		std::array<VkDescriptorSetLayoutBinding, 2> storage_layout_bindings = {};
+		for (uint32_t i = 0; i < storage_layout_bindings.size(); ++i) {
+			storage_layout_bindings[i].binding = i;
+			storage_layout_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			storage_layout_bindings[i].descriptorCount = 1;
+			storage_layout_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			storage_layout_bindings[i].pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = static_cast<uint32_t>(storage_layout_bindings.size());
+		layout_info.pBindings = storage_layout_bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device, &layout_info, allocator, &compute_descriptor_set_layout) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// Binding 0 the cluster uniforms, 1 the lights, 2 the cluster light grid. Shared by the
+	// scene's fragment shader and the cluster pass.
+	void CreateLightDescriptorSetLayout() {
+		std::array<VkDescriptorSetLayoutBinding, 3> light_layout_bindings = {};
+		for (uint32_t i = 0; i < light_layout_bindings.size(); ++i) {
+			light_layout_bindings[i].binding = i;
+			light_layout_bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			light_layout_bindings[i].descriptorCount = 1;
+			light_layout_bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+			light_layout_bindings[i].pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = static_cast<uint32_t>(light_layout_bindings.size());
+		layout_info.pBindings = light_layout_bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device, &layout_info, allocator, &light_descriptor_set_layout) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// Binding 0 the scene's vertices, 1 the meshlets, 2 their vertex indices, 3 their packed
+	// triangles, 4 the window's visible meshlets. Only the meshlet program reads them.
+	void CreateMeshletDescriptorSetLayout() {
+		std::array<VkDescriptorSetLayoutBinding, 5> geometry_layout_bindings = {};
+		for (uint32_t i = 0; i < geometry_layout_bindings.size(); ++i) {
+			geometry_layout_bindings[i].binding = i;
+			geometry_layout_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			geometry_layout_bindings[i].descriptorCount = 1;
+			geometry_layout_bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+			geometry_layout_bindings[i].pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = static_cast<uint32_t>(geometry_layout_bindings.size());
+		layout_info.pBindings = geometry_layout_bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device, &layout_info, allocator, &meshlet_descriptor_set_layout) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// Set 0 the uniform blocks, 1 the texture, 2 the lights, 3 the meshlet geometry. The push
+	// constant is where the meshlet program's phase starts in the visible meshlets.
+	void CreatePipelineLayout() {
+		std::array<VkDescriptorSetLayout, 4> set_layouts = { descriptor_set_layout, texture_descriptor_set_layout, light_descriptor_set_layout, meshlet_descriptor_set_layout };
+
+		VkPushConstantRange push_constant_range = {};
+		push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		push_constant_range.offset = 0;
+		push_constant_range.size = sizeof(uint32_t);
+
+		VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+		pipeline_layout_info.pSetLayouts = set_layouts.data();
+		pipeline_layout_info.pushConstantRangeCount = 1;
+		pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+		if (vkCreatePipelineLayout(device, &pipeline_layout_info, allocator, &pipeline_layout) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// Loads every program's SPIR-V, then builds the pipelines the previous run compiled and the
+	// default one of every program in parallel on the job system, so that first use of any of
+	// them does not stall a frame.
+	void PrewarmPipelines() {
+		for (uint32_t program = 0; program < PROGRAM_COUNT; ++program) {
+			shader_code[program] = LoadShaderCode(SHADER_PROGRAMS[program].vert_spv, SHADER_PROGRAMS[program].frag_spv);
+		}
+
+		std::vector<PipelineDesc> descs;
+		LoadPipelinePrewarmList(PIPELINE_PREWARM_FILE, descs);
+		for (uint32_t program = 0; program < PROGRAM_COUNT; ++program) {
+			descs.push_back(GetProgramDesc(program));
+		}
+
+		for (const auto& desc : descs) {
+			if (desc.program >= PROGRAM_COUNT) {
+				continue;
+			}
+			// Entries of since edited shaders or another swap chain format are stale.
+			PipelineDesc current = GetProgramDesc(desc.program);
+			if (desc.shader_hash != current.shader_hash || desc.color_format != current.color_format ||
+				desc.depth_format != current.depth_format || desc.samples != current.samples) {
+				continue;
+			}
+			if (pipeline_cache.Claim(desc)) {
+				CompilePipelineAsync(desc);
+			}
+		}
+		jobs.Wait(pipeline_jobs);
+	}
+
+	static std::shared_ptr<const ShaderCode> LoadShaderCode(const std::string& vert_path, const std::string& frag_path) {
+		std::shared_ptr<ShaderCode> code = std::make_shared<ShaderCode>();
+		code->vert = ReadFile(vert_path);
+		code->frag = ReadFile(frag_path);
+		code->hash = HashBytes(code->frag.data(), code->frag.size(), HashBytes(code->vert.data(), code->vert.size()));
+		return code;
+	}
+
+	template <size_t N>
+	static void SetVertexLayout(PipelineDesc& desc, const VkVertexInputBindingDescription& binding, const std::array<VkVertexInputAttributeDescription, N>& attributes) {
+		static_assert(N <= PipelineDesc::MAX_ATTRIBUTES, "too many vertex attributes");
+		desc.vertex_stride = binding.stride;
+		desc.vertex_input_rate = binding.inputRate;
+		desc.attribute_count = static_cast<uint32_t>(N);
+		for (size_t i = 0; i < N; ++i) {
+			desc.attributes[i] = { attributes[i].location, static_cast<uint32_t>(attributes[i].format), attributes[i].offset };
+		}
+	}
+
+	// The default pipeline state of a program for the current shaders and render pass; draws
+	// adjust it for their variant.
+	PipelineDesc GetProgramDesc(uint32_t program) {
+		PipelineDesc desc = MakePipelineDesc();
+		desc.shader_hash = shader_code[program]->hash;
+		desc.program = program;
+		desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		desc.polygon_mode = VK_POLYGON_MODE_FILL;
+		desc.cull_mode = VK_CULL_MODE_BACK_BIT;
+		desc.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		desc.blend_mode = PIPELINE_BLEND_NONE;
+		desc.depth_compare_op = VK_COMPARE_OP_LESS;
+		desc.color_format = swap_chain_image_format;
+		desc.depth_format = depth_format;
+		desc.samples = msaa_samples;
+		desc.subpass = 0;
+
+		switch (program) {
+		case PROGRAM_SCENE:
+			SetVertexLayout(desc, GetBindingDescription(), GetAttributeDescription());
+			desc.depth_test = VK_TRUE;
+			desc.depth_write = VK_TRUE;
+			break;
+		case PROGRAM_PARTICLES:
+			// Particles share the scene's descriptor sets and are drawn over it without depth.
+			SetVertexLayout(desc, GetParticleBindingDescription(), GetParticleAttributeDescription());
+			desc.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+			break;
+		case PROGRAM_OVERLAY:
+			SetVertexLayout(desc, GetBatchBindingDescription(), GetBatchAttributeDescription());
+			// Overlay lines come in either winding.
+			desc.cull_mode = VK_CULL_MODE_NONE;
+			desc.blend_mode = PIPELINE_BLEND_ALPHA;
+			break;
+		case PROGRAM_SCENE_MESHLETS:
+			// No vertex input: the shader fetches its vertices.
+			desc.depth_test = VK_TRUE;
+			desc.depth_write = VK_TRUE;
+			break;
+		default:
 			assert(0);
 		}
+		return desc;
+	}
+
+	// The pipeline for desc. A desc seen for the first time is compiled on the job system and
+	// the draw falls back to the fallback desc meanwhile, when there is one and it is ready;
+	// otherwise VK_NULL_HANDLE tells the caller to skip the draw.
+	VkPipeline GetPipeline(const PipelineDesc& desc, const PipelineDesc* fallback = nullptr) {
+		bool claimed_compile;
+		VkPipeline pipeline = pipeline_cache.Find(desc, claimed_compile);
+		if (claimed_compile) {
+			CompilePipelineAsync(desc);
+		}
+		if (pipeline == VK_NULL_HANDLE && fallback != nullptr) {
+			pipeline = pipeline_cache.Find(*fallback, claimed_compile);
+			if (claimed_compile) {
+				CompilePipelineAsync(*fallback);
+			}
+		}
+		return pipeline;
+	}
+
+	void CompilePipelineAsync(const PipelineDesc& desc) {
+		std::shared_ptr<const ShaderCode> code = shader_code[desc.program];
+		jobs.Schedule(pipeline_jobs, [this, desc, code]() {
+			pipeline_cache.Complete(desc, CreatePipeline(desc, *code));
+			// Renders a frame with the new pipeline even while idle.
+			pipelines_ready = true;
+			glfwPostEmptyEvent();
+		});
+	}
+
+	// Sources shared by several programs are watched once.
+	void WatchShaderSources() {
+		std::set<std::string> sources;
+		for (const auto& program : SHADER_PROGRAMS) {
+			sources.insert(program.vert_source);
+			sources.insert(program.frag_source);
+		}
+		for (const auto& source : sources) {
+			shader_watcher.AddFile(std::string(SHADER_SOURCE_DIR) + "/" + source);
+		}
+	}
+
+	// Starts a reload of every program whose sources changed. A program is only rebuilt by one
+	// job at a time; changes during a rebuild queue one more, started once it finished.
+	void PollShaderSources() {
+		changed_shader_sources.clear();
+		shader_watcher.Poll(changed_shader_sources);
+		for (uint32_t program = 0; program < PROGRAM_COUNT; ++program) {
+			if (shader_reload_queued[program] && !shader_reload_running[program]) {
+				shader_reload_queued[program] = false;
+				ScheduleShaderReload(program);
+				continue;
+			}
+			for (const auto& path : changed_shader_sources) {
+				if (path == std::string(SHADER_SOURCE_DIR) + "/" + SHADER_PROGRAMS[program].vert_source || path == std::string(SHADER_SOURCE_DIR) + "/" + SHADER_PROGRAMS[program].frag_source) {
+					ScheduleShaderReload(program);
+					break;
+				}
+			}
+		}
+	}
+
+	void ScheduleShaderReload(uint32_t program) {
+		if (shader_reload_running[program]) {
+			shader_reload_queued[program] = true;
+			return;
+		}
+		shader_reload_running[program] = true;
+		PipelineDesc desc = GetProgramDesc(program);
+		jobs.Schedule(pipeline_jobs, [this, desc]() {
+			ReloadShaderProgram(desc);
+		});
+	}
+
+	// Runs on a job: compiles both stages of desc's program next to their SPIR-V and builds the
+	// default pipeline from the new code into the cache, so the swap to the new shaders finds it
+	// ready. Only when both stages compile does the new SPIR-V replace the old.
+	void ReloadShaderProgram(PipelineDesc desc) {
+		const ShaderProgram& sources = SHADER_PROGRAMS[desc.program];
+		std::string vert_path = std::string(sources.vert_spv) + ".reload";
+		std::string frag_path = std::string(sources.frag_spv) + ".reload";
+
+		std::shared_ptr<const ShaderCode> code;
+		if (CompileShader(sources.vert_source, vert_path, sources.defines) && CompileShader(sources.frag_source, frag_path, sources.defines)) {
+			code = LoadShaderCode(vert_path, frag_path);
+			// The new code is swapped in either way; a SPIR-V file left stale only matters to
+			// the next run.
+			if (!ReplaceFileAtomically(vert_path, sources.vert_spv)) {
+				std::cerr << "shader reload: failed to replace " << sources.vert_spv << ", it keeps the old code" << std::endl;
+			}
+			if (!ReplaceFileAtomically(frag_path, sources.frag_spv)) {
+				std::cerr << "shader reload: failed to replace " << sources.frag_spv << ", it keeps the old code" << std::endl;
+			}
+
+			// Unchanged code hashes to a desc that may already be cached, or claimed by a lookup
+			// on the render thread; then that pipeline is the one to use.
+			desc.shader_hash = code->hash;
+			if (pipeline_cache.Claim(desc)) {
+				pipeline_cache.Complete(desc, CreatePipeline(desc, *code));
+			}
+		}
+		else {
+			std::cerr << "shader reload: " << sources.vert_source << " + " << sources.frag_source << " failed to compile, keeping the running pipeline" << std::endl;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(reloaded_programs_mutex);
+			reloaded_programs.push_back({ desc.program, code });
+		}
+		pipelines_ready = true;
+		glfwPostEmptyEvent();
+	}
+
+	static bool CompileShader(const std::string& source, const std::string& output, const std::string& defines) {
+		std::string command = std::string(SHADER_COMPILER) + " -V " + defines + " \"" + SHADER_SOURCE_DIR + "/" + source + "\" -o \"" + output + "\"";
+		return std::system(command.c_str()) == 0;
 	}
 
-	void CreateGraphicsPipeline() {
-		auto vert_shader_code = ReadFile("shaders/vert.spv");
-		auto frag_shader_code = ReadFile("shaders/frag.spv");
+	// Switches reloaded programs to their new shaders at the frame boundary. Pipelines built
+	// from the old shaders may still be bound by frames in flight, so they are retired until
+	// those completed.
+	void SwapReloadedShaders() {
+		std::vector<ReloadedProgram> reloaded;
+		{
+			std::lock_guard<std::mutex> lock(reloaded_programs_mutex);
+			reloaded.swap(reloaded_programs);
+		}
+		for (const auto& result : reloaded) {
+			shader_reload_running[result.program] = false;
+			if (!result.code) {
+				continue;
+			}
+			shader_code[result.program] = result.code;
+
+			std::vector<VkPipeline> stale;
+			pipeline_cache.RemoveIf([&result](const PipelineDesc& desc) {
+				return desc.program == result.program && desc.shader_hash != result.code->hash;
+			}, stale);
+			for (VkPipeline pipeline : stale) {
+				retired_pipelines.push_back({ pipeline, GetPendingGraphicsValue() });
+			}
+			std::cout << "shader reload: swapped in " << SHADER_PROGRAMS[result.program].vert_source << " + " << SHADER_PROGRAMS[result.program].frag_source << std::endl;
+		}
+	}
 
-		VkShaderModule vert_shader_module = CreateShaderModule(vert_shader_code);
-		VkShaderModule frag_shader_module = CreateShaderModule(frag_shader_code);
+	// Builds the pipeline desc describes from code. Runs on jobs; besides desc and code it only
+	// reads the device, pipeline layout and render pass, which are created before the first job
+	// and destroyed in Cleanup after waiting for them. Swap chain recreation keeps all three:
+	// the swap chain format must not change and viewports are dynamic. Returns VK_NULL_HANDLE
+	// on failure.
+	VkPipeline CreatePipeline(const PipelineDesc& desc, const ShaderCode& code) {
+		VkShaderModule vert_shader_module = CreateShaderModule(code.vert);
+		VkShaderModule frag_shader_module = CreateShaderModule(code.frag);
 
 		VkPipelineShaderStageCreateInfo vert_create_info = {};
 		vert_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -639,44 +1892,42 @@ return VK_FALSE;
 		VkPipelineShaderStageCreateInfo shader_stages[] = { vert_create_info, frag_create_info };
 
 		// Vertex input
-		
-		auto binding_description = GetBindingDescription();
-		auto attribute_description = GetAttributeDescription();
+
+		VkVertexInputBindingDescription binding_description = {};
+		binding_description.binding = 0;
+		binding_description.stride = desc.vertex_stride;
+		binding_description.inputRate = static_cast<VkVertexInputRate>(desc.vertex_input_rate);
+
+		std::array<VkVertexInputAttributeDescription, PipelineDesc::MAX_ATTRIBUTES> attribute_descriptions = {};
+		for (uint32_t i = 0; i < desc.attribute_count; ++i) {
+			attribute_descriptions[i].binding = 0;
+			attribute_descriptions[i].location = desc.attributes[i].location;
+			attribute_descriptions[i].format = static_cast<VkFormat>(desc.attributes[i].format);
+			attribute_descriptions[i].offset = desc.attributes[i].offset;
+		}
 
 		VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
 		vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertex_input_info.vertexBindingDescriptionCount = 1;
+		vertex_input_info.vertexBindingDescriptionCount = desc.attribute_count > 0 ? 1 : 0;
 		vertex_input_info.pVertexBindingDescriptions = &binding_description;
-		vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_description.size());
-		vertex_input_info.pVertexAttributeDescriptions = attribute_description.data();
+		vertex_input_info.vertexAttributeDescriptionCount = desc.attribute_count;
+		vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
 
 		// Input assembly
 
 		VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
 		input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		input_assembly.topology = static_cast<VkPrimitiveTopology>(desc.topology);
 		input_assembly.primitiveRestartEnable = VK_FALSE;
 
-		// Viewports and scissors
-
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swap_chain_extent.width;
-		viewport.height = (float)swap_chain_extent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset = { 0, 0 };
-		scissor.extent = swap_chain_extent;
+		// Viewports and scissors, set when drawing
 
 		VkPipelineViewportStateCreateInfo viewport_state = {};
 		viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewport_state.viewportCount = 1;
-		viewport_state.pViewports = &viewport;
+		viewport_state.pViewports = nullptr;
 		viewport_state.scissorCount = 1;
-		viewport_state.pScissors = &scissor;
+		viewport_state.pScissors = nullptr;
 
 		// Rasterizer
 
@@ -684,10 +1935,10 @@ return VK_FALSE;
 		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 		rasterizer.depthClampEnable = VK_FALSE;
 		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.polygonMode = static_cast<VkPolygonMode>(desc.polygon_mode);
 		rasterizer.lineWidth = 1.0f;
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		rasterizer.cullMode = desc.cull_mode;
+		rasterizer.frontFace = static_cast<VkFrontFace>(desc.front_face);
 		rasterizer.depthBiasEnable = VK_FALSE;
 		rasterizer.depthBiasConstantFactor = 0.0f;
 		rasterizer.depthBiasClamp = 0.0f;
@@ -698,19 +1949,30 @@ return VK_FALSE;
 		VkPipelineMultisampleStateCreateInfo multisampling = {};
 		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		multisampling.rasterizationSamples = static_cast<VkSampleCountFlagBits>(desc.samples);
 		multisampling.minSampleShading = 1.0f;
 		multisampling.pSampleMask = nullptr;
 		multisampling.alphaToCoverageEnable = VK_FALSE;
 		multisampling.alphaToOneEnable = VK_FALSE;
 
+		// Depth and stencil
+
+		VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+		depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depth_stencil.depthTestEnable = desc.depth_test;
+		depth_stencil.depthWriteEnable = desc.depth_write;
+		depth_stencil.depthCompareOp = static_cast<VkCompareOp>(desc.depth_compare_op);
+		depth_stencil.depthBoundsTestEnable = VK_FALSE;
+		depth_stencil.stencilTestEnable = VK_FALSE;
+
 		// Color blending
 
 		VkPipelineColorBlendAttachmentState color_blend_attachment = {};
 		color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		color_blend_attachment.blendEnable = VK_FALSE;
-		color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-		color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		color_blend_attachment.blendEnable = desc.blend_mode != PIPELINE_BLEND_NONE ? VK_TRUE : VK_FALSE;
+		color_blend_attachment.srcColorBlendFactor = desc.blend_mode == PIPELINE_BLEND_NONE ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_SRC_ALPHA;
+		color_blend_attachment.dstColorBlendFactor = desc.blend_mode == PIPELINE_BLEND_ALPHA ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA :
+			desc.blend_mode == PIPELINE_BLEND_ADDITIVE ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ZERO;
 		color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
 		color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
 		color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -739,18 +2001,17 @@ return VK_FALSE;
 		//dynamic_state.dynamicStateCount = 2;
 		//dynamic_state.pDynamicStates = dynamic_states;
 
-		// Pipeline layout
-
-		VkPipelineLayoutCreateInfo pipeline_layout_info = {};
-		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipeline_layout_info.setLayoutCount = 1;
-		pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
-		pipeline_layout_info.pushConstantRangeCount = 0;
-		pipeline_layout_info.pPushConstantRanges = nullptr;
+		// Dynamic viewport and scissor keep pipelines valid across resizes; the overlay also
+		// clips each of its draws to its own scissor.
+		VkDynamicState dynamic_states[] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
 
-		if (vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
-			assert(0);
-		}
+		VkPipelineDynamicStateCreateInfo dynamic_state = {};
+		dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamic_state.dynamicStateCount = 2;
+		dynamic_state.pDynamicStates = dynamic_states;
 
 		// Pipeline
 
@@ -763,126 +2024,826 @@ return VK_FALSE;
 		pipeline_info.pViewportState = &viewport_state;
 		pipeline_info.pRasterizationState = &rasterizer;
 		pipeline_info.pMultisampleState = &multisampling;
-		pipeline_info.pDepthStencilState = nullptr;
+		pipeline_info.pDepthStencilState = &depth_stencil;
 		pipeline_info.pColorBlendState = &color_blending;
-		pipeline_info.pDynamicState = nullptr;
+		pipeline_info.pDynamicState = &dynamic_state;
 		pipeline_info.layout = pipeline_layout;
 		pipeline_info.renderPass = render_pass;
-		pipeline_info.subpass = 0;
+		pipeline_info.subpass = desc.subpass;
 		pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 		pipeline_info.basePipelineIndex = -1;
 
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &graphics_pipeline) != VK_SUCCESS) {
-			assert(0);
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, allocator, &pipeline) != VK_SUCCESS) {
+			pipeline = VK_NULL_HANDLE;
 		}
 
-		vkDestroyShaderModule(device, vert_shader_module, nullptr);
-		vkDestroyShaderModule(device, frag_shader_module, nullptr);
+		vkDestroyShaderModule(device, vert_shader_module, allocator);
+		vkDestroyShaderModule(device, frag_shader_module, allocator);
+
+		return pipeline;
 	}
 
-	VkShaderModule CreateShaderModule(const std::vector<char>& code) {
-		VkShaderModuleCreateInfo create_info = {};
-		create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		create_info.codeSize = code.size();
-		create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	void CreateComputePipeline() {
+		VkPushConstantRange push_constant_range = {};
+		push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_constant_range.offset = 0;
+		push_constant_range.size = sizeof(ParticleSimulation);
 
-		VkShaderModule shader_module;
-		if (vkCreateShaderModule(device, &create_info, nullptr, &shader_module) != VK_SUCCESS) {
+		VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_layout_info.setLayoutCount = 1;
+		pipeline_layout_info.pSetLayouts = &compute_descriptor_set_layout;
+		pipeline_layout_info.pushConstantRangeCount = 1;
+		pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+		if (vkCreatePipelineLayout(device, &pipeline_layout_info, allocator, &compute_pipeline_layout) != VK_SUCCESS) {
 			assert(0);
 		}
 
-		return shader_module;
+		compute_pipeline = LoadComputePipeline("shaders/particle_comp.spv", compute_pipeline_layout);
 	}
 
-	void CreateFramebuffers() {
-		swap_chain_framebuffers.resize(swap_chain_image_views.size());
-		for (size_t i = 0; i < swap_chain_image_views.size(); ++i) {
-			VkImageView attachments[] = {
-				swap_chain_image_views[i]
-			};
+	VkPipeline LoadComputePipeline(const char* path, VkPipelineLayout layout) {
+		auto comp_shader_code = ReadFile(path);
 
-			VkFramebufferCreateInfo framebuffer_info = {};
-			framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebuffer_info.renderPass = render_pass;
-			framebuffer_info.attachmentCount = 1;
-			framebuffer_info.pAttachments = attachments;
-			framebuffer_info.width = swap_chain_extent.width;
-			framebuffer_info.height = swap_chain_extent.height;
-			framebuffer_info.layers = 1;
+		VkShaderModule comp_shader_module = CreateShaderModule(comp_shader_code);
 
-			if (vkCreateFramebuffer(device, &framebuffer_info, nullptr, &swap_chain_framebuffers[i]) != VK_SUCCESS) {
-				assert(0);
-			}
+		VkPipelineShaderStageCreateInfo comp_create_info = {};
+		comp_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		comp_create_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		comp_create_info.module = comp_shader_module;
+		comp_create_info.pName = "main";
+
+		VkComputePipelineCreateInfo pipeline_info = {};
+		pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeline_info.stage = comp_create_info;
+		pipeline_info.layout = layout;
+		pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+		pipeline_info.basePipelineIndex = -1;
+
+		VkPipeline pipeline;
+		if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, allocator, &pipeline) != VK_SUCCESS) {
+			assert(0);
 		}
-	}
 
-	void CreateCommandPool() {
-		QueueFamilyIndices queue_family_indices = FindQueueFamilies(physical_device);
+		vkDestroyShaderModule(device, comp_shader_module, allocator);
+		return pipeline;
+	}
 
-		VkCommandPoolCreateInfo pool_info = {};
-		pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		pool_info.queueFamilyIndex = queue_family_indices.graphics_family;
-		pool_info.flags = 0;
+	void CreateLightClusterPipeline() {
+		VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_layout_info.setLayoutCount = 1;
+		pipeline_layout_info.pSetLayouts = &light_descriptor_set_layout;
 
-		if (vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS) {
+		if (vkCreatePipelineLayout(device, &pipeline_layout_info, allocator, &light_cluster_pipeline_layout) != VK_SUCCESS) {
 			assert(0);
 		}
+
+		light_cluster_pipeline = LoadComputePipeline("shaders/light_cluster_comp.spv", light_cluster_pipeline_layout);
 	}
 
-	void CreateVertexBuffers() {
-		VkDeviceSize buffer_size = sizeof(vertices[0]) * vertices.size();
+	// Reduce: binding 0 the depth buffer or the level below, binding 1 the level written.
+	// Cull: the uniforms, visibility, draws and stats at bindings 0 to 3 and the pyramid at 4.
+	void CreateCullingPipelines() {
+		std::array<VkDescriptorSetLayoutBinding, 2> reduce_bindings = {};
+		reduce_bindings[0].binding = 0;
+		reduce_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		reduce_bindings[1].binding = 1;
+		reduce_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+		std::array<VkDescriptorSetLayoutBinding, 5> cull_bindings = {};
+		for (uint32_t binding = 0; binding < cull_bindings.size(); ++binding) {
+			cull_bindings[binding].binding = binding;
+			cull_bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}
+		cull_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		cull_bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 
-		VkBuffer staging_buffer;
-		VkDeviceMemory staging_buffer_memory;
-		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
+		for (auto& binding : reduce_bindings) {
+			binding.descriptorCount = 1;
+			binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		for (auto& binding : cull_bindings) {
+			binding.descriptorCount = 1;
+			binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
 
-		void* data;
-		vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
-		memcpy(data, vertices.data(), (size_t)buffer_size);
-		vkUnmapMemory(device, staging_buffer_memory);
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = static_cast<uint32_t>(reduce_bindings.size());
+		layout_info.pBindings = reduce_bindings.data();
+		if (vkCreateDescriptorSetLayout(device, &layout_info, allocator, &reduce_descriptor_set_layout) != VK_SUCCESS) {
+			assert(0);
+		}
+		layout_info.bindingCount = static_cast<uint32_t>(cull_bindings.size());
+		layout_info.pBindings = cull_bindings.data();
+		if (vkCreateDescriptorSetLayout(device, &layout_info, allocator, &cull_descriptor_set_layout) != VK_SUCCESS) {
+			assert(0);
+		}
 
-		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer, vertex_buffer_memory);
+		VkPushConstantRange push_constant_range = {};
+		push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_constant_range.offset = 0;
+		push_constant_range.size = sizeof(DepthReduce);
 
-		CopyBuffer(staging_buffer, vertex_buffer, buffer_size);
+		VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_layout_info.setLayoutCount = 1;
+		pipeline_layout_info.pSetLayouts = &reduce_descriptor_set_layout;
+		pipeline_layout_info.pushConstantRangeCount = 1;
+		pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+		if (vkCreatePipelineLayout(device, &pipeline_layout_info, allocator, &reduce_pipeline_layout) != VK_SUCCESS) {
+			assert(0);
+		}
 
-		vkDestroyBuffer(device, staging_buffer, nullptr);
+		// The phase.
+		push_constant_range.size = sizeof(uint32_t);
+		pipeline_layout_info.pSetLayouts = &cull_descriptor_set_layout;
+		if (vkCreatePipelineLayout(device, &pipeline_layout_info, allocator, &cull_pipeline_layout) != VK_SUCCESS) {
+			assert(0);
+		}
 
-		vkFreeMemory(device, staging_buffer_memory, nullptr);
+		reduce_pipeline = LoadComputePipeline("shaders/hiz_reduce_comp.spv", reduce_pipeline_layout);
+		if (msaa_samples != VK_SAMPLE_COUNT_1_BIT) {
+			reduce_ms_pipeline = LoadComputePipeline("shaders/hiz_reduce_ms_comp.spv", reduce_pipeline_layout);
+		}
+		cull_pipeline = LoadComputePipeline("shaders/hiz_cull_comp.spv", cull_pipeline_layout);
+
+		// Both shaders only ever texelFetch.
+		VkSamplerCreateInfo sampler_info = {};
+		sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		sampler_info.magFilter = VK_FILTER_NEAREST;
+		sampler_info.minFilter = VK_FILTER_NEAREST;
+		sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.maxAnisotropy = 1.0f;
+		sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+		sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+		sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		if (vkCreateSampler(device, &sampler_info, allocator, &depth_pyramid_sampler) != VK_SUCCESS) {
+			assert(0);
+		}
 	}
 
-	void CreateIndexBuffers() {
-		VkDeviceSize buffer_size = sizeof(indices[0]) * indices.size();
-
-		VkBuffer staging_buffer;
-		VkDeviceMemory staging_buffer_memory;
-		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
-
-		void* data;
-		vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
-		memcpy(data, indices.data(), (size_t)buffer_size);
-		vkUnmapMemory(device, staging_buffer_memory);
+	// The uniforms at binding 0, the meshlets, the object level draws, the meshlet draws, the
+	// visible meshlets and the stats at bindings 1 to 5.
+	void CreateMeshletCullingPipeline() {
+		std::array<VkDescriptorSetLayoutBinding, 6> cull_bindings = {};
+		for (uint32_t binding = 0; binding < cull_bindings.size(); ++binding) {
+			cull_bindings[binding].binding = binding;
+			cull_bindings[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			cull_bindings[binding].descriptorCount = 1;
+			cull_bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
 
-		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, index_buffer, index_buffer_memory);
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = static_cast<uint32_t>(cull_bindings.size());
+		layout_info.pBindings = cull_bindings.data();
+		if (vkCreateDescriptorSetLayout(device, &layout_info, allocator, &meshlet_cull_descriptor_set_layout) != VK_SUCCESS) {
+			assert(0);
+		}
 
-		CopyBuffer(staging_buffer, index_buffer, buffer_size);
+		// The phase.
+		VkPushConstantRange push_constant_range = {};
+		push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_constant_range.offset = 0;
+		push_constant_range.size = sizeof(uint32_t);
 
-		vkDestroyBuffer(device, staging_buffer, nullptr);
+		VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_layout_info.setLayoutCount = 1;
+		pipeline_layout_info.pSetLayouts = &meshlet_cull_descriptor_set_layout;
+		pipeline_layout_info.pushConstantRangeCount = 1;
+		pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+		if (vkCreatePipelineLayout(device, &pipeline_layout_info, allocator, &meshlet_cull_pipeline_layout) != VK_SUCCESS) {
+			assert(0);
+		}
 
-		vkFreeMemory(device, staging_buffer_memory, nullptr);
+		meshlet_cull_pipeline = LoadComputePipeline("shaders/meshlet_cull_comp.spv", meshlet_cull_pipeline_layout);
 	}
 
-	void CreateUniformBuffers() {
-		VkDeviceSize buffer_size = sizeof(UniformBufferObject);
+	// The scene color at binding 0, read with bilinear filtering, and the Upscale push
+	// constants. A fixed pipeline of its own: it draws into the upscale pass, which none of the
+	// cached pipelines are compatible with.
+	void CreateUpscalePipeline() {
+		VkDescriptorSetLayoutBinding sampler_binding = {};
+		sampler_binding.binding = 0;
+		sampler_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		sampler_binding.descriptorCount = 1;
+		sampler_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = 1;
+		layout_info.pBindings = &sampler_binding;
+		if (vkCreateDescriptorSetLayout(device, &layout_info, allocator, &upscale_descriptor_set_layout) != VK_SUCCESS) {
+			assert(0);
+		}
 
-		uniform_buffers.resize(swap_chain_images.size());
-		uniform_buffers_memory.resize(swap_chain_images.size());
+		VkPushConstantRange push_constant_range = {};
+		push_constant_range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		push_constant_range.offset = 0;
+		push_constant_range.size = sizeof(Upscale);
 
-		for (size_t i = 0; i < swap_chain_images.size(); ++i) {
-			CreateBuffer(buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniform_buffers[i], uniform_buffers_memory[i]);
+		VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_layout_info.setLayoutCount = 1;
+		pipeline_layout_info.pSetLayouts = &upscale_descriptor_set_layout;
+		pipeline_layout_info.pushConstantRangeCount = 1;
+		pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+		if (vkCreatePipelineLayout(device, &pipeline_layout_info, allocator, &upscale_pipeline_layout) != VK_SUCCESS) {
+			assert(0);
 		}
-	}
 
-	void CopyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size) {
+		VkShaderModule vert_shader_module = CreateShaderModule(ReadFile("shaders/upscale_vert.spv"));
+		VkShaderModule frag_shader_module = CreateShaderModule(ReadFile("shaders/upscale_frag.spv"));
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = {};
+		shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shader_stages[0].module = vert_shader_module;
+		shader_stages[0].pName = "main";
+		shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shader_stages[1].module = frag_shader_module;
+		shader_stages[1].pName = "main";
+
+		// The triangle comes from gl_VertexIndex alone.
+		VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+		vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+		input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkPipelineViewportStateCreateInfo viewport_state = {};
+		viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewport_state.viewportCount = 1;
+		viewport_state.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer = {};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth = 1.0f;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+		VkPipelineMultisampleStateCreateInfo multisampling = {};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		multisampling.minSampleShading = 1.0f;
+
+		VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+		color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		color_blend_attachment.blendEnable = VK_FALSE;
+
+		VkPipelineColorBlendStateCreateInfo color_blending = {};
+		color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		color_blending.attachmentCount = 1;
+		color_blending.pAttachments = &color_blend_attachment;
+
+		VkDynamicState dynamic_states[] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
+
+		VkPipelineDynamicStateCreateInfo dynamic_state = {};
+		dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamic_state.dynamicStateCount = 2;
+		dynamic_state.pDynamicStates = dynamic_states;
+
+		VkGraphicsPipelineCreateInfo pipeline_info = {};
+		pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipeline_info.stageCount = static_cast<uint32_t>(shader_stages.size());
+		pipeline_info.pStages = shader_stages.data();
+		pipeline_info.pVertexInputState = &vertex_input_info;
+		pipeline_info.pInputAssemblyState = &input_assembly;
+		pipeline_info.pViewportState = &viewport_state;
+		pipeline_info.pRasterizationState = &rasterizer;
+		pipeline_info.pMultisampleState = &multisampling;
+		pipeline_info.pColorBlendState = &color_blending;
+		pipeline_info.pDynamicState = &dynamic_state;
+		pipeline_info.layout = upscale_pipeline_layout;
+		pipeline_info.renderPass = upscale_render_pass;
+		pipeline_info.subpass = 0;
+		pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+		pipeline_info.basePipelineIndex = -1;
+
+		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, allocator, &upscale_pipeline) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		vkDestroyShaderModule(device, vert_shader_module, allocator);
+		vkDestroyShaderModule(device, frag_shader_module, allocator);
+
+		VkSamplerCreateInfo sampler_info = {};
+		sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		sampler_info.magFilter = VK_FILTER_LINEAR;
+		sampler_info.minFilter = VK_FILTER_LINEAR;
+		sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.maxAnisotropy = 1.0f;
+		sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+		sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+		if (vkCreateSampler(device, &sampler_info, allocator, &upscale_sampler) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	VkShaderModule CreateShaderModule(const std::vector<char>& code) {
+		VkShaderModuleCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		create_info.codeSize = code.size();
+		create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shader_module;
+		if (vkCreateShaderModule(device, &create_info, allocator, &shader_module) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		return shader_module;
+	}
+
+	// Dynamic resolution renders into a full sized scene color that the upscale pass samples.
+	void CreateColorResources(PresentWindow& window) {
+		if (DYNAMIC_RESOLUTION) {
+			CreateTransientAttachment(window.image_format, window.extent, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT, false, window.scene_color);
+		}
+		if (msaa_samples == VK_SAMPLE_COUNT_1_BIT) {
+			return;
+		}
+		CreateTransientAttachment(window.image_format, window.extent, msaa_samples, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, !OCCLUSION_CULLING, window.color_target);
+	}
+
+	// Occlusion culling samples depth to build the pyramid.
+	void CreateDepthResources(PresentWindow& window) {
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		if (OCCLUSION_CULLING) {
+			usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
+		CreateTransientAttachment(depth_format, window.extent, msaa_samples, usage, VK_IMAGE_ASPECT_DEPTH_BIT, !OCCLUSION_CULLING, window.depth_target);
+	}
+
+	// A transient attachment never leaves the render pass; otherwise its contents are kept
+	// across passes and it needs real memory.
+	void CreateTransientAttachment(VkFormat format, VkExtent2D extent, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageAspectFlags aspect_flags, bool transient, TransientAttachment& attachment) {
+		VkImageCreateInfo image_info = {};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.extent.width = extent.width;
+		image_info.extent.height = extent.height;
+		image_info.extent.depth = 1;
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.format = format;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image_info.usage = transient ? usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : usage;
+		image_info.samples = samples;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device, &image_info, allocator, &attachment.image) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		VkMemoryRequirements mem_requirements;
+		vkGetImageMemoryRequirements(device, attachment.image, &mem_requirements);
+
+		// Prefer lazily allocated memory so tilers never back the attachment with real pages;
+		// fall back to plain device local memory on drivers that don't expose it.
+		uint32_t memory_type;
+		attachment.lazily_allocated = transient && FindMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, memory_type);
+		if (!attachment.lazily_allocated) {
+			memory_type = FindMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		attachment.size = mem_requirements.size;
+
+		attachment.memory = AllocateMemory(mem_requirements, memory_type, MEMORY_CATEGORY_ATTACHMENT, mem_requirements.size);
+
+		vkBindImageMemory(device, attachment.image, attachment.memory, 0);
+
+		VkImageViewCreateInfo view_info = {};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = attachment.image;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = format;
+		view_info.subresourceRange.aspectMask = aspect_flags;
+		view_info.subresourceRange.baseMipLevel = 0;
+		view_info.subresourceRange.levelCount = 1;
+		view_info.subresourceRange.baseArrayLayer = 0;
+		view_info.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device, &view_info, allocator, &attachment.view) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	void DestroyTransientAttachment(TransientAttachment& attachment) {
+		if (attachment.image == VK_NULL_HANDLE) {
+			return;
+		}
+		vkDestroyImageView(device, attachment.view, allocator);
+		vkDestroyImage(device, attachment.image, allocator);
+		FreeMemory(attachment.memory);
+		attachment = {};
+	}
+
+	void ReportAttachmentMemory(const PresentWindow& window) {
+		const TransientAttachment* attachments[] = { &window.color_target, &window.depth_target, &window.scene_color };
+		const char* names[] = { "msaa color", "depth", "scene color" };
+
+		std::cout << "transient attachments (" << window.extent.width << "x" << window.extent.height << ", " << msaa_samples << "x):" << std::endl;
+		for (size_t i = 0; i < 3; ++i) {
+			const TransientAttachment& attachment = *attachments[i];
+			if (attachment.image == VK_NULL_HANDLE) {
+				continue;
+			}
+			std::cout << "\t" << names[i] << ": " << attachment.size << " bytes reserved";
+			if (attachment.lazily_allocated) {
+				VkDeviceSize committed = 0;
+				vkGetDeviceMemoryCommitment(device, attachment.memory, &committed);
+				std::cout << ", " << committed << " bytes committed (lazily allocated)";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	void CreateFramebuffers(PresentWindow& window) {
+		window.framebuffers.resize(DYNAMIC_RESOLUTION ? 1 : window.image_views.size());
+		for (size_t i = 0; i < window.framebuffers.size(); ++i) {
+			VkImageView output = DYNAMIC_RESOLUTION ? window.scene_color.view : window.image_views[i];
+			std::vector<VkImageView> attachments;
+			if (msaa_samples != VK_SAMPLE_COUNT_1_BIT) {
+				attachments = { window.color_target.view, window.depth_target.view, output };
+			}
+			else {
+				attachments = { output, window.depth_target.view };
+			}
+
+			VkFramebufferCreateInfo framebuffer_info = {};
+			framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebuffer_info.renderPass = render_pass;
+			framebuffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebuffer_info.pAttachments = attachments.data();
+			framebuffer_info.width = window.extent.width;
+			framebuffer_info.height = window.extent.height;
+			framebuffer_info.layers = 1;
+
+			if (vkCreateFramebuffer(device, &framebuffer_info, allocator, &window.framebuffers[i]) != VK_SUCCESS) {
+				assert(0);
+			}
+		}
+
+		if (!DYNAMIC_RESOLUTION) {
+			return;
+		}
+		window.upscale_framebuffers.resize(window.image_views.size());
+		for (size_t i = 0; i < window.image_views.size(); ++i) {
+			VkFramebufferCreateInfo framebuffer_info = {};
+			framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebuffer_info.renderPass = upscale_render_pass;
+			framebuffer_info.attachmentCount = 1;
+			framebuffer_info.pAttachments = &window.image_views[i];
+			framebuffer_info.width = window.extent.width;
+			framebuffer_info.height = window.extent.height;
+			framebuffer_info.layers = 1;
+
+			if (vkCreateFramebuffer(device, &framebuffer_info, allocator, &window.upscale_framebuffers[i]) != VK_SUCCESS) {
+				assert(0);
+			}
+		}
+	}
+
+	void CreateCommandPool() {
+		QueueFamilyIndices queue_family_indices = FindQueueFamilies(physical_device);
+
+		VkCommandPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		pool_info.queueFamilyIndex = queue_family_indices.graphics_family;
+		// Frame command buffers are re-recorded every frame.
+		pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(device, &pool_info, allocator, &command_pool) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		pool_info.queueFamilyIndex = queue_family_indices.compute_family;
+
+		if (vkCreateCommandPool(device, &pool_info, allocator, &compute_command_pool) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	void CreateVertexBuffers() {
+		VkDeviceSize buffer_size = sizeof(scene_vertices[0]) * scene_vertices.size();
+
+		VkBuffer staging_buffer;
+		VkDeviceMemory staging_buffer_memory;
+		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory, MEMORY_CATEGORY_STAGING);
+
+		void* data;
+		vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
+		PackVertices(scene_vertices, data);
+		vkUnmapMemory(device, staging_buffer_memory);
+
+		// The meshlet program reads the same vertices as a storage buffer.
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (MESHLET_GEOMETRY ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0);
+		CreateBuffer(buffer_size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer, vertex_buffer_memory, MEMORY_CATEGORY_VERTEX);
+
+		CopyBuffer(staging_buffer, vertex_buffer, buffer_size);
+		MarkDirty(DIRTY_UPLOAD);
+
+		vkDestroyBuffer(device, staging_buffer, allocator);
+
+		FreeMemory(staging_buffer_memory);
+	}
+
+	// Tessellates the quad and simplifies it into its LOD chain. All levels share the vertices
+	// and follow each other in the index buffer, and so do their meshlets.
+	void BuildSceneMesh() {
+		TessellateQuad(SCENE_GRID_SUBDIVISIONS, scene_vertices, scene_indices);
+
+		std::vector<glm::vec3> positions;
+		positions.reserve(scene_vertices.size());
+		for (const auto& vertex : scene_vertices) {
+			positions.push_back(glm::vec3(vertex.pos, 0.0f));
+		}
+		scene_lods = BuildMeshLods(positions, scene_indices, MESH_LOD_COUNT, MESH_LOD_REDUCTION);
+		ComputeBoundingSphere(positions, scene_bounds_center, scene_bounds_radius);
+
+		std::cout << "scene: LOD triangles";
+		for (const auto& lod : scene_lods) {
+			std::cout << " " << lod.index_count / 3;
+		}
+		std::cout << std::endl;
+
+		if (MESHLET_GEOMETRY) {
+			std::cout << "scene: LOD meshlets";
+			for (const auto& lod : scene_lods) {
+				MeshletRange range = BuildMeshlets(positions, scene_indices, lod.first_index, lod.index_count, scene_meshlets);
+				scene_meshlet_ranges.push_back(range);
+				scene_meshlet_capacity = std::max(scene_meshlet_capacity, range.meshlet_count);
+				std::cout << " " << range.meshlet_count;
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	void CreateIndexBuffers() {
+		VkDeviceSize buffer_size = sizeof(scene_indices[0]) * scene_indices.size();
+
+		VkBuffer staging_buffer;
+		VkDeviceMemory staging_buffer_memory;
+		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory, MEMORY_CATEGORY_STAGING);
+
+		void* data;
+		vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
+		PackIndices(scene_indices, data);
+		vkUnmapMemory(device, staging_buffer_memory);
+
+		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, index_buffer, index_buffer_memory, MEMORY_CATEGORY_INDEX);
+
+		CopyBuffer(staging_buffer, index_buffer, buffer_size);
+		MarkDirty(DIRTY_UPLOAD);
+
+		vkDestroyBuffer(device, staging_buffer, allocator);
+
+		FreeMemory(staging_buffer_memory);
+	}
+
+	// Static quad index pattern shared by every overlay chunk. The chunks themselves are
+	// created on demand by AcquireChunk.
+	void CreateOverlayBuffers() {
+		std::vector<uint16_t> overlay_indices(OVERLAY_CHUNK_QUADS * 6);
+		WriteQuadIndices(OVERLAY_CHUNK_QUADS, overlay_indices.data());
+		VkDeviceSize buffer_size = sizeof(overlay_indices[0]) * overlay_indices.size();
+
+		VkBuffer staging_buffer;
+		VkDeviceMemory staging_buffer_memory;
+		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory, MEMORY_CATEGORY_STAGING);
+
+		void* data;
+		vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
+		memcpy(data, overlay_indices.data(), buffer_size);
+		vkUnmapMemory(device, staging_buffer_memory);
+
+		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, overlay_index_buffer, overlay_index_buffer_memory, MEMORY_CATEGORY_INDEX);
+
+		CopyBuffer(staging_buffer, overlay_index_buffer, buffer_size);
+
+		vkDestroyBuffer(device, staging_buffer, allocator);
+		FreeMemory(staging_buffer_memory);
+
+		overlay_chunks.resize(MAX_FRAMES_IN_FLIGHT);
+	}
+
+	// Chunks belong to the frame in flight that wrote them and are reused once its timeline
+	// value was reached, so writing never waits on the GPU. Host coherent memory needs no flushes.
+	BatchVertex* AcquireChunk(uint32_t& quad_capacity) override {
+		std::vector<OverlayChunk>& chunks = overlay_chunks[current_frame];
+		if (overlay_chunks_used == chunks.size()) {
+			VkDeviceSize size = sizeof(BatchVertex) * 4 * OVERLAY_CHUNK_QUADS;
+
+			OverlayChunk chunk;
+			CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, chunk.buffer, chunk.memory, MEMORY_CATEGORY_VERTEX);
+			void* mapped;
+			vkMapMemory(device, chunk.memory, 0, size, 0, &mapped);
+			chunk.mapped = static_cast<BatchVertex*>(mapped);
+			chunks.push_back(chunk);
+		}
+
+		quad_capacity = OVERLAY_CHUNK_QUADS;
+		return chunks[overlay_chunks_used++].mapped;
+	}
+
+	void SubmitDraws(const std::vector<QuadBatchDraw>& draws) override {
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(overlay_command_buffer, 0, 1, &overlay_chunks[current_frame][overlay_chunks_used - 1].buffer, &offset);
+		for (const auto& draw : draws) {
+			vkCmdSetScissor(overlay_command_buffer, 0, 1, &draw.scissor);
+			vkCmdDrawIndexed(overlay_command_buffer, draw.quad_count * 6, 1, draw.first_quad * 6, 0, 0);
+		}
+	}
+
+	void CreateUniformBuffers() {
+		for (auto& window : windows) {
+			CreateUniformBlock(window.projection_uniforms, sizeof(ProjectionUniforms));
+		}
+		CreateUniformBlock(camera_uniforms, sizeof(CameraUniforms));
+		CreateUniformBlock(object_uniforms, sizeof(ObjectUniforms));
+	}
+
+	// The lights never change and are uploaded once. The cluster grid is rebuilt on the GPU
+	// every frame, so it needs no initial contents.
+	void CreateLightBuffers() {
+		std::vector<PointLight> lights = GenerateStressLights(LIGHT_COUNT, glm::vec3(-0.6f, -0.6f, 0.02f), glm::vec3(0.6f, 0.6f, 0.3f), LIGHT_MIN_RADIUS, LIGHT_MAX_RADIUS, LIGHT_INTENSITY, 1);
+		// A storage buffer cannot be empty.
+		VkDeviceSize buffer_size = sizeof(PointLight) * std::max<size_t>(lights.size(), 1);
+
+		VkBuffer staging_buffer;
+		VkDeviceMemory staging_buffer_memory;
+		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory, MEMORY_CATEGORY_STAGING);
+
+		void* data;
+		vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
+		memcpy(data, lights.data(), sizeof(PointLight) * lights.size());
+		vkUnmapMemory(device, staging_buffer_memory);
+
+		CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, light_buffer, light_buffer_memory, MEMORY_CATEGORY_STORAGE);
+
+		CopyBuffer(staging_buffer, light_buffer, buffer_size);
+
+		vkDestroyBuffer(device, staging_buffer, allocator);
+		FreeMemory(staging_buffer_memory);
+
+		for (auto& window : windows) {
+			CreateUniformBlock(window.cluster_uniforms, sizeof(ClusterUniforms));
+			CreateBuffer(sizeof(uint32_t) * CLUSTER_COUNT * CLUSTER_STRIDE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, window.cluster_light_buffer, window.cluster_light_memory, MEMORY_CATEGORY_STORAGE);
+		}
+	}
+
+	// Visibility and draws only ever live on the GPU; the stats are read back by the host.
+	void CreateCullingBuffers() {
+		for (auto& window : windows) {
+			CreateUniformBlock(window.cull_uniforms, sizeof(CullUniforms));
+			CreateBuffer(sizeof(uint32_t) * CULL_MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, window.visibility_buffer, window.visibility_memory, MEMORY_CATEGORY_STORAGE);
+			CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * CULL_MAX_OBJECTS * 2, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, window.draw_buffer, window.draw_memory, MEMORY_CATEGORY_STORAGE);
+			for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+				CreateBuffer(sizeof(CullStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, window.cull_stats_buffers[i], window.cull_stats_memories[i], MEMORY_CATEGORY_STORAGE);
+				void* mapped;
+				vkMapMemory(device, window.cull_stats_memories[i], 0, sizeof(CullStats), 0, &mapped);
+				window.cull_stats_mapped[i] = static_cast<const CullStats*>(mapped);
+			}
+		}
+	}
+
+	// Device local storage buffer holding size bytes of data, uploaded through staging memory.
+	void CreateStorageBuffer(const void* data, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory) {
+		VkBuffer staging_buffer;
+		VkDeviceMemory staging_buffer_memory;
+		CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory, MEMORY_CATEGORY_STAGING);
+
+		void* mapped;
+		vkMapMemory(device, staging_buffer_memory, 0, size, 0, &mapped);
+		memcpy(mapped, data, static_cast<size_t>(size));
+		vkUnmapMemory(device, staging_buffer_memory);
+
+		CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory, MEMORY_CATEGORY_STORAGE);
+		CopyBuffer(staging_buffer, buffer, size);
+		MarkDirty(DIRTY_UPLOAD);
+
+		vkDestroyBuffer(device, staging_buffer, allocator);
+		FreeMemory(staging_buffer_memory);
+	}
+
+	// The meshlets of every level are uploaded once. Each window culls into draws and visible
+	// lists of its own, for both phases; the stats are read back by the host.
+	void CreateMeshletBuffers() {
+		CreateStorageBuffer(scene_meshlets.meshlets.data(), sizeof(Meshlet) * scene_meshlets.meshlets.size(), meshlet_buffer, meshlet_buffer_memory);
+		CreateStorageBuffer(scene_meshlets.vertices.data(), sizeof(uint32_t) * scene_meshlets.vertices.size(), meshlet_vertex_buffer, meshlet_vertex_buffer_memory);
+		CreateStorageBuffer(scene_meshlets.triangles.data(), sizeof(uint32_t) * scene_meshlets.triangles.size(), meshlet_triangle_buffer, meshlet_triangle_buffer_memory);
+
+		for (auto& window : windows) {
+			CreateUniformBlock(window.meshlet_cull_uniforms, sizeof(MeshletCullUniforms));
+			CreateBuffer(sizeof(VkDrawIndirectCommand) * 2, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, window.meshlet_draw_buffer, window.meshlet_draw_memory, MEMORY_CATEGORY_STORAGE);
+			CreateBuffer(sizeof(uint32_t) * scene_meshlet_capacity * 2, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, window.visible_meshlet_buffer, window.visible_meshlet_memory, MEMORY_CATEGORY_STORAGE);
+			for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+				CreateBuffer(sizeof(MeshletStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, window.meshlet_stats_buffers[i], window.meshlet_stats_memories[i], MEMORY_CATEGORY_STORAGE);
+				void* mapped;
+				vkMapMemory(device, window.meshlet_stats_memories[i], 0, sizeof(MeshletStats), 0, &mapped);
+				window.meshlet_stats_mapped[i] = static_cast<const MeshletStats*>(mapped);
+			}
+		}
+	}
+
+	void DestroyMeshletBuffers(PresentWindow& window) {
+		DestroyUniformBlock(window.meshlet_cull_uniforms);
+		vkDestroyBuffer(device, window.meshlet_draw_buffer, allocator);
+		FreeMemory(window.meshlet_draw_memory);
+		vkDestroyBuffer(device, window.visible_meshlet_buffer, allocator);
+		FreeMemory(window.visible_meshlet_memory);
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			vkUnmapMemory(device, window.meshlet_stats_memories[i]);
+			vkDestroyBuffer(device, window.meshlet_stats_buffers[i], allocator);
+			FreeMemory(window.meshlet_stats_memories[i]);
+		}
+	}
+
+	void DestroyCullingBuffers(PresentWindow& window) {
+		DestroyUniformBlock(window.cull_uniforms);
+		vkDestroyBuffer(device, window.visibility_buffer, allocator);
+		FreeMemory(window.visibility_memory);
+		vkDestroyBuffer(device, window.draw_buffer, allocator);
+		FreeMemory(window.draw_memory);
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			vkUnmapMemory(device, window.cull_stats_memories[i]);
+			vkDestroyBuffer(device, window.cull_stats_buffers[i], allocator);
+			FreeMemory(window.cull_stats_memories[i]);
+		}
+	}
+
+	void CreateUniformBlock(UniformBlock& block, VkDeviceSize size) {
+		block.size = size;
+		block.data.assign(static_cast<size_t>(size), 0);
+		// Nothing has been uploaded yet, so every frame starts out behind.
+		block.version = 1;
+		block.uploaded_versions.assign(MAX_FRAMES_IN_FLIGHT, 0);
+		block.buffers.resize(MAX_FRAMES_IN_FLIGHT);
+		block.memories.resize(MAX_FRAMES_IN_FLIGHT);
+		block.mapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			CreateBuffer(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, block.buffers[i], block.memories[i], MEMORY_CATEGORY_UNIFORM);
+			vkMapMemory(device, block.memories[i], 0, size, 0, &block.mapped[i]);
+		}
+	}
+
+	template <typename T>
+	void SetUniformBlock(UniformBlock& block, const T& value) {
+		assert(sizeof(T) == block.size);
+
+		if (memcmp(block.data.data(), &value, sizeof(T)) == 0) {
+			return;
+		}
+		memcpy(block.data.data(), &value, sizeof(T));
+		++block.version;
+	}
+
+	void UploadUniformBlock(UniformBlock& block, size_t frame) {
+		if (block.uploaded_versions[frame] == block.version) {
+			return;
+		}
+		memcpy(block.mapped[frame], block.data.data(), static_cast<size_t>(block.size));
+		block.uploaded_versions[frame] = block.version;
+	}
+
+	void DestroyUniformBlock(UniformBlock& block) {
+		for (size_t i = 0; i < block.buffers.size(); ++i) {
+			vkUnmapMemory(device, block.memories[i]);
+			vkDestroyBuffer(device, block.buffers[i], allocator);
+			FreeMemory(block.memories[i]);
+		}
+	}
+
+	// The state buffer is only ever touched by the compute queue. The two vertex buffers
+	// ping-pong: compute writes one while graphics draws the other, and ownership moves
+	// between the queue families with every frame.
+	void CreateParticleBuffers() {
+		CreateBuffer(sizeof(Particle) * PARTICLE_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particle_state_buffer, particle_state_buffer_memory, MEMORY_CATEGORY_STORAGE);
+
+		for (size_t i = 0; i < particle_vertex_buffers.size(); ++i) {
+			CreateBuffer(sizeof(ParticleVertex) * PARTICLE_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particle_vertex_buffers[i], particle_vertex_buffers_memory[i], MEMORY_CATEGORY_VERTEX);
+		}
+	}
+
+	VkCommandBuffer BeginSingleTimeCommands() {
 		VkCommandBufferAllocateInfo alloc_info = {};
 		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -897,390 +2858,2957 @@ return VK_FALSE;
 		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 		vkBeginCommandBuffer(command_buffer, &begin_info);
 
+		return command_buffer;
+	}
+
+	// Waits for just this submit on the graphics timeline, not for the whole queue. Only used
+	// outside of frames, whose submits take the values in between.
+	void EndSingleTimeCommands(VkCommandBuffer command_buffer) {
+		vkEndCommandBuffer(command_buffer);
+
+		uint64_t signal_value = ++graphics_timeline_value;
+		VkTimelineSemaphoreSubmitInfoKHR timeline_info = {};
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timeline_info.signalSemaphoreValueCount = 1;
+		timeline_info.pSignalSemaphoreValues = &signal_value;
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = &timeline_info;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &command_buffer;
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &graphics_timeline;
+
+		vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+		WaitForTimeline(graphics_timeline, signal_value);
+
+		vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+	}
+
+	void CopyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size) {
+		VkCommandBuffer command_buffer = BeginSingleTimeCommands();
+
 		VkBufferCopy copy_region = {};
 		copy_region.srcOffset = 0;
 		copy_region.dstOffset = 0;
 		copy_region.size = size;
 		vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
 
-		vkEndCommandBuffer(command_buffer);
+		EndSingleTimeCommands(command_buffer);
+	}
+
+	void InitMemoryTelemetry() {
+		VkPhysicalDeviceMemoryProperties mem_properties;
+		vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+		memory_telemetry.SetMemoryProperties(mem_properties);
+
+		if (memory_budget) {
+			get_memory_properties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+			memory_budget = get_memory_properties2 != nullptr;
+		}
+		std::cout << "memory budget: " << (memory_budget ? "VK_EXT_memory_budget" : "heap sizes") << std::endl;
+		UpdateMemoryBudget();
+
+		// Streamed texture mips are the only cache that can be dropped without visible
+		// breakage: the budget shrinks and the finest mips go at the start of the next frame.
+		memory_telemetry.AddLowMemoryCallback([this](uint32_t heap, VkDeviceSize bytes) {
+			if (!memory_telemetry.GetHeapStats(heap).device_local) {
+				return;
+			}
+			uint64_t resident = texture_residency.GetResidentBytes();
+			texture_residency.SetBudget(resident > bytes ? resident - bytes : 0);
+			std::cout << "low device memory on heap " << heap << ": texture budget lowered to " << texture_residency.GetBudget() << " bytes" << std::endl;
+			MarkDirty(DIRTY_UPLOAD);
+		});
+	}
+
+	// Re-reads the live budget and usage of every heap, when the driver reports them, and
+	// notifies subsystems of heaps that ran low.
+	void UpdateMemoryBudget() {
+		if (memory_budget) {
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {};
+			budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+			VkPhysicalDeviceMemoryProperties2KHR properties = {};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+			properties.pNext = &budget_properties;
+			get_memory_properties2(physical_device, &properties);
+
+			for (uint32_t heap = 0; heap < memory_telemetry.GetHeapCount(); ++heap) {
+				memory_telemetry.SetBudget(heap, budget_properties.heapBudget[heap], budget_properties.heapUsage[heap]);
+			}
+		}
+		memory_telemetry.CheckBudget();
+	}
+
+	// Every device allocation goes through here to be tagged for telemetry. Heaps close to
+	// their budget first ask subsystems to shed memory; a failed allocation does the same and
+	// is retried once before giving up.
+	VkDeviceMemory AllocateMemory(const VkMemoryRequirements& requirements, uint32_t memory_type, MemoryCategory category, VkDeviceSize used_size) {
+		VkMemoryAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		alloc_info.allocationSize = requirements.size;
+		alloc_info.memoryTypeIndex = memory_type;
+
+		memory_telemetry.RequestMemory(memory_type, requirements.size);
+
+		VkDeviceMemory memory;
+		VkResult result = vkAllocateMemory(device, &alloc_info, allocator, &memory);
+		if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+			memory_telemetry.ReleaseMemory(memory_type, requirements.size);
+			ReleaseCompletedFrames();
+			result = vkAllocateMemory(device, &alloc_info, allocator, &memory);
+		}
+		if (result != VK_SUCCESS) {
+			memory_telemetry.Dump(std::cerr);
+			assert(0);
+		}
+
+		memory_telemetry.RecordAllocation(memory, memory_type, category, requirements.size, used_size);
+		return memory;
+	}
+
+	void FreeMemory(VkDeviceMemory memory) {
+		memory_telemetry.RecordFree(memory);
+		vkFreeMemory(device, memory, allocator);
+	}
+
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& buffer_memory, MemoryCategory category) {
+		VkBufferCreateInfo buffer_info = {};
+		buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_info.size = size;
+		buffer_info.usage = usage;
+		buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device, &buffer_info, allocator, &buffer) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		VkMemoryRequirements mem_requirements;
+		vkGetBufferMemoryRequirements(device, buffer, &mem_requirements);
+
+		buffer_memory = AllocateMemory(mem_requirements, FindMemoryType(mem_requirements.memoryTypeBits, properties), category, size);
+
+		vkBindBufferMemory(device, buffer, buffer_memory, 0);
+	}
+
+	// Every window has a light set per frame in flight. Occlusion culling adds a cull set per
+	// window and frame in flight and a reduce set per window and pyramid level, meshlets a
+	// meshlet cull set per window and frame in flight and a geometry set per window.
+	void CreateDescriptorPool() {
+		uint32_t light_sets = static_cast<uint32_t>(windows.size() * MAX_FRAMES_IN_FLIGHT);
+		uint32_t cull_sets = OCCLUSION_CULLING ? static_cast<uint32_t>(windows.size() * MAX_FRAMES_IN_FLIGHT) : 0;
+		uint32_t reduce_sets = OCCLUSION_CULLING ? static_cast<uint32_t>(windows.size() * DEPTH_PYRAMID_MAX_LEVELS) : 0;
+		uint32_t meshlet_cull_sets = MESHLET_GEOMETRY ? static_cast<uint32_t>(windows.size() * MAX_FRAMES_IN_FLIGHT) : 0;
+		uint32_t meshlet_geometry_sets = MESHLET_GEOMETRY ? static_cast<uint32_t>(windows.size()) : 0;
+		uint32_t upscale_sets = DYNAMIC_RESOLUTION ? static_cast<uint32_t>(windows.size()) : 0;
+
+		std::array<VkDescriptorPoolSize, 4> pool_sizes = {};
+		pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		pool_sizes[0].descriptorCount = static_cast<uint32_t>(windows.size() * MAX_FRAMES_IN_FLIGHT * 3) + light_sets + cull_sets + meshlet_cull_sets;
+		pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		pool_sizes[1].descriptorCount = static_cast<uint32_t>(compute_descriptor_sets.size() * 2) + light_sets * 2 + cull_sets * 3 + meshlet_cull_sets * 5 + meshlet_geometry_sets * 5;
+		pool_sizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		pool_sizes[2].descriptorCount = MAX_FRAMES_IN_FLIGHT + cull_sets + reduce_sets + upscale_sets;
+		pool_sizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		pool_sizes[3].descriptorCount = std::max(reduce_sets, 1u);
+
+		VkDescriptorPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+		pool_info.pPoolSizes = pool_sizes.data();
+		pool_info.maxSets = static_cast<uint32_t>(windows.size() * MAX_FRAMES_IN_FLIGHT + compute_descriptor_sets.size() + MAX_FRAMES_IN_FLIGHT) + light_sets + cull_sets + reduce_sets + meshlet_cull_sets + meshlet_geometry_sets + upscale_sets;
+		if (vkCreateDescriptorPool(device, &pool_info, allocator, &descriptor_pool) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	void CreateDescriptorSets() {
+		for (auto& window : windows) {
+			CreateDescriptorSets(window);
+		}
+	}
+
+	void CreateDescriptorSets(PresentWindow& window) {
+		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptor_set_layout);
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = descriptor_pool;
+		alloc_info.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+		alloc_info.pSetLayouts = layouts.data();
+
+		if (vkAllocateDescriptorSets(device, &alloc_info, window.descriptor_sets.data()) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		std::array<const UniformBlock*, 3> blocks = { &window.projection_uniforms, &camera_uniforms, &object_uniforms };
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			std::array<VkDescriptorBufferInfo, 3> buffer_infos = {};
+			std::array<VkWriteDescriptorSet, 3> descriptor_writes = {};
+
+			for (uint32_t binding = 0; binding < blocks.size(); ++binding) {
+				buffer_infos[binding].buffer = blocks[binding]->buffers[i];
+				buffer_infos[binding].offset = 0;
+				buffer_infos[binding].range = blocks[binding]->size;
+
+				descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptor_writes[binding].dstSet = window.descriptor_sets[i];
+				descriptor_writes[binding].dstBinding = binding;
+				descriptor_writes[binding].dstArrayElement = 0;
+				descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				descriptor_writes[binding].descriptorCount = 1;
+				descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+				descriptor_writes[binding].pImageInfo = nullptr;
+				descriptor_writes[binding].pTexelBufferView = nullptr;
+			}
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+		}
+	}
+
+	void CreateLightDescriptorSets() {
+		for (auto& window : windows) {
+			std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, light_descriptor_set_layout);
+			VkDescriptorSetAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			alloc_info.descriptorPool = descriptor_pool;
+			alloc_info.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+			alloc_info.pSetLayouts = layouts.data();
+
+			if (vkAllocateDescriptorSets(device, &alloc_info, window.light_descriptor_sets.data()) != VK_SUCCESS) {
+				assert(0);
+			}
+
+			for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+				std::array<VkDescriptorBufferInfo, 3> buffer_infos = {};
+				buffer_infos[0].buffer = window.cluster_uniforms.buffers[i];
+				buffer_infos[0].range = window.cluster_uniforms.size;
+				buffer_infos[1].buffer = light_buffer;
+				buffer_infos[1].range = VK_WHOLE_SIZE;
+				buffer_infos[2].buffer = window.cluster_light_buffer;
+				buffer_infos[2].range = VK_WHOLE_SIZE;
+
+				std::array<VkWriteDescriptorSet, 3> descriptor_writes = {};
+				for (uint32_t binding = 0; binding < descriptor_writes.size(); ++binding) {
+					descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					descriptor_writes[binding].dstSet = window.light_descriptor_sets[i];
+					descriptor_writes[binding].dstBinding = binding;
+					descriptor_writes[binding].dstArrayElement = 0;
+					descriptor_writes[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+					descriptor_writes[binding].descriptorCount = 1;
+					descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+				}
+
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+			}
+		}
+	}
+
+	// One set per vertex buffer the simulation can write to.
+	void CreateComputeDescriptorSets() {
+		std::array<VkDescriptorSetLayout, 2> layouts = { compute_descriptor_set_layout, compute_descriptor_set_layout };
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = descriptor_pool;
+		alloc_info.descriptorSetCount = static_cast<uint32_t>(compute_descriptor_sets.size());
+		alloc_info.pSetLayouts = layouts.data();
+
+		if (vkAllocateDescriptorSets(device, &alloc_info, compute_descriptor_sets.data()) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		for (size_t i = 0; i < compute_descriptor_sets.size(); ++i) {
+			std::array<VkDescriptorBufferInfo, 2> buffer_infos = {};
+			buffer_infos[0].buffer = particle_state_buffer;
+			buffer_infos[0].offset = 0;
+			buffer_infos[0].range = sizeof(Particle) * PARTICLE_COUNT;
+			buffer_infos[1].buffer = particle_vertex_buffers[i];
+			buffer_infos[1].offset = 0;
+			buffer_infos[1].range = sizeof(ParticleVertex) * PARTICLE_COUNT;
+
+			std::array<VkWriteDescriptorSet, 2> descriptor_writes = {};
+			for (uint32_t binding = 0; binding < descriptor_writes.size(); ++binding) {
+				descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptor_writes[binding].dstSet = compute_descriptor_sets[i];
+				descriptor_writes[binding].dstBinding = binding;
+				descriptor_writes[binding].dstArrayElement = 0;
+				descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				descriptor_writes[binding].descriptorCount = 1;
+				descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+			}
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+		}
+	}
+
+	// The buffers are bound once; the pyramid and depth are written by CreateDepthPyramid, as
+	// they change with the window's size.
+	void CreateCullingDescriptorSets(PresentWindow& window) {
+		std::array<VkDescriptorSetLayout, DEPTH_PYRAMID_MAX_LEVELS> reduce_layouts;
+		reduce_layouts.fill(reduce_descriptor_set_layout);
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = descriptor_pool;
+		alloc_info.descriptorSetCount = DEPTH_PYRAMID_MAX_LEVELS;
+		alloc_info.pSetLayouts = reduce_layouts.data();
+		if (vkAllocateDescriptorSets(device, &alloc_info, window.reduce_descriptor_sets.data()) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> cull_layouts;
+		cull_layouts.fill(cull_descriptor_set_layout);
+		alloc_info.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+		alloc_info.pSetLayouts = cull_layouts.data();
+		if (vkAllocateDescriptorSets(device, &alloc_info, window.cull_descriptor_sets.data()) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			std::array<VkDescriptorBufferInfo, 4> buffer_infos = {};
+			buffer_infos[0].buffer = window.cull_uniforms.buffers[i];
+			buffer_infos[0].range = window.cull_uniforms.size;
+			buffer_infos[1].buffer = window.visibility_buffer;
+			buffer_infos[1].range = VK_WHOLE_SIZE;
+			buffer_infos[2].buffer = window.draw_buffer;
+			buffer_infos[2].range = VK_WHOLE_SIZE;
+			buffer_infos[3].buffer = window.cull_stats_buffers[i];
+			buffer_infos[3].range = VK_WHOLE_SIZE;
+
+			std::array<VkWriteDescriptorSet, 4> descriptor_writes = {};
+			for (uint32_t binding = 0; binding < descriptor_writes.size(); ++binding) {
+				descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptor_writes[binding].dstSet = window.cull_descriptor_sets[i];
+				descriptor_writes[binding].dstBinding = binding;
+				descriptor_writes[binding].dstArrayElement = 0;
+				descriptor_writes[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				descriptor_writes[binding].descriptorCount = 1;
+				descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+			}
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+		}
+	}
+
+	// All buffers are bound once. Without occlusion culling there are no object level draws to
+	// gate on; the shader never reads binding 2 then, so the meshlet draws stand in for it.
+	void CreateMeshletDescriptorSets(PresentWindow& window) {
+		std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> cull_layouts;
+		cull_layouts.fill(meshlet_cull_descriptor_set_layout);
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = descriptor_pool;
+		alloc_info.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+		alloc_info.pSetLayouts = cull_layouts.data();
+		if (vkAllocateDescriptorSets(device, &alloc_info, window.meshlet_cull_descriptor_sets.data()) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			std::array<VkDescriptorBufferInfo, 6> buffer_infos = {};
+			buffer_infos[0].buffer = window.meshlet_cull_uniforms.buffers[i];
+			buffer_infos[0].range = window.meshlet_cull_uniforms.size;
+			buffer_infos[1].buffer = meshlet_buffer;
+			buffer_infos[2].buffer = OCCLUSION_CULLING ? window.draw_buffer : window.meshlet_draw_buffer;
+			buffer_infos[3].buffer = window.meshlet_draw_buffer;
+			buffer_infos[4].buffer = window.visible_meshlet_buffer;
+			buffer_infos[5].buffer = window.meshlet_stats_buffers[i];
+			for (uint32_t binding = 1; binding < buffer_infos.size(); ++binding) {
+				buffer_infos[binding].range = VK_WHOLE_SIZE;
+			}
+
+			std::array<VkWriteDescriptorSet, 6> descriptor_writes = {};
+			for (uint32_t binding = 0; binding < descriptor_writes.size(); ++binding) {
+				descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptor_writes[binding].dstSet = window.meshlet_cull_descriptor_sets[i];
+				descriptor_writes[binding].dstBinding = binding;
+				descriptor_writes[binding].dstArrayElement = 0;
+				descriptor_writes[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				descriptor_writes[binding].descriptorCount = 1;
+				descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+			}
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+		}
+
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &meshlet_descriptor_set_layout;
+		if (vkAllocateDescriptorSets(device, &alloc_info, &window.meshlet_geometry_set) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		std::array<VkDescriptorBufferInfo, 5> buffer_infos = {};
+		buffer_infos[0].buffer = vertex_buffer;
+		buffer_infos[1].buffer = meshlet_buffer;
+		buffer_infos[2].buffer = meshlet_vertex_buffer;
+		buffer_infos[3].buffer = meshlet_triangle_buffer;
+		buffer_infos[4].buffer = window.visible_meshlet_buffer;
+
+		std::array<VkWriteDescriptorSet, 5> descriptor_writes = {};
+		for (uint32_t binding = 0; binding < descriptor_writes.size(); ++binding) {
+			buffer_infos[binding].range = VK_WHOLE_SIZE;
+			descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptor_writes[binding].dstSet = window.meshlet_geometry_set;
+			descriptor_writes[binding].dstBinding = binding;
+			descriptor_writes[binding].dstArrayElement = 0;
+			descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_writes[binding].descriptorCount = 1;
+			descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+	}
+
+	// R32 float levels from half the depth buffer's size down to 1x1. Stays in the general
+	// layout, as every level is written as a storage image and read through a sampler.
+	void CreateDepthPyramid(PresentWindow& window) {
+		VkExtent2D extent = GetDepthPyramidExtent(window.extent, 0);
+		window.depth_pyramid_levels = GetDepthPyramidLevelCount(window.extent);
+		window.depth_pyramid_valid = false;
+
+		VkImageCreateInfo image_info = {};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.extent.width = extent.width;
+		image_info.extent.height = extent.height;
+		image_info.extent.depth = 1;
+		image_info.mipLevels = window.depth_pyramid_levels;
+		image_info.arrayLayers = 1;
+		image_info.format = VK_FORMAT_R32_SFLOAT;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device, &image_info, allocator, &window.depth_pyramid) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		VkMemoryRequirements mem_requirements;
+		vkGetImageMemoryRequirements(device, window.depth_pyramid, &mem_requirements);
+		uint32_t memory_type = FindMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		window.depth_pyramid_memory = AllocateMemory(mem_requirements, memory_type, MEMORY_CATEGORY_ATTACHMENT, mem_requirements.size);
+		vkBindImageMemory(device, window.depth_pyramid, window.depth_pyramid_memory, 0);
+
+		VkImageViewCreateInfo view_info = {};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = window.depth_pyramid;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = VK_FORMAT_R32_SFLOAT;
+		view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		view_info.subresourceRange.baseMipLevel = 0;
+		view_info.subresourceRange.levelCount = window.depth_pyramid_levels;
+		view_info.subresourceRange.baseArrayLayer = 0;
+		view_info.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(device, &view_info, allocator, &window.depth_pyramid_view) != VK_SUCCESS) {
+			assert(0);
+		}
+		view_info.subresourceRange.levelCount = 1;
+		for (uint32_t level = 0; level < window.depth_pyramid_levels; ++level) {
+			view_info.subresourceRange.baseMipLevel = level;
+			if (vkCreateImageView(device, &view_info, allocator, &window.depth_pyramid_level_views[level]) != VK_SUCCESS) {
+				assert(0);
+			}
+		}
+
+		VkCommandBuffer command_buffer = BeginSingleTimeCommands();
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = window.depth_pyramid;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, window.depth_pyramid_levels, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		EndSingleTimeCommands(command_buffer);
+
+		std::array<VkDescriptorImageInfo, DEPTH_PYRAMID_MAX_LEVELS * 2 + MAX_FRAMES_IN_FLIGHT> image_infos = {};
+		std::array<VkWriteDescriptorSet, DEPTH_PYRAMID_MAX_LEVELS * 2 + MAX_FRAMES_IN_FLIGHT> descriptor_writes = {};
+		uint32_t write_count = 0;
+		auto write_image = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view, VkImageLayout layout) {
+			image_infos[write_count].sampler = type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ? depth_pyramid_sampler : VK_NULL_HANDLE;
+			image_infos[write_count].imageView = view;
+			image_infos[write_count].imageLayout = layout;
+			descriptor_writes[write_count].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptor_writes[write_count].dstSet = set;
+			descriptor_writes[write_count].dstBinding = binding;
+			descriptor_writes[write_count].dstArrayElement = 0;
+			descriptor_writes[write_count].descriptorType = type;
+			descriptor_writes[write_count].descriptorCount = 1;
+			descriptor_writes[write_count].pImageInfo = &image_infos[write_count];
+			++write_count;
+		};
+		for (uint32_t level = 0; level < window.depth_pyramid_levels; ++level) {
+			VkDescriptorSet set = window.reduce_descriptor_sets[level];
+			if (level == 0) {
+				write_image(set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, window.depth_target.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			}
+			else {
+				write_image(set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, window.depth_pyramid_level_views[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+			}
+			write_image(set, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, window.depth_pyramid_level_views[level], VK_IMAGE_LAYOUT_GENERAL);
+		}
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			write_image(window.cull_descriptor_sets[i], 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, window.depth_pyramid_view, VK_IMAGE_LAYOUT_GENERAL);
+		}
+		vkUpdateDescriptorSets(device, write_count, descriptor_writes.data(), 0, nullptr);
+	}
+
+	// Written again whenever the swap chain is recreated, with the new scene color.
+	void CreateUpscaleDescriptorSet(PresentWindow& window) {
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = descriptor_pool;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &upscale_descriptor_set_layout;
+		if (vkAllocateDescriptorSets(device, &alloc_info, &window.upscale_descriptor_set) != VK_SUCCESS) {
+			assert(0);
+		}
+		WriteUpscaleDescriptorSet(window);
+	}
+
+	void WriteUpscaleDescriptorSet(PresentWindow& window) {
+		VkDescriptorImageInfo image_info = {};
+		image_info.sampler = upscale_sampler;
+		image_info.imageView = window.scene_color.view;
+		image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet descriptor_write = {};
+		descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_write.dstSet = window.upscale_descriptor_set;
+		descriptor_write.dstBinding = 0;
+		descriptor_write.dstArrayElement = 0;
+		descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptor_write.descriptorCount = 1;
+		descriptor_write.pImageInfo = &image_info;
+		vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
+	}
+
+	void DestroyDepthPyramid(PresentWindow& window) {
+		if (window.depth_pyramid == VK_NULL_HANDLE) {
+			return;
+		}
+		for (uint32_t level = 0; level < window.depth_pyramid_levels; ++level) {
+			vkDestroyImageView(device, window.depth_pyramid_level_views[level], allocator);
+		}
+		vkDestroyImageView(device, window.depth_pyramid_view, allocator);
+		vkDestroyImage(device, window.depth_pyramid, allocator);
+		FreeMemory(window.depth_pyramid_memory);
+		window.depth_pyramid = VK_NULL_HANDLE;
+	}
+
+	void CreateStagingRing() {
+		CreateBuffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_ring_buffer, staging_ring_memory, MEMORY_CATEGORY_STAGING);
+		vkMapMemory(device, staging_ring_memory, 0, STAGING_RING_SIZE, 0, &staging_ring_mapped);
+	}
+
+	// Paths ending in .ppm are image sequences, other paths raw files. A sequence without a run
+	// of '#' for the frame number gets one before the extension.
+	void OpenFrameExport() {
+		FrameExportFormat format = FRAME_EXPORT_PIPE;
+		std::string target = capture_options.export_command;
+		if (!capture_options.export_path.empty()) {
+			target = capture_options.export_path;
+			const std::string ppm_extension = ".ppm";
+			bool ppm = target.size() >= ppm_extension.size() && target.compare(target.size() - ppm_extension.size(), ppm_extension.size(), ppm_extension) == 0;
+			format = ppm ? FRAME_EXPORT_PPM : FRAME_EXPORT_RAW;
+			if (ppm && target.find('#') == std::string::npos) {
+				target.insert(target.size() - ppm_extension.size(), "_######");
+				std::cout << "export: writing frames to " << target << std::endl;
+			}
+		}
+		if (target.empty()) {
+			return;
+		}
+		if (!frame_exporter.Open(format, target, FRAME_EXPORT_SLOTS)) {
+			std::cerr << "failed to open export " << target << std::endl;
+		}
+	}
+
+	// Sized for the first window's images. The export worker reads every byte, so cached memory
+	// is preferred even where it is not coherent.
+	void CreateReadbackBuffers() {
+		const PresentWindow& window = windows[0];
+		if (window.image_format == VK_FORMAT_B8G8R8A8_UNORM || window.image_format == VK_FORMAT_B8G8R8A8_SRGB) {
+			readback_bgra = true;
+		}
+		else if (window.image_format != VK_FORMAT_R8G8B8A8_UNORM && window.image_format != VK_FORMAT_R8G8B8A8_SRGB) {
+			std::cerr << "swap chain format " << window.image_format << " cannot be exported" << std::endl;
+			frame_exporter.Close();
+			return;
+		}
+
+		readback_slots.resize(FRAME_EXPORT_SLOTS);
+		for (auto& slot : readback_slots) {
+			CreateReadbackSlot(slot, GetReadbackSize(window.extent));
+		}
+		std::cout << "export: " << window.extent.width << "x" << window.extent.height << (readback_bgra ? " bgra" : " rgba") << " frames" << std::endl;
+	}
+
+	VkDeviceSize GetReadbackSize(VkExtent2D extent) const {
+		return static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+	}
+
+	void CreateReadbackSlot(ReadbackSlot& slot, VkDeviceSize size) {
+		VkBufferCreateInfo buffer_info = {};
+		buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_info.size = size;
+		buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(device, &buffer_info, allocator, &slot.buffer) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		VkMemoryRequirements mem_requirements;
+		vkGetBufferMemoryRequirements(device, slot.buffer, &mem_requirements);
+		uint32_t memory_type;
+		if (!FindMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, memory_type)) {
+			memory_type = FindMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+		VkPhysicalDeviceMemoryProperties mem_properties;
+		vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+		readback_coherent = (mem_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+		slot.memory = AllocateMemory(mem_requirements, memory_type, MEMORY_CATEGORY_STAGING, size);
+		vkBindBufferMemory(device, slot.buffer, slot.memory, 0);
+		void* mapped;
+		vkMapMemory(device, slot.memory, 0, size, 0, &mapped);
+		slot.mapped = static_cast<const uint8_t*>(mapped);
+		slot.size = size;
+		slot.pending = false;
+	}
+
+	void DestroyReadbackSlot(ReadbackSlot& slot) {
+		vkUnmapMemory(device, slot.memory);
+		vkDestroyBuffer(device, slot.buffer, allocator);
+		FreeMemory(slot.memory);
+		slot = ReadbackSlot();
+	}
+
+	// Called with the device idle, once the first window's swap chain was recreated. Buffers
+	// only grow; frames read back to the old ones are written out before they are replaced.
+	void ResizeReadbackBuffers() {
+		VkDeviceSize size = GetReadbackSize(windows[0].extent);
+		if (readback_slots.empty() || size <= readback_slots[0].size) {
+			return;
+		}
+		ExportCompletedReadbacks(graphics_timeline_value);
+		frame_exporter.WaitIdle();
+		for (auto& slot : readback_slots) {
+			DestroyReadbackSlot(slot);
+			CreateReadbackSlot(slot, size);
+		}
+	}
+
+	// Copies the first window's image to the next readback slot once its last pass is done,
+	// before it is presented. Slots are filled round robin, and the frame is dropped instead
+	// of waiting when the next one is still pending or being written.
+	void RecordFrameReadback(VkCommandBuffer command_buffer) {
+		const PresentWindow& window = windows[0];
+		if (!window.acquired || readback_slots.empty()) {
+			return;
+		}
+		ReadbackSlot& slot = readback_slots[readback_next_slot];
+		if (slot.pending || frame_exporter.IsSlotBusy(readback_next_slot)) {
+			++export_dropped_frames;
+			return;
+		}
+		if (export_readback_frames == 0) {
+			export_start_time = glfwGetTime();
+		}
+		++export_readback_frames;
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = window.images[window.image_index];
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy region = {};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageExtent = { window.extent.width, window.extent.height, 1 };
+		vkCmdCopyImageToBuffer(command_buffer, window.images[window.image_index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+		// Back to presenting, which the present semaphore orders; the copy is made visible to
+		// the host reading the slot once the timeline passed the frame.
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = 0;
+		VkBufferMemoryBarrier buffer_barrier = {};
+		buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		buffer_barrier.buffer = slot.buffer;
+		buffer_barrier.offset = 0;
+		buffer_barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &buffer_barrier, 1, &barrier);
+
+		slot.pending = true;
+		slot.timeline_value = GetPendingGraphicsValue();
+		slot.extent = window.extent;
+		readback_next_slot = (readback_next_slot + 1) % static_cast<uint32_t>(readback_slots.size());
+	}
+
+	// Hands every slot the graphics timeline passed to the export worker, oldest first: the
+	// slot filled next is the oldest one.
+	void ExportCompletedReadbacks(uint64_t completed_value) {
+		uint32_t slot_count = static_cast<uint32_t>(readback_slots.size());
+		for (uint32_t i = 0; i < slot_count; ++i) {
+			uint32_t index = (readback_next_slot + i) % slot_count;
+			ReadbackSlot& slot = readback_slots[index];
+			if (!slot.pending || slot.timeline_value > completed_value) {
+				continue;
+			}
+			if (!readback_coherent) {
+				VkMappedMemoryRange range = {};
+				range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+				range.memory = slot.memory;
+				range.offset = 0;
+				range.size = VK_WHOLE_SIZE;
+				vkInvalidateMappedMemoryRanges(device, 1, &range);
+			}
+			frame_exporter.Submit(index, { slot.mapped, slot.extent.width, slot.extent.height, slot.extent.width * 4, readback_bgra });
+			slot.pending = false;
+		}
+	}
+
+	// Called with the device idle: writes out the last frames and reports how the export kept
+	// up. The worker's own rate is what it could sustain given frames fast enough.
+	void FinishFrameExport() {
+		if (!frame_exporter.IsOpen()) {
+			return;
+		}
+		ExportCompletedReadbacks(graphics_timeline_value);
+		frame_exporter.Close();
+
+		uint64_t frames = frame_exporter.GetWrittenFrameCount();
+		double seconds = glfwGetTime() - export_start_time;
+		std::cout << "export: " << frames << " frames, " << frame_exporter.GetWrittenBytes() << " bytes";
+		if (frames > 0 && seconds > 0.0 && frame_exporter.GetWriteSeconds() > 0.0) {
+			std::cout << ", " << frames / seconds << " frames/s (worker " << frames / frame_exporter.GetWriteSeconds() << " frames/s)";
+		}
+		std::cout << ", " << export_dropped_frames << " dropped";
+		if (frame_exporter.GetFailedFrameCount() > 0) {
+			std::cout << ", " << frame_exporter.GetFailedFrameCount() << " failed to write";
+		}
+		std::cout << std::endl;
+	}
+
+	void CreateTextureSampler() {
+		VkSamplerCreateInfo sampler_info = {};
+		sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		sampler_info.magFilter = VK_FILTER_LINEAR;
+		sampler_info.minFilter = VK_FILTER_LINEAR;
+		sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		sampler_info.mipLodBias = 0.0f;
+		sampler_info.anisotropyEnable = VK_FALSE;
+		sampler_info.maxAnisotropy = 1.0f;
+		sampler_info.compareEnable = VK_FALSE;
+		sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+		sampler_info.minLod = 0.0f;
+		// The image view only ever covers resident levels, so no clamp is needed here.
+		sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+		sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		sampler_info.unnormalizedCoordinates = VK_FALSE;
+
+		if (vkCreateSampler(device, &sampler_info, allocator, &texture_sampler) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// 1x1 white texture bound until the first mip of the scene texture is resident.
+	void CreatePlaceholderTexture() {
+		MipLevel white;
+		white.width = 1;
+		white.height = 1;
+		white.data.assign(4, 255);
+		placeholder_texture.mips.push_back(white);
+
+		VkDeviceSize staging_offset = staging_ring.Allocate(white.data.size(), 16, GetPendingGraphicsValue());
+		assert(staging_offset != StagingRing::INVALID_OFFSET);
+		memcpy(static_cast<char*>(staging_ring_mapped) + staging_offset, white.data.data(), white.data.size());
+
+		VkCommandBuffer command_buffer = BeginSingleTimeCommands();
+		ResizeTextureImage(command_buffer, placeholder_texture, 0, staging_offset);
+		EndSingleTimeCommands(command_buffer);
+	}
+
+	void CreateTextureDescriptorSets() {
+		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, texture_descriptor_set_layout);
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = descriptor_pool;
+		alloc_info.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+		alloc_info.pSetLayouts = layouts.data();
+
+		texture_descriptor_sets.resize(MAX_FRAMES_IN_FLIGHT);
+		// Written on first use by UpdateTextureDescriptorSet.
+		texture_descriptor_versions.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+		if (vkAllocateDescriptorSets(device, &alloc_info, texture_descriptor_sets.data()) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// Queues every texture for loading on the job system. Nothing touches the GPU until
+	// StreamTextures picks up the result on the render thread. The containers already hold the
+	// mip chain in texture_format, so the workers only read and validate them.
+	void LoadTextures() {
+		textures.resize(TEXTURE_FILES.size());
+		// Room for every texture up front, so registering and streaming them never allocates
+		// during a frame.
+		uint32_t texture_count = static_cast<uint32_t>(TEXTURE_FILES.size());
+		texture_residency.Reserve(texture_count);
+		residency_textures.reserve(texture_count);
+		stream_evicted.reserve(texture_count);
+		stream_pending.reserve(texture_count);
+		stream_level_sizes.reserve(TextureResidency::MAX_LEVELS);
+		frame_capture.registered_textures.reserve(texture_count);
+		frame_capture.uploads.reserve(texture_count);
+
+		for (uint32_t i = 0; i < TEXTURE_FILES.size(); ++i) {
+			std::string path = TEXTURE_FILES[i] + GetTextureContainerSuffix(texture_format);
+			jobs.Schedule(texture_decode_jobs, [this, i, path]() {
+				DecodedTexture decoded;
+				decoded.texture = i;
+				if (!ReadTextureContainer(ReadFile(path), decoded.format, decoded.mips) || decoded.format != texture_format) {
+					std::cerr << "failed to load " << path << std::endl;
+					return;
+				}
+				{
+					std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+					decoded_textures.push_back(std::move(decoded));
+				}
+				textures_decoded = true;
+				decoded_textures_condition.notify_all();
+				// Wakes a render-on-demand main loop blocked in glfwWaitEvents.
+				glfwPostEmptyEvent();
+			});
+		}
+	}
+
+	// Runs at the start of the frame's command buffer: registers freshly decoded textures and
+	// streams at most one more mip per texture, most recently used textures first, evicting
+	// fine mips of stale textures when the budget is exhausted.
+	void StreamTextures(VkCommandBuffer command_buffer) {
+		{
+			std::unique_lock<std::mutex> lock(decoded_textures_mutex);
+			if (replaying) {
+				WaitForReplayTextures(lock);
+			}
+			for (auto& decoded : decoded_textures) {
+				if (replaying && std::find(replay_frame.registered_textures.begin(), replay_frame.registered_textures.end(), decoded.texture) == replay_frame.registered_textures.end()) {
+					continue;
+				}
+				StreamedTexture& texture = textures[decoded.texture];
+				texture.mips = std::move(decoded.mips);
+				texture.format = decoded.format;
+				texture.image_first_level = static_cast<uint32_t>(texture.mips.size());
+
+				stream_level_sizes.clear();
+				for (const auto& mip : texture.mips) {
+					stream_level_sizes.push_back(mip.data.size());
+				}
+				texture.residency_id = texture_residency.AddTexture(stream_level_sizes);
+				residency_textures.push_back(decoded.texture);
+				frame_capture.registered_textures.push_back(decoded.texture);
+			}
+			// Registered textures were moved from; a replay keeps the rest for a later frame.
+			decoded_textures.erase(std::remove_if(decoded_textures.begin(), decoded_textures.end(), [this](const DecodedTexture& decoded) {
+				return !textures[decoded.texture].mips.empty();
+			}), decoded_textures.end());
+		}
+
+		if (!textures[SCENE_TEXTURE].mips.empty()) {
+			texture_residency.Touch(textures[SCENE_TEXTURE].residency_id, frame_number);
+		}
+
+		// The budget shrinks when device memory runs low.
+		std::vector<uint32_t>& evicted = stream_evicted;
+		evicted.clear();
+		texture_residency.EvictToBudget(evicted);
+		ShrinkEvictedTextures(command_buffer, evicted);
+
+		std::vector<uint32_t>& pending = stream_pending;
+		pending.clear();
+		for (uint32_t texture : residency_textures) {
+			if (!texture_residency.IsFullyResident(textures[texture].residency_id)) {
+				pending.push_back(texture);
+			}
+		}
+		std::sort(pending.begin(), pending.end(), [this](uint32_t a, uint32_t b) {
+			return texture_residency.GetLastUsedFrame(textures[a].residency_id) > texture_residency.GetLastUsedFrame(textures[b].residency_id);
+		});
+
+		for (uint32_t index : pending) {
+			StreamedTexture& texture = textures[index];
+			uint32_t level = texture_residency.GetFirstResidentLevel(texture.residency_id) - 1;
+			const MipLevel& mip = texture.mips[level];
+			if (!texture_residency.CanReserveNextLevel(texture.residency_id)) {
+				continue;
+			}
+
+			// Copies need the offset aligned to 4 and to the 8 byte texel block size.
+			VkDeviceSize staging_offset = staging_ring.Allocate(mip.data.size(), 16, GetPendingGraphicsValue());
+			if (staging_offset == StagingRing::INVALID_OFFSET) {
+				// Out of staging space until earlier frames retire; try again next frame.
+				MarkDirty(DIRTY_UPLOAD);
+				break;
+			}
+
+			evicted.clear();
+			texture_residency.ReserveNextLevel(texture.residency_id, evicted);
+			memcpy(static_cast<char*>(staging_ring_mapped) + staging_offset, mip.data.data(), mip.data.size());
+
+			ShrinkEvictedTextures(command_buffer, evicted);
+			ResizeTextureImage(command_buffer, texture, level, staging_offset);
+			frame_capture.uploads.push_back({ index, level });
+
+			// Keep frames coming until every level that fits has streamed in.
+			MarkDirty(DIRTY_UPLOAD);
+		}
+	}
+
+	// Blocks until every texture the replayed frame registers finished loading, so the replay
+	// streams the same uploads in the same frames as the capture regardless of decode speed.
+	void WaitForReplayTextures(std::unique_lock<std::mutex>& lock) {
+		auto all_decoded = [this]() {
+			for (uint32_t texture : replay_frame.registered_textures) {
+				auto found = std::find_if(decoded_textures.begin(), decoded_textures.end(), [texture](const DecodedTexture& decoded) {
+					return decoded.texture == texture;
+				});
+				if (found == decoded_textures.end()) {
+					return false;
+				}
+			}
+			return true;
+		};
+		if (!decoded_textures_condition.wait_for(lock, std::chrono::duration<double>(REPLAY_TEXTURE_WAIT), all_decoded)) {
+			std::cerr << "replay: textures of frame " << replay_frame_index << " did not finish loading" << std::endl;
+		}
+	}
+
+	// Drops the levels the residency evicted from the images of the given residency ids.
+	void ShrinkEvictedTextures(VkCommandBuffer command_buffer, const std::vector<uint32_t>& evicted) {
+		for (uint32_t residency_id : evicted) {
+			for (uint32_t evicted_index : residency_textures) {
+				if (textures[evicted_index].residency_id == residency_id) {
+					ResizeTextureImage(command_buffer, textures[evicted_index], texture_residency.GetFirstResidentLevel(residency_id), StagingRing::INVALID_OFFSET);
+				}
+			}
+		}
+	}
+
+	// Replaces the image of texture with one holding levels [first_level, level_count). Levels
+	// both images hold are copied on the GPU; a newly added finer level comes from the staging
+	// ring at staging_offset. The old image is retired until the frames sampling it completed.
+	void ResizeTextureImage(VkCommandBuffer command_buffer, StreamedTexture& texture, uint32_t first_level, VkDeviceSize staging_offset) {
+		uint32_t level_count = static_cast<uint32_t>(texture.mips.size());
+		const MipLevel& top = texture.mips[first_level];
+
+		VkImageCreateInfo image_info = {};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.extent.width = top.width;
+		image_info.extent.height = top.height;
+		image_info.extent.depth = 1;
+		image_info.mipLevels = level_count - first_level;
+		image_info.arrayLayers = 1;
+		image_info.format = texture.format;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkImage image;
+		if (vkCreateImage(device, &image_info, allocator, &image) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		VkMemoryRequirements mem_requirements;
+		vkGetImageMemoryRequirements(device, image, &mem_requirements);
+
+		VkDeviceMemory memory = AllocateMemory(mem_requirements, FindMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), MEMORY_CATEGORY_TEXTURE, mem_requirements.size);
+
+		vkBindImageMemory(device, image, memory, 0);
+
+		std::array<VkImageMemoryBarrier, 2> barriers = {};
+		barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[0].srcAccessMask = 0;
+		barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].image = image;
+		barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barriers[0].subresourceRange.baseMipLevel = 0;
+		barriers[0].subresourceRange.levelCount = image_info.mipLevels;
+		barriers[0].subresourceRange.baseArrayLayer = 0;
+		barriers[0].subresourceRange.layerCount = 1;
+
+		bool has_old_image = texture.image != VK_NULL_HANDLE;
+		if (has_old_image) {
+			barriers[1] = barriers[0];
+			barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barriers[1].image = texture.image;
+			barriers[1].subresourceRange.levelCount = level_count - texture.image_first_level;
+		}
+
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, has_old_image ? 2 : 1, barriers.data());
+
+		if (has_old_image) {
+			std::array<VkImageCopy, TextureResidency::MAX_LEVELS> regions;
+			uint32_t region_count = 0;
+			for (uint32_t level = std::max(first_level, texture.image_first_level); level < level_count; ++level) {
+				VkImageCopy& region = regions[region_count++];
+				region = {};
+				region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - texture.image_first_level, 0, 1 };
+				region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - first_level, 0, 1 };
+				region.extent = { texture.mips[level].width, texture.mips[level].height, 1 };
+			}
+			vkCmdCopyImage(command_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, region_count, regions.data());
+		}
+
+		if (staging_offset != StagingRing::INVALID_OFFSET) {
+			VkBufferImageCopy region = {};
+			region.bufferOffset = staging_offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { top.width, top.height, 1 };
+			vkCmdCopyBufferToImage(command_buffer, staging_ring_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+
+		barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, barriers.data());
+
+		VkImageViewCreateInfo view_info = {};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = image;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = image_info.format;
+		view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		view_info.subresourceRange.baseMipLevel = 0;
+		view_info.subresourceRange.levelCount = image_info.mipLevels;
+		view_info.subresourceRange.baseArrayLayer = 0;
+		view_info.subresourceRange.layerCount = 1;
+
+		VkImageView view;
+		if (vkCreateImageView(device, &view_info, allocator, &view) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		if (has_old_image) {
+			retired_images.push_back({ texture.image, texture.memory, texture.view, GetPendingGraphicsValue() });
+		}
+		texture.image = image;
+		texture.memory = memory;
+		texture.view = view;
+		texture.image_first_level = first_level;
+		++texture_version;
+	}
+
+	// Points this frame's texture set at the current scene texture image. The set is only
+	// rewritten after the frame's timeline wait, when no submitted work can still be reading it.
+	void UpdateTextureDescriptorSet() {
+		if (texture_descriptor_versions[current_frame] == texture_version) {
+			return;
+		}
+
+		const StreamedTexture& texture = textures[SCENE_TEXTURE].image != VK_NULL_HANDLE ? textures[SCENE_TEXTURE] : placeholder_texture;
+
+		VkDescriptorImageInfo image_info = {};
+		image_info.sampler = texture_sampler;
+		image_info.imageView = texture.view;
+		image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet descriptor_write = {};
+		descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_write.dstSet = texture_descriptor_sets[current_frame];
+		descriptor_write.dstBinding = 0;
+		descriptor_write.dstArrayElement = 0;
+		descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptor_write.descriptorCount = 1;
+		descriptor_write.pImageInfo = &image_info;
+
+		vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
+		texture_descriptor_versions[current_frame] = texture_version;
+	}
+
+	// Frees staging space, retired images and retired pipelines of every submit the graphics
+	// timeline has passed, which may be more recent than the frame waited for.
+	void ReleaseCompletedFrames() {
+		uint64_t completed_value;
+		if (get_semaphore_counter_value(device, graphics_timeline, &completed_value) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		staging_ring.Release(completed_value);
+		if (frame_exporter.IsOpen()) {
+			ExportCompletedReadbacks(completed_value);
+		}
+
+		auto retired_end = std::remove_if(retired_images.begin(), retired_images.end(), [&](const RetiredImage& retired) {
+			if (retired.timeline_value > completed_value) {
+				return false;
+			}
+			DestroyImage(retired.image, retired.memory, retired.view);
+			return true;
+		});
+		retired_images.erase(retired_end, retired_images.end());
+
+		auto retired_pipelines_end = std::remove_if(retired_pipelines.begin(), retired_pipelines.end(), [&](const RetiredPipeline& retired) {
+			if (retired.timeline_value > completed_value) {
+				return false;
+			}
+			vkDestroyPipeline(device, retired.pipeline, allocator);
+			return true;
+		});
+		retired_pipelines.erase(retired_pipelines_end, retired_pipelines.end());
+	}
+
+	// Value the next graphics submit signals: what resources used by the frame being recorded
+	// are retired with.
+	uint64_t GetPendingGraphicsValue() const {
+		return graphics_timeline_value + 1;
+	}
+
+	void WaitForTimeline(VkSemaphore semaphore, uint64_t value) {
+		VkSemaphoreWaitInfoKHR wait_info = {};
+		wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		wait_info.semaphoreCount = 1;
+		wait_info.pSemaphores = &semaphore;
+		wait_info.pValues = &value;
+		if (wait_semaphores(device, &wait_info, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	void DestroyImage(VkImage image, VkDeviceMemory memory, VkImageView view) {
+		vkDestroyImageView(device, view, allocator);
+		vkDestroyImage(device, image, allocator);
+		FreeMemory(memory);
+	}
+
+	uint32_t FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) {
+		uint32_t memory_type = 0;
+		if (!FindMemoryType(type_filter, properties, memory_type)) {
+			assert(0);
+		}
+		return memory_type;
+	}
+
+	bool FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties, uint32_t& memory_type) {
+		VkPhysicalDeviceMemoryProperties mem_properties;
+		vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+
+		for (uint32_t i = 0; i < mem_properties.memoryTypeCount; ++i) {
+			if (type_filter & (1 << i) && (mem_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+				memory_type = i;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Command buffers are recorded per frame in flight, since which particle buffer is drawn
+	// and which queue family owns it changes every frame.
+	void CreateCommandBuffers() {
+		command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+		compute_command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+		VkCommandBufferAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.commandPool = command_pool;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		alloc_info.commandBufferCount = (uint32_t)command_buffers.size();
+
+		if (vkAllocateCommandBuffers(device, &alloc_info, command_buffers.data()) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		alloc_info.commandPool = compute_command_pool;
+		alloc_info.commandBufferCount = (uint32_t)compute_command_buffers.size();
+
+		if (vkAllocateCommandBuffers(device, &alloc_info, compute_command_buffers.data()) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		if (DYNAMIC_RESOLUTION) {
+			upscale_command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+			alloc_info.commandPool = command_pool;
+			alloc_info.commandBufferCount = (uint32_t)upscale_command_buffers.size();
+
+			if (vkAllocateCommandBuffers(device, &alloc_info, upscale_command_buffers.data()) != VK_SUCCESS) {
+				assert(0);
+			}
+		}
+	}
+
+	// Records the scene into the acquired image of every window, drawing the particle vertex
+	// buffer written by the previous frame's simulation when there is one. With
+	// DYNAMIC_RESOLUTION it renders into the scene colors, and RecordUpscaleCommandBuffer
+	// takes them into the images.
+	void RecordCommandBuffer(VkCommandBuffer command_buffer, bool draw_particles, uint32_t particle_index) {
+		vkResetCommandBuffer(command_buffer, 0);
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		begin_info.pInheritanceInfo = nullptr;
+
+		if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		if (gpu_timer_pool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(command_buffer, gpu_timer_pool, GPU_TIMER_QUERIES * current_frame, GPU_TIMER_QUERIES);
+		}
+
+		StreamTextures(command_buffer);
+		UpdateTextureDescriptorSet();
+
+		if (draw_particles) {
+			// Acquire half of the compute -> graphics transfer released by the simulation.
+			TransferParticleOwnership(command_buffer, particle_index, compute_family, graphics_family,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		}
+
+		for (const auto& window : windows) {
+			if (window.acquired) {
+				RecordWindowPass(command_buffer, window, draw_particles, particle_index);
+			}
+		}
+
+		if (draw_particles) {
+			// Release half of the graphics -> compute transfer, so the next simulation step can
+			// write this buffer again. Only the semaphore orders it, there are no writes to flush.
+			TransferParticleOwnership(command_buffer, particle_index, graphics_family, compute_family,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+		}
+
+		// With dynamic resolution the image is only complete after the upscale.
+		if (frame_exporter.IsOpen() && !DYNAMIC_RESOLUTION) {
+			RecordFrameReadback(command_buffer);
+		}
+
+		if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// Stretches every acquired window's scene color over its image.
+	void RecordUpscaleCommandBuffer(VkCommandBuffer command_buffer) {
+		vkResetCommandBuffer(command_buffer, 0);
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		for (const auto& window : windows) {
+			if (!window.acquired) {
+				continue;
+			}
+			BeginGpuTimer(command_buffer, window, GPU_PASS_UPSCALE);
+
+			VkRenderPassBeginInfo render_pass_info = {};
+			render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			render_pass_info.renderPass = upscale_render_pass;
+			render_pass_info.framebuffer = window.upscale_framebuffers[window.image_index];
+			render_pass_info.renderArea.offset = { 0, 0 };
+			render_pass_info.renderArea.extent = window.extent;
+			vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport = {};
+			viewport.width = (float)window.extent.width;
+			viewport.height = (float)window.extent.height;
+			viewport.minDepth = 0.0f;
+			viewport.maxDepth = 1.0f;
+			vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+			VkRect2D scissor = {};
+			scissor.extent = window.extent;
+			vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+			// Samples at the centers of the rendered area's edge texels at most.
+			glm::vec2 full_size(window.extent.width, window.extent.height);
+			glm::vec2 rendered_size(window.render_extent.width, window.render_extent.height);
+			Upscale upscale = { rendered_size / full_size, (rendered_size - 0.5f) / full_size };
+
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscale_pipeline);
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscale_pipeline_layout, 0, 1, &window.upscale_descriptor_set, 0, nullptr);
+			vkCmdPushConstants(command_buffer, upscale_pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(upscale), &upscale);
+			vkCmdDraw(command_buffer, 3, 1, 0, 0);
+
+			vkCmdEndRenderPass(command_buffer);
+			EndGpuTimer(command_buffer, window, GPU_PASS_UPSCALE);
+		}
+
+		if (frame_exporter.IsOpen()) {
+			RecordFrameReadback(command_buffer);
+		}
+
+		if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
+
+	// The render pass into one window's acquired image, or its scene color with
+	// DYNAMIC_RESOLUTION. Only the first window gets the HUD.
+	void RecordWindowPass(VkCommandBuffer command_buffer, const PresentWindow& window, bool draw_particles, uint32_t particle_index) {
+		VkPipeline scene_pipeline = GetPipeline(GetProgramDesc(MESHLET_GEOMETRY ? PROGRAM_SCENE_MESHLETS : PROGRAM_SCENE));
+
+		if (CLUSTERED_LIGHTING) {
+			BeginGpuTimer(command_buffer, window, GPU_PASS_LIGHT_CLUSTERS);
+			DispatchLightClusters(command_buffer, window);
+			EndGpuTimer(command_buffer, window, GPU_PASS_LIGHT_CLUSTERS);
+		}
+
+		BeginGpuTimer(command_buffer, window, GPU_PASS_WINDOW);
+		// With occlusion culling the first pass draws what survived the previous frame's
+		// pyramid, and the second what this frame's pyramid shows was wrongly culled.
+		if (OCCLUSION_CULLING) {
+			DispatchCulling(command_buffer, window, 0);
+		}
+		if (MESHLET_GEOMETRY) {
+			DispatchMeshletCulling(command_buffer, window, 0);
+		}
+		BeginWindowRenderPass(command_buffer, window, render_pass);
+		DrawScene(command_buffer, window, scene_pipeline, 0);
+		if (OCCLUSION_CULLING) {
+			vkCmdEndRenderPass(command_buffer);
+			BeginGpuTimer(command_buffer, window, GPU_PASS_DEPTH_PYRAMID);
+			BuildDepthPyramid(command_buffer, window);
+			EndGpuTimer(command_buffer, window, GPU_PASS_DEPTH_PYRAMID);
+			DispatchCulling(command_buffer, window, 1);
+			if (MESHLET_GEOMETRY) {
+				DispatchMeshletCulling(command_buffer, window, 1);
+			}
+			BeginWindowRenderPass(command_buffer, window, late_render_pass);
+			DrawScene(command_buffer, window, scene_pipeline, 1);
+		}
+
+		VkDeviceSize offsets[] = {0};
+		if (draw_particles) {
+			// The additive variant is only compiled once first asked for; until then particles
+			// draw with the default blending.
+			PipelineDesc particle_desc = GetProgramDesc(PROGRAM_PARTICLES);
+			PipelineDesc additive_desc = particle_desc;
+			additive_desc.blend_mode = PIPELINE_BLEND_ADDITIVE;
+			VkPipeline particle_pipeline = additive_particles ? GetPipeline(additive_desc, &particle_desc) : GetPipeline(particle_desc);
+			if (particle_pipeline != VK_NULL_HANDLE) {
+				vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, particle_pipeline);
+				vkCmdBindVertexBuffers(command_buffer, 0, 1, &particle_vertex_buffers[particle_index], offsets);
+				vkCmdDraw(command_buffer, PARTICLE_COUNT, 1, 0, 0);
+				frame_capture.draw_flags |= FRAME_DRAW_PARTICLES;
+			}
+		}
+
+		if (&window == &windows[0]) {
+			DrawOverlay(command_buffer, window.render_extent);
+		}
+
+		vkCmdEndRenderPass(command_buffer);
+		EndGpuTimer(command_buffer, window, GPU_PASS_WINDOW);
+	}
+
+	// Rebuilds the window's cluster light grid for this frame's view. The previous frame's
+	// fragments are done reading it before it is written.
+	void DispatchLightClusters(VkCommandBuffer command_buffer, const PresentWindow& window) {
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, light_cluster_pipeline);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, light_cluster_pipeline_layout, 0, 1, &window.light_descriptor_sets[current_frame], 0, nullptr);
+		vkCmdDispatch(command_buffer, (CLUSTER_COUNT + CLUSTER_WORKGROUP_SIZE - 1) / CLUSTER_WORKGROUP_SIZE, 1, 1);
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	// Binds what every draw into the window uses. Everything is drawn into the render extent.
+	void BeginWindowRenderPass(VkCommandBuffer command_buffer, const PresentWindow& window, VkRenderPass pass) {
+		VkRenderPassBeginInfo render_pass_info = {};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		render_pass_info.renderPass = pass;
+		render_pass_info.framebuffer = window.framebuffers[DYNAMIC_RESOLUTION ? 0 : window.image_index];
+		render_pass_info.renderArea.offset = { 0,0 };
+		render_pass_info.renderArea.extent = window.render_extent;
+
+		// Attachment order matches CreateRenderPass: color, depth and (when multisampled) the resolve target.
+		std::array<VkClearValue, 3> clear_values = {};
+		clear_values[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+		clear_values[1].depthStencil = { 1.0f, 0 };
+		clear_values[2].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+		render_pass_info.clearValueCount = msaa_samples != VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
+		render_pass_info.pClearValues = clear_values.data();
+
+		vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)window.render_extent.width;
+		viewport.height = (float)window.render_extent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+		VkRect2D scissor = {};
+		scissor.offset = { 0, 0 };
+		scissor.extent = window.render_extent;
+		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+		std::array<VkDescriptorSet, 3> sets = { window.descriptor_sets[current_frame], texture_descriptor_sets[current_frame], window.light_descriptor_sets[current_frame] };
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+	}
+
+	// The culled phase draws come from the culling dispatch, one indirect draw per object so no
+	// multiDrawIndirect support is needed. Meshlets are drawn by one indirect draw per phase,
+	// an instance of MESHLET_MAX_TRIANGLES triangles per visible meshlet; the instance count
+	// stays 0 in the phase that does not draw the object.
+	void DrawScene(VkCommandBuffer command_buffer, const PresentWindow& window, VkPipeline scene_pipeline, uint32_t phase) {
+		if (scene_pipeline == VK_NULL_HANDLE) {
+			return;
+		}
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene_pipeline);
+
+		const MeshLod& lod = scene_lods[scene_lod];
+		if (MESHLET_GEOMETRY) {
+			uint32_t visible_offset = phase * scene_meshlet_capacity;
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 3, 1, &window.meshlet_geometry_set, 0, nullptr);
+			vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(visible_offset), &visible_offset);
+			vkCmdDrawIndirect(command_buffer, window.meshlet_draw_buffer, phase * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+		}
+		else {
+			VkBuffer vertex_buffers[] = { vertex_buffer };
+			VkDeviceSize offsets[] = {0};
+			vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
+
+			vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT16);
+
+			if (OCCLUSION_CULLING) {
+				VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+				for (uint32_t i = 0; i < cull_object_count; ++i) {
+					vkCmdDrawIndexedIndirect(command_buffer, window.draw_buffer, (phase * CULL_MAX_OBJECTS + i) * stride, 1, static_cast<uint32_t>(stride));
+				}
+			}
+			else {
+				vkCmdDrawIndexed(command_buffer, lod.index_count, 1, lod.first_index, 0, 0);
+			}
+		}
+		if (phase == 0) {
+			lod_triangles_drawn += lod.index_count / 3;
+			lod_triangles_full += scene_lods[0].index_count / 3;
+		}
+		frame_capture.draw_flags |= FRAME_DRAW_SCENE;
+	}
+
+	// The first phase also clears this frame's stats. Its barrier orders the previous frame's
+	// indirect draws and pyramid build before this frame's culling writes.
+	void DispatchCulling(VkCommandBuffer command_buffer, const PresentWindow& window, uint32_t phase) {
+		if (phase == 0) {
+			vkCmdFillBuffer(command_buffer, window.cull_stats_buffers[current_frame], 0, sizeof(CullStats), 0);
+
+			VkMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_layout, 0, 1, &window.cull_descriptor_sets[current_frame], 0, nullptr);
+		vkCmdPushConstants(command_buffer, cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phase), &phase);
+		vkCmdDispatch(command_buffer, (cull_object_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+		// The host reads the stats once the frame completed.
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	// The first phase resets both phases' meshlet draws and this frame's stats, once the
+	// previous frame's draws are done reading them. Each phase then waits for the object level
+	// culling of the same phase, whose draw decides whether it lists any meshlets.
+	void DispatchMeshletCulling(VkCommandBuffer command_buffer, const PresentWindow& window, uint32_t phase) {
+		if (phase == 0) {
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+			vkCmdFillBuffer(command_buffer, window.meshlet_draw_buffer, 0, VK_WHOLE_SIZE, 0);
+			vkCmdFillBuffer(command_buffer, window.meshlet_stats_buffers[current_frame], 0, sizeof(MeshletStats), 0);
+		}
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		const MeshletRange& range = scene_meshlet_ranges[scene_lod];
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshlet_cull_pipeline);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshlet_cull_pipeline_layout, 0, 1, &window.meshlet_cull_descriptor_sets[current_frame], 0, nullptr);
+		vkCmdPushConstants(command_buffer, meshlet_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phase), &phase);
+		vkCmdDispatch(command_buffer, (range.meshlet_count + MESHLET_WORKGROUP_SIZE - 1) / MESHLET_WORKGROUP_SIZE, 1, 1);
+
+		// The draw reads the command and the vertex shader the list; the host reads the stats
+		// once the frame completed.
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	// Reduces the depth of the first pass into the pyramid, a dispatch per level. Depth is read
+	// in place and handed back to the second pass.
+	void BuildDepthPyramid(VkCommandBuffer command_buffer, const PresentWindow& window) {
+		VkImageMemoryBarrier depth_barrier = {};
+		depth_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		depth_barrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depth_barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depth_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depth_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depth_barrier.image = window.depth_target.image;
+		depth_barrier.subresourceRange = { GetDepthAspectMask(), 0, 1, 0, 1 };
+		depth_barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depth_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		// Also keeps the writes to the pyramid behind the first phase's reads of it.
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &depth_barrier);
+
+		// Only the levels and texels over the rendered area of depth are built.
+		VkExtent2D source_extent = window.render_extent;
+		uint32_t levels = GetDepthPyramidLevelCount(window.render_extent);
+		for (uint32_t level = 0; level < levels; ++level) {
+			bool multisampled = level == 0 && msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+			VkExtent2D extent = GetDepthPyramidExtent(window.render_extent, level);
+			DepthReduce reduce = { source_extent.width, source_extent.height, extent.width, extent.height, static_cast<uint32_t>(msaa_samples) };
+
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, multisampled ? reduce_ms_pipeline : reduce_pipeline);
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, reduce_pipeline_layout, 0, 1, &window.reduce_descriptor_sets[level], 0, nullptr);
+			vkCmdPushConstants(command_buffer, reduce_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(reduce), &reduce);
+			vkCmdDispatch(command_buffer, (extent.width + DEPTH_REDUCE_GROUP_SIZE - 1) / DEPTH_REDUCE_GROUP_SIZE, (extent.height + DEPTH_REDUCE_GROUP_SIZE - 1) / DEPTH_REDUCE_GROUP_SIZE, 1);
+
+			// The next level, or after the last one the second culling phase, reads this one.
+			VkMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			source_extent = extent;
+		}
+
+		depth_barrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depth_barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depth_barrier.srcAccessMask = 0;
+		depth_barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &depth_barrier);
+	}
+
+	// HUD drawn over the scene with the immediate-mode batch: a graph of recent frame times,
+	// clipped to its frame, and OVERLAY_STRESS_QUADS filler quads.
+	void DrawOverlay(VkCommandBuffer command_buffer, VkExtent2D extent) {
+		VkPipeline overlay_pipeline = GetPipeline(GetProgramDesc(PROGRAM_OVERLAY));
+		if (overlay_pipeline == VK_NULL_HANDLE) {
+			return;
+		}
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, overlay_pipeline);
+		vkCmdBindIndexBuffer(command_buffer, overlay_index_buffer, 0, VK_INDEX_TYPE_UINT16);
+		overlay_command_buffer = command_buffer;
+		overlay_chunks_used = 0;
+		overlay_batch.Begin(extent);
+
+		const float graph_x = 10.0f;
+		const float graph_y = 10.0f;
+		const float graph_height = 60.0f;
+		const float bar_width = 2.0f;
+		float graph_width = bar_width * frame_times.size();
+		// Full graph height is twice the frame budget.
+		float budget = static_cast<float>(MAX_FRAME_RATE > 0.0 ? 1.0 / MAX_FRAME_RATE : 1.0 / 60.0);
+		float bar_scale = graph_height / (2.0f * budget);
+
+		overlay_batch.DrawQuad(graph_x, graph_y, graph_width, graph_height, PackColor(0.0f, 0.0f, 0.0f, 0.6f));
+		overlay_batch.SetScissor({ { static_cast<int32_t>(graph_x), static_cast<int32_t>(graph_y) }, { static_cast<uint32_t>(graph_width), static_cast<uint32_t>(graph_height) } });
+		for (uint32_t i = 0; i < frame_times.size(); ++i) {
+			float frame_time = frame_times[(frame_time_index + i) % frame_times.size()];
+			float bar_height = frame_time * bar_scale;
+			uint32_t color = frame_time <= budget ? PackColor(0.2f, 0.9f, 0.3f) : PackColor(0.9f, 0.2f, 0.2f);
+			overlay_batch.DrawQuad(graph_x + i * bar_width, graph_y + graph_height - bar_height, bar_width, bar_height, color);
+		}
+		overlay_batch.DrawLine(graph_x, graph_y + graph_height * 0.5f, graph_x + graph_width, graph_y + graph_height * 0.5f, 1.0f, PackColor(1.0f, 0.9f, 0.2f));
+		overlay_batch.SetScissor({ { 0, 0 }, extent });
+		overlay_batch.DrawRect(graph_x, graph_y, graph_width, graph_height, 1.0f, PackColor(1.0f, 1.0f, 1.0f, 0.8f));
+
+		uint32_t columns = std::max(extent.width / 4, 1u);
+		for (uint32_t i = 0; i < OVERLAY_STRESS_QUADS; ++i) {
+			float x = static_cast<float>(i % columns) * 4.0f;
+			float y = static_cast<float>(i / columns % std::max(extent.height / 4, 1u)) * 4.0f;
+			float shade = 0.5f + 0.5f * std::sin(animation_time + i * 0.01f);
+			overlay_batch.DrawQuad(x, y, 3.0f, 3.0f, PackColor(shade, 0.3f, 1.0f - shade, 0.25f));
+		}
+
+		overlay_batch.End();
+		frame_capture.overlay_quads = overlay_batch.GetQuadCount();
+		overlay_quads += overlay_batch.GetQuadCount();
+		overlay_draws += overlay_batch.GetDrawCount();
+		++overlay_frames;
+	}
+
+	void RecordComputeCommandBuffer(VkCommandBuffer command_buffer, uint32_t particle_index, bool acquire, const ParticleSimulation& simulation) {
+		vkResetCommandBuffer(command_buffer, 0);
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+			assert(0);
+		}
+
+		if (acquire) {
+			TransferParticleOwnership(command_buffer, particle_index, graphics_family, compute_family,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+		}
+
+		// The previous step on this queue may still be writing the particle state.
+		VkMemoryBarrier state_barrier = {};
+		state_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		state_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		state_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &state_barrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout, 0, 1, &compute_descriptor_sets[particle_index], 0, nullptr);
+		vkCmdPushConstants(command_buffer, compute_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(simulation), &simulation);
+		vkCmdDispatch(command_buffer, (PARTICLE_COUNT + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+
+		TransferParticleOwnership(command_buffer, particle_index, compute_family, graphics_family,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
 
-		VkSubmitInfo submit_info = {};
-		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submit_info.commandBufferCount = 1;
-		submit_info.pCommandBuffers = &command_buffer;
+		if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+			assert(0);
+		}
+	}
 
-		vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphics_queue);
+	// Records one half (release on the source queue or acquire on the destination queue) of a
+	// queue family ownership transfer of a particle vertex buffer. When compute and graphics
+	// share a family the semaphores between the submits already order the accesses.
+	void TransferParticleOwnership(VkCommandBuffer command_buffer, uint32_t particle_index, uint32_t src_family, uint32_t dst_family,
+		VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+		if (graphics_family == compute_family) {
+			return;
+		}
 
-		vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = src_access;
+		barrier.dstAccessMask = dst_access;
+		barrier.srcQueueFamilyIndex = src_family;
+		barrier.dstQueueFamilyIndex = dst_family;
+		barrier.buffer = particle_vertex_buffers[particle_index];
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
 	}
 
-	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& buffer_memory) {
-		VkBufferCreateInfo buffer_info = {};
-		buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		buffer_info.size = size;
-		buffer_info.usage = usage;
-		buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	// Binary semaphores remain only for acquire and present, which cannot take timeline ones.
+	// Everything else, between the queues and with the CPU, waits on the graphics and compute
+	// timelines, whose values only grow.
+	void CreateSemaphores() {
+		VkSemaphoreCreateInfo semaphore_info = {};
+		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		if (vkCreateBuffer(device, &buffer_info, nullptr, &buffer) != VK_SUCCESS) {
-			assert(0);
+		for (auto& window : windows) {
+			for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+				if (vkCreateSemaphore(device, &semaphore_info, allocator, &window.image_available_semaphores[i]) != VK_SUCCESS ||
+					vkCreateSemaphore(device, &semaphore_info, allocator, &window.render_finished_semaphores[i]) != VK_SUCCESS) {
+					assert(0);
+				}
+			}
 		}
 
-		VkMemoryRequirements mem_requirements;
-		vkGetBufferMemoryRequirements(device, buffer, &mem_requirements);
+		VkSemaphoreTypeCreateInfoKHR type_info = {};
+		type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		type_info.initialValue = 0;
 
-		VkMemoryAllocateInfo alloc_info = {};
-		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		alloc_info.allocationSize = mem_requirements.size;
-		alloc_info.memoryTypeIndex = FindMemoryType(mem_requirements.memoryTypeBits, properties);
+		VkSemaphoreCreateInfo timeline_info = {};
+		timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		timeline_info.pNext = &type_info;
 
-		if (vkAllocateMemory(device, &alloc_info, nullptr, &buffer_memory) != VK_SUCCESS) {
+		if (vkCreateSemaphore(device, &timeline_info, allocator, &graphics_timeline) != VK_SUCCESS ||
+			vkCreateSemaphore(device, &timeline_info, allocator, &compute_timeline) != VK_SUCCESS) {
 			assert(0);
 		}
-
-		vkBindBufferMemory(device, buffer, buffer_memory, 0);
 	}
 
-	void CreateDescriptorPool() {
-		VkDescriptorPoolSize pool_size = {};
-		pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		pool_size.descriptorCount = static_cast<uint32_t>(swap_chain_images.size());
+	// A begin and end timestamp per window and pass, for each frame in flight. Left off when the
+	// graphics queue cannot write timestamps.
+	void CreateGpuTimers() {
+		if (!GPU_PASS_TIMINGS) {
+			return;
+		}
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physical_device, &properties);
+		uint32_t queue_family_count;
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+		std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+		if (queue_families[graphics_family].timestampValidBits == 0) {
+			std::cout << "gpu timings: the graphics queue has no timestamps" << std::endl;
+			return;
+		}
+		gpu_timestamp_period = properties.limits.timestampPeriod;
 
-		VkDescriptorPoolCreateInfo pool_info = {};
-		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		pool_info.poolSizeCount = 1;
-		pool_info.pPoolSizes = &pool_size;
-		pool_info.maxSets = static_cast<uint32_t>(swap_chain_images.size());
-		if (vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+		VkQueryPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		pool_info.queryCount = GPU_TIMER_QUERIES * MAX_FRAMES_IN_FLIGHT;
+		if (vkCreateQueryPool(device, &pool_info, allocator, &gpu_timer_pool) != VK_SUCCESS) {
 			assert(0);
 		}
 	}
 
-	void CreateDescriptorSets() {
-		std::vector<VkDescriptorSetLayout> layouts(swap_chain_images.size(), descriptor_set_layout);
-		VkDescriptorSetAllocateInfo alloc_info = {};
-		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		alloc_info.descriptorPool = descriptor_pool;
-		alloc_info.descriptorSetCount = static_cast<uint32_t>(swap_chain_images.size());
-		alloc_info.pSetLayouts = layouts.data();
+	uint32_t GetGpuTimerQuery(const PresentWindow& window, GpuPass pass) {
+		uint32_t window_index = static_cast<uint32_t>(&window - windows.data());
+		return GPU_TIMER_QUERIES * current_frame + (window_index * GPU_PASS_COUNT + pass) * 2;
+	}
 
-		descriptor_sets.resize(swap_chain_images.size());
+	void BeginGpuTimer(VkCommandBuffer command_buffer, const PresentWindow& window, GpuPass pass) {
+		if (gpu_timer_pool == VK_NULL_HANDLE) {
+			return;
+		}
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, gpu_timer_pool, GetGpuTimerQuery(window, pass));
+	}
 
-		if (vkAllocateDescriptorSets(device, &alloc_info, descriptor_sets.data()) != VK_SUCCESS) {
-			assert(0);
+	void EndGpuTimer(VkCommandBuffer command_buffer, const PresentWindow& window, GpuPass pass) {
+		if (gpu_timer_pool == VK_NULL_HANDLE) {
+			return;
+		}
+		uint32_t query = GetGpuTimerQuery(window, pass);
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpu_timer_pool, query + 1);
+		gpu_timers_written[current_frame] |= 1ull << ((query % GPU_TIMER_QUERIES) / 2);
+	}
+
+	// Adds up the timers the frame that last used this frame in flight wrote, now complete.
+	// The scene's passes of all windows are what the resolution controller steers.
+	void CollectGpuTimings() {
+		uint64_t written = gpu_timers_written[current_frame];
+		gpu_timers_written[current_frame] = 0;
+		double scene_nanoseconds = 0.0;
+		for (uint32_t timer = 0; written != 0; ++timer, written >>= 1) {
+			if ((written & 1) == 0) {
+				continue;
+			}
+			std::array<uint64_t, 2> timestamps;
+			if (vkGetQueryPoolResults(device, gpu_timer_pool, GPU_TIMER_QUERIES * current_frame + timer * 2, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+				continue;
+			}
+			uint32_t pass = timer % GPU_PASS_COUNT;
+			double nanoseconds = (timestamps[1] - timestamps[0]) * gpu_timestamp_period;
+			gpu_pass_nanoseconds[pass] += nanoseconds;
+			++gpu_pass_samples[pass];
+			if (pass == GPU_PASS_LIGHT_CLUSTERS || pass == GPU_PASS_WINDOW) {
+				scene_nanoseconds += nanoseconds;
+			}
+		}
+		if (DYNAMIC_RESOLUTION && scene_nanoseconds > 0.0) {
+			resolution_controller.AddFrameTime(static_cast<float>(scene_nanoseconds / 1e6), frame_resolution_scales[current_frame]);
 		}
+	}
 
-		for (size_t i = 0; i < swap_chain_images.size(); ++i) {
-			VkDescriptorBufferInfo buffer_info = {};
-			buffer_info.buffer = uniform_buffers[i];
-			buffer_info.offset = 0;
-			buffer_info.range = sizeof(UniformBufferObject);
+	void CLeanupSwapChain(PresentWindow& window) {
+		for (auto framebuffer : window.framebuffers) {
+			vkDestroyFramebuffer(device, framebuffer, allocator);
+		}
+		for (auto framebuffer : window.upscale_framebuffers) {
+			vkDestroyFramebuffer(device, framebuffer, allocator);
+		}
 
-			VkWriteDescriptorSet descriptor_write = {};
-			descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptor_write.dstSet = descriptor_sets[i];
-			descriptor_write.dstBinding = 0;
-			descriptor_write.dstArrayElement = 0;
-			descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptor_write.descriptorCount = 1;
-			descriptor_write.pBufferInfo = &buffer_info;
-			descriptor_write.pImageInfo = nullptr;
-			descriptor_write.pTexelBufferView = nullptr;
+		DestroyTransientAttachment(window.color_target);
+		DestroyTransientAttachment(window.depth_target);
+		DestroyTransientAttachment(window.scene_color);
+		DestroyDepthPyramid(window);
 
-			vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
+		for (auto image_view : window.image_views) {
+			vkDestroyImageView(device, image_view, allocator);
 		}
+		vkDestroySwapchainKHR(device, window.swap_chain, allocator);
 	}
 
-	uint32_t FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties mem_properties;
-		vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+	// Rebuilds what is sized to the window. The render pass and pipelines are shared and stay:
+	// viewport and scissor are dynamic. A minimized primary window blocks here; other windows
+	// are left out of date and skipped until they are restored.
+	void RecreateSwapChain(PresentWindow& window) {
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(window.window, &width, &height);
+		while (&window == &windows[0] && (width == 0 || height == 0)) {
+			glfwWaitEvents();
+			glfwGetFramebufferSize(window.window, &width, &height);
+		}
+		if (width == 0 || height == 0) {
+			window.out_of_date = true;
+			return;
+		}
+		vkDeviceWaitIdle(device);
 
-		for (uint32_t i = 0; i < mem_properties.memoryTypeCount; ++i) {
-			if (type_filter & (1 << i) && (mem_properties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
+		ReportAttachmentMemory(window);
+		CLeanupSwapChain(window);
+
+		CreateSwapChain(window);
+		CreateImageViews(window);
+		CreateColorResources(window);
+		CreateDepthResources(window);
+		CreateFramebuffers(window);
+		if (OCCLUSION_CULLING) {
+			CreateDepthPyramid(window);
 		}
+		if (&window == &windows[0] && frame_exporter.IsOpen()) {
+			ResizeReadbackBuffers();
+		}
+		if (DYNAMIC_RESOLUTION) {
+			WriteUpscaleDescriptorSet(window);
+		}
+		window.out_of_date = false;
 
-		assert(0);
+		MarkDirty(DIRTY_RESIZE);
 	}
 
-	void CreateCommandBuffers() {
-		command_buffers.resize(swap_chain_framebuffers.size());
+	void MainLoop() {
+		double frame_interval = MAX_FRAME_RATE > 0.0 ? 1.0 / MAX_FRAME_RATE : 0.0;
+		double last_frame_time = -frame_interval;
+		double last_memory_report_time = glfwGetTime();
 
-		VkCommandBufferAllocateInfo alloc_info = {};
-		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		alloc_info.commandPool = command_pool;
-		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		alloc_info.commandBufferCount = (uint32_t)command_buffers.size();
+		if (FIXED_TIME_STEP <= 0.0) {
+			simulation.Start(clock);
+		}
+		if (SHADER_HOT_RELOAD) {
+			WatchShaderSources();
+		}
 
-		if (vkAllocateCommandBuffers(device, &alloc_info, command_buffers.data()) != VK_SUCCESS) {
-			assert(0);
+		if (!capture_options.capture_path.empty() && !capture_writer.Open(capture_options.capture_path, windows[0].extent)) {
+			std::cerr << "failed to open capture " << capture_options.capture_path << std::endl;
 		}
 
-		for (size_t i = 0; i < command_buffers.size(); ++i) {
-			VkCommandBufferBeginInfo begin_info = {};
-			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-			begin_info.pInheritanceInfo = nullptr;
+		while (!AnyWindowShouldClose()) {
+			double next_frame_time = last_frame_time + frame_interval;
+			WaitForEvents(next_frame_time);
 
-			if (vkBeginCommandBuffer(command_buffers[i], &begin_info) != VK_SUCCESS) {
-				assert(0);
+			// glfwGetTime only paces the loop; the simulation follows the injected clock.
+			double now = glfwGetTime();
+			if (animating || !RENDER_ON_DEMAND) {
+				MarkDirty(DIRTY_ANIMATION);
+			}
+			if (textures_decoded.exchange(false)) {
+				MarkDirty(DIRTY_UPLOAD);
+			}
+			if (SHADER_HOT_RELOAD) {
+				PollShaderSources();
+			}
+			if (pipelines_ready.exchange(false)) {
+				MarkDirty(DIRTY_PIPELINES);
+			}
+			if (dirty_flags == 0 || now < next_frame_time) {
+				continue;
 			}
 
-			VkRenderPassBeginInfo render_pass_info = {};
-			render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			render_pass_info.renderPass = render_pass;
-			render_pass_info.framebuffer = swap_chain_framebuffers[i];
-			render_pass_info.renderArea.offset = { 0,0 };
-			render_pass_info.renderArea.extent = swap_chain_extent;
+			clock.BeginFrame();
+			double clock_time = clock.Now();
+			if (FIXED_TIME_STEP > 0.0) {
+				simulation.AdvanceTo(clock_time);
+			}
+			SimulationState simulation_state = simulation.Sample(clock_time);
+			animation_time = static_cast<float>(simulation_state.time);
+			scene_rotation = static_cast<float>(simulation_state.rotation);
+
+			if (frame_number > 0) {
+				frame_times[frame_time_index] = static_cast<float>(now - last_frame_time);
+				frame_time_index = (frame_time_index + 1) % frame_times.size();
+			}
 
-			VkClearValue clear_color = { 0.0f, 0.0f, 0.0f, 1.0f };
-			render_pass_info.clearValueCount = 1;
-			render_pass_info.pClearValues = &clear_color;
+			// Cleared before drawing so that a swap chain recreation inside DrawFrame requests another frame.
+			dirty_flags = 0;
+			last_frame_time = now;
+			DrawCountedFrame();
+
+			if (MEMORY_REPORT_INTERVAL > 0.0 && now - last_memory_report_time >= MEMORY_REPORT_INTERVAL) {
+				memory_telemetry.Dump(std::cout);
+				std::cout << "vulkan: last frame";
+				WriteVulkanCallCounts(std::cout, vulkan_frame_counts, 1);
+				std::cout << std::endl;
+				last_memory_report_time = now;
+			}
+		}
+
+		simulation.Stop();
+		vkDeviceWaitIdle(device);
+		FinishFrameExport();
 
-			vkCmdBeginRenderPass(command_buffers[i], &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+		std::cout << "simulation: " << simulation.GetTickCount() << " ticks, " << simulation.GetDroppedTickCount() << " dropped" << std::endl;
+		if (capture_writer.IsOpen()) {
+			capture_writer.Close();
+			std::cout << "captured " << capture_writer.GetFrameCount() << " frames to " << capture_options.capture_path << std::endl;
+		}
+		ReportStatistics();
+	}
 
-			vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
+	// Renders every frame of the capture back to back without pacing. Inputs come from the
+	// log, so the same capture is the same workload on every build and the per-frame times can
+	// be compared across builds to bisect a regression. Each rendered frame is also checked
+	// against the capture to catch replays that stopped reproducing the captured work.
+	void ReplayCapture() {
+		std::vector<double> replay_times;
+		double last_frame_time = glfwGetTime();
+		bool frame_available = capture_reader.ReadFrame(replay_frame);
 
-			VkBuffer vertex_buffers[] = { vertex_buffer };
-			VkDeviceSize offsets[] = {0};
-			vkCmdBindVertexBuffers(command_buffers[i], 0, 1, vertex_buffers, offsets);
+		while (frame_available && !AnyWindowShouldClose()) {
+			glfwPollEvents();
+			ApplyReplayFrame();
+			if (!DrawCountedFrame()) {
+				// The swap chain was recreated; render the same frame again.
+				continue;
+			}
 
-			vkCmdBindIndexBuffer(command_buffers[i], index_buffer, 0, VK_INDEX_TYPE_UINT16);
+			double now = glfwGetTime();
+			replay_times.push_back(now - last_frame_time);
+			frame_times[frame_time_index] = static_cast<float>(now - last_frame_time);
+			frame_time_index = (frame_time_index + 1) % frame_times.size();
+			last_frame_time = now;
 
-			vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_sets[i], 0, nullptr);
+			++replay_frame_index;
+			frame_available = capture_reader.ReadFrame(replay_frame);
+		}
 
-			vkCmdDrawIndexed(command_buffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+		vkDeviceWaitIdle(device);
+		FinishFrameExport();
 
-			vkCmdEndRenderPass(command_buffers[i]);
+		ReportReplayTimings(replay_times);
+		ReportStatistics();
+	}
 
-			if (vkEndCommandBuffer(command_buffers[i]) != VK_SUCCESS) {
-				assert(0);
+	void ApplyReplayFrame() {
+		animation_time = replay_frame.animation_time;
+		scene_rotation = replay_frame.rotation;
+		if (camera.eye != replay_frame.camera_eye) {
+			camera.eye = replay_frame.camera_eye;
+			camera_dirty = true;
+		}
+		// Resized captures resize the window; the swap chain follows through the usual
+		// out of date path.
+		const VkExtent2D& extent = replay_frame.extent;
+		if ((extent.width != replay_window_extent.width || extent.height != replay_window_extent.height) && extent.width > 0 && extent.height > 0) {
+			if (extent.width != windows[0].extent.width || extent.height != windows[0].extent.height) {
+				glfwSetWindowSize(windows[0].window, static_cast<int>(extent.width), static_cast<int>(extent.height));
 			}
+			replay_window_extent = extent;
 		}
 	}
 
-	void CreateSemaphores() {
-		image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
+	void ReportReplayTimings(std::vector<double> replay_times) {
+		if (replay_times.empty()) {
+			std::cout << "replay: no frames rendered" << std::endl;
+			return;
+		}
 
-		VkSemaphoreCreateInfo semaphore_info = {};
-		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		if (!capture_options.timings_path.empty()) {
+			std::ofstream timings(capture_options.timings_path, std::ios::trunc);
+			timings << "frame,ms" << std::endl;
+			for (size_t i = 0; i < replay_times.size(); ++i) {
+				timings << i << "," << replay_times[i] * 1000.0 << "\n";
+			}
+		}
 
-		VkFenceCreateInfo fence_info = {};
-		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		double total = 0.0;
+		for (double time : replay_times) {
+			total += time;
+		}
+		std::sort(replay_times.begin(), replay_times.end());
+		auto percentile = [&replay_times](double fraction) {
+			return replay_times[std::min(static_cast<size_t>(fraction * replay_times.size()), replay_times.size() - 1)] * 1000.0;
+		};
+		std::cout << "replay: " << replay_times.size() << " frames in " << total << " s, ms per frame mean " << total * 1000.0 / replay_times.size()
+			<< " median " << percentile(0.5) << " p95 " << percentile(0.95) << " p99 " << percentile(0.99) << " max " << replay_times.back() * 1000.0 << std::endl;
+		if (replay_divergent_frames > 0) {
+			std::cout << "replay: " << replay_divergent_frames << " frames diverged from the capture, first at frame " << replay_first_divergent_frame << std::endl;
+		}
+	}
 
-		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-			if (vkCreateSemaphore(device, &semaphore_info, nullptr, &image_available_semaphores[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(device, &semaphore_info, nullptr, &render_finished_semaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(device, &fence_info, nullptr, &in_flight_fences[i]) != VK_SUCCESS) {
-				assert(0);
+	void ReportStatistics() {
+		for (const auto& window : windows) {
+			ReportAttachmentMemory(window);
+		}
+		UpdateMemoryBudget();
+		memory_telemetry.Dump(std::cout);
+		if (lod_triangles_full > 0) {
+			std::cout << "lod: " << lod_triangles_drawn << " of " << lod_triangles_full << " scene triangles drawn, "
+				<< 100.0 * (lod_triangles_full - lod_triangles_drawn) / lod_triangles_full << "% saved" << std::endl;
+		}
+		if (cull_passes > 0) {
+			std::cout << "occlusion: " << static_cast<double>(cull_drawn[0]) / cull_passes << " objects drawn by the first phase, "
+				<< static_cast<double>(cull_drawn[1]) / cull_passes << " by the second, " << static_cast<double>(cull_frustum_culled) / cull_passes << " frustum and "
+				<< static_cast<double>(cull_occlusion_culled) / cull_passes << " occlusion culled per window and frame" << std::endl;
+		}
+		if (meshlet_passes > 0) {
+			std::cout << "meshlets: " << static_cast<double>(meshlets_drawn) / meshlet_passes << " drawn, " << static_cast<double>(meshlets_frustum_culled) / meshlet_passes << " frustum and "
+				<< static_cast<double>(meshlets_cone_culled) / meshlet_passes << " backface cone culled per window and frame" << std::endl;
+		}
+		for (uint32_t pass = 0; pass < GPU_PASS_COUNT; ++pass) {
+			if (gpu_pass_samples[pass] > 0) {
+				std::cout << "gpu: " << GPU_PASS_NAMES[pass] << " " << gpu_pass_nanoseconds[pass] / gpu_pass_samples[pass] / 1e6 << " ms per window and frame" << std::endl;
+			}
+		}
+		if (DYNAMIC_RESOLUTION && resolution_frames > 0) {
+			std::cout << "dynamic resolution: " << resolution_scale_sum / resolution_frames << " average scale, " << resolution_controller.GetScale() << " last, "
+				<< resolution_controller.GetChangeCount() << " changes; " << resolution_controller.GetFullResolutionTime() << " ms per frame at full resolution" << std::endl;
+		}
+		if (overlay_frames > 0) {
+			std::cout << "overlay: " << overlay_quads / overlay_frames << " quads in " << static_cast<double>(overlay_draws) / overlay_frames << " draws per frame" << std::endl;
+		}
+		std::cout << "pipelines: " << pipeline_cache.GetHitCount() << " hits, " << pipeline_cache.GetMissCount() << " misses" << std::endl;
+		if (vulkan_frames > 0) {
+			std::cout << "vulkan: per frame";
+			WriteVulkanCallCounts(std::cout, vulkan_total_counts, vulkan_frames);
+			std::cout << std::endl;
+			std::cout << "vulkan: " << vulkan_frames_over_budget << " frames over budget";
+			if (vulkan_frames_over_budget > 0) {
+				std::cout << ", first at frame " << vulkan_first_frame_over_budget;
+			}
+			std::cout << "; driver host memory " << host_allocator.GetAllocationCount() << " allocations, "
+				<< host_allocator.GetLiveBytes() << " B live, " << host_allocator.GetPeakBytes() << " B peak, "
+				<< host_allocator.GetInternalBytes() << " B internal" << std::endl;
+			if (ARENA_HOST_ALLOCATIONS) {
+				std::cout << "vulkan: driver arenas " << driver_arenas.GetReservedBytes() << " B reserved, "
+					<< driver_arenas.GetHeapBlockCount() << " blocks too large for the pools" << std::endl;
 			}
 		}
 	}
 
-	void CLeanupSwapChain() {
-		vkFreeCommandBuffers(device, command_pool, static_cast<uint32_t>(command_buffers.size()), command_buffers.data());
+	void WaitForEvents(double next_frame_time) {
+		double now = glfwGetTime();
+		if (RENDER_ON_DEMAND && dirty_flags == 0 && !animating) {
+			if (SHADER_HOT_RELOAD) {
+				glfwWaitEventsTimeout(SHADER_POLL_INTERVAL);
+			}
+			else {
+				glfwWaitEvents();
+			}
+		}
+		else if (now < next_frame_time) {
+			glfwWaitEventsTimeout(next_frame_time - now);
+		}
+		else {
+			glfwPollEvents();
+		}
+	}
 
-		for (auto framebuffer : swap_chain_framebuffers) {
-			vkDestroyFramebuffer(device, framebuffer, nullptr);
+	// DrawFrame, with the Vulkan calls and driver host allocations the render thread made for
+	// it counted and checked against the frame budget.
+	bool DrawCountedFrame() {
+		// Whatever the thread did between frames, such as handling input, is not the frame's.
+		TakeVulkanCallCounts();
+		bool drawn = DrawFrame();
+		vulkan_frame_counts = TakeVulkanCallCounts();
+		vulkan_total_counts += vulkan_frame_counts;
+		++vulkan_frames;
+
+		if (vulkan_frames > VULKAN_FRAME_WARMUP) {
+			VulkanFrameBudget budget;
+			budget.max_calls[VULKAN_CALL_MAP_MEMORY] = 0;
+			budget.max_calls[VULKAN_CALL_UNMAP_MEMORY] = 0;
+			budget.max_calls[VULKAN_CALL_ALLOCATE_DESCRIPTOR_SETS] = 0;
+			std::ostringstream violations;
+			if (!CheckVulkanFrameBudget(vulkan_frame_counts, budget, &violations)) {
+				if (vulkan_frames_over_budget == 0) {
+					vulkan_first_frame_over_budget = vulkan_frames - 1;
+					std::cout << "vulkan: frame " << vulkan_first_frame_over_budget << " over budget:" << violations.str() << std::endl;
+					if (ASSERT_VULKAN_FRAME_BUDGET) {
+						assert(0);
+					}
+				}
+				++vulkan_frames_over_budget;
+			}
 		}
+		return drawn;
+	}
 
-		vkDestroyPipeline(device, graphics_pipeline, nullptr);
+	// Returns false when the swap chain had to be recreated before anything was submitted.
+	bool DrawFrame() {
+		// The frame in flight's command buffers are free again once both of its submits are done.
+		std::array<VkSemaphore, 2> timelines = { graphics_timeline, compute_timeline };
+		std::array<uint64_t, 2> frame_values = { frame_graphics_values[current_frame], frame_compute_values[current_frame] };
+		VkSemaphoreWaitInfoKHR wait_info = {};
+		wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		wait_info.semaphoreCount = static_cast<uint32_t>(timelines.size());
+		wait_info.pSemaphores = timelines.data();
+		wait_info.pValues = frame_values.data();
+		if (wait_semaphores(device, &wait_info, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS) {
+			assert(0);
+		}
+		if (OCCLUSION_CULLING) {
+			CollectCullStats();
+		}
+		if (MESHLET_GEOMETRY) {
+			CollectMeshletStats();
+		}
+		if (gpu_timer_pool != VK_NULL_HANDLE) {
+			CollectGpuTimings();
+		}
 
-		vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+		// The first window comes first: the frame is only recorded once it has an image. The
+		// others are left out of this frame while they are minimized or being recreated.
+		for (auto& window : windows) {
+			window.acquired = false;
+			if (window.out_of_date) {
+				RecreateSwapChain(window);
+				if (window.out_of_date) {
+					continue;
+				}
+			}
 
-		vkDestroyRenderPass(device, render_pass, nullptr);
+			VkResult result = vkAcquireNextImageKHR(device, window.swap_chain, std::numeric_limits<uint64_t>::max(), window.image_available_semaphores[current_frame], VK_NULL_HANDLE, &window.image_index);
+			if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+				RecreateSwapChain(window);
+				if (&window == &windows[0]) {
+					return false;
+				}
+				continue;
+			}
+			else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+				assert(0);
+			}
+			window.acquired = true;
+		}
 
-		for (auto image_view : swap_chain_image_views) {
-			vkDestroyImageView(device, image_view, nullptr);
+		BeginFrameCapture();
+		ReleaseCompletedFrames();
+		SwapReloadedShaders();
+		if (frame_number % MEMORY_BUDGET_POLL_FRAMES == 0) {
+			UpdateMemoryBudget();
 		}
-		vkDestroySwapchainKHR(device, swap_chain, nullptr);
-	}
+		UpdateRenderExtents();
+		UpdateUniformBuffer();
+
+		// This frame's simulation writes one vertex buffer while the graphics submit draws the
+		// other, written by the previous frame, so the two queues overlap.
+		uint32_t write_index = particle_frame % 2;
+		uint32_t read_index = 1 - write_index;
+		SubmitParticleSimulation(write_index);
+
+		bool draw_particles = particle_frame > 0;
+		RecordCommandBuffer(command_buffers[current_frame], draw_particles, read_index);
+		if (DYNAMIC_RESOLUTION) {
+			RecordUpscaleCommandBuffer(upscale_command_buffers[current_frame]);
+		}
+		++particle_frame;
+		EndFrameCapture();
 
-	void RecreateSwapChain() {
-		int width = 0, height = 0;
-		while (width == 0 || height == 0) {
-			glfwGetFramebufferSize(window, &width, &height);
-			glfwWaitEvents();
+		uint64_t frame_value = ++graphics_timeline_value;
+		frame_graphics_values[current_frame] = frame_value;
+		if (draw_particles) {
+			particles_drawn_values[read_index] = frame_value;
 		}
-		vkDeviceWaitIdle(device);
 
-		CLeanupSwapChain();
+		// One submit waits for every acquired image and signals every window's present
+		// semaphore; binary semaphores ignore their entries in the value arrays.
+		std::array<VkSemaphore, WINDOW_COUNT + 1> wait_semaphores;
+		std::array<uint64_t, WINDOW_COUNT + 1> wait_values;
+		std::array<VkPipelineStageFlags, WINDOW_COUNT + 1> wait_stages;
+		std::array<VkSemaphore, WINDOW_COUNT + 1> signal_semaphores;
+		std::array<uint64_t, WINDOW_COUNT + 1> signal_values;
+		std::array<VkSwapchainKHR, WINDOW_COUNT> swap_chains;
+		std::array<uint32_t, WINDOW_COUNT> image_indices;
+		std::array<PresentWindow*, WINDOW_COUNT> presented_windows;
+		uint32_t wait_count = 0;
+		uint32_t present_count = 0;
+		for (auto& window : windows) {
+			if (!window.acquired) {
+				continue;
+			}
+			wait_semaphores[wait_count] = window.image_available_semaphores[current_frame];
+			wait_values[wait_count] = 0;
+			wait_stages[wait_count] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			++wait_count;
+			signal_semaphores[present_count] = window.render_finished_semaphores[current_frame];
+			signal_values[present_count] = 0;
+			swap_chains[present_count] = window.swap_chain;
+			image_indices[present_count] = window.image_index;
+			presented_windows[present_count] = &window;
+			++present_count;
+		}
+		if (draw_particles) {
+			wait_semaphores[wait_count] = compute_timeline;
+			wait_values[wait_count] = particles_written_values[read_index];
+			wait_stages[wait_count] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+			++wait_count;
+		}
+		signal_semaphores[present_count] = graphics_timeline;
+		signal_values[present_count] = frame_value;
+
+		VkTimelineSemaphoreSubmitInfoKHR timeline_info = {};
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timeline_info.waitSemaphoreValueCount = wait_count;
+		timeline_info.pWaitSemaphoreValues = wait_values.data();
+		timeline_info.signalSemaphoreValueCount = present_count + 1;
+		timeline_info.pSignalSemaphoreValues = signal_values.data();
 
-		CreateSwapChain();
-		CreateImageViews();
-		CreateRenderPass();
-		CreateGraphicsPipeline();
-		CreateFramebuffers();
-		CreateCommandBuffers();
-	}
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = &timeline_info;
+		submit_info.waitSemaphoreCount = wait_count;
+		submit_info.pWaitSemaphores = wait_semaphores.data();
+		submit_info.pWaitDstStageMask = wait_stages.data();
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &command_buffers[current_frame];
+		submit_info.signalSemaphoreCount = present_count + 1;
+		submit_info.pSignalSemaphores = signal_semaphores.data();
+
+		// With dynamic resolution the scene is a batch of its own ahead of the upscale, and only
+		// the upscale waits for the acquired images, so the timings steering the resolution never
+		// include waiting for the presentation engine. Batches start in submission order and the
+		// upscale's signals cover everything submitted before them.
+		std::array<VkSubmitInfo, 2> submits = { submit_info, submit_info };
+		VkTimelineSemaphoreSubmitInfoKHR scene_timeline_info = timeline_info;
+		uint32_t submit_count = 1;
+		if (DYNAMIC_RESOLUTION) {
+			scene_timeline_info.waitSemaphoreValueCount = wait_count - present_count;
+			scene_timeline_info.pWaitSemaphoreValues = wait_values.data() + present_count;
+			scene_timeline_info.signalSemaphoreValueCount = 0;
+			scene_timeline_info.pSignalSemaphoreValues = nullptr;
+			submits[0].pNext = &scene_timeline_info;
+			submits[0].waitSemaphoreCount = wait_count - present_count;
+			submits[0].pWaitSemaphores = wait_semaphores.data() + present_count;
+			submits[0].pWaitDstStageMask = wait_stages.data() + present_count;
+			submits[0].signalSemaphoreCount = 0;
+			submits[0].pSignalSemaphores = nullptr;
+
+			timeline_info.waitSemaphoreValueCount = present_count;
+			submits[1].waitSemaphoreCount = present_count;
+			submits[1].pCommandBuffers = &upscale_command_buffers[current_frame];
+			submit_count = 2;
+		}
 
-	void MainLoop() {
-		while (!glfwWindowShouldClose(window)) {
-			glfwPollEvents();
-			DrawFrame();
+		if (vkQueueSubmit(graphics_queue, submit_count, submits.data(), VK_NULL_HANDLE) != VK_SUCCESS) {
+			assert(0);
 		}
 
-		vkDeviceWaitIdle(device);
+		// All windows in one present; each one's result tells whether it must be recreated.
+		std::array<VkResult, WINDOW_COUNT> present_results;
+		VkPresentInfoKHR present_info = {};
+		present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		present_info.waitSemaphoreCount = present_count;
+		present_info.pWaitSemaphores = signal_semaphores.data();
+		present_info.swapchainCount = present_count;
+		present_info.pSwapchains = swap_chains.data();
+		present_info.pImageIndices = image_indices.data();
+		present_info.pResults = present_results.data();
+
+		VkResult result = vkQueuePresentKHR(present_queue, &present_info);
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+			assert(0);
+		}
+		for (uint32_t i = 0; i < present_count; ++i) {
+			if (present_results[i] == VK_ERROR_OUT_OF_DATE_KHR || present_results[i] == VK_SUBOPTIMAL_KHR) {
+				RecreateSwapChain(*presented_windows[i]);
+			}
+			else if (present_results[i] != VK_SUCCESS) {
+				assert(0);
+			}
+		}
+
+		current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+		++frame_number;
+		return true;
 	}
 
-	void DrawFrame() {
-		vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	// frame_capture collects what the frame renders while it is recorded; StreamTextures adds
+	// the texture work.
+	void BeginFrameCapture() {
+		frame_capture.animation_time = animation_time;
+		frame_capture.rotation = scene_rotation;
+		frame_capture.camera_eye = camera.eye;
+		frame_capture.extent = windows[0].extent;
+		frame_capture.draw_flags = 0;
+		frame_capture.overlay_quads = 0;
+		frame_capture.registered_textures.clear();
+		frame_capture.uploads.clear();
+	}
 
-		uint32_t image_index;
-		VkResult result = vkAcquireNextImageKHR(device, swap_chain, std::numeric_limits<uint64_t>::max(), image_available_semaphores[current_frame], VK_NULL_HANDLE, &image_index);
-		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-			RecreateSwapChain();
-			return;
+	void EndFrameCapture() {
+		memcpy(&frame_capture.projection, windows[0].projection_uniforms.data.data(), sizeof(frame_capture.projection));
+		memcpy(&frame_capture.camera, camera_uniforms.data.data(), sizeof(frame_capture.camera));
+		memcpy(&frame_capture.object, object_uniforms.data.data(), sizeof(frame_capture.object));
+
+		if (capture_writer.IsOpen()) {
+			capture_writer.WriteFrame(frame_capture);
 		}
-		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-			assert(0);
+		if (replaying && frame_capture != replay_frame) {
+			if (replay_divergent_frames == 0) {
+				replay_first_divergent_frame = replay_frame_index;
+			}
+			++replay_divergent_frames;
 		}
+	}
 
-		UpdateUniformBuffer(image_index);
+	// Steps the simulation into particle_vertex_buffers[write_index] on the compute queue. The
+	// buffer was last drawn two frames ago, so past the first two frames the step waits on the
+	// graphics timeline for that draw and takes the buffer back from the graphics queue.
+	void SubmitParticleSimulation(uint32_t write_index) {
+		ParticleSimulation simulation = {};
+		simulation.delta_time = std::min(std::max(animation_time - particle_animation_time, 0.0f), MAX_PARTICLE_STEP);
+		simulation.particle_count = PARTICLE_COUNT;
+		simulation.reset = particle_frame == 0 ? 1 : 0;
+		particle_animation_time = animation_time;
+
+		bool reacquire = particle_frame >= 2;
+		RecordComputeCommandBuffer(compute_command_buffers[current_frame], write_index, reacquire, simulation);
+
+		uint64_t signal_value = ++compute_timeline_value;
+		frame_compute_values[current_frame] = signal_value;
+		particles_written_values[write_index] = signal_value;
+
+		VkTimelineSemaphoreSubmitInfoKHR timeline_info = {};
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timeline_info.waitSemaphoreValueCount = reacquire ? 1 : 0;
+		timeline_info.pWaitSemaphoreValues = &particles_drawn_values[write_index];
+		timeline_info.signalSemaphoreValueCount = 1;
+		timeline_info.pSignalSemaphoreValues = &signal_value;
 
 		VkSubmitInfo submit_info = {};
 		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = &timeline_info;
 
-		VkSemaphore wait_semaphores[] = { image_available_semaphores[current_frame] };
-		VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submit_info.waitSemaphoreCount = 1;
-		submit_info.pWaitSemaphores = wait_semaphores;
-		submit_info.pWaitDstStageMask = wait_stages;
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		submit_info.waitSemaphoreCount = reacquire ? 1 : 0;
+		submit_info.pWaitSemaphores = &graphics_timeline;
+		submit_info.pWaitDstStageMask = &wait_stage;
 		submit_info.commandBufferCount = 1;
-		submit_info.pCommandBuffers = &command_buffers[image_index];
-
-		VkSemaphore signal_semaphores[] = { render_finished_semaphores[current_frame] };
+		submit_info.pCommandBuffers = &compute_command_buffers[current_frame];
 		submit_info.signalSemaphoreCount = 1;
-		submit_info.pSignalSemaphores = signal_semaphores;
-
-		vkResetFences(device, 1, &in_flight_fences[current_frame]);
+		submit_info.pSignalSemaphores = &compute_timeline;
 
-		if (vkQueueSubmit(graphics_queue, 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
+		if (vkQueueSubmit(compute_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
 			assert(0);
 		}
+	}
 
-		VkPresentInfoKHR present_info = {};
-		present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		present_info.waitSemaphoreCount = 1;
-		present_info.pWaitSemaphores = signal_semaphores;
+	// Sizes this frame's scene to the resolution controller's scale. A pyramid built at another
+	// size does not line up with the new one, so the first culling phase skips it.
+	void UpdateRenderExtents() {
+		float scale = DYNAMIC_RESOLUTION ? resolution_controller.GetScale() : 1.0f;
+		for (auto& window : windows) {
+			VkExtent2D render_extent = GetScaledExtent(window.extent, scale);
+			if (render_extent.width != window.render_extent.width || render_extent.height != window.render_extent.height) {
+				window.render_extent = render_extent;
+				window.depth_pyramid_valid = false;
+			}
+		}
+		frame_resolution_scales[current_frame] = scale;
+		resolution_scale_sum += scale;
+		++resolution_frames;
+	}
 
-		VkSwapchainKHR swap_chains[] = { swap_chain };
-		present_info.swapchainCount = 1;
-		present_info.pSwapchains = swap_chains;
-		present_info.pImageIndices = &image_index;
-		present_info.pResults = nullptr;
+	// Each block is only recomputed when its inputs changed and only uploaded to images that
+	// have not seen the latest version.
+	void UpdateUniformBuffer() {
+		for (auto& window : windows) {
+			if (window.extent.width != window.projection_extent.width || window.extent.height != window.projection_extent.height) {
+				ProjectionUniforms projection = { ComputeProjection(window.extent) };
+				SetUniformBlock(window.projection_uniforms, projection);
+				window.projection_extent = window.extent;
+			}
+			UploadUniformBlock(window.projection_uniforms, current_frame);
 
-		result = vkQueuePresentKHR(present_queue, &present_info);
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-			RecreateSwapChain();
+			ClusterUniforms clusters = ComputeClusterUniforms(ComputeView(camera), ComputeProjection(window.extent), window.render_extent, LIGHT_COUNT, CLUSTERED_LIGHTING);
+			SetUniformBlock(window.cluster_uniforms, clusters);
+			UploadUniformBlock(window.cluster_uniforms, current_frame);
 		}
-		else if (result != VK_SUCCESS) {
-			assert(0);
+
+		if (camera_dirty) {
+			CameraUniforms view = { ComputeView(camera) };
+			SetUniformBlock(camera_uniforms, view);
+			camera_dirty = false;
 		}
 
-		current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+		if (scene_rotation != applied_scene_rotation) {
+			scene_transforms.SetRotation(quad_node, glm::angleAxis(scene_rotation, glm::vec3(0.0f, 0.0f, 1.0f)));
+			applied_scene_rotation = scene_rotation;
+		}
+		scene_transforms.Update();
+		if (scene_transforms.GetUpdatedNodeCount() > 0) {
+			ObjectUniforms object = { scene_transforms.GetWorldMatrix(quad_node) };
+			SetUniformBlock(object_uniforms, object);
+		}
+
+		UploadUniformBlock(camera_uniforms, current_frame);
+		UploadUniformBlock(object_uniforms, current_frame);
+
+		SelectSceneLod();
+		if (OCCLUSION_CULLING) {
+			UpdateCullUniforms();
+		}
+		if (MESHLET_GEOMETRY) {
+			UpdateMeshletCullUniforms();
+		}
 	}
 
-	void UpdateUniformBuffer(uint32_t current_image) {
-		static auto start_time = std::chrono::high_resolution_clock::now();
+	// The scene is the one quad, drawn at its selected level. Every acquired window builds a
+	// pyramid this frame, which the next frame tests against under this frame's view.
+	void UpdateCullUniforms() {
+		glm::mat4 model = scene_transforms.GetWorldMatrix(quad_node);
+		float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+		const MeshLod& lod = scene_lods[scene_lod];
+
+		CullUniforms cull = {};
+		cull.view = ComputeView(camera);
+		cull.objects[0].sphere = glm::vec4(glm::vec3(model * glm::vec4(scene_bounds_center, 1.0f)), scene_bounds_radius * scale);
+		cull.objects[0].index_count = lod.index_count;
+		cull.objects[0].first_index = lod.first_index;
+		cull.object_count = 1;
+		cull_object_count = cull.object_count;
+
+		for (auto& window : windows) {
+			glm::mat4 proj = ComputeProjection(window.extent);
+			cull.pyramid_view = window.depth_pyramid_view_matrix;
+			cull.projection = GetCullProjection(proj);
+			cull.pyramid_projection = GetCullProjection(window.depth_pyramid_projection);
+			cull.depth_width = window.render_extent.width;
+			cull.depth_height = window.render_extent.height;
+			cull.pyramid_levels = GetDepthPyramidLevelCount(window.render_extent);
+			cull.pyramid_valid = window.depth_pyramid_valid ? 1 : 0;
+			SetUniformBlock(window.cull_uniforms, cull);
+			UploadUniformBlock(window.cull_uniforms, current_frame);
+
+			if (window.acquired) {
+				window.depth_pyramid_view_matrix = cull.view;
+				window.depth_pyramid_projection = proj;
+				window.depth_pyramid_valid = true;
+				window.cull_stats_pending[current_frame] = true;
+			}
+		}
+	}
+
+	// The selected level's meshlets against every window's frustum, in world space.
+	void UpdateMeshletCullUniforms() {
+		glm::mat4 model = scene_transforms.GetWorldMatrix(quad_node);
+		const MeshletRange& range = scene_meshlet_ranges[scene_lod];
+		glm::mat4 view = ComputeView(camera);
+
+		MeshletCullUniforms cull = {};
+		cull.model = model;
+		cull.camera_position = glm::vec4(camera.eye, 1.0f);
+		cull.scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+		cull.first_meshlet = range.first_meshlet;
+		cull.meshlet_count = range.meshlet_count;
+		cull.visible_capacity = scene_meshlet_capacity;
+		cull.cone_culling = MESHLET_CONE_CULLING ? 1 : 0;
+		cull.object_culling = OCCLUSION_CULLING ? 1 : 0;
+
+		for (auto& window : windows) {
+			cull.frustum_planes = ExtractFrustumPlanes(ComputeProjection(window.extent) * view);
+			SetUniformBlock(window.meshlet_cull_uniforms, cull);
+			UploadUniformBlock(window.meshlet_cull_uniforms, current_frame);
+			if (window.acquired) {
+				window.meshlet_stats_pending[current_frame] = true;
+			}
+		}
+	}
 
-		auto current_time = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
+	void CollectMeshletStats() {
+		for (auto& window : windows) {
+			if (!window.meshlet_stats_pending[current_frame]) {
+				continue;
+			}
+			const MeshletStats& stats = *window.meshlet_stats_mapped[current_frame];
+			meshlets_drawn += stats.drawn;
+			meshlets_frustum_culled += stats.frustum_culled;
+			meshlets_cone_culled += stats.cone_culled;
+			++meshlet_passes;
+			window.meshlet_stats_pending[current_frame] = false;
+		}
+	}
 
-		UniformBufferObject ubo = {};
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.proj = glm::perspective(glm::radians(45.0f), swap_chain_extent.width / (float)swap_chain_extent.height, 0.1f, 10.0f);
-		ubo.proj[1][1] *= -1;
+	// Adds up the stats of the frame that last used this frame in flight, now complete.
+	void CollectCullStats() {
+		for (auto& window : windows) {
+			if (!window.cull_stats_pending[current_frame]) {
+				continue;
+			}
+			const CullStats& stats = *window.cull_stats_mapped[current_frame];
+			cull_drawn[0] += stats.drawn[0];
+			cull_drawn[1] += stats.drawn[1];
+			cull_frustum_culled += stats.frustum_culled;
+			cull_occlusion_culled += stats.occlusion_culled;
+			++cull_passes;
+			window.cull_stats_pending[current_frame] = false;
+		}
+	}
 
-		void* data;
-		vkMapMemory(device, uniform_buffers_memory[current_image], 0, sizeof(ubo), 0, &data);
-		memcpy(data, &ubo, sizeof(ubo));
-		vkUnmapMemory(device, uniform_buffers_memory[current_image]);
+	// The quad's level follows its size in the first window; other windows draw the same one.
+	void SelectSceneLod() {
+		glm::mat4 model_view = ComputeView(camera) * scene_transforms.GetWorldMatrix(quad_node);
+		float screen_size = ComputeScreenSize(ComputeProjection(windows[0].extent), model_view, scene_bounds_center, scene_bounds_radius);
+		scene_lod = SelectMeshLod(screen_size, scene_lod, static_cast<uint32_t>(scene_lods.size()), LOD_SCREEN_SIZE, LOD_HYSTERESIS);
 	}
 
 	void Cleanup() {
-		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-			vkDestroySemaphore(device, render_finished_semaphores[i], nullptr);
-			vkDestroySemaphore(device, image_available_semaphores[i], nullptr);
-			vkDestroyFence(device, in_flight_fences[i], nullptr);
+		// Finishes the decode and pipeline jobs before anything they write to, or glfw, goes away.
+		jobs.Wait(texture_decode_jobs);
+		jobs.Wait(pipeline_jobs);
+
+		// Only pipelines of the shaders on disk are worth building next run.
+		std::vector<PipelineDesc> compiled_descs;
+		pipeline_cache.GetCompiledDescs(compiled_descs);
+		compiled_descs.erase(std::remove_if(compiled_descs.begin(), compiled_descs.end(), [this](const PipelineDesc& desc) {
+			return desc.shader_hash != shader_code[desc.program]->hash;
+		}), compiled_descs.end());
+		if (!SavePipelinePrewarmList(PIPELINE_PREWARM_FILE, compiled_descs)) {
+			std::cerr << "failed to write " << PIPELINE_PREWARM_FILE << std::endl;
+		}
+
+		for (auto& window : windows) {
+			for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+				vkDestroySemaphore(device, window.render_finished_semaphores[i], allocator);
+				vkDestroySemaphore(device, window.image_available_semaphores[i], allocator);
+			}
+			CLeanupSwapChain(window);
+			DestroyUniformBlock(window.projection_uniforms);
+			if (OCCLUSION_CULLING) {
+				DestroyCullingBuffers(window);
+			}
+			if (MESHLET_GEOMETRY) {
+				DestroyMeshletBuffers(window);
+			}
+			DestroyUniformBlock(window.cluster_uniforms);
+			vkDestroyBuffer(device, window.cluster_light_buffer, allocator);
+			FreeMemory(window.cluster_light_memory);
+		}
+		vkDestroyBuffer(device, light_buffer, allocator);
+		FreeMemory(light_buffer_memory);
+		vkDestroyPipeline(device, light_cluster_pipeline, allocator);
+		vkDestroyPipelineLayout(device, light_cluster_pipeline_layout, allocator);
+		if (gpu_timer_pool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, gpu_timer_pool, allocator);
+		}
+		vkDestroyRenderPass(device, render_pass, allocator);
+		if (OCCLUSION_CULLING) {
+			vkDestroyRenderPass(device, late_render_pass, allocator);
+			vkDestroyPipeline(device, reduce_pipeline, allocator);
+			if (reduce_ms_pipeline != VK_NULL_HANDLE) {
+				vkDestroyPipeline(device, reduce_ms_pipeline, allocator);
+			}
+			vkDestroyPipeline(device, cull_pipeline, allocator);
+			vkDestroyPipelineLayout(device, reduce_pipeline_layout, allocator);
+			vkDestroyPipelineLayout(device, cull_pipeline_layout, allocator);
+			vkDestroyDescriptorSetLayout(device, reduce_descriptor_set_layout, allocator);
+			vkDestroyDescriptorSetLayout(device, cull_descriptor_set_layout, allocator);
+			vkDestroySampler(device, depth_pyramid_sampler, allocator);
+		}
+		if (DYNAMIC_RESOLUTION) {
+			vkDestroyRenderPass(device, upscale_render_pass, allocator);
+			vkDestroyPipeline(device, upscale_pipeline, allocator);
+			vkDestroyPipelineLayout(device, upscale_pipeline_layout, allocator);
+			vkDestroyDescriptorSetLayout(device, upscale_descriptor_set_layout, allocator);
+			vkDestroySampler(device, upscale_sampler, allocator);
+		}
+		if (MESHLET_GEOMETRY) {
+			vkDestroyPipeline(device, meshlet_cull_pipeline, allocator);
+			vkDestroyPipelineLayout(device, meshlet_cull_pipeline_layout, allocator);
+			vkDestroyDescriptorSetLayout(device, meshlet_cull_descriptor_set_layout, allocator);
+			vkDestroyBuffer(device, meshlet_buffer, allocator);
+			FreeMemory(meshlet_buffer_memory);
+			vkDestroyBuffer(device, meshlet_vertex_buffer, allocator);
+			FreeMemory(meshlet_vertex_buffer_memory);
+			vkDestroyBuffer(device, meshlet_triangle_buffer, allocator);
+			FreeMemory(meshlet_triangle_buffer_memory);
 		}
+		vkDestroySemaphore(device, graphics_timeline, allocator);
+		vkDestroySemaphore(device, compute_timeline, allocator);
 
-		CLeanupSwapChain();
+		for (size_t i = 0; i < particle_vertex_buffers.size(); ++i) {
+			vkDestroyBuffer(device, particle_vertex_buffers[i], allocator);
+			FreeMemory(particle_vertex_buffers_memory[i]);
+		}
+		vkDestroyBuffer(device, particle_state_buffer, allocator);
+		FreeMemory(particle_state_buffer_memory);
 
-		vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+		vkDestroyDescriptorPool(device, descriptor_pool, allocator);
 
-		vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptor_set_layout, allocator);
+		vkDestroyDescriptorSetLayout(device, texture_descriptor_set_layout, allocator);
+		vkDestroyDescriptorSetLayout(device, light_descriptor_set_layout, allocator);
+		vkDestroyDescriptorSetLayout(device, meshlet_descriptor_set_layout, allocator);
 
-		for (size_t i = 0; i < swap_chain_images.size(); ++i) {
-			vkDestroyBuffer(device, uniform_buffers[i], nullptr);
-			vkFreeMemory(device, uniform_buffers_memory[i], nullptr);
+		for (const auto& retired : retired_images) {
+			DestroyImage(retired.image, retired.memory, retired.view);
+		}
+		std::vector<VkPipeline> cached_pipelines;
+		pipeline_cache.RemoveIf([](const PipelineDesc&) { return true; }, cached_pipelines);
+		for (VkPipeline pipeline : cached_pipelines) {
+			vkDestroyPipeline(device, pipeline, allocator);
+		}
+		for (const auto& retired : retired_pipelines) {
+			vkDestroyPipeline(device, retired.pipeline, allocator);
+		}
+		vkDestroyPipelineLayout(device, pipeline_layout, allocator);
+		for (const auto& texture : textures) {
+			if (texture.image != VK_NULL_HANDLE) {
+				DestroyImage(texture.image, texture.memory, texture.view);
+			}
+		}
+		DestroyImage(placeholder_texture.image, placeholder_texture.memory, placeholder_texture.view);
+		vkDestroySampler(device, texture_sampler, allocator);
+
+		vkUnmapMemory(device, staging_ring_memory);
+		vkDestroyBuffer(device, staging_ring_buffer, allocator);
+		FreeMemory(staging_ring_memory);
+		for (auto& slot : readback_slots) {
+			DestroyReadbackSlot(slot);
 		}
 
-		vkDestroyBuffer(device, index_buffer, nullptr);
-		vkFreeMemory(device, index_buffer_memory, nullptr);
+		vkDestroyPipeline(device, compute_pipeline, allocator);
+		vkDestroyPipelineLayout(device, compute_pipeline_layout, allocator);
+		vkDestroyDescriptorSetLayout(device, compute_descriptor_set_layout, allocator);
+
+		DestroyUniformBlock(camera_uniforms);
+		DestroyUniformBlock(object_uniforms);
+
+		vkDestroyBuffer(device, index_buffer, allocator);
+		FreeMemory(index_buffer_memory);
 
-		vkDestroyBuffer(device, vertex_buffer, nullptr);
-		vkFreeMemory(device, vertex_buffer_memory, nullptr);
+		for (const auto& chunks : overlay_chunks) {
+			for (const auto& chunk : chunks) {
+				vkUnmapMemory(device, chunk.memory);
+				vkDestroyBuffer(device, chunk.buffer, allocator);
+				FreeMemory(chunk.memory);
+			}
+		}
+		vkDestroyBuffer(device, overlay_index_buffer, allocator);
+		FreeMemory(overlay_index_buffer_memory);
 
-		vkDestroyCommandPool(device, command_pool, nullptr);
+		vkDestroyBuffer(device, vertex_buffer, allocator);
+		FreeMemory(vertex_buffer_memory);
 
-		vkDestroyDevice(device, nullptr);
+		vkDestroyCommandPool(device, command_pool, allocator);
+		vkDestroyCommandPool(device, compute_command_pool, allocator);
+
+		vkDestroyDevice(device, allocator);
 
 		if (enable_validation_layers) {
-			DestroyDebugUtilsMessengerEXT(instance, callback, nullptr);
+			DestroyDebugUtilsMessengerEXT(instance, callback, allocator);
 		}
 
-		vkDestroySurfaceKHR(instance, surface, nullptr);
+		for (const auto& window : windows) {
+			vkDestroySurfaceKHR(instance, window.surface, allocator);
+		}
 
-		vkDestroyInstance(instance, nullptr);
+		vkDestroyInstance(instance, allocator);
 		
-		glfwDestroyWindow(window);
+		for (const auto& window : windows) {
+			glfwDestroyWindow(window.window);
+		}
 
 		glfwTerminate();
 	}
 
-	GLFWwindow* window;
+	std::vector<PresentWindow> windows;
+	// Counts the driver's host allocations and hands them on to the arenas. Every Vulkan object
+	// is created and destroyed with it, so it is declared before all of them.
+	ArenaHostAllocator driver_arenas;
+	CountingAllocator host_allocator{ ARENA_HOST_ALLOCATIONS ? driver_arenas.GetCallbacks() : nullptr };
+	const VkAllocationCallbacks* allocator = host_allocator.GetCallbacks();
+	// Temporaries of the main thread, such as the results of device and surface queries.
+	LinearArena scratch_arena;
 	VkInstance instance;
 	VkDebugUtilsMessengerEXT callback;
-	VkSurfaceKHR surface;
 	VkQueue present_queue;
 	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
 	VkDevice device;
 	VkQueue graphics_queue;
-	VkSwapchainKHR swap_chain;
-	std::vector<VkImage> swap_chain_images;
-	VkFormat swap_chain_image_format;
-	VkExtent2D swap_chain_extent;
-	std::vector<VkImageView> swap_chain_image_views;
+	VkQueue compute_queue;
+	uint32_t graphics_family;
+	uint32_t compute_family;
+	// Format of every window's swap chain, and of the render pass they share.
+	VkFormat swap_chain_image_format = VK_FORMAT_UNDEFINED;
+	VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+	VkFormat depth_format;
+	VkFormat texture_format;
+	bool physical_device_properties2 = false;
+	bool memory_budget = false;
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_memory_properties2 = nullptr;
+	MemoryTelemetry memory_telemetry;
 	VkRenderPass render_pass;
+	// Second scene pass of occlusion culling, continuing render_pass.
+	VkRenderPass late_render_pass = VK_NULL_HANDLE;
+	// Dynamic resolution's pass from the scene color into the swap chain image.
+	VkRenderPass upscale_render_pass = VK_NULL_HANDLE;
+	VkDescriptorSetLayout upscale_descriptor_set_layout;
+	VkPipelineLayout upscale_pipeline_layout;
+	VkPipeline upscale_pipeline;
+	VkSampler upscale_sampler;
 	VkDescriptorSetLayout descriptor_set_layout;
+	VkDescriptorSetLayout texture_descriptor_set_layout;
+	VkDescriptorSetLayout light_descriptor_set_layout;
+	VkDescriptorSetLayout meshlet_descriptor_set_layout;
 	VkPipelineLayout pipeline_layout;
-	VkPipeline graphics_pipeline;
-	std::vector<VkFramebuffer> swap_chain_framebuffers;
+	PipelineCache pipeline_cache;
+	std::array<std::shared_ptr<const ShaderCode>, PROGRAM_COUNT> shader_code;
+	// Pipeline compiles and shader reloads.
+	JobCounter pipeline_jobs;
+	// Set by jobs when a pipeline or reload finished, so an idle loop still renders it.
+	std::atomic<bool> pipelines_ready{ false };
+	bool additive_particles = false;
+	VkDescriptorSetLayout compute_descriptor_set_layout;
+	VkPipelineLayout compute_pipeline_layout;
+	VkPipeline compute_pipeline;
+	VkDescriptorSetLayout reduce_descriptor_set_layout;
+	VkDescriptorSetLayout cull_descriptor_set_layout;
+	VkPipelineLayout reduce_pipeline_layout;
+	VkPipelineLayout cull_pipeline_layout;
+	VkPipeline reduce_pipeline;
+	// Only with MSAA: builds the first level from the multisampled depth.
+	VkPipeline reduce_ms_pipeline = VK_NULL_HANDLE;
+	VkPipeline cull_pipeline;
+	VkSampler depth_pyramid_sampler;
+	VkDescriptorSetLayout meshlet_cull_descriptor_set_layout;
+	VkPipelineLayout meshlet_cull_pipeline_layout;
+	VkPipeline meshlet_cull_pipeline;
+	VkPipelineLayout light_cluster_pipeline_layout;
+	VkPipeline light_cluster_pipeline;
+	VkBuffer light_buffer;
+	VkDeviceMemory light_buffer_memory;
+	// Null without GPU_PASS_TIMINGS or timestamp support. Bit i of a frame's mask is set once
+	// the frame wrote timer i (window i / GPU_PASS_COUNT, pass i % GPU_PASS_COUNT).
+	VkQueryPool gpu_timer_pool = VK_NULL_HANDLE;
+	float gpu_timestamp_period = 1.0f;
+	std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> gpu_timers_written = {};
+	std::array<double, GPU_PASS_COUNT> gpu_pass_nanoseconds = {};
+	std::array<uint64_t, GPU_PASS_COUNT> gpu_pass_samples = {};
+	// Scale of the scene at each window's size, and the scale each frame in flight rendered at.
+	ResolutionController resolution_controller{ DYNAMIC_RESOLUTION_TARGET, DYNAMIC_RESOLUTION_MIN_SCALE, 1.0f };
+	std::array<float, MAX_FRAMES_IN_FLIGHT> frame_resolution_scales = {};
+	double resolution_scale_sum = 0.0;
+	uint64_t resolution_frames = 0;
+	uint32_t cull_object_count = 0;
+	// Occlusion culling totals over all windows and frames.
+	uint64_t cull_passes = 0;
+	std::array<uint64_t, 2> cull_drawn = {};
+	uint64_t cull_frustum_culled = 0;
+	uint64_t cull_occlusion_culled = 0;
+	// Meshlet culling totals over all windows and frames.
+	uint64_t meshlet_passes = 0;
+	uint64_t meshlets_drawn = 0;
+	uint64_t meshlets_frustum_culled = 0;
+	uint64_t meshlets_cone_culled = 0;
+	// Vulkan calls and host allocations of DrawFrame: the last frame, and the totals.
+	VulkanCallCounts vulkan_frame_counts;
+	VulkanCallCounts vulkan_total_counts;
+	uint64_t vulkan_frames = 0;
+	uint64_t vulkan_frames_over_budget = 0;
+	uint64_t vulkan_first_frame_over_budget = 0;
 	VkCommandPool command_pool;
+	VkCommandPool compute_command_pool;
 	VkBuffer vertex_buffer;
 	VkDeviceMemory vertex_buffer_memory;
 	VkBuffer index_buffer;
 	VkDeviceMemory index_buffer_memory;
+
+	// The quad's grid and its LOD chain, and the level it is drawn with.
+	std::vector<Vertex> scene_vertices;
+	std::vector<uint16_t> scene_indices;
+	std::vector<MeshLod> scene_lods;
+	glm::vec3 scene_bounds_center;
+	float scene_bounds_radius = 0.0f;
+	uint32_t scene_lod = 0;
+	// Meshlets of every level, their range per level and the most any level has.
+	MeshletMesh scene_meshlets;
+	std::vector<MeshletRange> scene_meshlet_ranges;
+	uint32_t scene_meshlet_capacity = 0;
+	VkBuffer meshlet_buffer;
+	VkDeviceMemory meshlet_buffer_memory;
+	VkBuffer meshlet_vertex_buffer;
+	VkDeviceMemory meshlet_vertex_buffer_memory;
+	VkBuffer meshlet_triangle_buffer;
+	VkDeviceMemory meshlet_triangle_buffer_memory;
+	// Triangles the selected levels drew, and what level 0 would have drawn instead.
+	uint64_t lod_triangles_drawn = 0;
+	uint64_t lod_triangles_full = 0;
 	VkDescriptorPool descriptor_pool;
-	std::vector<VkDescriptorSet> descriptor_sets;
-	std::vector<VkBuffer> uniform_buffers;
-	std::vector<VkDeviceMemory> uniform_buffers_memory;
+	UniformBlock camera_uniforms;
+	UniformBlock object_uniforms;
 	std::vector<VkCommandBuffer> command_buffers;
-	std::vector<VkSemaphore> image_available_semaphores;
-	std::vector<VkSemaphore> render_finished_semaphores;
-	std::vector<VkFence> in_flight_fences;
+	std::vector<VkCommandBuffer> compute_command_buffers;
+	std::vector<VkCommandBuffer> upscale_command_buffers;
+	VkBuffer particle_state_buffer;
+	VkDeviceMemory particle_state_buffer_memory;
+	std::array<VkBuffer, 2> particle_vertex_buffers;
+	std::array<VkDeviceMemory, 2> particle_vertex_buffers_memory;
+	std::array<VkDescriptorSet, 2> compute_descriptor_sets;
+	// Indexed like particle_vertex_buffers: compute timeline value of the step that wrote the
+	// buffer, and graphics timeline value of the frame that last drew it.
+	std::array<uint64_t, 2> particles_written_values = {};
+	std::array<uint64_t, 2> particles_drawn_values = {};
+	uint64_t particle_frame = 0;
+	float particle_animation_time = 0.0f;
+	// One timeline per queue. *_timeline_value is the last value submitted; each frame in
+	// flight remembers the values its submits signal.
+	VkSemaphore graphics_timeline;
+	VkSemaphore compute_timeline;
+	uint64_t graphics_timeline_value = 0;
+	uint64_t compute_timeline_value = 0;
+	std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frame_graphics_values = {};
+	std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frame_compute_values = {};
+	PFN_vkWaitSemaphoresKHR wait_semaphores = nullptr;
+	PFN_vkGetSemaphoreCounterValueKHR get_semaphore_counter_value = nullptr;
 	size_t current_frame = 0;
+	uint32_t dirty_flags = 0;
+	bool animating = true;
+	// Simulated time and quad rotation sampled from the simulation for the current frame.
+	float animation_time = 0.0f;
+	float scene_rotation = 0.0f;
+	Clock& clock;
+	JobSystem jobs{ JOB_WORKER_COUNT > 0 ? JOB_WORKER_COUNT : JobSystem::GetDefaultWorkerCount(), PIN_JOB_THREADS };
+	Simulation simulation{ 1.0 / SIMULATION_TICK_RATE, { 0.0, 0.0, QUAD_ROTATION_SPEED } };
+	Camera camera = { glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+	float camera_yaw = glm::radians(45.0f);
+	bool camera_dirty = true;
+	TransformHierarchy scene_transforms;
+	uint32_t quad_node;
+	// NaN so the first frame always writes the object transform.
+	float applied_scene_rotation = std::numeric_limits<float>::quiet_NaN();
+	uint64_t frame_number = 0;
+	std::vector<StreamedTexture> textures;
+	// Indices into textures that finished decoding, in registration order.
+	std::vector<uint32_t> residency_textures;
+	// Lists StreamTextures refills every frame, kept so their capacity is reused.
+	std::vector<uint32_t> stream_evicted;
+	std::vector<uint32_t> stream_pending;
+	std::vector<uint64_t> stream_level_sizes;
+	StreamedTexture placeholder_texture;
+	TextureResidency texture_residency{ TEXTURE_BUDGET };
+	StagingRing staging_ring{ STAGING_RING_SIZE };
+	VkBuffer staging_ring_buffer;
+	VkDeviceMemory staging_ring_memory;
+	void* staging_ring_mapped;
+	VkSampler texture_sampler;
+	std::vector<VkDescriptorSet> texture_descriptor_sets;
+	// Bumped whenever a texture image is replaced; each frame's set is rewritten when behind.
+	uint64_t texture_version = 1;
+	std::vector<uint64_t> texture_descriptor_versions;
+	std::vector<RetiredImage> retired_images;
+	std::mutex decoded_textures_mutex;
+	std::vector<DecodedTexture> decoded_textures;
+	// Notified with decoded_textures_mutex released whenever a worker adds to decoded_textures.
+	std::condition_variable decoded_textures_condition;
+	std::atomic<bool> textures_decoded{ false };
+	JobCounter texture_decode_jobs;
+	ShaderWatcher shader_watcher;
+	std::vector<std::string> changed_shader_sources;
+	std::array<bool, PROGRAM_COUNT> shader_reload_running = {};
+	std::array<bool, PROGRAM_COUNT> shader_reload_queued = {};
+	std::mutex reloaded_programs_mutex;
+	std::vector<ReloadedProgram> reloaded_programs;
+	std::vector<RetiredPipeline> retired_pipelines;
+	VkBuffer overlay_index_buffer;
+	VkDeviceMemory overlay_index_buffer_memory;
+	// Indexed by frame in flight.
+	std::vector<std::vector<OverlayChunk>> overlay_chunks;
+	uint32_t overlay_chunks_used = 0;
+	// Command buffer the overlay's draws are recorded into while DrawOverlay runs.
+	VkCommandBuffer overlay_command_buffer = VK_NULL_HANDLE;
+	QuadBatch overlay_batch{ *this };
+	// Seconds between rendered frames, oldest at frame_time_index.
+	std::array<float, 120> frame_times = {};
+	uint32_t frame_time_index = 0;
+	uint64_t overlay_quads = 0;
+	uint64_t overlay_draws = 0;
+	uint64_t overlay_frames = 0;
+	CaptureOptions capture_options;
+	// Filled in while each frame is recorded, then written to the capture or checked against the replay.
+	CapturedFrame frame_capture;
+	FrameCaptureWriter capture_writer;
+	FrameCaptureReader capture_reader;
+	bool replaying = false;
+	CapturedFrame replay_frame;
+	uint64_t replay_frame_index = 0;
+	VkExtent2D replay_window_extent = {};
+	uint64_t replay_divergent_frames = 0;
+	uint64_t replay_first_divergent_frame = 0;
+	FrameExporter frame_exporter;
+	// Ring of FRAME_EXPORT_SLOTS buffers; readback_next_slot is the one the next frame is copied to.
+	std::vector<ReadbackSlot> readback_slots;
+	uint32_t readback_next_slot = 0;
+	bool readback_bgra = false;
+	bool readback_coherent = true;
+	uint64_t export_readback_frames = 0;
+	uint64_t export_dropped_frames = 0;
+	double export_start_time = 0.0;
 };
 
-int main() {
-	HelloTriangleApplication app;
+// vulkan_tutorial [--capture <log>] [--replay <log> [--timings <csv>]] [--export <raw or .ppm> | --export-pipe <command>]
+int main(int argc, char** argv) {
+	CaptureOptions capture_options;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string option = argv[i];
+		if (option == "--capture") {
+			capture_options.capture_path = argv[i + 1];
+		}
+		else if (option == "--replay") {
+			capture_options.replay_path = argv[i + 1];
+		}
+		else if (option == "--timings") {
+			capture_options.timings_path = argv[i + 1];
+		}
+		else if (option == "--export") {
+			capture_options.export_path = argv[i + 1];
+		}
+		else if (option == "--export-pipe") {
+			capture_options.export_command = argv[i + 1];
+		}
+		else {
+			std::cerr << "unknown option " << option << std::endl;
+			return 1;
+		}
+	}
+
+	SteadyClock steady_clock;
+	FixedStepClock fixed_step_clock(FIXED_TIME_STEP);
+	Clock& clock = FIXED_TIME_STEP > 0.0 ? static_cast<Clock&>(fixed_step_clock) : steady_clock;
+
+	HelloTriangleApplication app(clock, capture_options);
 
 	app.Run();
 
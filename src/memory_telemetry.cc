@@ -0,0 +1,163 @@
+#include "memory_telemetry.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <iomanip>
+
+const double MemoryTelemetry::LOW_MEMORY_THRESHOLD = 0.9;
+const double MemoryTelemetry::RECOVERED_THRESHOLD = 0.8;
+
+namespace {
+
+const char* CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = {
+	"vertex",
+	"index",
+	"uniform",
+	"staging",
+	"storage",
+	"texture",
+	"attachment",
+};
+
+double ToMiB(VkDeviceSize bytes) {
+	return bytes / (1024.0 * 1024.0);
+}
+
+VkDeviceSize GetThreshold(VkDeviceSize budget, double fraction) {
+	return static_cast<VkDeviceSize>(budget * fraction);
+}
+
+}
+
+const char* GetMemoryCategoryName(MemoryCategory category) {
+	return CATEGORY_NAMES[category];
+}
+
+void MemoryTelemetry::SetMemoryProperties(const VkPhysicalDeviceMemoryProperties& properties) {
+	type_heaps.resize(properties.memoryTypeCount);
+	for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+		type_heaps[i] = properties.memoryTypes[i].heapIndex;
+	}
+
+	heaps.resize(properties.memoryHeapCount);
+	for (uint32_t i = 0; i < properties.memoryHeapCount; ++i) {
+		heaps[i].size = properties.memoryHeaps[i].size;
+		heaps[i].device_local = (properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		heaps[i].budget = heaps[i].size;
+	}
+}
+
+void MemoryTelemetry::SetBudget(uint32_t heap, VkDeviceSize budget, VkDeviceSize usage) {
+	heaps[heap].budget = budget;
+	heaps[heap].reported_usage = usage;
+	heaps[heap].allocated_at_report = heaps[heap].stats.allocated;
+}
+
+VkDeviceSize MemoryTelemetry::GetUsage(uint32_t heap) const {
+	const MemoryHeapStats& stats = heaps[heap];
+	// The reported usage already includes what was allocated up to the report.
+	if (stats.stats.allocated >= stats.allocated_at_report) {
+		return stats.reported_usage + (stats.stats.allocated - stats.allocated_at_report);
+	}
+	VkDeviceSize freed = stats.allocated_at_report - stats.stats.allocated;
+	return stats.reported_usage > freed ? stats.reported_usage - freed : 0;
+}
+
+void MemoryTelemetry::RecordAllocation(VkDeviceMemory memory, uint32_t memory_type, MemoryCategory category, VkDeviceSize allocated, VkDeviceSize used) {
+	Allocation allocation = { type_heaps[memory_type], category, allocated, std::min(used, allocated) };
+	MemoryStats* stats[] = { &heaps[allocation.heap].stats, &categories[category] };
+	for (MemoryStats* s : stats) {
+		s->allocated += allocation.allocated;
+		s->used += allocation.used;
+		++s->allocation_count;
+	}
+
+	bool inserted = allocations.insert({ memory, allocation }).second;
+	assert(inserted);
+}
+
+void MemoryTelemetry::RecordFree(VkDeviceMemory memory) {
+	if (memory == VK_NULL_HANDLE) {
+		return;
+	}
+	auto it = allocations.find(memory);
+	assert(it != allocations.end());
+
+	const Allocation& allocation = it->second;
+	MemoryStats* stats[] = { &heaps[allocation.heap].stats, &categories[allocation.category] };
+	for (MemoryStats* s : stats) {
+		s->allocated -= allocation.allocated;
+		s->used -= allocation.used;
+		--s->allocation_count;
+	}
+	allocations.erase(it);
+}
+
+void MemoryTelemetry::AddLowMemoryCallback(LowMemoryCallback callback) {
+	low_memory_callbacks.push_back(callback);
+}
+
+void MemoryTelemetry::NotifyLowMemory(uint32_t heap, VkDeviceSize bytes) {
+	for (const auto& callback : low_memory_callbacks) {
+		callback(heap, bytes);
+	}
+}
+
+void MemoryTelemetry::CheckBudget() {
+	for (uint32_t heap = 0; heap < heaps.size(); ++heap) {
+		MemoryHeapStats& stats = heaps[heap];
+		VkDeviceSize usage = GetUsage(heap);
+		VkDeviceSize threshold = GetThreshold(stats.budget, LOW_MEMORY_THRESHOLD);
+
+		if (!stats.low_memory && usage > threshold) {
+			stats.low_memory = true;
+			NotifyLowMemory(heap, usage - threshold);
+		}
+		else if (stats.low_memory && usage < GetThreshold(stats.budget, RECOVERED_THRESHOLD)) {
+			stats.low_memory = false;
+		}
+	}
+}
+
+bool MemoryTelemetry::RequestMemory(uint32_t memory_type, VkDeviceSize size) {
+	uint32_t heap = type_heaps[memory_type];
+	VkDeviceSize threshold = GetThreshold(heaps[heap].budget, LOW_MEMORY_THRESHOLD);
+	VkDeviceSize usage = GetUsage(heap);
+	if (usage + size > threshold) {
+		heaps[heap].low_memory = true;
+		NotifyLowMemory(heap, usage + size - threshold);
+	}
+	return GetUsage(heap) + size <= heaps[heap].budget;
+}
+
+void MemoryTelemetry::ReleaseMemory(uint32_t memory_type, VkDeviceSize size) {
+	uint32_t heap = type_heaps[memory_type];
+	heaps[heap].low_memory = true;
+	NotifyLowMemory(heap, size);
+}
+
+void MemoryTelemetry::Dump(std::ostream& out) const {
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(1);
+
+	out << "device memory:" << std::endl;
+	for (uint32_t heap = 0; heap < heaps.size(); ++heap) {
+		const MemoryHeapStats& stats = heaps[heap];
+		out << "\theap " << heap << (stats.device_local ? " (device local)" : " (host)") << ": "
+			<< ToMiB(GetUsage(heap)) << " of " << ToMiB(stats.budget) << " MiB budget (" << ToMiB(stats.size) << " MiB heap)"
+			<< (stats.low_memory ? ", LOW" : "") << "; ours " << ToMiB(stats.stats.allocated) << " MiB in " << stats.stats.allocation_count
+			<< " allocations, " << stats.stats.GetFragmented() / 1024.0 << " KiB fragmented" << std::endl;
+	}
+	for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; ++category) {
+		const MemoryStats& stats = categories[category];
+		if (stats.allocation_count == 0) {
+			continue;
+		}
+		out << "\t" << CATEGORY_NAMES[category] << ": " << ToMiB(stats.allocated) << " MiB in " << stats.allocation_count
+			<< " allocations, " << stats.GetFragmented() / 1024.0 << " KiB fragmented" << std::endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
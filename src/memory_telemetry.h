@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+enum MemoryCategory {
+	MEMORY_CATEGORY_VERTEX,
+	MEMORY_CATEGORY_INDEX,
+	MEMORY_CATEGORY_UNIFORM,
+	MEMORY_CATEGORY_STAGING,
+	MEMORY_CATEGORY_STORAGE,
+	MEMORY_CATEGORY_TEXTURE,
+	MEMORY_CATEGORY_ATTACHMENT,
+	MEMORY_CATEGORY_COUNT,
+};
+
+const char* GetMemoryCategoryName(MemoryCategory category);
+
+// Byte counts of a set of device allocations. allocated is what vkAllocateMemory was asked
+// for, used what the resources bound to it requested; the difference is alignment and size
+// rounding, reported as fragmented.
+struct MemoryStats {
+	VkDeviceSize allocated = 0;
+	VkDeviceSize used = 0;
+	uint32_t allocation_count = 0;
+
+	VkDeviceSize GetFragmented() const { return allocated - used; }
+};
+
+struct MemoryHeapStats {
+	VkDeviceSize size = 0;
+	bool device_local = false;
+	// What the process may use and uses of the heap, as last reported by VK_EXT_memory_budget.
+	// Without the extension the budget is the heap size and usage is only our allocations.
+	VkDeviceSize budget = 0;
+	VkDeviceSize reported_usage = 0;
+	// allocated at the time of the report, so later allocations can be added to its usage.
+	VkDeviceSize allocated_at_report = 0;
+	bool low_memory = false;
+	MemoryStats stats;
+};
+
+// Tags every device allocation with its heap and category, tracks heap usage against the
+// budget and notifies subsystems when a heap runs low, so they can shed caches before an
+// allocation fails.
+class MemoryTelemetry {
+public:
+	// Called with the heap that is low and roughly how many bytes it is over the threshold.
+	typedef std::function<void(uint32_t heap, VkDeviceSize bytes)> LowMemoryCallback;
+
+	// A heap is low once usage passes LOW_MEMORY_THRESHOLD of its budget and recovers below
+	// RECOVERED_THRESHOLD; the gap keeps callbacks from firing every frame around the limit.
+	static const double LOW_MEMORY_THRESHOLD;
+	static const double RECOVERED_THRESHOLD;
+
+	void SetMemoryProperties(const VkPhysicalDeviceMemoryProperties& properties);
+	void SetBudget(uint32_t heap, VkDeviceSize budget, VkDeviceSize usage);
+
+	void RecordAllocation(VkDeviceMemory memory, uint32_t memory_type, MemoryCategory category, VkDeviceSize allocated, VkDeviceSize used);
+	void RecordFree(VkDeviceMemory memory);
+
+	void AddLowMemoryCallback(LowMemoryCallback callback);
+	// Fires the callbacks for heaps that became low since the last check.
+	void CheckBudget();
+	// Asks subsystems to make room when allocating size bytes of memory_type would push its
+	// heap past the threshold. Returns whether the allocation fits the budget afterwards.
+	bool RequestMemory(uint32_t memory_type, VkDeviceSize size);
+	// Unconditionally asks subsystems to free size bytes of the heap of memory_type, after the
+	// driver failed an allocation.
+	void ReleaseMemory(uint32_t memory_type, VkDeviceSize size);
+
+	VkDeviceSize GetUsage(uint32_t heap) const;
+	uint32_t GetHeapCount() const { return static_cast<uint32_t>(heaps.size()); }
+	const MemoryHeapStats& GetHeapStats(uint32_t heap) const { return heaps[heap]; }
+	const MemoryStats& GetCategoryStats(MemoryCategory category) const { return categories[category]; }
+
+	void Dump(std::ostream& out) const;
+
+private:
+	void NotifyLowMemory(uint32_t heap, VkDeviceSize bytes);
+
+	struct Allocation {
+		uint32_t heap;
+		MemoryCategory category;
+		VkDeviceSize allocated;
+		VkDeviceSize used;
+	};
+
+	std::vector<uint32_t> type_heaps;
+	std::vector<MemoryHeapStats> heaps;
+	MemoryStats categories[MEMORY_CATEGORY_COUNT];
+	std::unordered_map<VkDeviceMemory, Allocation> allocations;
+	std::vector<LowMemoryCallback> low_memory_callbacks;
+};
@@ -0,0 +1,357 @@
+#include "mesh_lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+namespace {
+
+// Border constraint planes count this much more than the faces next to them, so open edges
+// of the mesh keep their outline.
+const double BORDER_WEIGHT = 10.0;
+// A level that keeps more than this fraction of the triangles of the one before it ends the chain.
+const float MIN_LOD_REDUCTION = 0.9f;
+
+// Symmetric 4x4 matrix summing squared distances to a set of planes, and the total weight of
+// those planes.
+struct Quadric {
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+	double weight;
+};
+
+void AddPlane(Quadric& q, const glm::dvec3& n, double d, double weight) {
+	q.a00 += weight * n.x * n.x;
+	q.a01 += weight * n.x * n.y;
+	q.a02 += weight * n.x * n.z;
+	q.a03 += weight * n.x * d;
+	q.a11 += weight * n.y * n.y;
+	q.a12 += weight * n.y * n.z;
+	q.a13 += weight * n.y * d;
+	q.a22 += weight * n.z * n.z;
+	q.a23 += weight * n.z * d;
+	q.a33 += weight * d * d;
+	q.weight += weight;
+}
+
+Quadric operator+(const Quadric& a, const Quadric& b) {
+	return {
+		a.a00 + b.a00, a.a01 + b.a01, a.a02 + b.a02, a.a03 + b.a03,
+		a.a11 + b.a11, a.a12 + b.a12, a.a13 + b.a13,
+		a.a22 + b.a22, a.a23 + b.a23,
+		a.a33 + b.a33,
+		a.weight + b.weight,
+	};
+}
+
+double Evaluate(const Quadric& q, const glm::vec3& p) {
+	double x = p.x, y = p.y, z = p.z;
+	double error = q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x
+		+ q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y
+		+ q.a22 * z * z + 2.0 * q.a23 * z
+		+ q.a33;
+	// Rounding can take an exact fit slightly below zero.
+	return std::max(error, 0.0);
+}
+
+// Moving from onto to, valid while neither quadric changed since it was queued.
+struct Collapse {
+	double cost;
+	uint32_t from;
+	uint32_t to;
+	uint32_t from_version;
+	uint32_t to_version;
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+}
+
+std::vector<uint16_t> SimplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<uint16_t>& indices, size_t target_index_count, float* error) {
+	size_t triangle_count = indices.size() / 3;
+	std::vector<uint32_t> triangles(indices.begin(), indices.begin() + triangle_count * 3);
+	std::vector<bool> triangle_removed(triangle_count, false);
+	std::vector<std::vector<uint32_t>> vertex_triangles(positions.size());
+	std::vector<Quadric> quadrics(positions.size(), Quadric());
+	std::unordered_map<uint64_t, uint32_t> edge_uses;
+
+	auto edge_key = [](uint32_t a, uint32_t b) {
+		return static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+	};
+
+	// Every face adds its plane, weighted by its area, to its corners.
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		const uint32_t* corners = &triangles[t * 3];
+		glm::dvec3 p0 = positions[corners[0]];
+		glm::dvec3 normal = glm::cross(glm::dvec3(positions[corners[1]]) - p0, glm::dvec3(positions[corners[2]]) - p0);
+		double length = glm::length(normal);
+		for (int k = 0; k < 3; ++k) {
+			if (length > 0.0) {
+				AddPlane(quadrics[corners[k]], normal / length, -glm::dot(normal / length, p0), length * 0.5);
+			}
+			vertex_triangles[corners[k]].push_back(t);
+			++edge_uses[edge_key(corners[k], corners[(k + 1) % 3])];
+		}
+	}
+
+	// Edges with one face are on a border: a plane through the edge, perpendicular to the face,
+	// keeps its endpoints from sliding off it.
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		const uint32_t* corners = &triangles[t * 3];
+		glm::dvec3 p0 = positions[corners[0]];
+		glm::dvec3 normal = glm::cross(glm::dvec3(positions[corners[1]]) - p0, glm::dvec3(positions[corners[2]]) - p0);
+		for (int k = 0; k < 3; ++k) {
+			uint32_t a = corners[k];
+			uint32_t b = corners[(k + 1) % 3];
+			if (edge_uses[edge_key(a, b)] != 1) {
+				continue;
+			}
+			glm::dvec3 edge = glm::dvec3(positions[b]) - glm::dvec3(positions[a]);
+			glm::dvec3 plane_normal = glm::cross(edge, normal);
+			double length = glm::length(plane_normal);
+			if (length == 0.0) {
+				continue;
+			}
+			plane_normal /= length;
+			double d = -glm::dot(plane_normal, glm::dvec3(positions[a]));
+			double weight = BORDER_WEIGHT * glm::dot(edge, edge);
+			AddPlane(quadrics[a], plane_normal, d, weight);
+			AddPlane(quadrics[b], plane_normal, d, weight);
+		}
+	}
+
+	std::vector<uint32_t> versions(positions.size(), 0);
+	std::vector<bool> vertex_removed(positions.size(), false);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses;
+
+	auto queue_collapse = [&](uint32_t from, uint32_t to) {
+		double cost = Evaluate(quadrics[from] + quadrics[to], positions[to]);
+		collapses.push({ cost, from, to, versions[from], versions[to] });
+	};
+	auto queue_edges = [&](uint32_t vertex) {
+		for (uint32_t t : vertex_triangles[vertex]) {
+			for (int k = 0; k < 3; ++k) {
+				uint32_t other = triangles[t * 3 + k];
+				if (other != vertex) {
+					queue_collapse(vertex, other);
+					queue_collapse(other, vertex);
+				}
+			}
+		}
+	};
+	auto gather_neighbors = [&](uint32_t vertex, std::vector<uint32_t>& neighbors) {
+		neighbors.clear();
+		for (uint32_t t : vertex_triangles[vertex]) {
+			for (int k = 0; k < 3; ++k) {
+				uint32_t other = triangles[t * 3 + k];
+				if (other != vertex && std::find(neighbors.begin(), neighbors.end(), other) == neighbors.end()) {
+					neighbors.push_back(other);
+				}
+			}
+		}
+	};
+	auto contains = [&](uint32_t t, uint32_t vertex) {
+		return triangles[t * 3] == vertex || triangles[t * 3 + 1] == vertex || triangles[t * 3 + 2] == vertex;
+	};
+
+	for (uint32_t vertex = 0; vertex < positions.size(); ++vertex) {
+		for (uint32_t t : vertex_triangles[vertex]) {
+			for (int k = 0; k < 3; ++k) {
+				uint32_t other = triangles[t * 3 + k];
+				if (other != vertex) {
+					queue_collapse(vertex, other);
+				}
+			}
+		}
+	}
+
+	size_t live_triangles = triangle_count;
+	double max_error = 0.0;
+	std::vector<uint32_t> from_neighbors;
+	std::vector<uint32_t> to_neighbors;
+	while (live_triangles * 3 > target_index_count && !collapses.empty()) {
+		Collapse collapse = collapses.top();
+		collapses.pop();
+		uint32_t from = collapse.from;
+		uint32_t to = collapse.to;
+		if (vertex_removed[from] || vertex_removed[to] || versions[from] != collapse.from_version || versions[to] != collapse.to_version) {
+			continue;
+		}
+
+		// The edge may have gone with an earlier collapse.
+		uint32_t shared_triangles = 0;
+		for (uint32_t t : vertex_triangles[from]) {
+			shared_triangles += contains(t, to) ? 1 : 0;
+		}
+		if (shared_triangles == 0) {
+			continue;
+		}
+
+		// Link condition: the endpoints may only share the neighbors opposite the edge, anything
+		// else would pinch the surface into a non-manifold edge.
+		gather_neighbors(from, from_neighbors);
+		gather_neighbors(to, to_neighbors);
+		uint32_t common_neighbors = 0;
+		for (uint32_t neighbor : from_neighbors) {
+			common_neighbors += std::find(to_neighbors.begin(), to_neighbors.end(), neighbor) != to_neighbors.end() ? 1 : 0;
+		}
+		if (common_neighbors != shared_triangles) {
+			continue;
+		}
+
+		// No face that stays may turn over.
+		bool flips = false;
+		for (uint32_t t : vertex_triangles[from]) {
+			if (contains(t, to)) {
+				continue;
+			}
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (int k = 0; k < 3; ++k) {
+				uint32_t vertex = triangles[t * 3 + k];
+				before[k] = positions[vertex];
+				after[k] = vertex == from ? positions[to] : positions[vertex];
+			}
+			glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if (glm::dot(normal_before, normal_after) <= 0.0f) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips) {
+			continue;
+		}
+
+		Quadric merged = quadrics[from] + quadrics[to];
+		if (merged.weight > 0.0) {
+			max_error = std::max(max_error, std::sqrt(collapse.cost / merged.weight));
+		}
+
+		for (uint32_t t : vertex_triangles[from]) {
+			if (contains(t, to)) {
+				triangle_removed[t] = true;
+				--live_triangles;
+				continue;
+			}
+			for (int k = 0; k < 3; ++k) {
+				if (triangles[t * 3 + k] == from) {
+					triangles[t * 3 + k] = to;
+				}
+			}
+			vertex_triangles[to].push_back(t);
+		}
+		vertex_triangles[from].clear();
+		vertex_removed[from] = true;
+		quadrics[to] = merged;
+		++versions[to];
+
+		// The removed faces were around to and its neighbors. Lists only ever name live faces, so
+		// the checks above need no removed tests.
+		to_neighbors.push_back(to);
+		for (uint32_t vertex : to_neighbors) {
+			auto& list = vertex_triangles[vertex];
+			list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t) { return triangle_removed[t]; }), list.end());
+		}
+		queue_edges(to);
+	}
+
+	std::vector<uint16_t> result;
+	result.reserve(live_triangles * 3);
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		if (!triangle_removed[t]) {
+			result.push_back(static_cast<uint16_t>(triangles[t * 3]));
+			result.push_back(static_cast<uint16_t>(triangles[t * 3 + 1]));
+			result.push_back(static_cast<uint16_t>(triangles[t * 3 + 2]));
+		}
+	}
+	if (error) {
+		*error = static_cast<float>(max_error);
+	}
+	return result;
+}
+
+std::vector<MeshLod> BuildMeshLods(const std::vector<glm::vec3>& positions, std::vector<uint16_t>& indices, uint32_t max_lods, float reduction) {
+	std::vector<MeshLod> lods;
+	lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+
+	std::vector<uint16_t> source(indices);
+	while (lods.size() < max_lods) {
+		size_t target_index_count = static_cast<size_t>(source.size() / 3 * reduction) * 3;
+		float level_error = 0.0f;
+		std::vector<uint16_t> level = SimplifyMesh(positions, source, target_index_count, &level_error);
+		if (level.empty() || level.size() > source.size() * MIN_LOD_REDUCTION) {
+			break;
+		}
+
+		// Each level is simplified from the previous one, so their errors add up.
+		MeshLod lod;
+		lod.first_index = static_cast<uint32_t>(indices.size());
+		lod.index_count = static_cast<uint32_t>(level.size());
+		lod.error = lods.back().error + level_error;
+		lods.push_back(lod);
+
+		indices.insert(indices.end(), level.begin(), level.end());
+		source.swap(level);
+	}
+	return lods;
+}
+
+void ComputeBoundingSphere(const std::vector<glm::vec3>& positions, glm::vec3& center, float& radius) {
+	center = glm::vec3(0.0f);
+	radius = 0.0f;
+	if (positions.empty()) {
+		return;
+	}
+
+	glm::vec3 min_corner = positions[0];
+	glm::vec3 max_corner = positions[0];
+	for (const auto& position : positions) {
+		min_corner = glm::min(min_corner, position);
+		max_corner = glm::max(max_corner, position);
+	}
+	center = (min_corner + max_corner) * 0.5f;
+	for (const auto& position : positions) {
+		radius = std::max(radius, glm::length(position - center));
+	}
+}
+
+float ComputeScreenSize(const glm::mat4& proj, const glm::mat4& model_view, const glm::vec3& center, float radius) {
+	glm::vec3 view_center = glm::vec3(model_view * glm::vec4(center, 1.0f));
+	float scale = std::max(glm::length(glm::vec3(model_view[0])), std::max(glm::length(glm::vec3(model_view[1])), glm::length(glm::vec3(model_view[2]))));
+	float view_radius = radius * scale;
+	float distance = -view_center.z;
+	if (distance <= view_radius) {
+		// The camera is inside the bounds.
+		return std::numeric_limits<float>::max();
+	}
+	// The viewport is 2 units high in clip space, so the projected radius is the fraction.
+	return view_radius * std::abs(proj[1][1]) / distance;
+}
+
+uint32_t SelectMeshLod(float screen_size, uint32_t current_lod, uint32_t lod_count, float lod_screen_size, float hysteresis) {
+	if (lod_count <= 1) {
+		return 0;
+	}
+	uint32_t last_lod = lod_count - 1;
+
+	// Band of current_lod: [lod_screen_size * 2^-i, lod_screen_size * 2^-(i-1)), open ended for
+	// the first and last level.
+	if (current_lod <= last_lod) {
+		float lower = current_lod == last_lod ? 0.0f : lod_screen_size * std::ldexp(1.0f, -static_cast<int>(current_lod));
+		float upper = current_lod == 0 ? std::numeric_limits<float>::max() : lod_screen_size * std::ldexp(1.0f, 1 - static_cast<int>(current_lod));
+		if (screen_size >= lower * (1.0f - hysteresis) && screen_size < upper * (1.0f + hysteresis)) {
+			return current_lod;
+		}
+	}
+
+	if (screen_size >= lod_screen_size) {
+		return 0;
+	}
+	float level = std::floor(std::log2(lod_screen_size / std::max(screen_size, std::numeric_limits<float>::min())));
+	return std::min(last_lod, 1 + static_cast<uint32_t>(std::min(level, static_cast<float>(last_lod))));
+}
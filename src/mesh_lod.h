@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+// One level of detail: a range of a shared index buffer. Every level indexes the same vertex
+// buffer, so switching levels only changes the range drawn.
+struct MeshLod {
+	uint32_t first_index;
+	uint32_t index_count;
+	// Upper bound of how far the surface moved from the full mesh, in object space units.
+	float error;
+};
+
+// Quadric error metric simplification. Edges are collapsed onto one of their endpoints,
+// cheapest first, until at most target_index_count indices remain or no collapse is left that
+// keeps the mesh from folding over. Open borders are held in place by constraint planes.
+// Vertices are never moved or added, so the result indexes the same vertices. error, when
+// given, receives the largest collapse error in object space units.
+std::vector<uint16_t> SimplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<uint16_t>& indices, size_t target_index_count, float* error = nullptr);
+
+// Simplifies indices into a chain of at most max_lods levels, each aiming for reduction times
+// the triangles of the one before, and appends the coarser levels to indices. Level 0 is the
+// original mesh. The chain ends early once a level no longer gets meaningfully smaller.
+std::vector<MeshLod> BuildMeshLods(const std::vector<glm::vec3>& positions, std::vector<uint16_t>& indices, uint32_t max_lods, float reduction);
+
+void ComputeBoundingSphere(const std::vector<glm::vec3>& positions, glm::vec3& center, float& radius);
+
+// Projected diameter of a bounding sphere as a fraction of the viewport height.
+float ComputeScreenSize(const glm::mat4& proj, const glm::mat4& model_view, const glm::vec3& center, float radius);
+
+// Level for an object covering screen_size of the viewport height. Level 0 is drawn down to
+// lod_screen_size and every further level takes over at half the size of the one before.
+// The current level is kept until the size leaves its band by more than hysteresis (a
+// fraction of the band's bounds), so an object sitting on a boundary does not pop between
+// levels every frame.
+uint32_t SelectMeshLod(float screen_size, uint32_t current_lod, uint32_t lod_count, float lod_screen_size, float hysteresis);
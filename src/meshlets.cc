@@ -0,0 +1,145 @@
+#include "meshlets.h"
+
+#include "mesh_lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Below this the normals spread over more than about 84 degrees from the axis and the cone
+// would hardly ever cull, so it is not worth testing.
+const float MIN_CONE_SPREAD = 0.1f;
+
+const uint32_t NO_LOCAL_INDEX = std::numeric_limits<uint32_t>::max();
+
+void ComputeMeshletBounds(const std::vector<glm::vec3>& positions, const MeshletMesh& mesh, Meshlet& meshlet, std::vector<glm::vec3>& scratch) {
+	scratch.clear();
+	for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+		scratch.push_back(positions[mesh.vertices[meshlet.vertex_offset + i]]);
+	}
+	glm::vec3 center;
+	float radius;
+	ComputeBoundingSphere(scratch, center, radius);
+	meshlet.sphere = glm::vec4(center, radius);
+
+	// Normals of the faces as the pipeline sees them: counter-clockwise is front facing.
+	std::array<glm::vec3, MESHLET_MAX_TRIANGLES> normals;
+	uint32_t normal_count = 0;
+	glm::vec3 normal_sum(0.0f);
+	for (uint32_t i = 0; i < meshlet.triangle_count; ++i) {
+		uint32_t triangle = mesh.triangles[meshlet.triangle_offset + i];
+		const glm::vec3& p0 = scratch[triangle & 0xff];
+		const glm::vec3& p1 = scratch[(triangle >> 8) & 0xff];
+		const glm::vec3& p2 = scratch[(triangle >> 16) & 0xff];
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f) {
+			continue;
+		}
+		normals[normal_count] = normal / length;
+		normal_sum += normals[normal_count];
+		++normal_count;
+	}
+
+	float sum_length = glm::length(normal_sum);
+	if (normal_count == 0 || sum_length == 0.0f) {
+		meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		return;
+	}
+	glm::vec3 axis = normal_sum / sum_length;
+	float min_dot = 1.0f;
+	for (uint32_t i = 0; i < normal_count; ++i) {
+		min_dot = std::min(min_dot, glm::dot(normals[i], axis));
+	}
+	// The normal cone has a half angle of acos(min_dot). The directions every triangle is seen
+	// from the back widen it by 90 degrees, and their cosine is -sin of the half angle.
+	float cutoff = min_dot <= MIN_CONE_SPREAD ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+	meshlet.cone = glm::vec4(axis, cutoff);
+}
+
+}
+
+MeshletRange BuildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<uint16_t>& indices, uint32_t first_index, uint32_t index_count, MeshletMesh& mesh) {
+	MeshletRange range = { static_cast<uint32_t>(mesh.meshlets.size()), 0 };
+
+	// Index into the current meshlet's vertices of every vertex it holds.
+	std::vector<uint32_t> local_indices(positions.size(), NO_LOCAL_INDEX);
+	std::vector<glm::vec3> scratch;
+	Meshlet meshlet = {};
+	meshlet.vertex_offset = static_cast<uint32_t>(mesh.vertices.size());
+	meshlet.triangle_offset = static_cast<uint32_t>(mesh.triangles.size());
+
+	auto close_meshlet = [&]() {
+		if (meshlet.triangle_count == 0) {
+			return;
+		}
+		ComputeMeshletBounds(positions, mesh, meshlet, scratch);
+		for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+			local_indices[mesh.vertices[meshlet.vertex_offset + i]] = NO_LOCAL_INDEX;
+		}
+		mesh.meshlets.push_back(meshlet);
+		++range.meshlet_count;
+		meshlet = {};
+		meshlet.vertex_offset = static_cast<uint32_t>(mesh.vertices.size());
+		meshlet.triangle_offset = static_cast<uint32_t>(mesh.triangles.size());
+	};
+
+	for (uint32_t i = first_index; i + 2 < first_index + index_count; i += 3) {
+		uint32_t new_vertices = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner) {
+			uint16_t vertex = indices[i + corner];
+			// A vertex repeated within the triangle only counts once.
+			bool repeated = (corner > 0 && indices[i] == vertex) || (corner > 1 && indices[i + 1] == vertex);
+			if (local_indices[vertex] == NO_LOCAL_INDEX && !repeated) {
+				++new_vertices;
+			}
+		}
+		if (meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES || meshlet.triangle_count == MESHLET_MAX_TRIANGLES) {
+			close_meshlet();
+		}
+
+		uint32_t triangle = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner) {
+			uint16_t vertex = indices[i + corner];
+			if (local_indices[vertex] == NO_LOCAL_INDEX) {
+				local_indices[vertex] = meshlet.vertex_count++;
+				mesh.vertices.push_back(vertex);
+			}
+			triangle |= local_indices[vertex] << (corner * 8);
+		}
+		mesh.triangles.push_back(triangle);
+		++meshlet.triangle_count;
+	}
+	close_meshlet();
+	return range;
+}
+
+bool IsMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& camera_position) {
+	glm::vec3 offset = glm::vec3(meshlet.sphere) - camera_position;
+	return glm::dot(offset, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(offset) + meshlet.sphere.w;
+}
+
+std::array<glm::vec4, 6> ExtractFrustumPlanes(const glm::mat4& view_proj) {
+	glm::vec4 row_x(view_proj[0][0], view_proj[1][0], view_proj[2][0], view_proj[3][0]);
+	glm::vec4 row_y(view_proj[0][1], view_proj[1][1], view_proj[2][1], view_proj[3][1]);
+	glm::vec4 row_z(view_proj[0][2], view_proj[1][2], view_proj[2][2], view_proj[3][2]);
+	glm::vec4 row_w(view_proj[0][3], view_proj[1][3], view_proj[2][3], view_proj[3][3]);
+
+	// -w <= x, y <= w and 0 <= z <= w.
+	std::array<glm::vec4, 6> planes = { row_w + row_x, row_w - row_x, row_w + row_y, row_w - row_y, row_z, row_w - row_z };
+	for (auto& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return planes;
+}
+
+bool IsSphereInFrustum(const std::array<glm::vec4, 6>& planes, const glm::vec3& center, float radius) {
+	for (const auto& plane : planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
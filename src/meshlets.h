@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// Limits of one meshlet. 124 triangles rather than 128 follows the usual mesh shader sizing,
+// which keeps the packed triangles and vertex indices of a meshlet within 1 KB.
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+// local_size of meshlet_cull.comp.
+const uint32_t MESHLET_WORKGROUP_SIZE = 64;
+
+// A small cluster of a mesh's triangles with bounds to cull it by, laid out like Meshlet
+// (std430) in meshlet_cull.comp and shader.vert. Its vertices are vertex_count entries of
+// MeshletMesh::vertices from vertex_offset, indices into the mesh's vertex buffer; its
+// triangles are triangle_count entries of MeshletMesh::triangles from triangle_offset, three
+// 8 bit indices into those vertices each.
+struct Meshlet {
+	// Object space bounding sphere: center, radius.
+	glm::vec4 sphere;
+	// Normal cone: the average facing direction and the cutoff of IsMeshletBackfacing. A
+	// cutoff of 1 never culls, for meshlets facing too many ways.
+	glm::vec4 cone;
+	uint32_t vertex_offset;
+	uint32_t triangle_offset;
+	uint32_t vertex_count;
+	uint32_t triangle_count;
+};
+
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 layout of the shaders");
+
+// Meshlets of one level of detail, a range of MeshletMesh::meshlets.
+struct MeshletRange {
+	uint32_t first_meshlet;
+	uint32_t meshlet_count;
+};
+
+struct MeshletMesh {
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertices;
+	std::vector<uint32_t> triangles;
+};
+
+// Splits the triangles of indices[first_index, first_index + index_count) into meshlets and
+// appends them to mesh. Triangles are taken in index order and a meshlet is closed once the
+// next triangle would take it over either limit, so the input's locality (a vertex cache
+// optimized or grid order) carries over into tight bounds.
+MeshletRange BuildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<uint16_t>& indices, uint32_t first_index, uint32_t index_count, MeshletMesh& mesh);
+
+// Whether every triangle of the meshlet faces away from a camera at camera_position, both in
+// the meshlet's space. The test needs no cone apex: the bounding sphere stands in for it.
+bool IsMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& camera_position);
+
+// Planes of the frustum of view_proj (Vulkan clip space, depth 0..1), normals pointing
+// inwards and normalized, so a point's distance to one is dot(plane.xyz, point) + plane.w.
+std::array<glm::vec4, 6> ExtractFrustumPlanes(const glm::mat4& view_proj);
+bool IsSphereInFrustum(const std::array<glm::vec4, 6>& planes, const glm::vec3& center, float radius);
+
+// Everything one window's meshlet culling reads, laid out like MeshletCullUniforms (std140) in
+// meshlet_cull.comp. Meshlet bounds are in object space and tested in world space.
+struct MeshletCullUniforms {
+	glm::mat4 model;
+	std::array<glm::vec4, 6> frustum_planes;
+	glm::vec4 camera_position;
+	// Largest axis scale of model, for the radii.
+	float scale;
+	uint32_t first_meshlet;
+	uint32_t meshlet_count;
+	// Entries of the visible meshlet list per phase.
+	uint32_t visible_capacity;
+	uint32_t cone_culling;
+	// Whether the object level culling decides which phase draws the object; without it the
+	// one phase always does.
+	uint32_t object_culling;
+	uint32_t padding[2];
+};
+
+static_assert(offsetof(MeshletCullUniforms, scale) == 176, "MeshletCullUniforms must match the std140 layout of meshlet_cull.comp");
+
+// Counters the meshlet culling of one window and frame adds to, over both phases.
+struct MeshletStats {
+	uint32_t drawn;
+	uint32_t frustum_culled;
+	uint32_t cone_culled;
+	uint32_t padding;
+};
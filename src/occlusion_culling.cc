@@ -0,0 +1,27 @@
+#include "occlusion_culling.h"
+
+#include <algorithm>
+
+glm::vec4 GetCullProjection(const glm::mat4& proj) {
+	return glm::vec4(proj[0][0], proj[1][1], proj[2][2], proj[3][2]);
+}
+
+uint32_t GetDepthPyramidLevelCount(VkExtent2D depth_extent) {
+	VkExtent2D extent = GetDepthPyramidExtent(depth_extent, 0);
+	uint32_t levels = 1;
+	while (extent.width > 1 || extent.height > 1) {
+		extent.width = (extent.width + 1) / 2;
+		extent.height = (extent.height + 1) / 2;
+		++levels;
+	}
+	return std::min(levels, DEPTH_PYRAMID_MAX_LEVELS);
+}
+
+VkExtent2D GetDepthPyramidExtent(VkExtent2D depth_extent, uint32_t level) {
+	VkExtent2D extent = { std::max(depth_extent.width, 1u), std::max(depth_extent.height, 1u) };
+	for (uint32_t i = 0; i <= level; ++i) {
+		extent.width = (extent.width + 1) / 2;
+		extent.height = (extent.height + 1) / 2;
+	}
+	return extent;
+}
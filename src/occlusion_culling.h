@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Objects one culling dispatch can test, the size of the arrays in hiz_cull.comp.
+const uint32_t CULL_MAX_OBJECTS = 64;
+// Enough levels for a 65536 texel wide depth buffer.
+const uint32_t DEPTH_PYRAMID_MAX_LEVELS = 16;
+// local_size of hiz_cull.comp, and of both dimensions of hiz_reduce.comp.
+const uint32_t CULL_WORKGROUP_SIZE = 64;
+const uint32_t DEPTH_REDUCE_GROUP_SIZE = 8;
+
+// An object the culling pass may reject: world space bounding sphere (center, radius) and
+// the indexed draw it guards.
+struct CullObject {
+	glm::vec4 sphere;
+	uint32_t index_count;
+	uint32_t first_index;
+	uint32_t padding[2];
+};
+
+// Everything a window's culling dispatches read, laid out like CullUniforms (std140) in
+// hiz_cull.comp. The first phase tests against the pyramid of the previous frame, so under
+// the view and projection that frame was drawn with; the second against this frame's.
+struct CullUniforms {
+	glm::mat4 view;
+	glm::mat4 pyramid_view;
+	// GetCullProjection of the projections.
+	glm::vec4 projection;
+	glm::vec4 pyramid_projection;
+	uint32_t depth_width;
+	uint32_t depth_height;
+	uint32_t pyramid_levels;
+	uint32_t object_count;
+	// 0 while there is no previous pyramid to test against, after startup or a resize.
+	uint32_t pyramid_valid;
+	uint32_t padding[3];
+	CullObject objects[CULL_MAX_OBJECTS];
+};
+
+static_assert(offsetof(CullUniforms, objects) == 192, "CullUniforms must match the std140 layout of hiz_cull.comp");
+
+// Counters the culling dispatches of one window and frame add to, read back once the frame
+// completed. Objects drawn by each phase and the ones neither phase drew.
+struct CullStats {
+	uint32_t drawn[2];
+	uint32_t frustum_culled;
+	uint32_t occlusion_culled;
+};
+
+// What the shader needs of a perspective projection: P00, P11 and the two terms that map a
+// view space z to depth, depth = (z * proj[2][2] + proj[3][2]) / -z.
+glm::vec4 GetCullProjection(const glm::mat4& proj);
+
+// The pyramid starts at half the depth buffer's size (rounded up, so every texel covers a
+// whole 2x2 block) and halves down to 1x1.
+uint32_t GetDepthPyramidLevelCount(VkExtent2D depth_extent);
+VkExtent2D GetDepthPyramidExtent(VkExtent2D depth_extent, uint32_t level);
@@ -0,0 +1,119 @@
+#include "pipeline_cache.h"
+
+#include <fstream>
+#include <iterator>
+#include <string.h>
+
+namespace {
+
+const char PREWARM_MAGIC[8] = { 'V', 'K', 'T', 'P', 'S', 'O', 0, 1 };
+
+}
+
+PipelineDesc MakePipelineDesc() {
+	PipelineDesc desc;
+	memset(&desc, 0, sizeof(desc));
+	return desc;
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+	// FNV-1a
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool operator==(const PipelineDesc& a, const PipelineDesc& b) {
+	return memcmp(&a, &b, sizeof(PipelineDesc)) == 0;
+}
+
+PipelineCache::Shard& PipelineCache::GetShard(const PipelineDesc& desc) {
+	// The low bits pick the bucket inside the shard's map; use high ones for the shard.
+	return shards[(HashBytes(&desc, sizeof(desc)) >> 56) % SHARD_COUNT];
+}
+
+VkPipeline PipelineCache::Find(const PipelineDesc& desc, bool& claimed_compile) {
+	Shard& shard = GetShard(desc);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	// Looked up before inserting: emplace builds its node even when the desc is there, which
+	// would allocate on every draw.
+	auto found = shard.entries.find(desc);
+	claimed_compile = found == shard.entries.end();
+	if (claimed_compile) {
+		found = shard.entries.emplace(desc, Entry()).first;
+	}
+	VkPipeline pipeline = found->second.pipeline;
+	if (pipeline != VK_NULL_HANDLE) {
+		++hits;
+	}
+	else {
+		++misses;
+	}
+	return pipeline;
+}
+
+bool PipelineCache::Claim(const PipelineDesc& desc) {
+	Shard& shard = GetShard(desc);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	if (shard.entries.find(desc) != shard.entries.end()) {
+		return false;
+	}
+	shard.entries.emplace(desc, Entry());
+	return true;
+}
+
+void PipelineCache::Complete(const PipelineDesc& desc, VkPipeline pipeline) {
+	Shard& shard = GetShard(desc);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	Entry& entry = shard.entries[desc];
+	entry.pipeline = pipeline;
+	entry.compiled = true;
+}
+
+void PipelineCache::GetCompiledDescs(std::vector<PipelineDesc>& descs) {
+	for (auto& shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		for (const auto& entry : shard.entries) {
+			if (entry.second.pipeline != VK_NULL_HANDLE) {
+				descs.push_back(entry.first);
+			}
+		}
+	}
+}
+
+bool SavePipelinePrewarmList(const std::string& path, const std::vector<PipelineDesc>& descs) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+	uint32_t count = static_cast<uint32_t>(descs.size());
+	file.write(PREWARM_MAGIC, sizeof(PREWARM_MAGIC));
+	file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	file.write(reinterpret_cast<const char*>(descs.data()), descs.size() * sizeof(PipelineDesc));
+	return file.good();
+}
+
+bool LoadPipelinePrewarmList(const std::string& path, std::vector<PipelineDesc>& descs) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	uint32_t count;
+	size_t header_size = sizeof(PREWARM_MAGIC) + sizeof(count);
+	if (data.size() < header_size || memcmp(data.data(), PREWARM_MAGIC, sizeof(PREWARM_MAGIC)) != 0) {
+		return false;
+	}
+	memcpy(&count, data.data() + sizeof(PREWARM_MAGIC), sizeof(count));
+	if ((data.size() - header_size) / sizeof(PipelineDesc) < count) {
+		return false;
+	}
+	descs.resize(count);
+	memcpy(descs.data(), data.data() + header_size, count * sizeof(PipelineDesc));
+	return true;
+}
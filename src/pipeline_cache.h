@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+enum PipelineBlendMode {
+	PIPELINE_BLEND_NONE,
+	PIPELINE_BLEND_ALPHA,
+	PIPELINE_BLEND_ADDITIVE,
+};
+
+struct PipelineVertexAttribute {
+	uint32_t location;
+	uint32_t format;
+	uint32_t offset;
+};
+
+// Everything a graphics pipeline is built from. Only 32 bit fields after the leading hash, so
+// there is no padding and descs hash and compare as plain bytes and can be written to disk.
+// Viewport and scissor are dynamic, so a pipeline outlives swap chain resizes; the render
+// pass only matters through the attachment formats and sample count it is compatible with.
+struct PipelineDesc {
+	static const uint32_t MAX_ATTRIBUTES = 4;
+
+	// Hash of the SPIR-V of both stages, so edited shaders are new pipelines.
+	uint64_t shader_hash;
+	uint32_t program;
+	uint32_t vertex_stride;
+	uint32_t vertex_input_rate;
+	uint32_t attribute_count;
+	std::array<PipelineVertexAttribute, MAX_ATTRIBUTES> attributes;
+	uint32_t topology;
+	uint32_t polygon_mode;
+	uint32_t cull_mode;
+	uint32_t front_face;
+	uint32_t blend_mode;
+	uint32_t depth_test;
+	uint32_t depth_write;
+	uint32_t depth_compare_op;
+	uint32_t color_format;
+	uint32_t depth_format;
+	uint32_t samples;
+	uint32_t subpass;
+};
+
+static_assert(sizeof(PipelineDesc) == sizeof(uint64_t) + 28 * sizeof(uint32_t), "PipelineDesc must not have padding");
+
+// All fields zero, so descs built field by field compare equal.
+PipelineDesc MakePipelineDesc();
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+bool operator==(const PipelineDesc& a, const PipelineDesc& b);
+
+struct PipelineDescHash {
+	size_t operator()(const PipelineDesc& desc) const { return static_cast<size_t>(HashBytes(&desc, sizeof(desc))); }
+};
+
+// Compiled pipelines by desc, safe to use from any thread. The map is split into shards with
+// a lock each, so lookups on the render thread rarely wait for a worker finishing a compile.
+// The first lookup of a missing desc claims its compile; later lookups see it pending until
+// Complete.
+class PipelineCache {
+public:
+	static const uint32_t SHARD_COUNT = 16;
+
+	// Returns the pipeline, or VK_NULL_HANDLE while it is missing, pending or failed to build.
+	// claimed_compile is set when this call inserted the desc and the caller must compile it.
+	VkPipeline Find(const PipelineDesc& desc, bool& claimed_compile);
+	// Inserts desc as pending without counting a lookup; true when the caller must compile it.
+	bool Claim(const PipelineDesc& desc);
+	// Stores the compiled pipeline, VK_NULL_HANDLE when compiling failed.
+	void Complete(const PipelineDesc& desc, VkPipeline pipeline);
+
+	// Removes every compiled pipeline whose desc matches, for the caller to destroy.
+	template <typename Predicate>
+	void RemoveIf(Predicate predicate, std::vector<VkPipeline>& removed);
+
+	// Descs of every compiled pipeline, in no particular order.
+	void GetCompiledDescs(std::vector<PipelineDesc>& descs);
+
+	uint64_t GetHitCount() const { return hits; }
+	uint64_t GetMissCount() const { return misses; }
+
+private:
+	struct Entry {
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		bool compiled = false;
+	};
+
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<PipelineDesc, Entry, PipelineDescHash> entries;
+	};
+
+	Shard& GetShard(const PipelineDesc& desc);
+
+	std::array<Shard, SHARD_COUNT> shards;
+	// Only counted by the render thread's lookups, which are the ones that can miss a frame.
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+};
+
+template <typename Predicate>
+void PipelineCache::RemoveIf(Predicate predicate, std::vector<VkPipeline>& removed) {
+	for (auto& shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+			if (it->second.compiled && predicate(it->first)) {
+				if (it->second.pipeline != VK_NULL_HANDLE) {
+					removed.push_back(it->second.pipeline);
+				}
+				it = shard.entries.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+}
+
+// The descs a previous run compiled, so the next one can build them before they are drawn.
+bool SavePipelinePrewarmList(const std::string& path, const std::vector<PipelineDesc>& descs);
+bool LoadPipelinePrewarmList(const std::string& path, std::vector<PipelineDesc>& descs);
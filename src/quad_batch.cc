@@ -0,0 +1,175 @@
+#include "quad_batch.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUAD_BATCH_SSE
+#include <emmintrin.h>
+#endif
+
+QuadBatchTarget::~QuadBatchTarget() {
+}
+
+VkVertexInputBindingDescription GetBatchBindingDescription() {
+	VkVertexInputBindingDescription binding_description = {};
+	binding_description.binding = 0;
+	binding_description.stride = sizeof(BatchVertex);
+	binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	return binding_description;
+}
+
+std::array<VkVertexInputAttributeDescription, 2> GetBatchAttributeDescription() {
+	std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions = {};
+
+	attribute_descriptions[0].binding = 0;
+	attribute_descriptions[0].location = 0;
+	attribute_descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+	attribute_descriptions[0].offset = offsetof(BatchVertex, x);
+
+	attribute_descriptions[1].binding = 0;
+	attribute_descriptions[1].location = 1;
+	attribute_descriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+	attribute_descriptions[1].offset = offsetof(BatchVertex, color);
+
+	return attribute_descriptions;
+}
+
+void WriteQuadIndices(uint32_t quad_count, uint16_t* indices) {
+	assert(quad_count * 4 <= 65536);
+	for (uint32_t quad = 0; quad < quad_count; ++quad) {
+		uint16_t first = static_cast<uint16_t>(quad * 4);
+		uint16_t* out = indices + quad * 6;
+		out[0] = first;
+		out[1] = first + 1;
+		out[2] = first + 2;
+		out[3] = first + 2;
+		out[4] = first + 3;
+		out[5] = first;
+	}
+}
+
+uint32_t PackColor(float r, float g, float b, float a) {
+	auto pack = [](float value) {
+		return static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	};
+	return pack(r) | pack(g) << 8 | pack(b) << 16 | pack(a) << 24;
+}
+
+QuadBatch::QuadBatch(QuadBatchTarget& target) : target(target) {
+}
+
+void QuadBatch::Begin(VkExtent2D extent) {
+	scale_x = 2.0f / extent.width;
+	scale_y = 2.0f / extent.height;
+	scissor = { { 0, 0 }, extent };
+	frame_quad_count = 0;
+	frame_draw_count = 0;
+
+	draws.clear();
+	draw_open = false;
+	chunk = target.AcquireChunk(chunk_capacity);
+	chunk_quad_count = 0;
+	assert(chunk_capacity > 0 && reinterpret_cast<uintptr_t>(chunk) % 16 == 0);
+}
+
+void QuadBatch::End() {
+	if (chunk_quad_count > 0) {
+		Flush();
+	}
+	chunk = nullptr;
+	chunk_capacity = 0;
+}
+
+void QuadBatch::Flush() {
+#ifdef QUAD_BATCH_SSE
+	// Non-temporal stores are weakly ordered; make them visible before the memory is handed on.
+	_mm_sfence();
+#endif
+	target.SubmitDraws(draws);
+	frame_draw_count += static_cast<uint32_t>(draws.size());
+	draws.clear();
+	draw_open = false;
+	chunk_quad_count = 0;
+}
+
+void QuadBatch::SetScissor(const VkRect2D& new_scissor) {
+	if (memcmp(&scissor, &new_scissor, sizeof(scissor)) != 0) {
+		scissor = new_scissor;
+		draw_open = false;
+	}
+}
+
+void QuadBatch::DrawQuad(float x, float y, float width, float height, uint32_t color) {
+	WriteQuad(x, y, x + width, y, x + width, y + height, x, y + height, color);
+}
+
+void QuadBatch::DrawLine(float x0, float y0, float x1, float y1, float thickness, uint32_t color) {
+	float dx = x1 - x0;
+	float dy = y1 - y0;
+	float length = std::sqrt(dx * dx + dy * dy);
+	if (length == 0.0f) {
+		return;
+	}
+	float half = 0.5f * thickness / length;
+	float nx = -dy * half;
+	float ny = dx * half;
+	WriteQuad(x0 + nx, y0 + ny, x1 + nx, y1 + ny, x1 - nx, y1 - ny, x0 - nx, y0 - ny, color);
+}
+
+void QuadBatch::DrawRect(float x, float y, float width, float height, float thickness, uint32_t color) {
+	thickness = std::min(thickness, std::min(width, height) * 0.5f);
+	DrawQuad(x, y, width, thickness, color);
+	DrawQuad(x, y + height - thickness, width, thickness, color);
+	DrawQuad(x, y + thickness, thickness, height - 2.0f * thickness, color);
+	DrawQuad(x + width - thickness, y + thickness, thickness, height - 2.0f * thickness, color);
+}
+
+void QuadBatch::WriteQuad(float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3, uint32_t color) {
+	if (chunk_quad_count == chunk_capacity) {
+		Flush();
+		chunk = target.AcquireChunk(chunk_capacity);
+		assert(chunk_capacity > 0 && reinterpret_cast<uintptr_t>(chunk) % 16 == 0);
+	}
+	if (!draw_open) {
+		draws.push_back({ chunk_quad_count, 0, scissor });
+		draw_open = true;
+	}
+	++draws.back().quad_count;
+
+	BatchVertex* vertices = chunk + chunk_quad_count * 4;
+	++chunk_quad_count;
+	++frame_quad_count;
+
+#ifdef QUAD_BATCH_SSE
+	// Transforms all corners with two multiply-adds and writes the 48 byte quad as three
+	// aligned streaming stores: the mapped memory is usually write-combined and never read back.
+	__m128 scale = _mm_setr_ps(scale_x, scale_y, scale_x, scale_y);
+	__m128 offset = _mm_set1_ps(-1.0f);
+	__m128 v01 = _mm_add_ps(_mm_mul_ps(_mm_setr_ps(x0, y0, x1, y1), scale), offset);
+	__m128 v23 = _mm_add_ps(_mm_mul_ps(_mm_setr_ps(x2, y2, x3, y3), scale), offset);
+	__m128 c = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(color)));
+
+	// [x0 y0 c x1] [y1 c x2 y2] [c x3 y3 c]
+	__m128 c_x1 = _mm_shuffle_ps(c, v01, _MM_SHUFFLE(2, 2, 0, 0));
+	__m128 r0 = _mm_shuffle_ps(v01, c_x1, _MM_SHUFFLE(2, 0, 1, 0));
+	__m128 y1_c = _mm_shuffle_ps(v01, c, _MM_SHUFFLE(0, 0, 3, 3));
+	__m128 r1 = _mm_shuffle_ps(y1_c, v23, _MM_SHUFFLE(1, 0, 2, 0));
+	__m128 c_x3 = _mm_shuffle_ps(c, v23, _MM_SHUFFLE(3, 2, 0, 0));
+	__m128 r2 = _mm_shuffle_ps(c_x3, c_x3, _MM_SHUFFLE(0, 3, 2, 0));
+
+	float* out = reinterpret_cast<float*>(vertices);
+	_mm_stream_ps(out, r0);
+	_mm_stream_ps(out + 4, r1);
+	_mm_stream_ps(out + 8, r2);
+#else
+	vertices[0] = { x0 * scale_x - 1.0f, y0 * scale_y - 1.0f, color };
+	vertices[1] = { x1 * scale_x - 1.0f, y1 * scale_y - 1.0f, color };
+	vertices[2] = { x2 * scale_x - 1.0f, y2 * scale_y - 1.0f, color };
+	vertices[3] = { x3 * scale_x - 1.0f, y3 * scale_y - 1.0f, color };
+#endif
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <vector>
+#include <stdint.h>
+
+// Overlay vertex: normalized device coordinates and an RGBA8 color, 12 bytes.
+struct BatchVertex {
+	float x, y;
+	uint32_t color;
+};
+
+VkVertexInputBindingDescription GetBatchBindingDescription();
+std::array<VkVertexInputAttributeDescription, 2> GetBatchAttributeDescription();
+
+// Every quad is drawn from the same 6 indices relative to its first vertex, so one static
+// index buffer of 0 1 2 2 3 0, 4 5 6 6 7 4, ... serves all chunks.
+void WriteQuadIndices(uint32_t quad_count, uint16_t* indices);
+
+// Quads [first_quad, first_quad + quad_count) of the current chunk, clipped to scissor.
+struct QuadBatchDraw {
+	uint32_t first_quad;
+	uint32_t quad_count;
+	VkRect2D scissor;
+};
+
+// Where a QuadBatch writes to and what it hands its draws to. The renderer hands out
+// persistently mapped chunks of a per-frame streaming buffer and records the draws straight
+// into the frame's command buffer.
+class QuadBatchTarget {
+public:
+	virtual ~QuadBatchTarget();
+
+	// Returns memory for quad_capacity quads (4 vertices each), 16 byte aligned, that stays
+	// untouched by the GPU until the frame completes.
+	virtual BatchVertex* AcquireChunk(uint32_t& quad_capacity) = 0;
+
+	// Draws the quads written to the last acquired chunk.
+	virtual void SubmitDraws(const std::vector<QuadBatchDraw>& draws) = 0;
+};
+
+uint32_t PackColor(float r, float g, float b, float a = 1.0f);
+
+// Immediate-mode 2D renderer. Primitives are appended as quads in pixel coordinates (origin
+// top left) and written with SIMD stores straight into mapped memory. Consecutive quads with
+// the same scissor share a draw; the batch flushes when the chunk is full, so a frame costs one
+// draw per scissor change plus one per full chunk.
+class QuadBatch {
+public:
+	explicit QuadBatch(QuadBatchTarget& target);
+
+	// Starts a frame drawing into a target of extent, scissor reset to the whole target.
+	void Begin(VkExtent2D extent);
+	// Submits whatever is still pending.
+	void End();
+
+	void DrawQuad(float x, float y, float width, float height, uint32_t color);
+	// A thickness wide quad centered on the segment.
+	void DrawLine(float x0, float y0, float x1, float y1, float thickness, uint32_t color);
+	// Outline of the rectangle, thickness inside its bounds.
+	void DrawRect(float x, float y, float width, float height, float thickness, uint32_t color);
+
+	// Quads drawn after this are clipped to scissor. A different scissor starts a new draw.
+	void SetScissor(const VkRect2D& scissor);
+
+	// Totals of the current (or, after End, the last) frame.
+	uint32_t GetQuadCount() const { return frame_quad_count; }
+	uint32_t GetDrawCount() const { return frame_draw_count; }
+
+private:
+	void Flush();
+	// Corners in pixels, in winding order.
+	void WriteQuad(float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3, uint32_t color);
+
+	QuadBatchTarget& target;
+
+	BatchVertex* chunk = nullptr;
+	uint32_t chunk_capacity = 0;
+	uint32_t chunk_quad_count = 0;
+	std::vector<QuadBatchDraw> draws;
+	// Whether quads can still be appended to draws.back().
+	bool draw_open = false;
+
+	VkRect2D scissor = {};
+	// Pixel to normalized device coordinate transform.
+	float scale_x = 0.0f, scale_y = 0.0f;
+
+	uint32_t frame_quad_count = 0;
+	uint32_t frame_draw_count = 0;
+};
@@ -0,0 +1,170 @@
+#include "render_helpers.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <assert.h>
+#include <string.h>
+
+VkVertexInputBindingDescription GetBindingDescription() {
+	VkVertexInputBindingDescription binding_description = {};
+	binding_description.binding = 0;
+	binding_description.stride = sizeof(Vertex);
+	binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	return binding_description;
+}
+
+std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescription() {
+	std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions = {};
+
+	attribute_descriptions[0].binding = 0;
+	attribute_descriptions[0].location = 0;
+	attribute_descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+	attribute_descriptions[0].offset = offsetof(Vertex, pos);
+
+	attribute_descriptions[1].binding = 0;
+	attribute_descriptions[1].location = 1;
+	attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attribute_descriptions[1].offset = offsetof(Vertex, color);
+
+	attribute_descriptions[2].binding = 0;
+	attribute_descriptions[2].location = 2;
+	attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+	attribute_descriptions[2].offset = offsetof(Vertex, tex_coord);
+
+	return attribute_descriptions;
+}
+
+VkVertexInputBindingDescription GetParticleBindingDescription() {
+	VkVertexInputBindingDescription binding_description = {};
+	binding_description.binding = 0;
+	binding_description.stride = sizeof(ParticleVertex);
+	binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	return binding_description;
+}
+
+std::array<VkVertexInputAttributeDescription, 2> GetParticleAttributeDescription() {
+	std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions = {};
+
+	attribute_descriptions[0].binding = 0;
+	attribute_descriptions[0].location = 0;
+	attribute_descriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	attribute_descriptions[0].offset = offsetof(ParticleVertex, position);
+
+	attribute_descriptions[1].binding = 0;
+	attribute_descriptions[1].location = 1;
+	attribute_descriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	attribute_descriptions[1].offset = offsetof(ParticleVertex, color);
+
+	return attribute_descriptions;
+}
+
+VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const VkSurfaceFormatKHR* available_formats, uint32_t format_count) {
+	if (format_count == 1 && available_formats[0].format == VK_FORMAT_UNDEFINED) {
+		return { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+	}
+	for (uint32_t i = 0; i < format_count; ++i) {
+		if (available_formats[i].format == VK_FORMAT_B8G8R8A8_UNORM && available_formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+			return available_formats[i];
+		}
+	}
+	return available_formats[0];
+}
+
+VkPresentModeKHR ChooseSwapPresentMode(const VkPresentModeKHR* available_present_modes, uint32_t present_mode_count) {
+	VkPresentModeKHR best_mode = VK_PRESENT_MODE_FIFO_KHR;
+	for (uint32_t i = 0; i < present_mode_count; ++i) {
+		if (available_present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
+			return available_present_modes[i];
+		}
+		else if (available_present_modes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+			best_mode = available_present_modes[i];
+		}
+	}
+	return best_mode;
+}
+
+VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, int framebuffer_width, int framebuffer_height) {
+	if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+		return capabilities.currentExtent;
+	}
+	else {
+		VkExtent2D actual_extent = { static_cast<uint32_t>(framebuffer_width), static_cast<uint32_t>(framebuffer_height) };
+
+		actual_extent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actual_extent.width));
+		actual_extent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actual_extent.height));
+
+		return actual_extent;
+	}
+}
+
+std::vector<char> ReadFile(const std::string& filename) {
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open()) {
+		assert(0);
+	}
+
+	size_t file_size = (size_t)file.tellg();
+	std::vector<char> buffer(file_size);
+
+	file.seekg(0);
+	file.read(buffer.data(), file_size);
+
+	file.close();
+
+	return buffer;
+}
+
+glm::mat4 ComputeProjection(VkExtent2D extent) {
+	glm::mat4 proj = glm::perspective(glm::radians(45.0f), extent.width / (float)extent.height, 0.1f, 10.0f);
+	proj[1][1] *= -1;
+
+	return proj;
+}
+
+glm::mat4 ComputeView(const Camera& camera) {
+	return glm::lookAt(camera.eye, camera.target, camera.up);
+}
+
+void PackVertices(const std::vector<Vertex>& vertices, void* destination) {
+	memcpy(destination, vertices.data(), sizeof(vertices[0]) * vertices.size());
+}
+
+void PackIndices(const std::vector<uint16_t>& indices, void* destination) {
+	memcpy(destination, indices.data(), sizeof(indices[0]) * indices.size());
+}
+
+void TessellateQuad(uint32_t subdivisions, std::vector<Vertex>& vertices, std::vector<uint16_t>& indices) {
+	const glm::vec3 corner_colors[4] = {
+		{ 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f },
+	};
+	uint32_t row = subdivisions + 1;
+	assert(row * row <= std::numeric_limits<uint16_t>::max() + 1u);
+
+	vertices.clear();
+	indices.clear();
+	for (uint32_t y = 0; y <= subdivisions; ++y) {
+		for (uint32_t x = 0; x <= subdivisions; ++x) {
+			float u = static_cast<float>(x) / subdivisions;
+			float v = static_cast<float>(y) / subdivisions;
+			glm::vec3 bottom = glm::mix(corner_colors[0], corner_colors[1], u);
+			glm::vec3 top = glm::mix(corner_colors[3], corner_colors[2], u);
+			vertices.push_back({ { u - 0.5f, v - 0.5f }, glm::mix(bottom, top, v), { u, v } });
+		}
+	}
+	// Same winding as the single quad: 0 1 2, 2 3 0 per cell.
+	for (uint32_t y = 0; y < subdivisions; ++y) {
+		for (uint32_t x = 0; x < subdivisions; ++x) {
+			uint16_t a = static_cast<uint16_t>(y * row + x);
+			uint16_t b = static_cast<uint16_t>(a + 1);
+			uint16_t c = static_cast<uint16_t>(a + row + 1);
+			uint16_t d = static_cast<uint16_t>(a + row);
+			indices.insert(indices.end(), { a, b, c, c, d, a });
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <array>
+#include <string>
+
+// CPU-side helpers shared by the renderer and the benchmarks. Nothing in here touches a
+// device or a window, so it can be exercised without a GPU.
+
+struct Vertex {
+	glm::vec2 pos;
+	glm::vec3 color;
+	glm::vec2 tex_coord;
+};
+
+// Particle state lives in a buffer only the compute queue touches; each simulation step also
+// writes a vertex stream that the graphics queue draws as points.
+struct Particle {
+	glm::vec2 position;
+	glm::vec2 velocity;
+};
+
+struct ParticleVertex {
+	glm::vec4 position;
+	glm::vec4 color;
+};
+
+// Uniform data is split by how often it changes, one block (and descriptor binding) each.
+struct ProjectionUniforms {
+	glm::mat4 proj;
+};
+
+struct CameraUniforms {
+	glm::mat4 view;
+};
+
+struct ObjectUniforms {
+	glm::mat4 model;
+};
+
+struct Camera {
+	glm::vec3 eye;
+	glm::vec3 target;
+	glm::vec3 up;
+};
+
+VkVertexInputBindingDescription GetBindingDescription();
+std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescription();
+VkVertexInputBindingDescription GetParticleBindingDescription();
+std::array<VkVertexInputAttributeDescription, 2> GetParticleAttributeDescription();
+
+// Take arrays rather than vectors, so the caller decides where the surface queries live.
+VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const VkSurfaceFormatKHR* available_formats, uint32_t format_count);
+VkPresentModeKHR ChooseSwapPresentMode(const VkPresentModeKHR* available_present_modes, uint32_t present_mode_count);
+VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, int framebuffer_width, int framebuffer_height);
+
+std::vector<char> ReadFile(const std::string& filename);
+
+glm::mat4 ComputeProjection(VkExtent2D extent);
+glm::mat4 ComputeView(const Camera& camera);
+
+// Copies geometry into (mapped) staging memory in the layout the pipeline expects.
+void PackVertices(const std::vector<Vertex>& vertices, void* destination);
+void PackIndices(const std::vector<uint16_t>& indices, void* destination);
+
+// The textured quad as a subdivisions x subdivisions grid of vertices spanning -0.5..0.5, the
+// corner colors blended across it, so there are triangles to simplify into coarser levels.
+void TessellateQuad(uint32_t subdivisions, std::vector<Vertex>& vertices, std::vector<uint16_t>& indices);
@@ -0,0 +1,68 @@
+#include "resolution_scaling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Weight of a new sample in the smoothed full resolution time. A rising cost is followed
+// faster than a falling one, so a heavy scene sheds resolution within a few frames while a
+// single light frame does not bring it back.
+const float RISING_SMOOTHING = 0.5f;
+const float FALLING_SMOOTHING = 0.1f;
+// Scales are multiples of this, so small swings in the timings do not resize every frame.
+const float SCALE_STEP = 0.05f;
+// Growing must leave this fraction of the target unused.
+const float GROW_HEADROOM = 0.15f;
+// Samples to wait after a change, for the smoothed time to catch up with the new scale.
+const uint32_t SETTLE_SAMPLES = 4;
+
+// Largest multiple of SCALE_STEP up to scale; the epsilon keeps exact multiples from rounding
+// down a step.
+float QuantizeScale(float scale) {
+	return std::floor(scale / SCALE_STEP + 1e-3f) * SCALE_STEP;
+}
+
+}
+
+ResolutionController::ResolutionController(float target_milliseconds, float min_scale, float max_scale)
+	: target_milliseconds(target_milliseconds), min_scale(min_scale), max_scale(max_scale), scale(max_scale) {
+}
+
+void ResolutionController::AddFrameTime(float milliseconds, float frame_scale) {
+	if (milliseconds <= 0.0f || frame_scale <= 0.0f) {
+		return;
+	}
+	float time = milliseconds / (frame_scale * frame_scale);
+	float smoothing = time > full_resolution_time ? RISING_SMOOTHING : FALLING_SMOOTHING;
+	full_resolution_time = full_resolution_time == 0.0f ? time : full_resolution_time + smoothing * (time - full_resolution_time);
+
+	if (settle_samples > 0) {
+		--settle_samples;
+		return;
+	}
+
+	// Scales whose frames would just take the target, and leave the headroom.
+	float fitting_scale = std::sqrt(target_milliseconds / full_resolution_time);
+	float growing_scale = std::sqrt(target_milliseconds * (1.0f - GROW_HEADROOM) / full_resolution_time);
+	float new_scale = scale;
+	if (fitting_scale < scale) {
+		new_scale = QuantizeScale(fitting_scale);
+	}
+	else if (QuantizeScale(growing_scale) > scale) {
+		new_scale = QuantizeScale(growing_scale);
+	}
+	new_scale = std::min(std::max(new_scale, min_scale), max_scale);
+
+	if (new_scale != scale) {
+		scale = new_scale;
+		settle_samples = SETTLE_SAMPLES;
+		++change_count;
+	}
+}
+
+VkExtent2D GetScaledExtent(VkExtent2D extent, float scale) {
+	uint32_t width = static_cast<uint32_t>(std::lround(extent.width * scale));
+	uint32_t height = static_cast<uint32_t>(std::lround(extent.height * scale));
+	return { std::min(std::max(width, 1u), extent.width), std::min(std::max(height, 1u), extent.height) };
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <stdint.h>
+
+// Picks the fraction of a window's width and height the scene is rendered at, so that the GPU
+// time of a frame holds a target. Frame times are normalized to full resolution assuming they
+// grow with the pixel count, which lets timings of frames rendered before a change still count
+// after it. The scale moves in steps: down as soon as the smoothed cost misses the target, up
+// only once it would fit with some headroom, so a scene near the target keeps its scale.
+class ResolutionController {
+public:
+	ResolutionController(float target_milliseconds, float min_scale, float max_scale);
+
+	// GPU time of a frame and the scale it was rendered at, which is older than GetScale() by
+	// the frames in flight.
+	void AddFrameTime(float milliseconds, float frame_scale);
+
+	float GetScale() const { return scale; }
+	// Smoothed time a frame would take at full resolution; 0 before the first sample.
+	float GetFullResolutionTime() const { return full_resolution_time; }
+	uint64_t GetChangeCount() const { return change_count; }
+
+private:
+	float target_milliseconds;
+	float min_scale;
+	float max_scale;
+	float scale;
+	float full_resolution_time = 0.0f;
+	// Samples left before the scale may change again.
+	uint32_t settle_samples = 0;
+	uint64_t change_count = 0;
+};
+
+// extent scaled and rounded to whole pixels, at least 1x1.
+VkExtent2D GetScaledExtent(VkExtent2D extent, float scale);
@@ -0,0 +1,123 @@
+#include "shader_watcher.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+int64_t GetModifiedTime(const std::string& path) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) {
+		return -1;
+	}
+	return static_cast<int64_t>(info.st_mtime);
+}
+
+void AddChanged(std::vector<std::string>& changed, const std::string& path) {
+	if (std::find(changed.begin(), changed.end(), path) == changed.end()) {
+		changed.push_back(path);
+	}
+}
+
+}
+
+bool ReplaceFileAtomically(const std::string& from, const std::string& to) {
+#if defined(_WIN32)
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+ShaderWatcher::ShaderWatcher() {
+#ifdef __linux__
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher() {
+#ifdef __linux__
+	if (inotify_fd >= 0) {
+		close(inotify_fd);
+	}
+#endif
+}
+
+void ShaderWatcher::AddFile(const std::string& path) {
+	size_t separator = path.find_last_of("/\\");
+	WatchedFile file;
+	file.path = path;
+	file.directory = separator == std::string::npos ? "." : path.substr(0, separator);
+	file.name = separator == std::string::npos ? path : path.substr(separator + 1);
+	file.modified_time = GetModifiedTime(path);
+	files.push_back(file);
+
+#ifdef __linux__
+	if (inotify_fd < 0) {
+		return;
+	}
+	for (const auto& directory : directories) {
+		if (directory.directory == file.directory) {
+			return;
+		}
+	}
+	int descriptor = inotify_add_watch(inotify_fd, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (descriptor >= 0) {
+		directories.push_back({ file.directory, descriptor });
+	}
+#endif
+}
+
+void ShaderWatcher::Poll(std::vector<std::string>& changed) {
+#ifdef __linux__
+	if (inotify_fd >= 0) {
+		alignas(inotify_event) char buffer[4096];
+		for (;;) {
+			ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+			if (length <= 0) {
+				break;
+			}
+			for (ssize_t offset = 0; offset < length;) {
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+				if (event->len == 0) {
+					continue;
+				}
+				for (const auto& directory : directories) {
+					if (directory.descriptor != event->wd) {
+						continue;
+					}
+					for (const auto& file : files) {
+						if (file.directory == directory.directory && file.name == event->name) {
+							AddChanged(changed, file.path);
+						}
+					}
+				}
+			}
+		}
+		return;
+	}
+#endif
+
+	for (auto& file : files) {
+		int64_t modified_time = GetModifiedTime(file.path);
+		if (modified_time != file.modified_time) {
+			file.modified_time = modified_time;
+			if (modified_time >= 0) {
+				AddChanged(changed, file.path);
+			}
+		}
+	}
+}
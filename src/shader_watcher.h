@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Moves from over to, replacing it in one step, so readers of to never find it missing.
+bool ReplaceFileAtomically(const std::string& from, const std::string& to);
+
+// Reports files that were written since the last poll. Uses inotify on the files' directories
+// where available, so polling is a single non-blocking read; elsewhere it compares
+// modification times. Editors that save through a temporary file and a rename are seen as a
+// write of the target.
+class ShaderWatcher {
+public:
+	ShaderWatcher();
+	~ShaderWatcher();
+
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	void AddFile(const std::string& path);
+
+	// Appends every added path that changed since the last call, each at most once.
+	void Poll(std::vector<std::string>& changed);
+
+private:
+	struct WatchedFile {
+		std::string path;
+		std::string directory;
+		std::string name;
+		int64_t modified_time;
+	};
+
+	std::vector<WatchedFile> files;
+#ifdef __linux__
+	struct WatchedDirectory {
+		std::string directory;
+		int descriptor;
+	};
+
+	int inotify_fd = -1;
+	std::vector<WatchedDirectory> directories;
+#endif
+};
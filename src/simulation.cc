@@ -0,0 +1,84 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+SimulationState StepSimulation(const SimulationState& state, double tick) {
+	SimulationState next = state;
+	next.time += tick;
+	next.rotation += state.rotation_speed * tick;
+	return next;
+}
+
+SimulationState InterpolateSimulation(const SimulationState& a, const SimulationState& b, double alpha) {
+	SimulationState state = b;
+	state.time = a.time + (b.time - a.time) * alpha;
+	state.rotation = a.rotation + (b.rotation - a.rotation) * alpha;
+	return state;
+}
+
+Simulation::Simulation(double tick, const SimulationState& initial_state) : tick(tick), state(initial_state) {
+	snapshots.GetWriteBuffer() = { state, state, 0.0, 0 };
+	snapshots.Publish();
+}
+
+Simulation::~Simulation() {
+	Stop();
+}
+
+void Simulation::Start(const Clock& clock) {
+	stopping = false;
+	thread = std::thread(&Simulation::Run, this, std::cref(clock));
+}
+
+void Simulation::Stop() {
+	stopping = true;
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void Simulation::Run(const Clock& clock) {
+	while (!stopping) {
+		double now = clock.Now();
+		AdvanceTo(now);
+		// Sleeps for whole ticks; a late wake up is caught up by the next AdvanceTo.
+		std::this_thread::sleep_for(std::chrono::duration<double>(std::max(next_tick_time - now, 0.0)));
+	}
+}
+
+void Simulation::AdvanceTo(double time) {
+	if (time < next_tick_time) {
+		return;
+	}
+
+	uint64_t due = static_cast<uint64_t>(std::floor((time - next_tick_time) / tick)) + 1;
+	if (due > MAX_CATCH_UP_TICKS) {
+		dropped_ticks += due - MAX_CATCH_UP_TICKS;
+		next_tick_time += (due - MAX_CATCH_UP_TICKS) * tick;
+		due = MAX_CATCH_UP_TICKS;
+	}
+
+	SimulationState previous = state;
+	double current_time = next_tick_time;
+	for (uint64_t i = 0; i < due; ++i) {
+		previous = state;
+		if (!paused) {
+			state = StepSimulation(state, tick);
+		}
+		current_time = next_tick_time;
+		next_tick_time += tick;
+	}
+	tick_count += due;
+
+	snapshots.GetWriteBuffer() = { previous, state, current_time, tick_count };
+	snapshots.Publish();
+}
+
+SimulationState Simulation::Sample(double time) {
+	snapshots.Update();
+	const SimulationSnapshot& snapshot = snapshots.GetReadBuffer();
+	double alpha = std::min(std::max((time - snapshot.current_time) / tick, 0.0), 1.0);
+	return InterpolateSimulation(snapshot.previous, snapshot.current, alpha);
+}
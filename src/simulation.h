@@ -0,0 +1,77 @@
+#pragma once
+
+#include "clock.h"
+#include "triple_buffer.h"
+
+#include <atomic>
+#include <thread>
+#include <stdint.h>
+
+// Everything the fixed-step simulation owns. Immutable once published.
+struct SimulationState {
+	// Simulated seconds; stands still while paused.
+	double time = 0.0;
+	// Radians about the scene's up axis. Not wrapped, so states interpolate linearly.
+	double rotation = 0.0;
+	double rotation_speed = 0.0;
+};
+
+SimulationState StepSimulation(const SimulationState& state, double tick);
+SimulationState InterpolateSimulation(const SimulationState& a, const SimulationState& b, double alpha);
+
+// The two most recent ticks. The tick run at clock time current_time stepped previous to
+// current, so the states bracket [current_time, current_time + tick].
+struct SimulationSnapshot {
+	SimulationState previous;
+	SimulationState current;
+	double current_time = 0.0;
+	uint64_t tick = 0;
+};
+
+// Steps SimulationState at a fixed tick and publishes every step through a triple buffer.
+// AdvanceTo can run on a thread of its own (Start) or inline on the render thread, which is
+// what a FixedStepClock needs. The renderer interpolates between the last two ticks, so motion
+// stays smooth at any frame rate. It never waits on the simulation, and a slow frame never
+// holds the simulation back.
+class Simulation {
+public:
+	// Steps beyond this many behind the clock are dropped instead of caught up, so a stall
+	// does not turn into a burst of ticks.
+	static const uint32_t MAX_CATCH_UP_TICKS = 8;
+
+	Simulation(double tick, const SimulationState& initial_state);
+	~Simulation();
+
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+
+	// Runs AdvanceTo(clock.Now()) on a new thread every tick until Stop. clock must be safe
+	// to read from that thread.
+	void Start(const Clock& clock);
+	void Stop();
+
+	// Writer side: runs every tick due by time and publishes the result.
+	void AdvanceTo(double time);
+	void SetPaused(bool paused) { this->paused = paused; }
+
+	// Reader side: the state at time, interpolated from the latest snapshot. Holds at the
+	// newest tick when the simulation has fallen behind time.
+	SimulationState Sample(double time);
+
+	// Written by the simulating thread; only exact once it stopped.
+	uint64_t GetTickCount() const { return tick_count; }
+	uint64_t GetDroppedTickCount() const { return dropped_ticks; }
+
+private:
+	void Run(const Clock& clock);
+
+	double tick;
+	SimulationState state;
+	double next_tick_time = 0.0;
+	std::atomic<uint64_t> tick_count{ 0 };
+	std::atomic<uint64_t> dropped_ticks{ 0 };
+	std::atomic<bool> paused{ false };
+	std::atomic<bool> stopping{ false };
+	std::thread thread;
+	TripleBuffer<SimulationSnapshot> snapshots;
+};
@@ -0,0 +1,51 @@
+#include "staging_ring.h"
+
+#include <assert.h>
+
+const uint64_t StagingRing::INVALID_OFFSET;
+
+StagingRing::StagingRing(uint64_t capacity) : capacity(capacity) {
+}
+
+uint64_t StagingRing::Allocate(uint64_t size, uint64_t alignment, uint64_t value) {
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	if (used == 0) {
+		head = 0;
+		tail = 0;
+	}
+	else if (head == tail) {
+		return INVALID_OFFSET;
+	}
+
+	uint64_t offset = (head + alignment - 1) & ~(alignment - 1);
+	uint64_t padding = offset - head;
+	if (head >= tail) {
+		// Free space is [head, capacity) followed by [0, tail). Skipping the end of the buffer
+		// on wrap is charged to this allocation.
+		if (offset + size > capacity) {
+			if (size > tail) {
+				return INVALID_OFFSET;
+			}
+			padding = capacity - head;
+			offset = 0;
+		}
+	}
+	else if (offset + size > tail) {
+		return INVALID_OFFSET;
+	}
+
+	spans.push_back({ value, offset + size, padding + size });
+	used += padding + size;
+	head = offset + size;
+
+	return offset;
+}
+
+void StagingRing::Release(uint64_t completed_value) {
+	while (!spans.empty() && spans.front().value <= completed_value) {
+		tail = spans.front().end;
+		used -= spans.front().size;
+		spans.pop_front();
+	}
+}
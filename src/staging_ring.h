@@ -0,0 +1,38 @@
+#pragma once
+
+#include <deque>
+#include <stdint.h>
+
+// Sub-allocates a persistently mapped upload buffer in FIFO order. Every allocation is tagged
+// with the timeline value signaled by the submit that reads it and is reclaimed once the GPU
+// reached that value, so uploads never wait on a fence of their own.
+class StagingRing {
+public:
+	static const uint64_t INVALID_OFFSET = ~0ull;
+
+	explicit StagingRing(uint64_t capacity);
+
+	// Returns the offset of size bytes aligned to alignment (a power of two), or INVALID_OFFSET
+	// when the ring has no room until older submits are released.
+	uint64_t Allocate(uint64_t size, uint64_t alignment, uint64_t value);
+
+	// Reclaims every allocation tagged with a value <= completed_value.
+	void Release(uint64_t completed_value);
+
+	uint64_t GetCapacity() const { return capacity; }
+	// Bytes held by live allocations, including alignment padding and the skipped tail on wrap.
+	uint64_t GetUsed() const { return used; }
+
+private:
+	struct Span {
+		uint64_t value;
+		uint64_t end;
+		uint64_t size;
+	};
+
+	uint64_t capacity;
+	uint64_t head = 0;
+	uint64_t tail = 0;
+	uint64_t used = 0;
+	std::deque<Span> spans;
+};
@@ -0,0 +1,130 @@
+#include "texture_container.h"
+
+#include <algorithm>
+#include <string.h>
+
+const std::vector<TextureContainerFormat> TEXTURE_CONTAINER_FORMATS = {
+	{ VK_FORMAT_BC1_RGB_UNORM_BLOCK, ".bc1.ktx2" },
+	{ VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, ".etc2.ktx2" },
+	{ VK_FORMAT_R8G8B8A8_UNORM, ".rgba8.ktx2" },
+};
+
+namespace {
+
+const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// Fields are little-endian, which every platform this builds for is.
+struct Ktx2Header {
+	uint8_t identifier[12];
+	uint32_t vk_format;
+	uint32_t type_size;
+	uint32_t pixel_width;
+	uint32_t pixel_height;
+	uint32_t pixel_depth;
+	uint32_t layer_count;
+	uint32_t face_count;
+	uint32_t level_count;
+	uint32_t supercompression_scheme;
+	uint32_t dfd_byte_offset;
+	uint32_t dfd_byte_length;
+	uint32_t kvd_byte_offset;
+	uint32_t kvd_byte_length;
+	uint64_t sgd_byte_offset;
+	uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+struct Ktx2LevelIndex {
+	uint64_t byte_offset;
+	uint64_t byte_length;
+	uint64_t uncompressed_byte_length;
+};
+
+}
+
+const char* GetTextureContainerSuffix(VkFormat format) {
+	for (const auto& container_format : TEXTURE_CONTAINER_FORMATS) {
+		if (container_format.format == format) {
+			return container_format.suffix;
+		}
+	}
+	return nullptr;
+}
+
+uint64_t GetTextureLevelSize(VkFormat format, uint32_t width, uint32_t height) {
+	switch (format) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return static_cast<uint64_t>(width) * height * 4;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+		return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * 8;
+	default:
+		return 0;
+	}
+}
+
+std::vector<char> WriteTextureContainer(VkFormat format, const std::vector<MipLevel>& mips) {
+	Ktx2Header header = {};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vk_format = format;
+	header.type_size = 1;
+	header.pixel_width = mips[0].width;
+	header.pixel_height = mips[0].height;
+	header.layer_count = 0;
+	header.face_count = 1;
+	header.level_count = static_cast<uint32_t>(mips.size());
+
+	// Header and index sizes are multiples of 8, and so is every level size, which keeps all
+	// levels aligned to the texel block size.
+	std::vector<Ktx2LevelIndex> index(mips.size());
+	uint64_t offset = sizeof(Ktx2Header) + sizeof(Ktx2LevelIndex) * index.size();
+	for (size_t level = mips.size(); level-- > 0;) {
+		index[level].byte_offset = offset;
+		index[level].byte_length = mips[level].data.size();
+		index[level].uncompressed_byte_length = mips[level].data.size();
+		offset += (mips[level].data.size() + 7) & ~uint64_t(7);
+	}
+
+	std::vector<char> file(offset);
+	memcpy(file.data(), &header, sizeof(header));
+	memcpy(file.data() + sizeof(header), index.data(), sizeof(Ktx2LevelIndex) * index.size());
+	for (size_t level = 0; level < mips.size(); ++level) {
+		memcpy(file.data() + index[level].byte_offset, mips[level].data.data(), mips[level].data.size());
+	}
+	return file;
+}
+
+bool ReadTextureContainer(const std::vector<char>& file, VkFormat& format, std::vector<MipLevel>& mips) {
+	Ktx2Header header;
+	if (file.size() < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 || header.supercompression_scheme != 0 ||
+		header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1 ||
+		header.level_count == 0 || header.level_count > 32) {
+		return false;
+	}
+	format = static_cast<VkFormat>(header.vk_format);
+
+	if (file.size() < sizeof(header) + sizeof(Ktx2LevelIndex) * header.level_count) {
+		return false;
+	}
+	std::vector<Ktx2LevelIndex> index(header.level_count);
+	memcpy(index.data(), file.data() + sizeof(header), sizeof(Ktx2LevelIndex) * index.size());
+
+	mips.assign(header.level_count, MipLevel());
+	for (uint32_t level = 0; level < header.level_count; ++level) {
+		MipLevel& mip = mips[level];
+		mip.width = std::max(header.pixel_width >> level, 1u);
+		mip.height = std::max(header.pixel_height >> level, 1u);
+
+		uint64_t size = GetTextureLevelSize(format, mip.width, mip.height);
+		if (size == 0 || index[level].byte_length != size || index[level].byte_offset > file.size() || file.size() - index[level].byte_offset < size) {
+			return false;
+		}
+		mip.data.resize(size);
+		memcpy(mip.data.data(), file.data() + index[level].byte_offset, size);
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "texture_data.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <stdint.h>
+
+// Textures are transcoded at build time into a KTX2-layout container: the KTX2 header and
+// level index followed by the level data, stored coarsest level first as KTX2 lays it out.
+// The data format descriptor and key/value data are left out (offsets are 0); the vkFormat
+// field is all the loader needs.
+
+// The formats texture_compiler emits, in the order the runtime prefers them.
+struct TextureContainerFormat {
+	VkFormat format;
+	// Appended to the texture base name, e.g. "textures/checker" + ".bc1.ktx2".
+	const char* suffix;
+};
+extern const std::vector<TextureContainerFormat> TEXTURE_CONTAINER_FORMATS;
+
+const char* GetTextureContainerSuffix(VkFormat format);
+
+// Size in bytes of a width x height level of format, 0 for formats the container does not carry.
+uint64_t GetTextureLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+std::vector<char> WriteTextureContainer(VkFormat format, const std::vector<MipLevel>& mips);
+
+// Validates the header and level index against the file size and the level dimensions.
+bool ReadTextureContainer(const std::vector<char>& file, VkFormat& format, std::vector<MipLevel>& mips);
@@ -0,0 +1,111 @@
+#include "texture_data.h"
+
+#include <algorithm>
+#include <ctype.h>
+
+namespace {
+
+// Reads the next whitespace separated unsigned integer of a PPM header, skipping comments.
+bool ReadHeaderValue(const std::vector<char>& file, size_t& offset, uint32_t& value) {
+	while (offset < file.size()) {
+		if (file[offset] == '#') {
+			while (offset < file.size() && file[offset] != '\n') {
+				++offset;
+			}
+		}
+		else if (isspace(static_cast<unsigned char>(file[offset]))) {
+			++offset;
+		}
+		else {
+			break;
+		}
+	}
+
+	if (offset >= file.size() || !isdigit(static_cast<unsigned char>(file[offset]))) {
+		return false;
+	}
+	value = 0;
+	while (offset < file.size() && isdigit(static_cast<unsigned char>(file[offset]))) {
+		value = value * 10 + (file[offset] - '0');
+		++offset;
+	}
+	return true;
+}
+
+}
+
+bool DecodePpm(const std::vector<char>& file, MipLevel& image) {
+	if (file.size() < 2 || file[0] != 'P' || file[1] != '6') {
+		return false;
+	}
+
+	size_t offset = 2;
+	uint32_t width, height, max_value;
+	if (!ReadHeaderValue(file, offset, width) || !ReadHeaderValue(file, offset, height) || !ReadHeaderValue(file, offset, max_value)) {
+		return false;
+	}
+	// A single whitespace byte separates the header from the pixels.
+	++offset;
+
+	size_t pixel_count = static_cast<size_t>(width) * height;
+	if (max_value != 255 || width == 0 || height == 0 || file.size() < offset + pixel_count * 3) {
+		return false;
+	}
+
+	image.width = width;
+	image.height = height;
+	image.data.resize(pixel_count * 4);
+
+	const uint8_t* src = reinterpret_cast<const uint8_t*>(file.data() + offset);
+	uint8_t* dst = image.data.data();
+	for (size_t i = 0; i < pixel_count; ++i) {
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 255;
+		src += 3;
+		dst += 4;
+	}
+
+	return true;
+}
+
+std::vector<MipLevel> GenerateMipChain(MipLevel base) {
+	std::vector<MipLevel> mips;
+	mips.push_back(std::move(base));
+
+	while (mips.back().width > 1 || mips.back().height > 1) {
+		const MipLevel& src = mips.back();
+
+		MipLevel dst;
+		dst.width = std::max(src.width / 2, 1u);
+		dst.height = std::max(src.height / 2, 1u);
+		dst.data.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+		for (uint32_t y = 0; y < dst.height; ++y) {
+			const uint8_t* row0 = &src.data[static_cast<size_t>(std::min(y * 2, src.height - 1)) * src.width * 4];
+			const uint8_t* row1 = &src.data[static_cast<size_t>(std::min(y * 2 + 1, src.height - 1)) * src.width * 4];
+			uint8_t* out = &dst.data[static_cast<size_t>(y) * dst.width * 4];
+
+			for (uint32_t x = 0; x < dst.width; ++x) {
+				uint32_t x0 = std::min(x * 2, src.width - 1) * 4;
+				uint32_t x1 = std::min(x * 2 + 1, src.width - 1) * 4;
+				for (uint32_t c = 0; c < 4; ++c) {
+					out[x * 4 + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+				}
+			}
+		}
+
+		mips.push_back(std::move(dst));
+	}
+
+	return mips;
+}
+
+uint64_t GetMipChainSize(const std::vector<MipLevel>& mips) {
+	uint64_t size = 0;
+	for (const auto& mip : mips) {
+		size += mip.data.size();
+	}
+	return size;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+// One mip level: tightly packed RGBA8 rows, or rows of 4x4 blocks for block-compressed
+// formats. width and height are in texels either way.
+struct MipLevel {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> data;
+};
+
+// Decodes a binary PPM (P6, 8 bits per channel) into RGBA8 with opaque alpha.
+bool DecodePpm(const std::vector<char>& file, MipLevel& image);
+
+// Returns the full mip chain, level 0 being base, down to 1x1. Each level is a 2x2 box filter
+// of the previous one; odd dimensions clamp the last row/column.
+std::vector<MipLevel> GenerateMipChain(MipLevel base);
+
+uint64_t GetMipChainSize(const std::vector<MipLevel>& mips);
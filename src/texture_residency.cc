@@ -0,0 +1,132 @@
+#include "texture_residency.h"
+
+#include <algorithm>
+#include <assert.h>
+
+TextureResidency::TextureResidency(uint64_t budget_bytes) : budget_bytes(budget_bytes) {
+}
+
+void TextureResidency::Reserve(uint32_t texture_count) {
+	textures.reserve(texture_count);
+	candidates.reserve(texture_count);
+}
+
+uint32_t TextureResidency::AddTexture(const std::vector<uint64_t>& level_sizes) {
+	assert(!level_sizes.empty() && level_sizes.size() <= MAX_LEVELS);
+
+	Texture texture;
+	std::copy(level_sizes.begin(), level_sizes.end(), texture.level_sizes.begin());
+	texture.level_count = static_cast<uint32_t>(level_sizes.size());
+	texture.first_resident_level = texture.level_count;
+	texture.last_used_frame = 0;
+	textures.push_back(texture);
+	candidates.reserve(textures.size());
+
+	return static_cast<uint32_t>(textures.size() - 1);
+}
+
+void TextureResidency::Touch(uint32_t texture, uint64_t frame) {
+	textures[texture].last_used_frame = std::max(textures[texture].last_used_frame, frame);
+}
+
+bool TextureResidency::PlanReservation(uint32_t texture) const {
+	candidates.clear();
+	const Texture& requester = textures[texture];
+	if (requester.first_resident_level == 0) {
+		return false;
+	}
+
+	uint64_t needed = requester.level_sizes[requester.first_resident_level - 1];
+	if (needed > budget_bytes) {
+		return false;
+	}
+
+	// Textures used as recently as the requester are never evicted for it, so two visible
+	// textures cannot thrash each other's mips.
+	for (uint32_t i = 0; i < textures.size(); ++i) {
+		const Texture& candidate = textures[i];
+		if (i != texture && candidate.last_used_frame < requester.last_used_frame && candidate.first_resident_level + 1 < candidate.level_count) {
+			candidates.push_back(i);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+		return textures[a].last_used_frame < textures[b].last_used_frame;
+	});
+
+	uint64_t reclaimable = 0;
+	for (uint32_t candidate : candidates) {
+		const Texture& t = textures[candidate];
+		for (uint32_t level = t.first_resident_level; level + 1 < t.level_count; ++level) {
+			reclaimable += t.level_sizes[level];
+		}
+	}
+
+	return resident_bytes + needed <= budget_bytes + reclaimable;
+}
+
+bool TextureResidency::CanReserveNextLevel(uint32_t texture) const {
+	return PlanReservation(texture);
+}
+
+bool TextureResidency::ReserveNextLevel(uint32_t texture, std::vector<uint32_t>& evicted_textures) {
+	if (!PlanReservation(texture)) {
+		return false;
+	}
+
+	Texture& requester = textures[texture];
+	uint64_t needed = requester.level_sizes[requester.first_resident_level - 1];
+
+	// Finest levels of the least recently used texture go first.
+	for (uint32_t candidate : candidates) {
+		if (resident_bytes + needed <= budget_bytes) {
+			break;
+		}
+
+		Texture& t = textures[candidate];
+		while (resident_bytes + needed > budget_bytes && t.first_resident_level + 1 < t.level_count) {
+			resident_bytes -= t.level_sizes[t.first_resident_level];
+			evicted_bytes += t.level_sizes[t.first_resident_level];
+			++t.first_resident_level;
+		}
+		evicted_textures.push_back(candidate);
+	}
+
+	--requester.first_resident_level;
+	resident_bytes += needed;
+
+	return true;
+}
+
+void TextureResidency::SetBudget(uint64_t budget) {
+	budget_bytes = budget;
+}
+
+void TextureResidency::EvictToBudget(std::vector<uint32_t>& evicted_textures) {
+	if (resident_bytes <= budget_bytes) {
+		return;
+	}
+
+	candidates.clear();
+	for (uint32_t i = 0; i < textures.size(); ++i) {
+		if (textures[i].first_resident_level + 1 < textures[i].level_count) {
+			candidates.push_back(i);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+		return textures[a].last_used_frame < textures[b].last_used_frame;
+	});
+
+	for (uint32_t candidate : candidates) {
+		if (resident_bytes <= budget_bytes) {
+			break;
+		}
+
+		Texture& t = textures[candidate];
+		while (resident_bytes > budget_bytes && t.first_resident_level + 1 < t.level_count) {
+			resident_bytes -= t.level_sizes[t.first_resident_level];
+			evicted_bytes += t.level_sizes[t.first_resident_level];
+			++t.first_resident_level;
+		}
+		evicted_textures.push_back(candidate);
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <stdint.h>
+
+// Tracks which mip levels of every streamed texture are resident against a fixed VRAM budget.
+// Levels are made resident coarsest-first and stay contiguous: a texture holds levels
+// [first_resident_level, level_count). The coarsest level is never evicted once resident, so
+// a texture can always be sampled.
+//
+// Only AddTexture allocates, and not even that once Reserve made room for every texture, so
+// the per-frame calls never touch the heap.
+class TextureResidency {
+public:
+	// A 32 bit extent has at most 32 levels.
+	static const uint32_t MAX_LEVELS = 32;
+
+	explicit TextureResidency(uint64_t budget_bytes);
+
+	void Reserve(uint32_t texture_count);
+	// level_sizes[0] is the finest level, at most MAX_LEVELS of them. Nothing is resident yet.
+	uint32_t AddTexture(const std::vector<uint64_t>& level_sizes);
+
+	// Records that texture was used by frame, for least recently used eviction.
+	void Touch(uint32_t texture, uint64_t frame);
+
+	// Makes the next finer level of texture resident in the budget. When it does not fit, the
+	// finest levels of textures used less recently than this one are evicted first; their ids
+	// are appended to evicted_textures. Returns false (and evicts nothing) when the level cannot
+	// be made to fit or the texture is already fully resident.
+	bool ReserveNextLevel(uint32_t texture, std::vector<uint32_t>& evicted_textures);
+	// Whether ReserveNextLevel would succeed, without changing anything.
+	bool CanReserveNextLevel(uint32_t texture) const;
+
+	// Changes the budget, e.g. to shed memory when the device runs low. Nothing is evicted
+	// until EvictToBudget.
+	void SetBudget(uint64_t budget);
+	// Evicts the finest levels of the least recently used textures until the resident levels fit
+	// the budget again (or only coarsest levels are left). Evicted ids are appended to
+	// evicted_textures.
+	void EvictToBudget(std::vector<uint32_t>& evicted_textures);
+
+	// Level count when nothing is resident.
+	uint32_t GetFirstResidentLevel(uint32_t texture) const { return textures[texture].first_resident_level; }
+	uint32_t GetLevelCount(uint32_t texture) const { return textures[texture].level_count; }
+	bool IsFullyResident(uint32_t texture) const { return textures[texture].first_resident_level == 0; }
+	uint64_t GetLastUsedFrame(uint32_t texture) const { return textures[texture].last_used_frame; }
+	uint32_t GetTextureCount() const { return static_cast<uint32_t>(textures.size()); }
+
+	uint64_t GetBudget() const { return budget_bytes; }
+	uint64_t GetResidentBytes() const { return resident_bytes; }
+	uint64_t GetEvictedBytes() const { return evicted_bytes; }
+
+private:
+	// Collects the textures ReserveNextLevel may evict from into candidates, least recently
+	// used first, and returns whether evicting all of them makes the next level of texture fit.
+	bool PlanReservation(uint32_t texture) const;
+
+	struct Texture {
+		std::array<uint64_t, MAX_LEVELS> level_sizes;
+		uint32_t level_count;
+		uint32_t first_resident_level;
+		uint64_t last_used_frame;
+	};
+
+	uint64_t budget_bytes;
+	uint64_t resident_bytes = 0;
+	uint64_t evicted_bytes = 0;
+	std::vector<Texture> textures;
+	// Scratch for the eviction order, with room for every texture.
+	mutable std::vector<uint32_t> candidates;
+};
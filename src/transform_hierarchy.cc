@@ -0,0 +1,228 @@
+#include "transform_hierarchy.h"
+
+#include <algorithm>
+#include <assert.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_HIERARCHY_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+const uint32_t LANES = 4;
+
+}
+
+const uint32_t TransformHierarchy::NO_PARENT;
+
+uint32_t TransformHierarchy::AddNode(uint32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+	assert(parent == NO_PARENT || parent < node_count);
+
+	uint32_t node = node_count++;
+	uint32_t padded_count = (node_count + LANES - 1) / LANES * LANES;
+	if (padded_count > parents.size()) {
+		// Padding lanes hold identity transforms and are never marked dirty.
+		translation_x.resize(padded_count, 0.0f);
+		translation_y.resize(padded_count, 0.0f);
+		translation_z.resize(padded_count, 0.0f);
+		rotation_x.resize(padded_count, 0.0f);
+		rotation_y.resize(padded_count, 0.0f);
+		rotation_z.resize(padded_count, 0.0f);
+		rotation_w.resize(padded_count, 1.0f);
+		scale_x.resize(padded_count, 1.0f);
+		scale_y.resize(padded_count, 1.0f);
+		scale_z.resize(padded_count, 1.0f);
+		parents.resize(padded_count, NO_PARENT);
+		dirty.resize(padded_count, 0);
+		world_matrices.resize(padded_count, glm::mat4(1.0f));
+	}
+
+	parents[node] = parent;
+	SetTranslation(node, translation);
+	SetRotation(node, rotation);
+	SetScale(node, scale);
+
+	return node;
+}
+
+void TransformHierarchy::SetTranslation(uint32_t node, const glm::vec3& translation) {
+	translation_x[node] = translation.x;
+	translation_y[node] = translation.y;
+	translation_z[node] = translation.z;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetRotation(uint32_t node, const glm::quat& rotation) {
+	rotation_x[node] = rotation.x;
+	rotation_y[node] = rotation.y;
+	rotation_z[node] = rotation.z;
+	rotation_w[node] = rotation.w;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetScale(uint32_t node, const glm::vec3& scale) {
+	scale_x[node] = scale.x;
+	scale_y[node] = scale.y;
+	scale_z[node] = scale.z;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::MarkDirty(uint32_t node) {
+	dirty[node] = 1;
+	first_dirty = std::min(first_dirty, node);
+}
+
+void TransformHierarchy::Update() {
+	updated_node_count = 0;
+	if (first_dirty >= node_count) {
+		return;
+	}
+
+	uint32_t start = first_dirty / LANES * LANES;
+	glm::mat4 local[LANES];
+	for (uint32_t first = start; first < node_count; first += LANES) {
+		uint32_t last = std::min(first + LANES, node_count);
+
+		// Parents precede children, so a parent's flag is final by the time its children are
+		// visited and dirtiness flows down the subtree within the same pass.
+		bool any_dirty = false;
+		for (uint32_t node = first; node < last; ++node) {
+			uint32_t parent = parents[node];
+			if (parent != NO_PARENT && dirty[parent]) {
+				dirty[node] = 1;
+			}
+			any_dirty |= dirty[node] != 0;
+		}
+		if (!any_dirty) {
+			continue;
+		}
+
+		ComputeLocalMatrices(first, local);
+
+		for (uint32_t node = first; node < last; ++node) {
+			if (!dirty[node]) {
+				continue;
+			}
+			uint32_t parent = parents[node];
+			if (parent == NO_PARENT) {
+				world_matrices[node] = local[node - first];
+			}
+			else {
+				MultiplyMatrices(world_matrices[parent], local[node - first], world_matrices[node]);
+			}
+			++updated_node_count;
+		}
+	}
+
+	// Flags are cleared after the pass since children read their parent's flag.
+	for (uint32_t node = start; node < node_count; ++node) {
+		dirty[node] = 0;
+	}
+	first_dirty = NO_PARENT;
+}
+
+// Builds T * R * S for four consecutive nodes at once, one node per SIMD lane.
+void TransformHierarchy::ComputeLocalMatrices(uint32_t first, glm::mat4* local) const {
+#ifdef TRANSFORM_HIERARCHY_SSE
+	__m128 x = _mm_loadu_ps(&rotation_x[first]);
+	__m128 y = _mm_loadu_ps(&rotation_y[first]);
+	__m128 z = _mm_loadu_ps(&rotation_z[first]);
+	__m128 w = _mm_loadu_ps(&rotation_w[first]);
+	__m128 sx = _mm_loadu_ps(&scale_x[first]);
+	__m128 sy = _mm_loadu_ps(&scale_y[first]);
+	__m128 sz = _mm_loadu_ps(&scale_z[first]);
+
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 zero = _mm_setzero_ps();
+
+	__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+	__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+	__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+	// Rows of the scaled rotation, transposed below into per-node columns.
+	__m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+	__m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+	__m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+	__m128 c0w = zero;
+
+	__m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+	__m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+	__m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+	__m128 c1w = zero;
+
+	__m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+	__m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+	__m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+	__m128 c2w = zero;
+
+	__m128 c3x = _mm_loadu_ps(&translation_x[first]);
+	__m128 c3y = _mm_loadu_ps(&translation_y[first]);
+	__m128 c3z = _mm_loadu_ps(&translation_z[first]);
+	__m128 c3w = one;
+
+	_MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+	_MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+	_MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+	_MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+	__m128 columns[4][LANES] = {
+		{ c0x, c0y, c0z, c0w },
+		{ c1x, c1y, c1z, c1w },
+		{ c2x, c2y, c2z, c2w },
+		{ c3x, c3y, c3z, c3w },
+	};
+	for (uint32_t lane = 0; lane < LANES; ++lane) {
+		float* out = &local[lane][0][0];
+		_mm_storeu_ps(out + 0, columns[0][lane]);
+		_mm_storeu_ps(out + 4, columns[1][lane]);
+		_mm_storeu_ps(out + 8, columns[2][lane]);
+		_mm_storeu_ps(out + 12, columns[3][lane]);
+	}
+#else
+	for (uint32_t lane = 0; lane < LANES; ++lane) {
+		uint32_t i = first + lane;
+		float x = rotation_x[i], y = rotation_y[i], z = rotation_z[i], w = rotation_w[i];
+		float xx = x * x, yy = y * y, zz = z * z;
+		float xy = x * y, xz = x * z, yz = y * z;
+		float wx = w * x, wy = w * y, wz = w * z;
+
+		glm::mat4& m = local[lane];
+		m[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * scale_x[i];
+		m[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * scale_y[i];
+		m[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * scale_z[i];
+		m[3] = glm::vec4(translation_x[i], translation_y[i], translation_z[i], 1.0f);
+	}
+#endif
+}
+
+// world = parent * local, where local is affine (last row 0 0 0 1).
+void TransformHierarchy::MultiplyMatrices(const glm::mat4& parent, const glm::mat4& local, glm::mat4& world) {
+#ifdef TRANSFORM_HIERARCHY_SSE
+	const float* p = &parent[0][0];
+	const float* l = &local[0][0];
+	float* out = &world[0][0];
+
+	__m128 p0 = _mm_loadu_ps(p + 0);
+	__m128 p1 = _mm_loadu_ps(p + 4);
+	__m128 p2 = _mm_loadu_ps(p + 8);
+	__m128 p3 = _mm_loadu_ps(p + 12);
+
+	for (int column = 0; column < 4; ++column) {
+		__m128 l_column = _mm_loadu_ps(l + column * 4);
+		__m128 result = _mm_mul_ps(p0, _mm_shuffle_ps(l_column, l_column, _MM_SHUFFLE(0, 0, 0, 0)));
+		result = _mm_add_ps(result, _mm_mul_ps(p1, _mm_shuffle_ps(l_column, l_column, _MM_SHUFFLE(1, 1, 1, 1))));
+		result = _mm_add_ps(result, _mm_mul_ps(p2, _mm_shuffle_ps(l_column, l_column, _MM_SHUFFLE(2, 2, 2, 2))));
+		if (column == 3) {
+			result = _mm_add_ps(result, p3);
+		}
+		_mm_storeu_ps(out + column * 4, result);
+	}
+#else
+	for (int column = 0; column < 4; ++column) {
+		world[column] = parent[0] * local[column][0] + parent[1] * local[column][1] + parent[2] * local[column][2];
+	}
+	world[3] += parent[3];
+#endif
+}
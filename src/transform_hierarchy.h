@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+// Scene node transforms stored as structure-of-arrays local TRS. Nodes are kept in an order
+// where every parent precedes its children, so world matrices are produced by a single
+// forward pass that only touches dirty subtrees. World matrices are stored contiguously and
+// can be copied straight into per-instance or uniform buffers.
+class TransformHierarchy {
+public:
+	static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+	// parent must be NO_PARENT or an existing node, which keeps parents ahead of children.
+	uint32_t AddNode(uint32_t parent,
+		const glm::vec3& translation = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		const glm::vec3& scale = glm::vec3(1.0f));
+
+	void SetTranslation(uint32_t node, const glm::vec3& translation);
+	void SetRotation(uint32_t node, const glm::quat& rotation);
+	void SetScale(uint32_t node, const glm::vec3& scale);
+
+	// Recomputes world matrices of every dirty node and its descendants.
+	void Update();
+
+	const glm::mat4& GetWorldMatrix(uint32_t node) const { return world_matrices[node]; }
+	const glm::mat4* GetWorldMatrices() const { return world_matrices.data(); }
+	uint32_t GetParent(uint32_t node) const { return parents[node]; }
+	uint32_t GetNodeCount() const { return node_count; }
+	// Number of world matrices recomputed by the last Update.
+	uint32_t GetUpdatedNodeCount() const { return updated_node_count; }
+
+private:
+	void MarkDirty(uint32_t node);
+	void ComputeLocalMatrices(uint32_t first, glm::mat4* local) const;
+	static void MultiplyMatrices(const glm::mat4& parent, const glm::mat4& local, glm::mat4& world);
+
+	uint32_t node_count = 0;
+	uint32_t updated_node_count = 0;
+	// Lowest dirty node; nothing before it can change, so Update starts there.
+	uint32_t first_dirty = NO_PARENT;
+
+	// Padded to a multiple of 4 so the SIMD pass can always load whole lanes.
+	std::vector<float> translation_x, translation_y, translation_z;
+	std::vector<float> rotation_x, rotation_y, rotation_z, rotation_w;
+	std::vector<float> scale_x, scale_y, scale_z;
+	std::vector<uint32_t> parents;
+	std::vector<uint8_t> dirty;
+
+	std::vector<glm::mat4> world_matrices;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stdint.h>
+
+// Hands values from one writer thread to one reader thread without locks. The writer fills
+// its private buffer and swaps it with the shared one; the reader swaps the shared one for its
+// own when something new was published. Neither side ever waits for the other, and the
+// reader always sees the most recently published value.
+template <typename T>
+class TripleBuffer {
+public:
+	// Writer side: the buffer to fill before Publish.
+	T& GetWriteBuffer() { return buffers[write_index]; }
+
+	void Publish() {
+		uint32_t previous = shared.exchange(write_index | NEW_BIT, std::memory_order_acq_rel);
+		write_index = previous & INDEX_MASK;
+	}
+
+	// Reader side: takes the latest published value, if any. Returns false when nothing was
+	// published since the last call, in which case GetReadBuffer is unchanged.
+	bool Update() {
+		if ((shared.load(std::memory_order_relaxed) & NEW_BIT) == 0) {
+			return false;
+		}
+		uint32_t previous = shared.exchange(read_index, std::memory_order_acq_rel);
+		read_index = previous & INDEX_MASK;
+		return true;
+	}
+
+	const T& GetReadBuffer() const { return buffers[read_index]; }
+
+private:
+	static const uint32_t INDEX_MASK = 3;
+	static const uint32_t NEW_BIT = 4;
+
+	std::array<T, 3> buffers = {};
+	// The indices are each touched by one thread only; keep them off the shared cache line.
+	alignas(64) uint32_t write_index = 0;
+	alignas(64) std::atomic<uint32_t> shared{ 1 };
+	alignas(64) uint32_t read_index = 2;
+};
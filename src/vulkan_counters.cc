@@ -0,0 +1,221 @@
+#include "vulkan_counters.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <iomanip>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+const char* CALL_NAMES[VULKAN_CALL_COUNT] = {
+	"vkQueueSubmit",
+	"vkQueuePresentKHR",
+	"vkAcquireNextImageKHR",
+	"vkAllocateMemory",
+	"vkFreeMemory",
+	"vkMapMemory",
+	"vkUnmapMemory",
+	"vkAllocateDescriptorSets",
+	"vkUpdateDescriptorSets",
+	"vkBeginCommandBuffer",
+	"vkCmdBeginRenderPass",
+	"vkCmdBindPipeline",
+	"vkCmdBindDescriptorSets",
+	"vkCmdBindVertexBuffers",
+	"vkCmdBindIndexBuffer",
+	"vkCmdPushConstants",
+	"vkCmdPipelineBarrier",
+	"vkCmdCopyBuffer",
+	"vkCmdCopyBufferToImage",
+	"vkCmdCopyImageToBuffer",
+	"vkCmdDraw",
+	"vkCmdDrawIndexed",
+	"vkCmdDrawIndirect",
+	"vkCmdDrawIndexedIndirect",
+	"vkCmdDispatch",
+};
+
+thread_local VulkanCallCounts thread_counts;
+
+// In front of every block handed to the driver, ending right before it.
+struct BlockHeader {
+	size_t size;
+	// From the start of the underlying allocation to the block.
+	size_t offset;
+};
+
+const size_t MIN_ALIGNMENT = 16;
+static_assert(sizeof(BlockHeader) <= MIN_ALIGNMENT, "BlockHeader must fit in front of the block");
+
+BlockHeader* GetHeader(void* memory) {
+	return reinterpret_cast<BlockHeader*>(static_cast<char*>(memory) - sizeof(BlockHeader));
+}
+
+}
+
+const char* GetVulkanCallName(VulkanCall call) {
+	return CALL_NAMES[call];
+}
+
+VulkanCallCounts& VulkanCallCounts::operator+=(const VulkanCallCounts& other) {
+	for (size_t i = 0; i < calls.size(); ++i) {
+		calls[i] += other.calls[i];
+	}
+	host_allocations += other.host_allocations;
+	host_allocated_bytes += other.host_allocated_bytes;
+	host_frees += other.host_frees;
+	heap_allocations += other.heap_allocations;
+	return *this;
+}
+
+void CountVulkanCall(VulkanCall call) {
+	++thread_counts.calls[call];
+}
+
+void CountHeapAllocation() {
+	++thread_counts.heap_allocations;
+}
+
+VulkanCallCounts TakeVulkanCallCounts() {
+	VulkanCallCounts counts = thread_counts;
+	thread_counts = VulkanCallCounts();
+	return counts;
+}
+
+bool CheckVulkanFrameBudget(const VulkanCallCounts& counts, const VulkanFrameBudget& budget, std::ostream* violations) {
+	bool within = true;
+	if (counts.host_allocations > budget.max_host_allocations) {
+		within = false;
+		if (violations) {
+			*violations << " host allocations " << counts.host_allocations << " > " << budget.max_host_allocations;
+		}
+	}
+	if (counts.heap_allocations > budget.max_heap_allocations) {
+		within = false;
+		if (violations) {
+			*violations << " heap allocations " << counts.heap_allocations << " > " << budget.max_heap_allocations;
+		}
+	}
+	for (int i = 0; i < VULKAN_CALL_COUNT; ++i) {
+		if (counts.calls[i] > budget.max_calls[i]) {
+			within = false;
+			if (violations) {
+				*violations << " " << GetVulkanCallName(static_cast<VulkanCall>(i)) << " " << counts.calls[i] << " > " << budget.max_calls[i];
+			}
+		}
+	}
+	return within;
+}
+
+void WriteVulkanCallCounts(std::ostream& out, const VulkanCallCounts& counts, uint64_t frames) {
+	double divisor = static_cast<double>(std::max<uint64_t>(frames, 1));
+	out << std::fixed << std::setprecision(1);
+	for (int i = 0; i < VULKAN_CALL_COUNT; ++i) {
+		if (counts.calls[i] != 0) {
+			out << " " << GetVulkanCallName(static_cast<VulkanCall>(i)) << " " << counts.calls[i] / divisor;
+		}
+	}
+	out << " host allocations " << counts.host_allocations / divisor
+		<< " (" << counts.host_allocated_bytes / divisor << " B) frees " << counts.host_frees / divisor
+		<< " heap allocations " << counts.heap_allocations / divisor;
+	out << std::defaultfloat;
+}
+
+CountingAllocator::CountingAllocator(const VkAllocationCallbacks* upstream)
+	: upstream(upstream) {
+	callbacks.pUserData = this;
+	callbacks.pfnAllocation = Allocate;
+	callbacks.pfnReallocation = Reallocate;
+	callbacks.pfnFree = Free;
+	callbacks.pfnInternalAllocation = InternalAllocate;
+	callbacks.pfnInternalFree = InternalFree;
+}
+
+void* CountingAllocator::AllocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+	// The header takes a whole alignment in front of the block, so the block stays aligned.
+	size_t header_size = std::max(alignment, MIN_ALIGNMENT);
+	char* base;
+	char* memory;
+	if (upstream) {
+		base = static_cast<char*>(upstream->pfnAllocation(upstream->pUserData, size + header_size, header_size, scope));
+		if (!base) {
+			return nullptr;
+		}
+		memory = base + header_size;
+	}
+	else {
+		base = static_cast<char*>(malloc(size + header_size * 2));
+		if (!base) {
+			return nullptr;
+		}
+		uintptr_t address = reinterpret_cast<uintptr_t>(base) + header_size;
+		memory = reinterpret_cast<char*>((address + header_size - 1) & ~static_cast<uintptr_t>(header_size - 1));
+	}
+	BlockHeader* header = GetHeader(memory);
+	header->size = size;
+	header->offset = memory - base;
+
+	++allocation_count;
+	++scope_allocation_counts[scope];
+	uint64_t live = live_bytes += size;
+	uint64_t peak = peak_bytes;
+	while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+	}
+	++thread_counts.host_allocations;
+	thread_counts.host_allocated_bytes += size;
+	return memory;
+}
+
+void CountingAllocator::FreeBlock(void* memory) {
+	BlockHeader* header = GetHeader(memory);
+	char* base = static_cast<char*>(memory) - header->offset;
+	++free_count;
+	live_bytes -= header->size;
+	++thread_counts.host_frees;
+	if (upstream) {
+		upstream->pfnFree(upstream->pUserData, base);
+	}
+	else {
+		free(base);
+	}
+}
+
+void* VKAPI_PTR CountingAllocator::Allocate(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	return static_cast<CountingAllocator*>(user_data)->AllocateBlock(size, alignment, scope);
+}
+
+void* VKAPI_PTR CountingAllocator::Reallocate(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	CountingAllocator* allocator = static_cast<CountingAllocator*>(user_data);
+	if (!original) {
+		return allocator->AllocateBlock(size, alignment, scope);
+	}
+	if (size == 0) {
+		allocator->FreeBlock(original);
+		return nullptr;
+	}
+	// Moved every time; the driver seldom reallocates, so there is no point growing in place.
+	void* memory = allocator->AllocateBlock(size, alignment, scope);
+	if (!memory) {
+		return nullptr;
+	}
+	memcpy(memory, original, std::min(size, GetHeader(original)->size));
+	allocator->FreeBlock(original);
+	return memory;
+}
+
+void VKAPI_PTR CountingAllocator::Free(void* user_data, void* memory) {
+	if (memory) {
+		static_cast<CountingAllocator*>(user_data)->FreeBlock(memory);
+	}
+}
+
+// Internal allocations are only reported as a total; type and scope go unused.
+void VKAPI_PTR CountingAllocator::InternalAllocate(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+	static_cast<CountingAllocator*>(user_data)->internal_bytes += size;
+}
+
+void VKAPI_PTR CountingAllocator::InternalFree(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+	static_cast<CountingAllocator*>(user_data)->internal_bytes -= size;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <ostream>
+#include <stdint.h>
+
+// Entry points counted by the wrappers in vulkan_dispatch.h.
+enum VulkanCall {
+	VULKAN_CALL_QUEUE_SUBMIT,
+	VULKAN_CALL_QUEUE_PRESENT,
+	VULKAN_CALL_ACQUIRE_NEXT_IMAGE,
+	VULKAN_CALL_ALLOCATE_MEMORY,
+	VULKAN_CALL_FREE_MEMORY,
+	VULKAN_CALL_MAP_MEMORY,
+	VULKAN_CALL_UNMAP_MEMORY,
+	VULKAN_CALL_ALLOCATE_DESCRIPTOR_SETS,
+	VULKAN_CALL_UPDATE_DESCRIPTOR_SETS,
+	VULKAN_CALL_BEGIN_COMMAND_BUFFER,
+	VULKAN_CALL_BEGIN_RENDER_PASS,
+	VULKAN_CALL_BIND_PIPELINE,
+	VULKAN_CALL_BIND_DESCRIPTOR_SETS,
+	VULKAN_CALL_BIND_VERTEX_BUFFERS,
+	VULKAN_CALL_BIND_INDEX_BUFFER,
+	VULKAN_CALL_PUSH_CONSTANTS,
+	VULKAN_CALL_PIPELINE_BARRIER,
+	VULKAN_CALL_COPY_BUFFER,
+	VULKAN_CALL_COPY_BUFFER_TO_IMAGE,
+	VULKAN_CALL_COPY_IMAGE_TO_BUFFER,
+	VULKAN_CALL_DRAW,
+	VULKAN_CALL_DRAW_INDEXED,
+	VULKAN_CALL_DRAW_INDIRECT,
+	VULKAN_CALL_DRAW_INDEXED_INDIRECT,
+	VULKAN_CALL_DISPATCH,
+	VULKAN_CALL_COUNT,
+};
+
+const char* GetVulkanCallName(VulkanCall call);
+
+// Vulkan calls and driver host allocations of one thread over some span, usually a frame.
+struct VulkanCallCounts {
+	std::array<uint64_t, VULKAN_CALL_COUNT> calls = {};
+	// Allocations and reallocations the driver made through a CountingAllocator, and their
+	// bytes. Frees are counted separately, as a frame may free what an earlier one allocated.
+	uint64_t host_allocations = 0;
+	uint64_t host_allocated_bytes = 0;
+	uint64_t host_frees = 0;
+	// Calls of the global operator new, when the program counts them with CountHeapAllocation.
+	uint64_t heap_allocations = 0;
+
+	VulkanCallCounts& operator+=(const VulkanCallCounts& other);
+};
+
+// Counted per thread, so pipeline compiles on the job system do not show up in the frames of
+// the render thread.
+void CountVulkanCall(VulkanCall call);
+void CountHeapAllocation();
+// The calling thread's counts since its previous call, which are reset.
+VulkanCallCounts TakeVulkanCallCounts();
+
+// Limits for one frame's counts. Calls default to unchecked, host and heap allocations to none.
+struct VulkanFrameBudget {
+	uint64_t max_host_allocations = 0;
+	uint64_t max_heap_allocations = 0;
+	std::array<uint64_t, VULKAN_CALL_COUNT> max_calls;
+
+	VulkanFrameBudget() { max_calls.fill(UINT64_MAX); }
+};
+
+// Returns whether counts stay within budget. Every exceeded limit is written to violations,
+// when given, so a failed assertion can say what went over.
+bool CheckVulkanFrameBudget(const VulkanCallCounts& counts, const VulkanFrameBudget& budget, std::ostream* violations = nullptr);
+
+// One line of the calls made, averaged over frames and leaving out the ones never made.
+void WriteVulkanCallCounts(std::ostream& out, const VulkanCallCounts& counts, uint64_t frames);
+
+// VkAllocationCallbacks that count the driver's host allocations, per thread in
+// VulkanCallCounts and in totals for the process, and pass them on to upstream. Without
+// upstream they come from the C heap. Has to outlive every object created with it.
+class CountingAllocator {
+public:
+	explicit CountingAllocator(const VkAllocationCallbacks* upstream = nullptr);
+
+	const VkAllocationCallbacks* GetCallbacks() const { return &callbacks; }
+
+	uint64_t GetAllocationCount() const { return allocation_count; }
+	uint64_t GetFreeCount() const { return free_count; }
+	uint64_t GetLiveBytes() const { return live_bytes; }
+	uint64_t GetPeakBytes() const { return peak_bytes; }
+	// Allocations by VkSystemAllocationScope, the lifetime the driver asked for.
+	uint64_t GetScopeAllocationCount(VkSystemAllocationScope scope) const { return scope_allocation_counts[scope]; }
+	// Memory the driver allocated itself and only reported, such as executable code.
+	uint64_t GetInternalBytes() const { return internal_bytes; }
+
+private:
+	static void* VKAPI_PTR Allocate(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void* VKAPI_PTR Reallocate(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void VKAPI_PTR Free(void* user_data, void* memory);
+	static void VKAPI_PTR InternalAllocate(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static void VKAPI_PTR InternalFree(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+	void* AllocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void FreeBlock(void* memory);
+
+	VkAllocationCallbacks callbacks;
+	const VkAllocationCallbacks* upstream;
+	std::atomic<uint64_t> allocation_count{ 0 };
+	std::atomic<uint64_t> free_count{ 0 };
+	std::atomic<uint64_t> live_bytes{ 0 };
+	std::atomic<uint64_t> peak_bytes{ 0 };
+	std::atomic<uint64_t> internal_bytes{ 0 };
+	std::array<std::atomic<uint64_t>, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1> scope_allocation_counts = {};
+};
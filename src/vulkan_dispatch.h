@@ -0,0 +1,36 @@
+#pragma once
+
+// Counts every call of the entry points in VulkanCall made after including this header, for
+// the calling thread's VulkanCallCounts. Include it after vulkan.h, and only where the calls
+// should be counted. A macro naming itself is not expanded again, so each one still ends up
+// calling the real function.
+
+#include <vulkan/vulkan.h>
+
+#include "vulkan_counters.h"
+
+#define vkQueueSubmit(...) (CountVulkanCall(VULKAN_CALL_QUEUE_SUBMIT), vkQueueSubmit(__VA_ARGS__))
+#define vkQueuePresentKHR(...) (CountVulkanCall(VULKAN_CALL_QUEUE_PRESENT), vkQueuePresentKHR(__VA_ARGS__))
+#define vkAcquireNextImageKHR(...) (CountVulkanCall(VULKAN_CALL_ACQUIRE_NEXT_IMAGE), vkAcquireNextImageKHR(__VA_ARGS__))
+#define vkAllocateMemory(...) (CountVulkanCall(VULKAN_CALL_ALLOCATE_MEMORY), vkAllocateMemory(__VA_ARGS__))
+#define vkFreeMemory(...) (CountVulkanCall(VULKAN_CALL_FREE_MEMORY), vkFreeMemory(__VA_ARGS__))
+#define vkMapMemory(...) (CountVulkanCall(VULKAN_CALL_MAP_MEMORY), vkMapMemory(__VA_ARGS__))
+#define vkUnmapMemory(...) (CountVulkanCall(VULKAN_CALL_UNMAP_MEMORY), vkUnmapMemory(__VA_ARGS__))
+#define vkAllocateDescriptorSets(...) (CountVulkanCall(VULKAN_CALL_ALLOCATE_DESCRIPTOR_SETS), vkAllocateDescriptorSets(__VA_ARGS__))
+#define vkUpdateDescriptorSets(...) (CountVulkanCall(VULKAN_CALL_UPDATE_DESCRIPTOR_SETS), vkUpdateDescriptorSets(__VA_ARGS__))
+#define vkBeginCommandBuffer(...) (CountVulkanCall(VULKAN_CALL_BEGIN_COMMAND_BUFFER), vkBeginCommandBuffer(__VA_ARGS__))
+#define vkCmdBeginRenderPass(...) (CountVulkanCall(VULKAN_CALL_BEGIN_RENDER_PASS), vkCmdBeginRenderPass(__VA_ARGS__))
+#define vkCmdBindPipeline(...) (CountVulkanCall(VULKAN_CALL_BIND_PIPELINE), vkCmdBindPipeline(__VA_ARGS__))
+#define vkCmdBindDescriptorSets(...) (CountVulkanCall(VULKAN_CALL_BIND_DESCRIPTOR_SETS), vkCmdBindDescriptorSets(__VA_ARGS__))
+#define vkCmdBindVertexBuffers(...) (CountVulkanCall(VULKAN_CALL_BIND_VERTEX_BUFFERS), vkCmdBindVertexBuffers(__VA_ARGS__))
+#define vkCmdBindIndexBuffer(...) (CountVulkanCall(VULKAN_CALL_BIND_INDEX_BUFFER), vkCmdBindIndexBuffer(__VA_ARGS__))
+#define vkCmdPushConstants(...) (CountVulkanCall(VULKAN_CALL_PUSH_CONSTANTS), vkCmdPushConstants(__VA_ARGS__))
+#define vkCmdPipelineBarrier(...) (CountVulkanCall(VULKAN_CALL_PIPELINE_BARRIER), vkCmdPipelineBarrier(__VA_ARGS__))
+#define vkCmdCopyBuffer(...) (CountVulkanCall(VULKAN_CALL_COPY_BUFFER), vkCmdCopyBuffer(__VA_ARGS__))
+#define vkCmdCopyBufferToImage(...) (CountVulkanCall(VULKAN_CALL_COPY_BUFFER_TO_IMAGE), vkCmdCopyBufferToImage(__VA_ARGS__))
+#define vkCmdCopyImageToBuffer(...) (CountVulkanCall(VULKAN_CALL_COPY_IMAGE_TO_BUFFER), vkCmdCopyImageToBuffer(__VA_ARGS__))
+#define vkCmdDraw(...) (CountVulkanCall(VULKAN_CALL_DRAW), vkCmdDraw(__VA_ARGS__))
+#define vkCmdDrawIndexed(...) (CountVulkanCall(VULKAN_CALL_DRAW_INDEXED), vkCmdDrawIndexed(__VA_ARGS__))
+#define vkCmdDrawIndirect(...) (CountVulkanCall(VULKAN_CALL_DRAW_INDIRECT), vkCmdDrawIndirect(__VA_ARGS__))
+#define vkCmdDrawIndexedIndirect(...) (CountVulkanCall(VULKAN_CALL_DRAW_INDEXED_INDIRECT), vkCmdDrawIndexedIndirect(__VA_ARGS__))
+#define vkCmdDispatch(...) (CountVulkanCall(VULKAN_CALL_DISPATCH), vkCmdDispatch(__VA_ARGS__))
@@ -0,0 +1,64 @@
+// Build-time texture transcoder: decodes a PPM, generates the mip chain and writes one
+// container per GPU format, so the renderer uploads blocks as they are without any decoding.
+//
+// usage: texture_compiler <input.ppm> <output base name>
+
+#include "block_compression.h"
+#include "texture_container.h"
+#include "texture_data.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+namespace {
+
+std::vector<MipLevel> Compress(VkFormat format, const std::vector<MipLevel>& mips) {
+	std::vector<MipLevel> levels;
+	for (const auto& mip : mips) {
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			levels.push_back(CompressBc1(mip));
+			break;
+		case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+			levels.push_back(CompressEtc2Rgb(mip));
+			break;
+		default:
+			levels.push_back(mip);
+			break;
+		}
+	}
+	return levels;
+}
+
+}
+
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		std::cerr << "usage: texture_compiler <input.ppm> <output base name>" << std::endl;
+		return 1;
+	}
+
+	std::ifstream input(argv[1], std::ios::binary);
+	std::vector<char> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+	MipLevel base;
+	if (!DecodePpm(file, base)) {
+		std::cerr << "texture_compiler: cannot decode " << argv[1] << std::endl;
+		return 1;
+	}
+	std::vector<MipLevel> mips = GenerateMipChain(std::move(base));
+
+	for (const auto& container_format : TEXTURE_CONTAINER_FORMATS) {
+		std::vector<char> container = WriteTextureContainer(container_format.format, Compress(container_format.format, mips));
+
+		std::string path = std::string(argv[2]) + container_format.suffix;
+		std::ofstream output(path, std::ios::binary);
+		output.write(container.data(), container.size());
+		if (!output) {
+			std::cerr << "texture_compiler: cannot write " << path << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}